@@ -0,0 +1,213 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+//  File           : crud_arena.c
+//  Description    : This is the implementation of the scratch arena of the
+//                   CRUD file system.  Buffers are handed out in power of
+//                   two size classes; a freed buffer goes onto the free list
+//                   of its class and is handed out again by the next request
+//                   of that class, so the heap is only touched while the
+//                   arena warms up.  Each buffer carries a small header
+//                   naming its class.
+//
+//  Last Modified  : Sun Oct 18 12:21:44 EDT 2026
+//
+
+// Includes
+#include <stdlib.h>
+#include <string.h>
+
+// Project Includes
+#include <crud_arena.h>
+#include <crud_log.h>
+
+// Type definitions
+
+// This is the header in front of every arena buffer
+typedef union CrudArenaBuffer {
+	struct {
+		uint32_t                klass; // The size class of the buffer
+		union CrudArenaBuffer  *next;  // The next free buffer of the class
+	} hdr;
+	uint64_t align[2];                 // Keep the data 16 byte aligned
+} CrudArenaBuffer;
+
+// This is a size class of the arena
+typedef struct {
+	CrudArenaBuffer *free;  // The free buffers of the class
+	uint32_t         count; // The number of free buffers
+} CrudArenaClass;
+
+//
+// Global Data
+
+static CrudArenaClass crud_arena[CRUD_ARENA_CLASSES]; // The size classes
+static uint64_t crud_arena_mallocs;                   // Buffers taken from the heap
+
+//
+// Functions
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : crud_arena_alloc
+// Description  : Get a buffer of at least size bytes, reusing a free buffer
+//                of the size class if there is one
+//
+// Inputs       : size - the number of bytes needed
+// Outputs      : the buffer, or NULL if larger than the largest class
+
+void *crud_arena_alloc( uint32_t size ) {
+
+	// Local variables
+	CrudArenaBuffer *b;
+	uint32_t klass = 0;
+
+	// Find the smallest class that fits
+	while ( (klass < CRUD_ARENA_CLASSES) && ((1U << (klass+CRUD_ARENA_MIN_SHIFT)) < size) ) {
+		klass++;
+	}
+	if ( klass == CRUD_ARENA_CLASSES ) {
+		CRUD_LOG( LOG_ERROR_LEVEL, "CRUD arena: buffer of %u bytes is too large", size );
+		return( NULL );
+	}
+
+	// Reuse a free buffer, else take one from the heap
+	if ( (b = crud_arena[klass].free) != NULL ) {
+		crud_arena[klass].free = b->hdr.next;
+		crud_arena[klass].count--;
+	} else {
+		b = malloc( sizeof(CrudArenaBuffer) + (1U << (klass+CRUD_ARENA_MIN_SHIFT)) );
+		b->hdr.klass = klass;
+		crud_arena_mallocs++;
+	}
+	return( b + 1 );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : crud_arena_free
+// Description  : Give a buffer back to its size class (the heap gets it if
+//                the class already holds enough free buffers)
+//
+// Inputs       : buf - the buffer (NULL is ignored)
+// Outputs      : none
+
+void crud_arena_free( void *buf ) {
+
+	// Local variables
+	CrudArenaBuffer *b;
+	CrudArenaClass *c;
+
+	// Find the header, push the buffer on its class
+	if ( buf == NULL ) {
+		return;
+	}
+	b = (CrudArenaBuffer *)buf - 1;
+	c = &crud_arena[b->hdr.klass];
+	if ( c->count >= CRUD_ARENA_CLASS_DEPTH ) {
+		free( b );
+		return;
+	}
+	b->hdr.next = c->free;
+	c->free = b;
+	c->count++;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : crud_arena_release
+// Description  : Return every free buffer to the heap
+//
+// Inputs       : none
+// Outputs      : none
+
+void crud_arena_release( void ) {
+
+	// Local variables
+	CrudArenaBuffer *b;
+	int i;
+
+	// Empty each class
+	for ( i=0; i<CRUD_ARENA_CLASSES; i++ ) {
+		while ( (b = crud_arena[i].free) != NULL ) {
+			crud_arena[i].free = b->hdr.next;
+			free( b );
+		}
+		crud_arena[i].count = 0;
+	}
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : crud_arena_heap_allocations
+// Description  : Number of buffers the arena has taken from the heap
+//
+// Inputs       : none
+// Outputs      : the count
+
+uint64_t crud_arena_heap_allocations( void ) {
+	return( crud_arena_mallocs );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : crudArenaUnitTest
+// Description  : Check that buffers are reused by size class and that a
+//                warmed up arena makes no heap allocations
+//
+// Inputs       : none
+// Outputs      : 0 if successful, -1 if failure
+
+int crudArenaUnitTest( void ) {
+
+	// Local variables
+	uint8_t *bufs[CRUD_ARENA_CLASS_DEPTH];
+	uint32_t sizes[CRUD_ARENA_CLASS_DEPTH], size, k;
+	uint64_t warm;
+	int i, j;
+
+	// Sizes past the largest class are refused
+	if ( crud_arena_alloc((1U << CRUD_ARENA_MAX_SHIFT) + 1) != NULL ) {
+		CRUD_LOG( LOG_ERROR_LEVEL, "CRUD_ARENA_UNIT_TEST : oversized buffer was allocated." );
+		return( -1 );
+	}
+
+	// Warm up every class to its full depth
+	crud_arena_release();
+	for ( size=1U << CRUD_ARENA_MIN_SHIFT; size <= (1U << CRUD_ARENA_MAX_SHIFT); size <<= 1 ) {
+		for ( i=0; i<CRUD_ARENA_CLASS_DEPTH; i++ ) {
+			bufs[i] = crud_arena_alloc( size );
+		}
+		for ( i=0; i<CRUD_ARENA_CLASS_DEPTH; i++ ) {
+			crud_arena_free( bufs[i] );
+		}
+	}
+	warm = crud_arena_heap_allocations();
+
+	// Random sizes from the warm arena, each buffer must hold its own data
+	for ( j=0; j<256; j++ ) {
+		for ( i=0; i<CRUD_ARENA_CLASS_DEPTH; i++ ) {
+			sizes[i] = 1 + (uint32_t)(j * 7919 + i * 104729) % (1U << CRUD_ARENA_MAX_SHIFT);
+			bufs[i] = crud_arena_alloc( sizes[i] );
+			memset( bufs[i], i+j, sizes[i] );
+		}
+		for ( i=0; i<CRUD_ARENA_CLASS_DEPTH; i++ ) {
+			for ( k=0; k<sizes[i]; k+=sizes[i]/16+1 ) {
+				if ( bufs[i][k] != (uint8_t)(i+j) ) {
+					CRUD_LOG( LOG_ERROR_LEVEL, "CRUD_ARENA_UNIT_TEST : buffers overlap." );
+					return( -1 );
+				}
+			}
+			crud_arena_free( bufs[i] );
+		}
+	}
+	if ( crud_arena_heap_allocations() != warm ) {
+		CRUD_LOG( LOG_ERROR_LEVEL, "CRUD_ARENA_UNIT_TEST : warm arena allocated from the heap [%lu]",
+				crud_arena_heap_allocations() - warm );
+		return( -1 );
+	}
+	crud_arena_release();
+
+	// Log, return successfully
+	CRUD_LOG( LOG_INFO_LEVEL, "CRUD arena unit tests completed successfully." );
+	return( 0 );
+}
@@ -0,0 +1,45 @@
+#ifndef CRUD_ARENA_INCLUDED
+#define CRUD_ARENA_INCLUDED
+
+////////////////////////////////////////////////////////////////////////////////
+//
+//  File           : crud_arena.h
+//  Description    : This is the interface for the scratch arena of the CRUD
+//                   file system: a pool of reusable, size-classed buffers
+//                   that lives for one mount, so the I/O path does not go to
+//                   the heap once it has warmed up.
+//
+//  Last Modified  : Sun Oct 18 12:21:44 EDT 2026
+//
+
+// Includes
+#include <stdint.h>
+
+// Defines
+#define CRUD_ARENA_MIN_SHIFT 8    // smallest size class is 256 bytes
+#define CRUD_ARENA_MAX_SHIFT 20   // largest size class is 1 MB (holds any object)
+#define CRUD_ARENA_CLASSES (CRUD_ARENA_MAX_SHIFT - CRUD_ARENA_MIN_SHIFT + 1)
+#define CRUD_ARENA_CLASS_DEPTH 8  // free buffers kept per size class
+
+//
+// Arena interface
+
+void *crud_arena_alloc( uint32_t size );
+	// Get a buffer of at least size bytes (NULL if larger than the largest class)
+
+void crud_arena_free( void *buf );
+	// Give a buffer back to the arena (NULL is ignored)
+
+void crud_arena_release( void );
+	// Return every free buffer to the heap (at unmount)
+
+uint64_t crud_arena_heap_allocations( void );
+	// Number of buffers the arena has taken from the heap
+
+//
+// Unit testing for the module
+
+int crudArenaUnitTest( void );
+	// Perform a test of the arena
+
+#endif
@@ -0,0 +1,460 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+//  File           : crud_backend.c
+//  Description    : This is the storage backend registry and the backend for
+//                   the CRUD device linked into the program.
+//
+//  Last Modified  : Sun Oct 18 21:48:10 EDT 2026
+//
+
+// Includes
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <time.h>
+
+// Project Includes
+#include <crud_backend.h>
+#include <crud_log.h>
+
+// Type definitions
+
+// This is a request queued on a worker
+typedef struct {
+	CrudRequest       request;  // The request
+	void             *buf;      // The buffer of the request
+	CrudResponse     *response; // Where the response goes
+	CrudBackendWait  *wait;     // The wait counting it
+} CrudBackendJob;
+
+// This is a thread issuing the requests of one backend
+struct CrudBackendWorker {
+	CrudBackend      *be;       // The backend
+	pthread_t         thread;   // The thread
+	pthread_mutex_t   mutex;    // Guards the queue
+	pthread_cond_t    queued;   // Signalled when a job is queued (or stopping)
+	CrudBackendJob   *jobs;     // The queue (a ring)
+	uint32_t          head;     // The first job
+	uint32_t          count;    // The jobs queued
+	uint32_t          slots;    // The slots of the ring
+	uint32_t          busy;     // The requests queued or being issued
+	double            average;  // The moving average time of a request (us)
+	int               stopping; // Flag telling the thread to finish
+};
+
+// This is an entry in the backend registry
+typedef struct {
+	const char   *name;                           // The name of the backend
+	CrudBackend *(*create)( const char *arg );    // The constructor
+} CrudBackendType;
+
+//
+// Global Data
+
+static CrudBackendType crud_backend_types[] = {
+	{ "crud",    crud_device_backend_create },
+	{ "memory",  crud_memory_backend_create },
+	{ "file",    crud_file_backend_create },
+	{ "latency", crud_latency_backend_create },
+	{ "stripe",  crud_stripe_backend_create },
+	{ NULL,      NULL }
+};
+
+//
+// Functions
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : crud_backend_create
+// Description  : Create a backend from a "name[:argument]" specification
+//
+// Inputs       : spec - the backend specification
+// Outputs      : the backend, or NULL if failure
+
+CrudBackend *crud_backend_create( const char *spec ) {
+
+	// Local variables
+	const char *arg;
+	size_t len;
+	int i;
+
+	// Split off the argument, then look up the name
+	arg = strchr( spec, ':' );
+	len = (arg == NULL) ? strlen(spec) : (size_t)(arg - spec);
+	for ( i=0; crud_backend_types[i].name != NULL; i++ ) {
+		if ( (strlen(crud_backend_types[i].name) == len) &&
+			 (strncmp(crud_backend_types[i].name, spec, len) == 0) ) {
+			return( crud_backend_types[i].create((arg == NULL) ? NULL : arg+1) );
+		}
+	}
+
+	// Not found
+	CRUD_LOG( LOG_ERROR_LEVEL, "CRUD: unknown storage backend [%s]", spec );
+	return( NULL );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : crud_backend_destroy
+// Description  : Release a backend
+//
+// Inputs       : be - the backend
+// Outputs      : none
+
+void crud_backend_destroy( CrudBackend *be ) {
+	if ( be != NULL ) {
+		be->destroy( be );
+	}
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : crud_backend_serial_batch
+// Description  : Batch implementation that issues the requests one after
+//                the other (for stores with no better way)
+//
+// Inputs       : be - the backend
+//                requests - the requests
+//                bufs - the buffer of each request
+//                responses - the response of each request (out)
+//                count - the number of requests
+// Outputs      : 0 if every request succeeded, -1 otherwise
+
+int crud_backend_serial_batch( CrudBackend *be, CrudRequest *requests, void **bufs,
+		CrudResponse *responses, int count ) {
+
+	// Local variables
+	int i, failed = 0;
+
+	// Issue each request, noting failures
+	for ( i=0; i<count; i++ ) {
+		responses[i] = be->request( be, requests[i], bufs[i] );
+		if ( responses[i] & 0x1 ) {
+			failed = 1;
+		}
+	}
+	return( failed ? -1 : 0 );
+}
+
+//
+// Backend workers
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : crud_backend_worker_timed
+// Description  : Issue a request of a worker, folding the time it took into
+//                the moving average and counting it done
+//
+// Inputs       : worker - the worker
+//                request - the request
+//                buf - the buffer of the request
+// Outputs      : the response
+
+static CrudResponse crud_backend_worker_timed( CrudBackendWorker *worker, CrudRequest request, void *buf ) {
+
+	// Local variables
+	struct timespec start, end;
+	CrudResponse response;
+	double took;
+
+	clock_gettime( CLOCK_MONOTONIC, &start );
+	response = worker->be->request( worker->be, request, buf );
+	clock_gettime( CLOCK_MONOTONIC, &end );
+	took = (end.tv_sec - start.tv_sec) * 1000000.0 + (end.tv_nsec - start.tv_nsec) / 1000.0;
+	pthread_mutex_lock( &worker->mutex );
+	worker->average += (took - worker->average) / 8;
+	worker->busy--;
+	pthread_mutex_unlock( &worker->mutex );
+	return( response );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : crud_backend_worker_run
+// Description  : Issue the queued requests until told to stop
+//
+// Inputs       : arg - the worker
+// Outputs      : NULL
+
+static void *crud_backend_worker_run( void *arg ) {
+
+	// Local variables
+	CrudBackendWorker *worker = arg;
+	CrudBackendJob job;
+
+	pthread_mutex_lock( &worker->mutex );
+	while ( 1 ) {
+		while ( (worker->count == 0) && !worker->stopping ) {
+			pthread_cond_wait( &worker->queued, &worker->mutex );
+		}
+		if ( worker->count == 0 ) {
+			break;
+		}
+		job = worker->jobs[worker->head];
+		worker->head = (worker->head + 1) % worker->slots;
+		worker->count--;
+
+		// Issue it without the lock, then count it answered
+		pthread_mutex_unlock( &worker->mutex );
+		*job.response = crud_backend_worker_timed( worker, job.request, job.buf );
+		pthread_mutex_lock( &job.wait->mutex );
+		if ( --job.wait->pending == 0 ) {
+			pthread_cond_signal( &job.wait->done );
+		}
+		pthread_mutex_unlock( &job.wait->mutex );
+		pthread_mutex_lock( &worker->mutex );
+	}
+	pthread_mutex_unlock( &worker->mutex );
+	return( NULL );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : crud_backend_worker_start
+// Description  : Start a thread issuing requests to a backend
+//
+// Inputs       : be - the backend
+// Outputs      : the worker, or NULL if failure
+
+CrudBackendWorker *crud_backend_worker_start( CrudBackend *be ) {
+
+	// Local variables
+	CrudBackendWorker *worker = calloc( 1, sizeof(CrudBackendWorker) );
+
+	worker->be = be;
+	pthread_mutex_init( &worker->mutex, NULL );
+	pthread_cond_init( &worker->queued, NULL );
+	if ( pthread_create(&worker->thread, NULL, crud_backend_worker_run, worker) ) {
+		CRUD_LOG( LOG_ERROR_LEVEL, "CRUD: cannot start a worker for [%s]", be->name );
+		free( worker );
+		return( NULL );
+	}
+	return( worker );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : crud_backend_worker_stop
+// Description  : Finish the queued requests and stop the thread
+//
+// Inputs       : worker - the worker
+// Outputs      : none
+
+void crud_backend_worker_stop( CrudBackendWorker *worker ) {
+	if ( worker != NULL ) {
+		pthread_mutex_lock( &worker->mutex );
+		worker->stopping = 1;
+		pthread_cond_signal( &worker->queued );
+		pthread_mutex_unlock( &worker->mutex );
+		pthread_join( worker->thread, NULL );
+		pthread_mutex_destroy( &worker->mutex );
+		pthread_cond_destroy( &worker->queued );
+		free( worker->jobs );
+		free( worker );
+	}
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : crud_backend_worker_queue
+// Description  : Queue a request on a worker (the ring doubles when full)
+//
+// Inputs       : worker - the worker
+//                request - the request
+//                buf - the buffer of the request
+//                response - where the response goes
+//                wait - the wait counting the request (already counted)
+// Outputs      : none
+
+void crud_backend_worker_queue( CrudBackendWorker *worker, CrudRequest request, void *buf,
+		CrudResponse *response, CrudBackendWait *wait ) {
+
+	// Local variables
+	uint32_t i, slots;
+	CrudBackendJob *jobs;
+
+	pthread_mutex_lock( &wait->mutex );
+	wait->pending++;
+	pthread_mutex_unlock( &wait->mutex );
+	pthread_mutex_lock( &worker->mutex );
+	if ( worker->count == worker->slots ) {
+		slots = (worker->slots == 0) ? 16 : worker->slots * 2;
+		jobs = malloc( sizeof(CrudBackendJob) * slots );
+		for ( i=0; i<worker->count; i++ ) {
+			jobs[i] = worker->jobs[(worker->head + i) % worker->slots];
+		}
+		free( worker->jobs );
+		worker->jobs = jobs;
+		worker->slots = slots;
+		worker->head = 0;
+	}
+	worker->jobs[(worker->head + worker->count) % worker->slots] = (CrudBackendJob){ request, buf, response, wait };
+	worker->count++;
+	worker->busy++;
+	pthread_cond_signal( &worker->queued );
+	pthread_mutex_unlock( &worker->mutex );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : crud_backend_worker_issue
+// Description  : Issue a request of a worker's backend from the calling
+//                thread (timed and counted as the worker's own)
+//
+// Inputs       : worker - the worker
+//                request - the request
+//                buf - the buffer of the request
+// Outputs      : the response
+
+CrudResponse crud_backend_worker_issue( CrudBackendWorker *worker, CrudRequest request, void *buf ) {
+	pthread_mutex_lock( &worker->mutex );
+	worker->busy++;
+	pthread_mutex_unlock( &worker->mutex );
+	return( crud_backend_worker_timed(worker, request, buf) );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : crud_backend_worker_estimate
+// Description  : Estimate how long a request given to a worker now would
+//                take to be answered (what is ahead of it, and itself)
+//
+// Inputs       : worker - the worker
+// Outputs      : the estimate in microseconds
+
+double crud_backend_worker_estimate( CrudBackendWorker *worker ) {
+
+	// Local variables
+	double estimate;
+
+	pthread_mutex_lock( &worker->mutex );
+	estimate = (worker->busy + 1) * worker->average;
+	pthread_mutex_unlock( &worker->mutex );
+	return( estimate );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : crud_backend_wait_init
+// Description  : Set up a wait with nothing pending
+//
+// Inputs       : wait - the wait
+// Outputs      : none
+
+void crud_backend_wait_init( CrudBackendWait *wait ) {
+	pthread_mutex_init( &wait->mutex, NULL );
+	pthread_cond_init( &wait->done, NULL );
+	wait->pending = 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : crud_backend_wait
+// Description  : Wait for every request of a wait to be answered, then clean
+//                the wait up
+//
+// Inputs       : wait - the wait
+// Outputs      : none
+
+void crud_backend_wait( CrudBackendWait *wait ) {
+	pthread_mutex_lock( &wait->mutex );
+	while ( wait->pending > 0 ) {
+		pthread_cond_wait( &wait->done, &wait->mutex );
+	}
+	pthread_mutex_unlock( &wait->mutex );
+	pthread_mutex_destroy( &wait->mutex );
+	pthread_cond_destroy( &wait->done );
+}
+
+//
+// CRUD device backend
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : crud_device_request
+// Description  : Execute a request on the CRUD device
+//
+// Inputs       : be - the backend
+//                request - the request
+//                buf - the buffer for the request
+// Outputs      : the response
+
+static CrudResponse crud_device_request( CrudBackend *be, CrudRequest request, void *buf ) {
+	return( crud_bus_request(request, buf) );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : crud_device_save
+// Description  : Save the CRUD device to a file
+//
+// Inputs       : be - the backend
+//                fname - the store file
+// Outputs      : 0 if successful, -1 if failure
+
+static int crud_device_save( CrudBackend *be, char *fname ) {
+	return( crud_save_store(fname) );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : crud_device_load
+// Description  : Load the CRUD device from a file
+//
+// Inputs       : be - the backend
+//                fname - the store file
+// Outputs      : 0 if successful, -1 if failure
+
+static int crud_device_load( CrudBackend *be, char *fname ) {
+	return( crud_load_store(fname) );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : crud_device_sync
+// Description  : Make the CRUD device durable by saving it to its store file
+//                (the device writes back only the objects that changed)
+//
+// Inputs       : be - the backend
+// Outputs      : 0 if successful, -1 if failure
+
+static int crud_device_sync( CrudBackend *be ) {
+	return( crud_save_store(CRUD_DEVICE_STORE_FILE) );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : crud_device_destroy
+// Description  : Release the CRUD device backend (the device stays as is)
+//
+// Inputs       : be - the backend
+// Outputs      : none
+
+static void crud_device_destroy( CrudBackend *be ) {
+	free( be );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : crud_device_backend_create
+// Description  : Create the backend for the CRUD device linked into the
+//                program (crud_bus_request)
+//
+// Inputs       : arg - unused
+// Outputs      : the backend
+
+CrudBackend *crud_device_backend_create( const char *arg ) {
+
+	// Local variables
+	CrudBackend *be = calloc( 1, sizeof(CrudBackend) );
+
+	// Fill in the interface
+	be->name = "crud";
+	be->request = crud_device_request;
+	be->batch = crud_backend_serial_batch;
+	be->save = crud_device_save;
+	be->load = crud_device_load;
+	be->sync = crud_device_sync;
+	be->destroy = crud_device_destroy;
+	return( be );
+}
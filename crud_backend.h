@@ -0,0 +1,125 @@
+#ifndef CRUD_BACKEND_INCLUDED
+#define CRUD_BACKEND_INCLUDED
+
+////////////////////////////////////////////////////////////////////////////////
+//
+//  File           : crud_backend.h
+//  Description    : This is the interface for the storage backends used by
+//                   the CRUD file I/O layer.  A backend carries CRUD requests
+//                   to an object store; the file system picks one when it
+//                   mounts.
+//
+//  Last Modified  : Sun Oct 18 21:48:10 EDT 2026
+//
+
+// Includes
+#include <stdint.h>
+#include <pthread.h>
+
+// Project includes
+#include <crud_driver.h>
+
+// Defines
+#define CRUD_DEFAULT_BACKEND "crud"
+#define CRUD_FILE_BACKEND_DIR "crud_objects"
+#define CRUD_DEVICE_STORE_FILE "crud_content.crd" // the file the CRUD device keeps its store in
+#define CRUD_STRIPE_UNIT (64*1024)                // bytes of an object put on a volume before the next
+#define CRUD_STRIPE_MAX_VOLUMES 16
+
+// Type definitions
+
+// This is a storage backend (the state is private to the backend)
+typedef struct CrudBackend {
+	const char   *name;   // The name of the backend
+	CrudResponse (*request)( struct CrudBackend *be, CrudRequest request, void *buf );
+		// Execute a single request
+	int          (*batch)( struct CrudBackend *be, CrudRequest *requests, void **bufs,
+	                       CrudResponse *responses, int count );
+		// Execute a list of requests, 0 if every one succeeded
+	int          (*save)( struct CrudBackend *be, char *fname );
+		// Write the contents of the store to a file
+	int          (*load)( struct CrudBackend *be, char *fname );
+		// Read the contents of the store from a file
+	int          (*sync)( struct CrudBackend *be );
+		// Make the store durable as it is now (what survives a crash)
+	void         (*destroy)( struct CrudBackend *be );
+		// Release the backend
+	void         *state;  // The backend state
+} CrudBackend;
+
+// This is a thread issuing the requests of one backend, in the order queued
+typedef struct CrudBackendWorker CrudBackendWorker;
+
+// This is a set of queued requests being waited for
+typedef struct {
+	pthread_mutex_t  mutex;    // Guards pending
+	pthread_cond_t   done;     // Signalled when pending reaches zero
+	int              pending;  // Requests not answered yet
+} CrudBackendWait;
+
+//
+// Backend interface
+
+CrudBackend *crud_backend_create( const char *spec );
+	// Create a backend from a "name[:argument]" specification
+
+void crud_backend_destroy( CrudBackend *be );
+	// Release a backend
+
+int crud_backend_serial_batch( CrudBackend *be, CrudRequest *requests, void **bufs,
+		CrudResponse *responses, int count );
+	// Batch implementation that issues the requests one after the other
+
+//
+// Backend workers
+
+CrudBackendWorker *crud_backend_worker_start( CrudBackend *be );
+	// Start a thread issuing requests to the backend
+
+void crud_backend_worker_stop( CrudBackendWorker *worker );
+	// Finish the queued requests and stop the thread
+
+void crud_backend_worker_queue( CrudBackendWorker *worker, CrudRequest request, void *buf,
+		CrudResponse *response, CrudBackendWait *wait );
+	// Queue a request, its response is stored and wait counted down when answered
+
+CrudResponse crud_backend_worker_issue( CrudBackendWorker *worker, CrudRequest request, void *buf );
+	// Issue a request from the calling thread, counted as the worker's
+
+double crud_backend_worker_estimate( CrudBackendWorker *worker );
+	// Estimate the microseconds a request given to the worker now would take
+
+void crud_backend_wait_init( CrudBackendWait *wait );
+	// Set up a wait with nothing pending
+
+void crud_backend_wait( CrudBackendWait *wait );
+	// Wait for every request of the wait to be answered, and clean it up
+
+//
+// Backend constructors
+
+CrudBackend *crud_device_backend_create( const char *arg );
+	// The CRUD device linked into the program (crud_bus_request)
+
+CrudBackend *crud_memory_backend_create( const char *arg );
+	// A volatile in-process object store
+
+CrudBackend *crud_file_backend_create( const char *arg );
+	// An object store keeping one host file per object (arg is the directory)
+
+CrudBackend *crud_latency_backend_create( const char *arg );
+	// A device model wrapping another backend (arg is "model[@backend]")
+
+CrudBackend *crud_latency_backend_wrap( CrudBackend *inner, const char *model );
+	// Wrap a backend in a device model (latency, bandwidth, jitter, failures)
+
+CrudBackend *crud_stripe_backend_create( const char *arg );
+	// Objects striped over volumes (arg is "[map=<file>+][unit=<n>+][copies=<n>+]<backend>+<backend>...")
+
+//
+// Unit testing for the module
+
+int crudStripeUnitTest( void );
+	// Perform a test of the striped (and mirrored) backend
+
+#endif
@@ -0,0 +1,363 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+//  File           : crud_backend_file.c
+//  Description    : This is an object store backend that keeps one host file
+//                   per object in a directory (named by OID), plus a small
+//                   "store" file holding the next OID and the priority
+//                   object.  Every request goes straight to the host file
+//                   system, so the contents persist without a save (and are
+//                   durable once the host file system is synced).
+//
+//  Last Modified  : Sun Oct 18 10:02:17 EDT 2026
+//
+
+// Includes
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <sys/stat.h>
+
+// Project Includes
+#include <crud_backend.h>
+#include <crud_log.h>
+
+// Defines
+#define CRUD_FILE_FIRST_OID 4096
+#define CRUD_FILE_META "store"
+#define CRUD_FILE_MAX_PATH 512
+
+// Type definitions
+
+// This is the state of a file backend
+typedef struct {
+	char      dir[CRUD_FILE_MAX_PATH]; // The directory holding the objects
+	CrudOID   next_oid;                // The next OID to hand out
+	CrudOID   priority_oid;            // The priority object (CRUD_NO_OBJECT if none)
+} CrudFileStore;
+
+//
+// Functional Prototypes
+
+CrudRequest construct_crud_request(CrudOID oid, CRUD_REQUEST_TYPES req,
+		uint32_t length, uint8_t flags, uint8_t res);
+int deconstruct_crud_request(CrudRequest request, CrudOID *oid,
+		CRUD_REQUEST_TYPES *req, uint32_t *length, uint8_t *flags,
+		uint8_t *res);
+
+//
+// Module local methods
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : crud_file_meta
+// Description  : Read or write the store file of the directory
+//
+// Inputs       : fs - the store
+//                store - 1 to write the store file, 0 to read it
+// Outputs      : 0 if successful, -1 if failure
+
+static int crud_file_meta( CrudFileStore *fs, int store ) {
+
+	// Local variables
+	char path[CRUD_FILE_MAX_PATH*2];
+	CrudOID meta[2];
+	int fh, ret = 0;
+
+	// A missing store file means an empty store
+	snprintf( path, sizeof(path), "%s/%s", fs->dir, CRUD_FILE_META );
+	if ( ! store ) {
+		fs->next_oid = CRUD_FILE_FIRST_OID;
+		fs->priority_oid = CRUD_NO_OBJECT;
+		if ( (fh = open(path, O_RDONLY)) == -1 ) {
+			return( (errno == ENOENT) ? 0 : -1 );
+		}
+		if ( read(fh, meta, sizeof(meta)) == sizeof(meta) ) {
+			fs->next_oid = meta[0];
+			fs->priority_oid = meta[1];
+		} else {
+			ret = -1;
+		}
+		close( fh );
+		return( ret );
+	}
+
+	// Write it
+	meta[0] = fs->next_oid;
+	meta[1] = fs->priority_oid;
+	if ( (fh = open(path, O_WRONLY|O_CREAT|O_TRUNC, S_IRUSR|S_IWUSR)) == -1 ) {
+		return( -1 );
+	}
+	if ( (write(fh, meta, sizeof(meta)) != sizeof(meta)) || (fsync(fh) == -1) ) {
+		ret = -1;
+	}
+	close( fh );
+	return( ret );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : crud_file_format
+// Description  : Remove every object file from the directory
+//
+// Inputs       : fs - the store
+// Outputs      : 0 if successful, -1 if failure
+
+static int crud_file_format( CrudFileStore *fs ) {
+
+	// Local variables
+	char path[CRUD_FILE_MAX_PATH*2];
+	struct dirent *ent;
+	DIR *dh;
+
+	// Walk the directory, unlinking the object files
+	if ( (dh = opendir(fs->dir)) == NULL ) {
+		return( -1 );
+	}
+	while ( (ent = readdir(dh)) != NULL ) {
+		if ( ent->d_name[0] != '.' ) {
+			snprintf( path, sizeof(path), "%s/%s", fs->dir, ent->d_name );
+			unlink( path );
+		}
+	}
+	closedir( dh );
+	fs->next_oid = CRUD_FILE_FIRST_OID;
+	fs->priority_oid = CRUD_NO_OBJECT;
+	return( crud_file_meta(fs, 1) );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : crud_file_request
+// Description  : Execute a request on the object files
+//
+// Inputs       : be - the backend
+//                request - the request
+//                buf - the buffer for the request
+// Outputs      : the response
+
+static CrudResponse crud_file_request( CrudBackend *be, CrudRequest request, void *buf ) {
+
+	// Local variables
+	CrudFileStore *fs = be->state;
+	char path[CRUD_FILE_MAX_PATH*2];
+	CRUD_REQUEST_TYPES req;
+	uint32_t length;
+	uint8_t flags, res;
+	struct stat st;
+	CrudOID oid;
+	int fh;
+
+	// Unpack the request, the priority flag picks the priority object
+	deconstruct_crud_request( request, &oid, &req, &length, &flags, &res );
+	if ( (flags == CRUD_PRIORITY_OBJECT) && (req != CRUD_CREATE) ) {
+		oid = fs->priority_oid;
+	}
+	snprintf( path, sizeof(path), "%s/%u", fs->dir, oid );
+
+	switch ( req ) {
+
+	case CRUD_INIT: // Make sure the directory is there, read the store file
+		if ( ((mkdir(fs->dir, S_IRWXU) == -1) && (errno != EEXIST)) || crud_file_meta(fs, 0) ) {
+			CRUD_LOG( LOG_ERROR_LEVEL, "CRUD file: cannot open store [%s]", fs->dir );
+			return( construct_crud_request(oid, req, length, flags, 1) );
+		}
+		return( construct_crud_request(0, req, 0, flags, 0) );
+
+	case CRUD_FORMAT: // Remove every object
+		if ( crud_file_format(fs) ) {
+			CRUD_LOG( LOG_ERROR_LEVEL, "CRUD file: cannot format store [%s]", fs->dir );
+			return( construct_crud_request(oid, req, length, flags, 1) );
+		}
+		return( construct_crud_request(0, req, 0, flags, 0) );
+
+	case CRUD_CREATE: // Write a new file (skipping OIDs left over from a crash)
+		if ( (flags == CRUD_PRIORITY_OBJECT) && (fs->priority_oid != CRUD_NO_OBJECT) ) {
+			CRUD_LOG( LOG_ERROR_LEVEL, "CRUD file: priority object already exists" );
+			return( construct_crud_request(oid, req, length, flags, 1) );
+		}
+		do {
+			oid = fs->next_oid++;
+			snprintf( path, sizeof(path), "%s/%u", fs->dir, oid );
+			fh = open( path, O_WRONLY|O_CREAT|O_EXCL, S_IRUSR|S_IWUSR );
+		} while ( (fh == -1) && (errno == EEXIST) );
+		if ( (fh == -1) || (write(fh, buf, length) != length) ) {
+			CRUD_LOG( LOG_ERROR_LEVEL, "CRUD file: create failed [%s], %s", path, strerror(errno) );
+			if ( fh != -1 ) {
+				close( fh );
+			}
+			return( construct_crud_request(oid, req, length, flags, 1) );
+		}
+		close( fh );
+		if ( flags == CRUD_PRIORITY_OBJECT ) {
+			fs->priority_oid = oid;
+			crud_file_meta( fs, 1 );
+		}
+		return( construct_crud_request(oid, req, length, flags, 0) );
+
+	case CRUD_READ: // Read the whole file
+		if ( ((fh = open(path, O_RDONLY)) == -1) || (fstat(fh, &st) == -1) ||
+			 (st.st_size > length) || (read(fh, buf, st.st_size) != st.st_size) ) {
+			CRUD_LOG( LOG_ERROR_LEVEL, "CRUD file: read failed [OID %u]", oid );
+			if ( fh != -1 ) {
+				close( fh );
+			}
+			return( construct_crud_request(oid, req, length, flags, 1) );
+		}
+		close( fh );
+		return( construct_crud_request(oid, req, st.st_size, flags, 0) );
+
+	case CRUD_UPDATE: // Overwrite the file, the size cannot change
+		if ( ((fh = open(path, O_WRONLY)) == -1) || (fstat(fh, &st) == -1) ||
+			 (st.st_size != length) || (pwrite(fh, buf, length, 0) != length) ) {
+			CRUD_LOG( LOG_ERROR_LEVEL, "CRUD file: update failed [OID %u]", oid );
+			if ( fh != -1 ) {
+				close( fh );
+			}
+			return( construct_crud_request(oid, req, length, flags, 1) );
+		}
+		close( fh );
+		return( construct_crud_request(oid, req, length, flags, 0) );
+
+	case CRUD_DELETE: // Remove the file
+		if ( (oid == CRUD_NO_OBJECT) || (unlink(path) == -1) ) {
+			CRUD_LOG( LOG_ERROR_LEVEL, "CRUD file: delete failed [OID %u]", oid );
+			return( construct_crud_request(oid, req, length, flags, 1) );
+		}
+		if ( oid == fs->priority_oid ) {
+			fs->priority_oid = CRUD_NO_OBJECT;
+			crud_file_meta( fs, 1 );
+		}
+		return( construct_crud_request(oid, req, 0, flags, 0) );
+
+	case CRUD_CLOSE: // Record the next OID
+		if ( crud_file_meta(fs, 1) ) {
+			CRUD_LOG( LOG_ERROR_LEVEL, "CRUD file: cannot write store file [%s]", fs->dir );
+			return( construct_crud_request(oid, req, length, flags, 1) );
+		}
+		return( construct_crud_request(0, req, 0, flags, 0) );
+
+	default: // Unknown request
+		CRUD_LOG( LOG_ERROR_LEVEL, "CRUD file: unknown request type [%d]", req );
+		return( construct_crud_request(oid, req, length, flags, 1) );
+	}
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : crud_file_save
+// Description  : Objects are already on disk, saving records the store file
+//                (fname must name the backend directory)
+//
+// Inputs       : be - the backend
+//                fname - the store directory
+// Outputs      : 0 if successful, -1 if failure
+
+static int crud_file_save( CrudBackend *be, char *fname ) {
+
+	// Local variables
+	CrudFileStore *fs = be->state;
+
+	// Only the directory of the store can be saved to
+	if ( strcmp(fname, fs->dir) != 0 ) {
+		CRUD_LOG( LOG_ERROR_LEVEL, "CRUD file: cannot save store [%s] to [%s]", fs->dir, fname );
+		return( -1 );
+	}
+	return( crud_file_meta(fs, 1) );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : crud_file_load
+// Description  : Switch the backend to the store in another directory
+//
+// Inputs       : be - the backend
+//                fname - the store directory
+// Outputs      : 0 if successful, -1 if failure
+
+static int crud_file_load( CrudBackend *be, char *fname ) {
+
+	// Local variables
+	CrudFileStore *fs = be->state;
+
+	// Point at the directory and read its store file
+	strncpy( fs->dir, fname, CRUD_FILE_MAX_PATH-1 );
+	return( crud_file_meta(fs, 0) );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : crud_file_sync
+// Description  : Make the store durable, syncing the file system holding the
+//                object files, then the store file
+//
+// Inputs       : be - the backend
+// Outputs      : 0 if successful, -1 if failure
+
+static int crud_file_sync( CrudBackend *be ) {
+
+	// Local variables
+	CrudFileStore *fs = be->state;
+	int fh, ret;
+
+	// The object files were written without syncing, sync them all at once
+	if ( (fh = open(fs->dir, O_RDONLY)) == -1 ) {
+		return( -1 );
+	}
+	ret = syncfs( fh );
+	close( fh );
+	if ( ret == -1 ) {
+		CRUD_LOG( LOG_ERROR_LEVEL, "CRUD file: sync of [%s] failed, %s", fs->dir, strerror(errno) );
+		return( -1 );
+	}
+	return( crud_file_meta(fs, 1) );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : crud_file_destroy
+// Description  : Release the backend (the files stay)
+//
+// Inputs       : be - the backend
+// Outputs      : none
+
+static void crud_file_destroy( CrudBackend *be ) {
+	free( be->state );
+	free( be );
+}
+
+//
+// Functions
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : crud_file_backend_create
+// Description  : Create a backend keeping one host file per object
+//
+// Inputs       : arg - the directory for the objects (NULL for the default)
+// Outputs      : the backend
+
+CrudBackend *crud_file_backend_create( const char *arg ) {
+
+	// Local variables
+	CrudBackend *be = calloc( 1, sizeof(CrudBackend) );
+	CrudFileStore *fs = calloc( 1, sizeof(CrudFileStore) );
+
+	// Set up the store and fill in the interface
+	strncpy( fs->dir, ((arg == NULL) || (*arg == 0x0)) ? CRUD_FILE_BACKEND_DIR : arg, CRUD_FILE_MAX_PATH-1 );
+	fs->next_oid = CRUD_FILE_FIRST_OID;
+	fs->priority_oid = CRUD_NO_OBJECT;
+	be->name = "file";
+	be->request = crud_file_request;
+	be->batch = crud_backend_serial_batch;
+	be->save = crud_file_save;
+	be->load = crud_file_load;
+	be->sync = crud_file_sync;
+	be->destroy = crud_file_destroy;
+	be->state = fs;
+	return( be );
+}
@@ -0,0 +1,450 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+//  File           : crud_backend_latency.c
+//  Description    : This is a backend wrapper that makes another backend
+//                   behave like real hardware.  Each request is delayed by a
+//                   per-request-type cost, a transfer time at the modeled
+//                   bandwidth and random jitter, and may be failed (R bit
+//                   set, the request is not executed).  The model is a list
+//                   of key=value settings separated by commas:
+//
+//                     lat=<us>      cost of every request type
+//                     init=<us> format=<us> create=<us> read=<us>
+//                     update=<us> delete=<us> close=<us>
+//                                   cost of one request type
+//                     bw=<MB/s>     bandwidth of the data transferred
+//                     jitter=<us>   random extra delay, up to this much
+//                     fail=<prob>   chance a data request fails (0.0-1.0)
+//                     seed=<n>      seed of the jitter and failures
+//                     virtual       account the delays without waiting
+//
+//  Last Modified  : Sun Oct 18 11:40:03 EDT 2026
+//
+
+// Includes
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <time.h>
+
+// Project Includes
+#include <crud_backend.h>
+#include <crud_log.h>
+
+// Defines
+#define CRUD_LATENCY_SPIN_NS 100000 // the last part of a delay is spun, not slept
+
+// Type definitions
+
+// This is the state of a latency wrapper
+typedef struct {
+	CrudBackend *inner;               // The backend doing the work
+	uint32_t     cost[CRUD_MAXVAL];   // Fixed cost of each request type (us)
+	double       bandwidth;           // Bytes per microsecond (0 is unlimited)
+	uint32_t     jitter;              // Largest random extra delay (us)
+	double       fail;                // Probability a data request fails
+	unsigned int seed;                // State of the random generator
+	int          virtual;             // Account the delays, do not wait
+	uint64_t     requests;            // Requests seen
+	uint64_t     faults;              // Failures injected
+	uint64_t     modeled_us;          // Total delay modeled (us)
+} CrudLatencyModel;
+
+//
+// Functional Prototypes
+
+CrudRequest construct_crud_request(CrudOID oid, CRUD_REQUEST_TYPES req,
+		uint32_t length, uint8_t flags, uint8_t res);
+int deconstruct_crud_request(CrudRequest request, CrudOID *oid,
+		CRUD_REQUEST_TYPES *req, uint32_t *length, uint8_t *flags,
+		uint8_t *res);
+
+//
+// Module local methods
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : crud_latency_wait
+// Description  : Delay the caller (sleeping, then spinning for precision)
+//
+// Inputs       : lm - the model
+//                us - the delay in microseconds
+// Outputs      : none
+
+static void crud_latency_wait( CrudLatencyModel *lm, uint64_t us ) {
+
+	// Local variables
+	struct timespec now, end, nap;
+	uint64_t ns = us * 1000;
+
+	// Account the delay, only wait on a real device model
+	lm->modeled_us += us;
+	if ( lm->virtual || (us == 0) ) {
+		return;
+	}
+	clock_gettime( CLOCK_MONOTONIC, &end );
+	end.tv_sec += (end.tv_nsec + ns) / 1000000000;
+	end.tv_nsec = (end.tv_nsec + ns) % 1000000000;
+	if ( ns > CRUD_LATENCY_SPIN_NS ) {
+		nap.tv_sec = (ns - CRUD_LATENCY_SPIN_NS) / 1000000000;
+		nap.tv_nsec = (ns - CRUD_LATENCY_SPIN_NS) % 1000000000;
+		nanosleep( &nap, NULL );
+	}
+	do {
+		clock_gettime( CLOCK_MONOTONIC, &now );
+	} while ( (now.tv_sec < end.tv_sec) || ((now.tv_sec == end.tv_sec) && (now.tv_nsec < end.tv_nsec)) );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : crud_latency_cost
+// Description  : Work out the delay of a request (before its transfer)
+//
+// Inputs       : lm - the model
+//                req - the request type
+// Outputs      : the delay in microseconds
+
+static uint64_t crud_latency_cost( CrudLatencyModel *lm, CRUD_REQUEST_TYPES req ) {
+
+	// Fixed cost plus jitter
+	uint64_t us = (req < CRUD_MAXVAL) ? lm->cost[req] : 0;
+	if ( lm->jitter > 0 ) {
+		us += rand_r( &lm->seed ) % (lm->jitter + 1);
+	}
+	return( us );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : crud_latency_transfer
+// Description  : Work out the time to move the data of a request
+//
+// Inputs       : lm - the model
+//                bytes - the bytes moved
+// Outputs      : the delay in microseconds
+
+static uint64_t crud_latency_transfer( CrudLatencyModel *lm, uint32_t bytes ) {
+	return( (lm->bandwidth > 0.0) ? (uint64_t)(bytes / lm->bandwidth) : 0 );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : crud_latency_fault
+// Description  : Decide whether a request is failed (data requests only, so
+//                the store can always be opened and closed)
+//
+// Inputs       : lm - the model
+//                req - the request type
+// Outputs      : 1 if the request fails, 0 otherwise
+
+static int crud_latency_fault( CrudLatencyModel *lm, CRUD_REQUEST_TYPES req ) {
+
+	// Only create/read/update/delete fail
+	if ( (lm->fail <= 0.0) || (req < CRUD_CREATE) || (req > CRUD_DELETE) ) {
+		return( 0 );
+	}
+	if ( (double)rand_r(&lm->seed) / ((double)RAND_MAX + 1.0) >= lm->fail ) {
+		return( 0 );
+	}
+	lm->faults++;
+	return( 1 );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : crud_latency_request
+// Description  : Execute a request on the wrapped backend, modeling the
+//                device cost
+//
+// Inputs       : be - the backend
+//                request - the request
+//                buf - the buffer for the request
+// Outputs      : the response
+
+static CrudResponse crud_latency_request( CrudBackend *be, CrudRequest request, void *buf ) {
+
+	// Local variables
+	CrudLatencyModel *lm = be->state;
+	CrudResponse response;
+	CRUD_REQUEST_TYPES req;
+	uint32_t length;
+	uint8_t flags, res;
+	CrudOID oid;
+
+	// Pay the fixed cost, then fail or execute the request
+	deconstruct_crud_request( request, &oid, &req, &length, &flags, &res );
+	lm->requests++;
+	crud_latency_wait( lm, crud_latency_cost(lm, req) );
+	if ( crud_latency_fault(lm, req) ) {
+		CRUD_LOG( LOG_WARNING_LEVEL, "CRUD latency: injected failure of %s [OID %u]",
+				CRUD_REQUEST_TYPE_LABLES[req], oid );
+		return( request | 0x1 );
+	}
+	response = lm->inner->request( lm->inner, request, buf );
+
+	// Pay for the data moved (the response carries the length read)
+	if ( (req == CRUD_CREATE) || (req == CRUD_UPDATE) ) {
+		crud_latency_wait( lm, crud_latency_transfer(lm, length) );
+	} else if ( req == CRUD_READ ) {
+		deconstruct_crud_request( response, &oid, &req, &length, &flags, &res );
+		crud_latency_wait( lm, crud_latency_transfer(lm, length) );
+	}
+
+	// Report the totals when the store is closed
+	if ( req == CRUD_CLOSE ) {
+		CRUD_LOG( LOG_INFO_LEVEL, "CRUD latency: %lu requests, %lu failures injected, %lu us modeled.",
+				lm->requests, lm->faults, lm->modeled_us );
+	}
+	return( response );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : crud_latency_batch
+// Description  : Execute a batch on the wrapped backend.  The batch is one
+//                trip to the device: it pays the largest fixed cost once,
+//                plus the transfer of all of its data.  A failure fails
+//                the whole batch before any of it runs.
+//
+// Inputs       : be - the backend
+//                requests - the requests
+//                bufs - the buffer of each request
+//                responses - the response of each request (out)
+//                count - the number of requests
+// Outputs      : 0 if every request succeeded, -1 otherwise
+
+static int crud_latency_batch( CrudBackend *be, CrudRequest *requests, void **bufs,
+		CrudResponse *responses, int count ) {
+
+	// Local variables
+	CrudLatencyModel *lm = be->state;
+	CRUD_REQUEST_TYPES req;
+	uint64_t us, worst = 0, transfer = 0;
+	uint32_t length;
+	uint8_t flags, res;
+	CrudOID oid;
+	int i, ret, fault = 0;
+
+	// Work out the cost of the trip and whether it fails
+	for ( i=0; i<count; i++ ) {
+		deconstruct_crud_request( requests[i], &oid, &req, &length, &flags, &res );
+		lm->requests++;
+		if ( (us = crud_latency_cost(lm, req)) > worst ) {
+			worst = us;
+		}
+		if ( (req == CRUD_CREATE) || (req == CRUD_UPDATE) ) {
+			transfer += crud_latency_transfer( lm, length );
+		}
+		fault |= crud_latency_fault( lm, req );
+	}
+	crud_latency_wait( lm, worst );
+	if ( fault ) {
+		CRUD_LOG( LOG_WARNING_LEVEL, "CRUD latency: injected failure of a %d request batch", count );
+		for ( i=0; i<count; i++ ) {
+			responses[i] = requests[i] | 0x1;
+		}
+		return( -1 );
+	}
+
+	// Execute it, then pay for the data moved
+	ret = lm->inner->batch( lm->inner, requests, bufs, responses, count );
+	for ( i=0; i<count; i++ ) {
+		deconstruct_crud_request( responses[i], &oid, &req, &length, &flags, &res );
+		if ( req == CRUD_READ ) {
+			transfer += crud_latency_transfer( lm, length );
+		}
+	}
+	crud_latency_wait( lm, transfer );
+	return( ret );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : crud_latency_save
+// Description  : Save the wrapped backend
+//
+// Inputs       : be - the backend
+//                fname - the store file
+// Outputs      : 0 if successful, -1 if failure
+
+static int crud_latency_save( CrudBackend *be, char *fname ) {
+	CrudLatencyModel *lm = be->state;
+	return( lm->inner->save(lm->inner, fname) );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : crud_latency_load
+// Description  : Load the wrapped backend
+//
+// Inputs       : be - the backend
+//                fname - the store file
+// Outputs      : 0 if successful, -1 if failure
+
+static int crud_latency_load( CrudBackend *be, char *fname ) {
+	CrudLatencyModel *lm = be->state;
+	return( lm->inner->load(lm->inner, fname) );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : crud_latency_sync
+// Description  : Make the wrapped backend durable, paying the cost of a close
+//
+// Inputs       : be - the backend
+// Outputs      : 0 if successful, -1 if failure
+
+static int crud_latency_sync( CrudBackend *be ) {
+	CrudLatencyModel *lm = be->state;
+	crud_latency_wait( lm, crud_latency_cost(lm, CRUD_CLOSE) );
+	return( lm->inner->sync(lm->inner) );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : crud_latency_destroy
+// Description  : Release the wrapper and the wrapped backend
+//
+// Inputs       : be - the backend
+// Outputs      : none
+
+static void crud_latency_destroy( CrudBackend *be ) {
+	CrudLatencyModel *lm = be->state;
+	crud_backend_destroy( lm->inner );
+	free( lm );
+	free( be );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : crud_latency_parse
+// Description  : Read the settings of a device model
+//
+// Inputs       : lm - the model
+//                model - the settings
+// Outputs      : 0 if successful, -1 if failure
+
+static int crud_latency_parse( CrudLatencyModel *lm, const char *model ) {
+
+	// Local variables
+	char *copy, *key, *value, *save = NULL;
+	double mbps;
+	int i, ret = 0;
+
+	// Walk the comma separated list of settings
+	copy = strdup( model );
+	for ( key = strtok_r(copy, ",", &save); (key != NULL) && (ret == 0); key = strtok_r(NULL, ",", &save) ) {
+		if ( strcmp(key, "virtual") == 0 ) {
+			lm->virtual = 1;
+			continue;
+		}
+		if ( (value = strchr(key, '=')) == NULL ) {
+			ret = -1;
+			break;
+		}
+		*value++ = 0x0;
+
+		// Per request type costs use the lower case request name
+		for ( i=CRUD_INIT; i<CRUD_UNKNOWN; i++ ) {
+			if ( strcasecmp(key, CRUD_REQUEST_TYPE_LABLES[i]+5) == 0 ) {
+				lm->cost[i] = strtoul( value, NULL, 10 );
+				break;
+			}
+		}
+		if ( i < CRUD_UNKNOWN ) {
+			continue;
+		}
+		if ( strcmp(key, "lat") == 0 ) {
+			for ( i=CRUD_INIT; i<CRUD_MAXVAL; i++ ) {
+				lm->cost[i] = strtoul( value, NULL, 10 );
+			}
+		} else if ( strcmp(key, "bw") == 0 ) {
+			mbps = strtod( value, NULL );
+			lm->bandwidth = mbps * 1048576.0 / 1000000.0;
+		} else if ( strcmp(key, "jitter") == 0 ) {
+			lm->jitter = strtoul( value, NULL, 10 );
+		} else if ( strcmp(key, "fail") == 0 ) {
+			lm->fail = strtod( value, NULL );
+		} else if ( strcmp(key, "seed") == 0 ) {
+			lm->seed = strtoul( value, NULL, 10 );
+		} else {
+			ret = -1;
+		}
+	}
+	free( copy );
+	if ( ret ) {
+		CRUD_LOG( LOG_ERROR_LEVEL, "CRUD latency: bad device model [%s]", model );
+	}
+	return( ret );
+}
+
+//
+// Functions
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : crud_latency_backend_wrap
+// Description  : Wrap a backend in a device model
+//
+// Inputs       : inner - the backend to wrap (owned by the wrapper)
+//                model - the model settings (see the top of this file)
+// Outputs      : the backend, or NULL if failure
+
+CrudBackend *crud_latency_backend_wrap( CrudBackend *inner, const char *model ) {
+
+	// Local variables
+	CrudBackend *be;
+	CrudLatencyModel *lm;
+
+	// Read the model first
+	if ( inner == NULL ) {
+		return( NULL );
+	}
+	lm = calloc( 1, sizeof(CrudLatencyModel) );
+	lm->seed = 1;
+	if ( crud_latency_parse(lm, model) ) {
+		free( lm );
+		crud_backend_destroy( inner );
+		return( NULL );
+	}
+
+	// Fill in the interface
+	be = calloc( 1, sizeof(CrudBackend) );
+	lm->inner = inner;
+	be->name = "latency";
+	be->request = crud_latency_request;
+	be->batch = crud_latency_batch;
+	be->save = crud_latency_save;
+	be->load = crud_latency_load;
+	be->sync = crud_latency_sync;
+	be->destroy = crud_latency_destroy;
+	be->state = lm;
+	return( be );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : crud_latency_backend_create
+// Description  : Create a device model from a "model[@backend]"
+//                specification, wrapping the CRUD device by default
+//
+// Inputs       : arg - the specification
+// Outputs      : the backend, or NULL if failure
+
+CrudBackend *crud_latency_backend_create( const char *arg ) {
+
+	// Local variables
+	CrudBackend *be;
+	char *model, *inner;
+
+	// Split the wrapped backend off the model
+	model = strdup( (arg == NULL) ? "" : arg );
+	inner = strchr( model, '@' );
+	if ( inner != NULL ) {
+		*inner++ = 0x0;
+	}
+	be = crud_latency_backend_wrap( crud_backend_create((inner == NULL) ? CRUD_DEFAULT_BACKEND : inner), model );
+	free( model );
+	return( be );
+}
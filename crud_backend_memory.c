@@ -0,0 +1,387 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+//  File           : crud_backend_memory.c
+//  Description    : This is a volatile in-process object store backend.  It
+//                   keeps objects in a hash table of heap buffers, so it
+//                   measures the file system layer without any device cost.
+//                   Save and load use the flat store file format (next OID,
+//                   object count, then OID/flags/length/data per object);
+//                   given an image file, the store loads it on INIT and
+//                   saves it on CLOSE.
+//
+//  Last Modified  : Sun Oct 18 10:02:17 EDT 2026
+//
+
+// Includes
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+
+// Project Includes
+#include <crud_backend.h>
+#include <crud_log.h>
+#include <cmpsc311_hashtable.h>
+
+// Defines
+#define CRUD_MEMORY_FIRST_OID 4096
+#define CRUD_MEMORY_HASH_BITS 12
+
+// Type definitions
+
+// This is an object in memory
+typedef struct {
+	CrudOID   oid;    // The object identifier
+	uint8_t   flags;  // The object flags
+	uint32_t  length; // The object length
+	char     *data;   // The object contents
+} CrudMemoryObject;
+
+// This is the state of a memory backend
+typedef struct {
+	HTable    objects;      // The objects, by OID
+	uint32_t  count;        // The number of objects
+	CrudOID   next_oid;     // The next OID to hand out
+	CrudOID   priority_oid; // The priority object (CRUD_NO_OBJECT if none)
+	char     *image;        // The image file kept across runs (NULL if none)
+} CrudMemoryStore;
+
+//
+// Functional Prototypes
+
+static int crud_memory_save( CrudBackend *be, char *fname );
+static int crud_memory_load( CrudBackend *be, char *fname );
+
+CrudRequest construct_crud_request(CrudOID oid, CRUD_REQUEST_TYPES req,
+		uint32_t length, uint8_t flags, uint8_t res);
+int deconstruct_crud_request(CrudRequest request, CrudOID *oid,
+		CRUD_REQUEST_TYPES *req, uint32_t *length, uint8_t *flags,
+		uint8_t *res);
+
+//
+// Module local methods
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : crud_memory_insert
+// Description  : Add an object to the store
+//
+// Inputs       : ms - the store
+//                oid - the object identifier
+//                flags - the object flags
+//                length - the object length
+// Outputs      : the object
+
+static CrudMemoryObject *crud_memory_insert( CrudMemoryStore *ms, CrudOID oid, uint8_t flags, uint32_t length ) {
+
+	// Local variables
+	CrudMemoryObject *obj = malloc( sizeof(CrudMemoryObject) );
+
+	// Fill in the object, add it to the table
+	obj->oid = oid;
+	obj->flags = flags;
+	obj->length = length;
+	obj->data = malloc( (length > 0) ? length : 1 );
+	insertValueInHashTable( &ms->objects, oid, obj );
+	ms->count++;
+	if ( flags == CRUD_PRIORITY_OBJECT ) {
+		ms->priority_oid = oid;
+	}
+	return( obj );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : crud_memory_clear
+// Description  : Remove every object from the store
+//
+// Inputs       : ms - the store
+// Outputs      : none
+
+static void crud_memory_clear( CrudMemoryStore *ms ) {
+
+	// Local variables
+	CrudMemoryObject *obj;
+	HtIterator it;
+	CrudOID *oids;
+	uint32_t i, n = 0;
+
+	// Collect the OIDs first, the table cannot change while iterating
+	oids = malloc( (ms->count+1) * sizeof(CrudOID) );
+	initHashTableIterator( &ms->objects, &it );
+	while ( (obj = iterateHashTable(&it)) != NULL ) {
+		oids[n++] = obj->oid;
+	}
+	for ( i=0; i<n; i++ ) {
+		obj = deleteValueFromHashTable( &ms->objects, oids[i] );
+		free( obj->data );
+		free( obj );
+	}
+	free( oids );
+	ms->count = 0;
+	ms->next_oid = CRUD_MEMORY_FIRST_OID;
+	ms->priority_oid = CRUD_NO_OBJECT;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : crud_memory_request
+// Description  : Execute a request on the in-memory store
+//
+// Inputs       : be - the backend
+//                request - the request
+//                buf - the buffer for the request
+// Outputs      : the response
+
+static CrudResponse crud_memory_request( CrudBackend *be, CrudRequest request, void *buf ) {
+
+	// Local variables
+	CrudMemoryStore *ms = be->state;
+	CrudMemoryObject *obj = NULL;
+	CRUD_REQUEST_TYPES req;
+	uint32_t length;
+	uint8_t flags, res;
+	CrudOID oid;
+
+	// Unpack the request, find the object it is about
+	deconstruct_crud_request( request, &oid, &req, &length, &flags, &res );
+	if ( (req == CRUD_READ) || (req == CRUD_UPDATE) || (req == CRUD_DELETE) ) {
+		if ( flags == CRUD_PRIORITY_OBJECT ) {
+			oid = ms->priority_oid;
+		}
+		if ( (oid == CRUD_NO_OBJECT) || ((obj = findValueInHashTable(&ms->objects, oid)) == NULL) ) {
+			CRUD_LOG( LOG_ERROR_LEVEL, "CRUD memory: no such object [OID %u]", oid );
+			return( construct_crud_request(oid, req, length, flags, 1) );
+		}
+	}
+
+	switch ( req ) {
+
+	case CRUD_INIT: // Load the image if there is one, else start empty
+		if ( (ms->image != NULL) && (access(ms->image, F_OK) == 0) && crud_memory_load(be, ms->image) ) {
+			return( construct_crud_request(0, req, 0, flags, 1) );
+		}
+		return( construct_crud_request(0, req, 0, flags, 0) );
+
+	case CRUD_CLOSE: // Save the image if there is one
+		if ( (ms->image != NULL) && crud_memory_save(be, ms->image) ) {
+			return( construct_crud_request(0, req, 0, flags, 1) );
+		}
+		return( construct_crud_request(0, req, 0, flags, 0) );
+
+	case CRUD_FORMAT: // Drop every object
+		crud_memory_clear( ms );
+		return( construct_crud_request(0, req, 0, flags, 0) );
+
+	case CRUD_CREATE: // Copy the data into a new object
+		if ( (flags == CRUD_PRIORITY_OBJECT) && (ms->priority_oid != CRUD_NO_OBJECT) ) {
+			CRUD_LOG( LOG_ERROR_LEVEL, "CRUD memory: priority object already exists" );
+			return( construct_crud_request(oid, req, length, flags, 1) );
+		}
+		if ( (length > 0) && (buf == NULL) ) {
+			CRUD_LOG( LOG_ERROR_LEVEL, "CRUD memory: create of %u bytes with no buffer", length );
+			return( construct_crud_request(oid, req, length, flags, 1) );
+		}
+		obj = crud_memory_insert( ms, ms->next_oid++, flags, length );
+		memcpy( obj->data, buf, length );
+		return( construct_crud_request(obj->oid, req, length, flags, 0) );
+
+	case CRUD_READ: // Copy the whole object out
+		if ( obj->length > length ) {
+			CRUD_LOG( LOG_ERROR_LEVEL, "CRUD memory: read buffer too small [OID %u]", obj->oid );
+			return( construct_crud_request(oid, req, length, flags, 1) );
+		}
+		if ( (obj->length > 0) && (buf == NULL) ) {
+			CRUD_LOG( LOG_ERROR_LEVEL, "CRUD memory: read of %u bytes with no buffer [OID %u]", obj->length, obj->oid );
+			return( construct_crud_request(oid, req, length, flags, 1) );
+		}
+		memcpy( buf, obj->data, obj->length );
+		return( construct_crud_request(oid, req, obj->length, flags, 0) );
+
+	case CRUD_UPDATE: // Overwrite the object, the size cannot change
+		if ( obj->length != length ) {
+			CRUD_LOG( LOG_ERROR_LEVEL, "CRUD memory: update length mismatch [OID %u]", obj->oid );
+			return( construct_crud_request(oid, req, length, flags, 1) );
+		}
+		if ( (length > 0) && (buf == NULL) ) {
+			CRUD_LOG( LOG_ERROR_LEVEL, "CRUD memory: update of %u bytes with no buffer [OID %u]", length, obj->oid );
+			return( construct_crud_request(oid, req, length, flags, 1) );
+		}
+		memcpy( obj->data, buf, length );
+		return( construct_crud_request(oid, req, length, flags, 0) );
+
+	case CRUD_DELETE: // Drop the object
+		deleteValueFromHashTable( &ms->objects, obj->oid );
+		if ( obj->oid == ms->priority_oid ) {
+			ms->priority_oid = CRUD_NO_OBJECT;
+		}
+		ms->count--;
+		free( obj->data );
+		free( obj );
+		return( construct_crud_request(oid, req, 0, flags, 0) );
+
+	default: // Unknown request
+		CRUD_LOG( LOG_ERROR_LEVEL, "CRUD memory: unknown request type [%d]", req );
+		return( construct_crud_request(oid, req, length, flags, 1) );
+	}
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : crud_memory_save
+// Description  : Write the objects to a flat store file
+//
+// Inputs       : be - the backend
+//                fname - the store file
+// Outputs      : 0 if successful, -1 if failure
+
+static int crud_memory_save( CrudBackend *be, char *fname ) {
+
+	// Local variables
+	CrudMemoryStore *ms = be->state;
+	CrudMemoryObject *obj;
+	HtIterator it;
+	FILE *fh;
+	int err = 0;
+
+	// Write the preamble then each object
+	if ( (fh = fopen(fname, "w")) == NULL ) {
+		CRUD_LOG( LOG_ERROR_LEVEL, "CRUD memory: cannot open [%s], %s", fname, strerror(errno) );
+		return( -1 );
+	}
+	err |= (fwrite(&ms->next_oid, sizeof(CrudOID), 1, fh) != 1);
+	err |= (fwrite(&ms->count, sizeof(uint32_t), 1, fh) != 1);
+	initHashTableIterator( &ms->objects, &it );
+	while ( (obj = iterateHashTable(&it)) != NULL ) {
+		err |= (fwrite(&obj->oid, sizeof(CrudOID), 1, fh) != 1);
+		err |= (fwrite(&obj->flags, sizeof(uint8_t), 1, fh) != 1);
+		err |= (fwrite(&obj->length, sizeof(uint32_t), 1, fh) != 1);
+		err |= (fwrite(obj->data, 1, obj->length, fh) != obj->length);
+	}
+	err |= (fclose(fh) != 0);
+	if ( err ) {
+		CRUD_LOG( LOG_ERROR_LEVEL, "CRUD memory: failed writing [%s]", fname );
+		return( -1 );
+	}
+	return( 0 );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : crud_memory_load
+// Description  : Replace the objects with the contents of a flat store file
+//
+// Inputs       : be - the backend
+//                fname - the store file
+// Outputs      : 0 if successful, -1 if failure
+
+static int crud_memory_load( CrudBackend *be, char *fname ) {
+
+	// Local variables
+	CrudMemoryStore *ms = be->state;
+	CrudMemoryObject *obj;
+	uint32_t count, length, i;
+	CrudOID next_oid, oid;
+	uint8_t flags;
+	FILE *fh;
+
+	// Read the preamble, then each object
+	if ( (fh = fopen(fname, "r")) == NULL ) {
+		CRUD_LOG( LOG_ERROR_LEVEL, "CRUD memory: cannot open [%s], %s", fname, strerror(errno) );
+		return( -1 );
+	}
+	crud_memory_clear( ms );
+	if ( (fread(&next_oid, sizeof(CrudOID), 1, fh) != 1) || (fread(&count, sizeof(uint32_t), 1, fh) != 1) ) {
+		count = 0;
+		next_oid = 0;
+	}
+	for ( i=0; i<count; i++ ) {
+		if ( (fread(&oid, sizeof(CrudOID), 1, fh) != 1) ||
+			 (fread(&flags, sizeof(uint8_t), 1, fh) != 1) ||
+			 (fread(&length, sizeof(uint32_t), 1, fh) != 1) ||
+			 (length > CRUD_MAX_OBJECT_SIZE) ) {
+			break;
+		}
+		obj = crud_memory_insert( ms, oid, flags, length );
+		if ( fread(obj->data, 1, length, fh) != length ) {
+			break;
+		}
+	}
+	fclose( fh );
+	if ( (i < count) || (next_oid == 0) ) {
+		CRUD_LOG( LOG_ERROR_LEVEL, "CRUD memory: bad store file [%s]", fname );
+		crud_memory_clear( ms );
+		return( -1 );
+	}
+	ms->next_oid = next_oid;
+	return( 0 );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : crud_memory_sync
+// Description  : Make the store durable by saving its image (a store with no
+//                image is never durable)
+//
+// Inputs       : be - the backend
+// Outputs      : 0 if successful, -1 if failure
+
+static int crud_memory_sync( CrudBackend *be ) {
+	CrudMemoryStore *ms = be->state;
+	return( (ms->image != NULL) ? crud_memory_save(be, ms->image) : 0 );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : crud_memory_destroy
+// Description  : Release the store and the backend
+//
+// Inputs       : be - the backend
+// Outputs      : none
+
+static void crud_memory_destroy( CrudBackend *be ) {
+
+	// Local variables
+	CrudMemoryStore *ms = be->state;
+
+	// Free the objects and the table
+	crud_memory_clear( ms );
+	cleanupHashTable( &ms->objects );
+	free( ms->image );
+	free( ms );
+	free( be );
+}
+
+//
+// Functions
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : crud_memory_backend_create
+// Description  : Create an empty in-memory object store backend
+//
+// Inputs       : arg - the image file kept across runs (NULL for none)
+// Outputs      : the backend
+
+CrudBackend *crud_memory_backend_create( const char *arg ) {
+
+	// Local variables
+	CrudBackend *be = calloc( 1, sizeof(CrudBackend) );
+	CrudMemoryStore *ms = calloc( 1, sizeof(CrudMemoryStore) );
+
+	// Set up the store and fill in the interface
+	initHashTable( &ms->objects, CRUD_MEMORY_HASH_BITS );
+	ms->next_oid = CRUD_MEMORY_FIRST_OID;
+	ms->priority_oid = CRUD_NO_OBJECT;
+	ms->image = ((arg == NULL) || (*arg == 0x0)) ? NULL : strdup( arg );
+	be->name = "memory";
+	be->request = crud_memory_request;
+	be->batch = crud_backend_serial_batch;
+	be->save = crud_memory_save;
+	be->load = crud_memory_load;
+	be->sync = crud_memory_sync;
+	be->destroy = crud_memory_destroy;
+	be->state = ms;
+	return( be );
+}
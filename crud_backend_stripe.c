@@ -0,0 +1,1096 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+//  File           : crud_backend_stripe.c
+//  Description    : This is a backend striping objects over a set of
+//                   independent volumes (each a backend of its own), RAID-0
+//                   style.  An object is cut into units; the first goes to
+//                   the object's home volume (its OID modulo the volumes)
+//                   and the next ones go round the other volumes.  Each
+//                   volume keeps the units it got of an object in one
+//                   object of its own.  A worker thread per volume issues
+//                   the requests, so the parts of a large object move in
+//                   parallel.
+//
+//                   With copies, the volumes are split into that many
+//                   mirrors of the columns the units go round (RAID-10).
+//                   A write goes to every copy and succeeds if one does;
+//                   a copy that missed it is marked stale and rewritten by
+//                   the next write.  A read goes to the copy expected to
+//                   answer first (the fewest requests ahead, by the
+//                   average time of its requests), and to the next one if
+//                   it fails.  The argument is a list separated by '+':
+//
+//                     map=<file>    where the object map is kept (none
+//                                   keeps it in memory only)
+//                     unit=<bytes>  the stripe unit (CRUD_STRIPE_UNIT)
+//                     copies=<n>    the copies of each unit (1, the
+//                                   volumes must be a multiple)
+//                     <backend>     a volume, e.g. memory:vol0.crd or
+//                                   file:vol1 (at least one)
+//
+//                   The map is written at CLOSE and at every sync (after
+//                   the volumes), and read at INIT.
+//
+//  Last Modified  : Sun Oct 18 21:48:10 EDT 2026
+//
+
+// Includes
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+
+// Project Includes
+#include <crud_backend.h>
+#include <crud_log.h>
+#include <cmpsc311_hashtable.h>
+
+// Defines
+#define CRUD_STRIPE_FIRST_OID 4096
+#define CRUD_STRIPE_HASH_BITS 12
+#define CRUD_STRIPE_MAGIC "CRUDSTR2"
+#define CRUD_STRIPE_UNIT_TEST_UNIT 4096
+#define CRUD_STRIPE_UNIT_TEST_VOLUMES 3
+#define CRUD_STRIPE_UNIT_TEST_OBJECTS 8
+
+// Type definitions
+
+// This is a striped object
+typedef struct {
+	CrudOID   oid;                           // The object identifier
+	uint8_t   flags;                         // The object flags
+	uint32_t  length;                        // The object length
+	uint16_t  stale;                         // The volumes whose copy missed a write (a bit each)
+	CrudOID   parts[CRUD_STRIPE_MAX_VOLUMES];// The object of its units on each volume (CRUD_NO_OBJECT if none)
+} CrudStripeObject;
+
+// This is the state of a striped backend
+typedef struct {
+	CrudBackend       *volumes[CRUD_STRIPE_MAX_VOLUMES]; // The volumes
+	CrudBackendWorker *workers[CRUD_STRIPE_MAX_VOLUMES]; // The thread of each volume
+	uint32_t           count;        // The number of volumes
+	uint32_t           copies;       // The copies of each unit
+	uint32_t           columns;      // The volumes the units go round (count / copies)
+	uint32_t           unit;         // The stripe unit
+	HTable             objects;      // The objects, by OID
+	uint32_t           objects_count;// The number of objects
+	CrudOID            next_oid;     // The next OID to hand out
+	CrudOID            priority_oid; // The priority object (CRUD_NO_OBJECT if none)
+	char              *map;          // The map file (NULL if none)
+	uint64_t           failovers;    // Reads answered by another copy
+	uint64_t           missed;       // Copies that missed a write
+} CrudStripeStore;
+
+// This is a request being carried out on the volumes
+typedef struct {
+	CrudStripeObject  *obj;                               // The object (NULL for the store requests)
+	CRUD_REQUEST_TYPES req;                               // The request type
+	uint8_t            flags;                             // The request flags
+	uint32_t           length;                            // The request length
+	char              *buf;                               // The buffer of the request
+	CrudRequest        requests[CRUD_STRIPE_MAX_VOLUMES]; // The request to each volume
+	CrudResponse       responses[CRUD_STRIPE_MAX_VOLUMES];// The response of each
+	char              *bufs[CRUD_STRIPE_MAX_VOLUMES];     // The buffer of each column (buf itself for a whole object)
+	uint8_t            used[CRUD_STRIPE_MAX_VOLUMES];     // Flags marking the volumes with a request
+	int                failed;                            // Flag marking a request that cannot be carried out
+} CrudStripeOp;
+
+//
+// Functional Prototypes
+
+static int crud_stripe_save( CrudBackend *be, char *fname );
+static int crud_stripe_load( CrudBackend *be, char *fname );
+static int crud_stripe_save_map( CrudStripeStore *ss, const char *fname );
+static int crud_stripe_load_map( CrudStripeStore *ss, const char *fname );
+
+CrudRequest construct_crud_request(CrudOID oid, CRUD_REQUEST_TYPES req,
+		uint32_t length, uint8_t flags, uint8_t res);
+int deconstruct_crud_request(CrudRequest request, CrudOID *oid,
+		CRUD_REQUEST_TYPES *req, uint32_t *length, uint8_t *flags,
+		uint8_t *res);
+
+//
+// Module local methods
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : crud_stripe_column
+// Description  : Get the column holding a part of an object (its copies are
+//                the volumes column, column + columns, ...)
+//
+// Inputs       : ss - the store
+//                oid - the object
+//                part - the part (0 is the home column, then round the others)
+// Outputs      : the column
+
+static uint32_t crud_stripe_column( CrudStripeStore *ss, CrudOID oid, uint32_t part ) {
+	return( (oid % ss->columns + part) % ss->columns );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : crud_stripe_copy_to_read
+// Description  : Pick the copy of a part to read: the one expected to answer
+//                first, of those holding the part and not stale (the first
+//                copy on a tie)
+//
+// Inputs       : ss - the store
+//                obj - the object
+//                column - the column of the part
+//                tried - the volumes not to pick (a bit each)
+// Outputs      : the volume, or CRUD_STRIPE_MAX_VOLUMES if none can be read
+
+static uint32_t crud_stripe_copy_to_read( CrudStripeStore *ss, CrudStripeObject *obj, uint32_t column, uint16_t tried ) {
+
+	// Local variables
+	uint32_t c, v, best = CRUD_STRIPE_MAX_VOLUMES;
+	double estimate, lowest = 0;
+
+	for ( c=0; c<ss->copies; c++ ) {
+		v = column + c * ss->columns;
+		if ( (tried & (1 << v)) || (obj->parts[v] == CRUD_NO_OBJECT) || (obj->stale & (1 << v)) ) {
+			continue;
+		}
+		estimate = (ss->copies > 1) ? crud_backend_worker_estimate( ss->workers[v] ) : 0;
+		if ( (best == CRUD_STRIPE_MAX_VOLUMES) || (estimate < lowest) ) {
+			best = v;
+			lowest = estimate;
+		}
+	}
+	return( best );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : crud_stripe_share
+// Description  : Get the bytes of an object in one of its parts
+//
+// Inputs       : ss - the store
+//                length - the object length
+//                part - the part
+// Outputs      : the bytes of the part
+
+static uint32_t crud_stripe_share( CrudStripeStore *ss, uint32_t length, uint32_t part ) {
+
+	// Local variables
+	uint32_t bytes = 0, at;
+
+	for ( at=part*ss->unit; at<length; at+=ss->columns*ss->unit ) {
+		bytes += (length - at < ss->unit) ? length - at : ss->unit;
+	}
+	return( bytes );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : crud_stripe_copy
+// Description  : Gather the units of a part out of an object, or scatter
+//                them back into it
+//
+// Inputs       : ss - the store
+//                object - the object contents
+//                length - the object length
+//                data - the part contents
+//                part - the part
+//                gather - nonzero to copy object to part, zero for part to object
+// Outputs      : none
+
+static void crud_stripe_copy( CrudStripeStore *ss, char *object, uint32_t length, char *data, uint32_t part, int gather ) {
+
+	// Local variables
+	uint32_t at, n, off = 0;
+
+	for ( at=part*ss->unit; at<length; at+=ss->columns*ss->unit ) {
+		n = (length - at < ss->unit) ? length - at : ss->unit;
+		if ( gather ) {
+			memcpy( &data[off], &object[at], n );
+		} else {
+			memcpy( &object[at], &data[off], n );
+		}
+		off += n;
+	}
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : crud_stripe_clear
+// Description  : Forget every object of the map
+//
+// Inputs       : ss - the store
+// Outputs      : none
+
+static void crud_stripe_clear( CrudStripeStore *ss ) {
+
+	// Local variables
+	CrudStripeObject *obj;
+	HtIterator it;
+	CrudOID *oids;
+	uint32_t i, n = 0;
+
+	// Collect the OIDs first, the table cannot change while iterating
+	oids = malloc( (ss->objects_count+1) * sizeof(CrudOID) );
+	initHashTableIterator( &ss->objects, &it );
+	while ( (obj = iterateHashTable(&it)) != NULL ) {
+		oids[n++] = obj->oid;
+	}
+	for ( i=0; i<n; i++ ) {
+		free( deleteValueFromHashTable(&ss->objects, oids[i]) );
+	}
+	free( oids );
+	ss->objects_count = 0;
+	ss->next_oid = CRUD_STRIPE_FIRST_OID;
+	ss->priority_oid = CRUD_NO_OBJECT;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : crud_stripe_plan
+// Description  : Work out the request to each volume of a request (the
+//                parts of a written object are gathered here)
+//
+// Inputs       : ss - the store
+//                op - the request being carried out (out)
+//                request - the request
+//                buf - the buffer of the request
+// Outputs      : none (op->failed is set if it cannot be carried out)
+
+static void crud_stripe_plan( CrudStripeStore *ss, CrudStripeOp *op, CrudRequest request, void *buf ) {
+
+	// Local variables
+	uint32_t length, share, part, column, v, c, parts;
+	uint8_t flags, res;
+	CrudOID oid;
+
+	// Unpack the request, find the object it is about
+	memset( op, 0x0, sizeof(CrudStripeOp) );
+	deconstruct_crud_request( request, &oid, &op->req, &length, &flags, &res );
+	op->flags = flags;
+	op->length = length;
+	op->buf = buf;
+	if ( (op->req == CRUD_READ) || (op->req == CRUD_UPDATE) || (op->req == CRUD_DELETE) ) {
+		if ( flags == CRUD_PRIORITY_OBJECT ) {
+			oid = ss->priority_oid;
+		}
+		if ( (oid == CRUD_NO_OBJECT) || ((op->obj = findValueInHashTable(&ss->objects, oid)) == NULL) ) {
+			CRUD_LOG( LOG_ERROR_LEVEL, "CRUD stripe: no such object [OID %u]", oid );
+			op->failed = 1;
+			return;
+		}
+		if ( ((op->req == CRUD_READ) && (op->obj->length > length)) ||
+				((op->req == CRUD_UPDATE) && (op->obj->length != length)) ) {
+			CRUD_LOG( LOG_ERROR_LEVEL, "CRUD stripe: %s length mismatch [OID %u]", CRUD_REQUEST_TYPE_LABLES[op->req], oid );
+			op->failed = 1;
+			return;
+		}
+	}
+
+	switch ( op->req ) {
+
+	case CRUD_INIT:   // Every volume gets the store requests
+	case CRUD_FORMAT:
+	case CRUD_CLOSE:
+		for ( v=0; v<ss->count; v++ ) {
+			op->requests[v] = construct_crud_request( 0, op->req, 0, CRUD_NULL_FLAG, 0 );
+			op->used[v] = 1;
+		}
+		return;
+
+	case CRUD_CREATE: // Hand out the OID, the parts are made below
+		if ( (flags == CRUD_PRIORITY_OBJECT) && (ss->priority_oid != CRUD_NO_OBJECT) ) {
+			CRUD_LOG( LOG_ERROR_LEVEL, "CRUD stripe: priority object already exists" );
+			op->failed = 1;
+			return;
+		}
+		op->obj = calloc( 1, sizeof(CrudStripeObject) );
+		op->obj->oid = ss->next_oid++;
+		op->obj->flags = flags;
+		op->obj->length = length;
+		break;
+
+	case CRUD_READ:
+	case CRUD_UPDATE:
+	case CRUD_DELETE:
+		break;
+
+	default:
+		CRUD_LOG( LOG_ERROR_LEVEL, "CRUD stripe: unknown request type [%d]", op->req );
+		op->failed = 1;
+		return;
+	}
+
+	// The parts of the object, on their own buffers unless it is all one
+	length = op->obj->length;
+	parts = (length > ss->unit) ? ss->columns : 1;
+	for ( part=0; part<parts; part++ ) {
+		column = crud_stripe_column( ss, op->obj->oid, part );
+		share = crud_stripe_share( ss, length, part );
+		if ( (share == 0) && (part > 0) ) {
+			continue; // a short object, nothing of it goes this far round
+		}
+		if ( op->req != CRUD_DELETE ) {
+			if ( parts == 1 ) {
+				op->bufs[column] = buf;
+			} else {
+				op->bufs[column] = malloc( share );
+				if ( op->req != CRUD_READ ) {
+					crud_stripe_copy( ss, buf, length, op->bufs[column], part, 1 );
+				}
+			}
+		}
+
+		// A read goes to one copy, the rest to all of them (a copy that
+		// lost its part or missed a write is made again)
+		if ( op->req == CRUD_READ ) {
+			if ( (v = crud_stripe_copy_to_read(ss, op->obj, column, 0)) == CRUD_STRIPE_MAX_VOLUMES ) {
+				CRUD_LOG( LOG_ERROR_LEVEL, "CRUD stripe: no copy to read [OID %u]", op->obj->oid );
+				op->failed = 1;
+				return;
+			}
+			op->used[v] = 1;
+			op->requests[v] = construct_crud_request( op->obj->parts[v], CRUD_READ, share, CRUD_NULL_FLAG, 0 );
+			continue;
+		}
+		for ( c=0; c<ss->copies; c++ ) {
+			v = column + c * ss->columns;
+			if ( op->req == CRUD_DELETE ) {
+				if ( op->obj->parts[v] != CRUD_NO_OBJECT ) {
+					op->used[v] = 1;
+					op->requests[v] = construct_crud_request( op->obj->parts[v], CRUD_DELETE, 0, CRUD_NULL_FLAG, 0 );
+				}
+			} else {
+				op->used[v] = 1;
+				op->requests[v] = ( (op->req == CRUD_UPDATE) && (op->obj->parts[v] != CRUD_NO_OBJECT) &&
+						!(op->obj->stale & (1 << v)) ) ?
+						construct_crud_request( op->obj->parts[v], CRUD_UPDATE, share, CRUD_NULL_FLAG, 0 ) :
+						construct_crud_request( 0, CRUD_CREATE, share, CRUD_NULL_FLAG, 0 );
+			}
+		}
+	}
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : crud_stripe_finish
+// Description  : Finish a request once the volumes answered: scatter what
+//                was read, update the map and make the response
+//
+// Inputs       : ss - the store
+//                op - the request being carried out
+// Outputs      : the response
+
+static CrudResponse crud_stripe_finish( CrudStripeStore *ss, CrudStripeOp *op ) {
+
+	// Local variables
+	CrudStripeObject *obj = op->obj;
+	uint32_t v, c, part, parts, column, share, length = 0;
+	CRUD_REQUEST_TYPES req;
+	uint8_t flags, res;
+	int failed = op->failed, done;
+	uint16_t tried;
+	CrudOID oid;
+
+	// The store requests need every volume
+	if ( obj == NULL ) {
+		for ( v=0; v<ss->count; v++ ) {
+			if ( op->used[v] && (op->responses[v] & 0x1) ) {
+				failed = 1;
+			}
+		}
+	}
+
+	// Each part needs a copy to have answered (a read fails over to the
+	// next copy); the parts made go into the map
+	parts = ((obj != NULL) && (obj->length > ss->unit)) ? ss->columns : 1;
+	for ( part=0; (obj != NULL) && !op->failed && (part<parts); part++ ) {
+		column = crud_stripe_column( ss, obj->oid, part );
+		share = crud_stripe_share( ss, obj->length, part );
+		if ( (share == 0) && (part > 0) ) {
+			continue;
+		}
+		done = 0;
+		for ( c=0; c<ss->copies; c++ ) {
+			v = column + c * ss->columns;
+			if ( op->used[v] && !(op->responses[v] & 0x1) ) {
+				done++;
+			}
+		}
+		tried = 0;
+		for ( c=0; (op->req == CRUD_READ) && (c<ss->copies); c++ ) {
+			v = column + c * ss->columns;
+			tried |= op->used[v] ? (1 << v) : 0;
+		}
+		while ( (op->req == CRUD_READ) && !done && ((v = crud_stripe_copy_to_read(ss, obj, column, tried)) != CRUD_STRIPE_MAX_VOLUMES) ) {
+			ss->failovers++;
+			tried |= (1 << v);
+			done = !(crud_backend_worker_issue(ss->workers[v], construct_crud_request(obj->parts[v], CRUD_READ, share,
+					CRUD_NULL_FLAG, 0), op->bufs[column]) & 0x1);
+		}
+		if ( !done && (op->req != CRUD_DELETE) ) {
+			failed = 1;
+		}
+
+		// The copies written are current, the others missed it (if any got it)
+		for ( c=0; (op->req == CRUD_CREATE || op->req == CRUD_UPDATE) && (c<ss->copies); c++ ) {
+			v = column + c * ss->columns;
+			deconstruct_crud_request( op->requests[v], &oid, &req, &length, &flags, &res );
+			if ( op->responses[v] & 0x1 ) {
+				if ( done ) {
+					obj->stale |= (1 << v);
+					ss->missed++;
+				}
+				continue;
+			}
+			if ( req == CRUD_CREATE ) {
+				deconstruct_crud_request( op->responses[v], &oid, &req, &length, &flags, &res );
+				if ( obj->parts[v] != CRUD_NO_OBJECT ) {
+					crud_backend_worker_issue( ss->workers[v], construct_crud_request(obj->parts[v], CRUD_DELETE, 0, CRUD_NULL_FLAG, 0), NULL );
+				}
+				obj->parts[v] = oid;
+			}
+			obj->stale &= ~(1 << v);
+		}
+		if ( (op->req == CRUD_READ) && done && (op->bufs[column] != op->buf) ) {
+			crud_stripe_copy( ss, op->buf, obj->length, op->bufs[column], part, 0 );
+		}
+		if ( op->bufs[column] != op->buf ) {
+			free( op->bufs[column] );
+		}
+	}
+	for ( column=0; op->failed && (column<ss->columns); column++ ) {
+		if ( op->bufs[column] != op->buf ) {
+			free( op->bufs[column] ); // planned before the request failed
+		}
+	}
+
+	switch ( op->req ) {
+
+	case CRUD_INIT: // Read the map (a new store has none yet)
+		if ( !failed && (ss->map != NULL) && (access(ss->map, F_OK) == 0) && crud_stripe_load_map(ss, ss->map) ) {
+			failed = 1;
+		}
+		return( construct_crud_request(0, op->req, 0, op->flags, failed) );
+
+	case CRUD_CLOSE: // Write the map
+		if ( (ss->map != NULL) && crud_stripe_save_map(ss, ss->map) ) {
+			failed = 1;
+		}
+		if ( ss->copies > 1 ) {
+			CRUD_LOG( LOG_INFO_LEVEL, "CRUD stripe: %lu reads failed over, %lu copies missed a write.",
+					ss->failovers, ss->missed );
+		}
+		return( construct_crud_request(0, op->req, 0, op->flags, failed) );
+
+	case CRUD_FORMAT: // Forget every object
+		crud_stripe_clear( ss );
+		return( construct_crud_request(0, op->req, 0, op->flags, failed) );
+
+	case CRUD_CREATE: // Add the object, or drop the parts made of a failed one
+		if ( op->failed ) {
+			return( construct_crud_request(0, op->req, op->length, op->flags, 1) );
+		}
+		if ( failed ) {
+			for ( v=0; v<ss->count; v++ ) {
+				if ( obj->parts[v] != CRUD_NO_OBJECT ) {
+					crud_backend_worker_issue( ss->workers[v], construct_crud_request(obj->parts[v], CRUD_DELETE, 0, CRUD_NULL_FLAG, 0), NULL );
+				}
+			}
+			free( obj );
+			return( construct_crud_request(0, op->req, op->length, op->flags, 1) );
+		}
+		insertValueInHashTable( &ss->objects, obj->oid, obj );
+		ss->objects_count++;
+		if ( obj->flags == CRUD_PRIORITY_OBJECT ) {
+			ss->priority_oid = obj->oid;
+		}
+		return( construct_crud_request(obj->oid, op->req, obj->length, op->flags, 0) );
+
+	case CRUD_DELETE: // Drop the object (even if a volume failed, its parts are lost)
+		if ( op->failed ) {
+			return( construct_crud_request(0, op->req, 0, op->flags, 1) );
+		}
+		deleteValueFromHashTable( &ss->objects, obj->oid );
+		ss->objects_count--;
+		if ( obj->oid == ss->priority_oid ) {
+			ss->priority_oid = CRUD_NO_OBJECT;
+		}
+		oid = obj->oid;
+		free( obj );
+		return( construct_crud_request(oid, op->req, 0, op->flags, failed) );
+
+	default: // Reads and updates
+		return( construct_crud_request((obj != NULL) ? obj->oid : 0, op->req, (obj != NULL) ? obj->length : op->length,
+				op->flags, failed) );
+	}
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : crud_stripe_issue
+// Description  : Queue the requests of a request on the volume workers
+//
+// Inputs       : ss - the store
+//                op - the request being carried out
+//                wait - the wait counting the requests
+// Outputs      : none
+
+static void crud_stripe_issue( CrudStripeStore *ss, CrudStripeOp *op, CrudBackendWait *wait ) {
+
+	// Local variables
+	uint32_t v;
+
+	for ( v=0; (v<ss->count) && !op->failed; v++ ) {
+		if ( op->used[v] ) {
+			crud_backend_worker_queue( ss->workers[v], op->requests[v], op->bufs[v % ss->columns], &op->responses[v], wait );
+		}
+	}
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : crud_stripe_request
+// Description  : Execute a request on the striped volumes (a request on one
+//                volume is issued here, not through its worker)
+//
+// Inputs       : be - the backend
+//                request - the request
+//                buf - the buffer for the request
+// Outputs      : the response
+
+static CrudResponse crud_stripe_request( CrudBackend *be, CrudRequest request, void *buf ) {
+
+	// Local variables
+	CrudStripeStore *ss = be->state;
+	CrudBackendWait wait;
+	CrudStripeOp op;
+	uint32_t v, used = 0, last = 0;
+
+	crud_stripe_plan( ss, &op, request, buf );
+	for ( v=0; v<ss->count; v++ ) {
+		if ( op.used[v] ) {
+			used++;
+			last = v;
+		}
+	}
+	if ( !op.failed && (used == 1) ) {
+		op.responses[last] = crud_backend_worker_issue( ss->workers[last], op.requests[last], op.bufs[last % ss->columns] );
+	} else {
+		crud_backend_wait_init( &wait );
+		crud_stripe_issue( ss, &op, &wait );
+		crud_backend_wait( &wait );
+	}
+	return( crud_stripe_finish(ss, &op) );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : crud_stripe_batch
+// Description  : Execute a list of requests, all of their parts at once
+//                (each volume takes its parts in the order of the list)
+//
+// Inputs       : be - the backend
+//                requests - the requests
+//                bufs - the buffer of each request
+//                responses - the response of each request (out)
+//                count - the number of requests
+// Outputs      : 0 if every request succeeded, -1 otherwise
+
+static int crud_stripe_batch( CrudBackend *be, CrudRequest *requests, void **bufs,
+		CrudResponse *responses, int count ) {
+
+	// Local variables
+	CrudStripeStore *ss = be->state;
+	CrudBackendWait wait;
+	CrudStripeOp *ops;
+	int i, failed = 0;
+
+	ops = malloc( sizeof(CrudStripeOp) * count );
+	crud_backend_wait_init( &wait );
+	for ( i=0; i<count; i++ ) {
+		crud_stripe_plan( ss, &ops[i], requests[i], bufs[i] );
+		crud_stripe_issue( ss, &ops[i], &wait );
+	}
+	crud_backend_wait( &wait );
+	for ( i=0; i<count; i++ ) {
+		responses[i] = crud_stripe_finish( ss, &ops[i] );
+		if ( responses[i] & 0x1 ) {
+			failed = 1;
+		}
+	}
+	free( ops );
+	return( failed ? -1 : 0 );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : crud_stripe_save_map
+// Description  : Write the object map to a file (replacing it whole)
+//
+// Inputs       : ss - the store
+//                fname - the map file
+// Outputs      : 0 if successful, -1 if failure
+
+static int crud_stripe_save_map( CrudStripeStore *ss, const char *fname ) {
+
+	// Local variables
+	char tmp[4096];
+	CrudStripeObject *obj;
+	HtIterator it;
+	FILE *fh;
+	int err = 0;
+
+	// Write the preamble then each object, into a file renamed over the map
+	snprintf( tmp, sizeof(tmp), "%s.tmp", fname );
+	if ( (fh = fopen(tmp, "w")) == NULL ) {
+		CRUD_LOG( LOG_ERROR_LEVEL, "CRUD stripe: cannot open [%s], %s", tmp, strerror(errno) );
+		return( -1 );
+	}
+	err |= (fwrite(CRUD_STRIPE_MAGIC, 8, 1, fh) != 1);
+	err |= (fwrite(&ss->count, sizeof(uint32_t), 1, fh) != 1);
+	err |= (fwrite(&ss->copies, sizeof(uint32_t), 1, fh) != 1);
+	err |= (fwrite(&ss->unit, sizeof(uint32_t), 1, fh) != 1);
+	err |= (fwrite(&ss->next_oid, sizeof(CrudOID), 1, fh) != 1);
+	err |= (fwrite(&ss->priority_oid, sizeof(CrudOID), 1, fh) != 1);
+	err |= (fwrite(&ss->objects_count, sizeof(uint32_t), 1, fh) != 1);
+	initHashTableIterator( &ss->objects, &it );
+	while ( (obj = iterateHashTable(&it)) != NULL ) {
+		err |= (fwrite(&obj->oid, sizeof(CrudOID), 1, fh) != 1);
+		err |= (fwrite(&obj->flags, sizeof(uint8_t), 1, fh) != 1);
+		err |= (fwrite(&obj->length, sizeof(uint32_t), 1, fh) != 1);
+		err |= (fwrite(&obj->stale, sizeof(uint16_t), 1, fh) != 1);
+		err |= (fwrite(obj->parts, sizeof(CrudOID), ss->count, fh) != ss->count);
+	}
+	err |= (fflush(fh) != 0) || (fsync(fileno(fh)) != 0);
+	err |= (fclose(fh) != 0);
+	if ( err || rename(tmp, fname) ) {
+		CRUD_LOG( LOG_ERROR_LEVEL, "CRUD stripe: failed writing [%s]", fname );
+		return( -1 );
+	}
+	return( 0 );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : crud_stripe_load_map
+// Description  : Replace the object map with the contents of a file
+//
+// Inputs       : ss - the store
+//                fname - the map file
+// Outputs      : 0 if successful, -1 if failure
+
+static int crud_stripe_load_map( CrudStripeStore *ss, const char *fname ) {
+
+	// Local variables
+	uint32_t volumes, copies, unit, count, i;
+	CrudOID next_oid, priority_oid;
+	CrudStripeObject *obj;
+	char magic[8];
+	FILE *fh;
+
+	// Read the preamble, it has to be of this set of volumes
+	if ( (fh = fopen(fname, "r")) == NULL ) {
+		CRUD_LOG( LOG_ERROR_LEVEL, "CRUD stripe: cannot open [%s], %s", fname, strerror(errno) );
+		return( -1 );
+	}
+	crud_stripe_clear( ss );
+	if ( (fread(magic, 8, 1, fh) != 1) || memcmp(magic, CRUD_STRIPE_MAGIC, 8) ||
+			(fread(&volumes, sizeof(uint32_t), 1, fh) != 1) || (fread(&copies, sizeof(uint32_t), 1, fh) != 1) ||
+			(fread(&unit, sizeof(uint32_t), 1, fh) != 1) ||
+			(fread(&next_oid, sizeof(CrudOID), 1, fh) != 1) || (fread(&priority_oid, sizeof(CrudOID), 1, fh) != 1) ||
+			(fread(&count, sizeof(uint32_t), 1, fh) != 1) || (volumes != ss->count) || (copies != ss->copies) || (unit != ss->unit) ) {
+		CRUD_LOG( LOG_ERROR_LEVEL, "CRUD stripe: [%s] is not a map of these volumes", fname );
+		fclose( fh );
+		return( -1 );
+	}
+
+	// Then each object
+	for ( i=0; i<count; i++ ) {
+		obj = calloc( 1, sizeof(CrudStripeObject) );
+		if ( (fread(&obj->oid, sizeof(CrudOID), 1, fh) != 1) ||
+			 (fread(&obj->flags, sizeof(uint8_t), 1, fh) != 1) ||
+			 (fread(&obj->length, sizeof(uint32_t), 1, fh) != 1) ||
+			 (fread(&obj->stale, sizeof(uint16_t), 1, fh) != 1) ||
+			 (fread(obj->parts, sizeof(CrudOID), volumes, fh) != volumes) ) {
+			free( obj );
+			break;
+		}
+		insertValueInHashTable( &ss->objects, obj->oid, obj );
+		ss->objects_count++;
+	}
+	fclose( fh );
+	if ( i < count ) {
+		CRUD_LOG( LOG_ERROR_LEVEL, "CRUD stripe: bad map file [%s]", fname );
+		crud_stripe_clear( ss );
+		return( -1 );
+	}
+	ss->next_oid = next_oid;
+	ss->priority_oid = priority_oid;
+	return( 0 );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : crud_stripe_save
+// Description  : Write the store to files: the map to fname, each volume to
+//                fname.<volume>
+//
+// Inputs       : be - the backend
+//                fname - the store file
+// Outputs      : 0 if successful, -1 if failure
+
+static int crud_stripe_save( CrudBackend *be, char *fname ) {
+
+	// Local variables
+	CrudStripeStore *ss = be->state;
+	char name[4096];
+	uint32_t v;
+
+	for ( v=0; v<ss->count; v++ ) {
+		snprintf( name, sizeof(name), "%s.%u", fname, v );
+		if ( ss->volumes[v]->save(ss->volumes[v], name) ) {
+			return( -1 );
+		}
+	}
+	return( crud_stripe_save_map(ss, fname) );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : crud_stripe_load
+// Description  : Read the store from the files crud_stripe_save wrote
+//
+// Inputs       : be - the backend
+//                fname - the store file
+// Outputs      : 0 if successful, -1 if failure
+
+static int crud_stripe_load( CrudBackend *be, char *fname ) {
+
+	// Local variables
+	CrudStripeStore *ss = be->state;
+	char name[4096];
+	uint32_t v;
+
+	for ( v=0; v<ss->count; v++ ) {
+		snprintf( name, sizeof(name), "%s.%u", fname, v );
+		if ( ss->volumes[v]->load(ss->volumes[v], name) ) {
+			return( -1 );
+		}
+	}
+	return( crud_stripe_load_map(ss, fname) );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : crud_stripe_sync
+// Description  : Make the volumes durable, then the map (so the map never
+//                names parts a crash could lose)
+//
+// Inputs       : be - the backend
+// Outputs      : 0 if successful, -1 if failure
+
+static int crud_stripe_sync( CrudBackend *be ) {
+
+	// Local variables
+	CrudStripeStore *ss = be->state;
+	uint32_t v;
+
+	for ( v=0; v<ss->count; v++ ) {
+		if ( ss->volumes[v]->sync(ss->volumes[v]) ) {
+			return( -1 );
+		}
+	}
+	return( (ss->map != NULL) ? crud_stripe_save_map(ss, ss->map) : 0 );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : crud_stripe_destroy
+// Description  : Stop the workers and release the volumes and the backend
+//
+// Inputs       : be - the backend
+// Outputs      : none
+
+static void crud_stripe_destroy( CrudBackend *be ) {
+
+	// Local variables
+	CrudStripeStore *ss = be->state;
+	uint32_t v;
+
+	for ( v=0; v<ss->count; v++ ) {
+		crud_backend_worker_stop( ss->workers[v] );
+		crud_backend_destroy( ss->volumes[v] );
+	}
+	crud_stripe_clear( ss );
+	cleanupHashTable( &ss->objects );
+	free( ss->map );
+	free( ss );
+	free( be );
+}
+
+//
+// Functions
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : crud_stripe_backend_create
+// Description  : Create a backend striping objects over volumes
+//
+// Inputs       : arg - the settings and volumes, separated by '+'
+// Outputs      : the backend, or NULL if failure
+
+CrudBackend *crud_stripe_backend_create( const char *arg ) {
+
+	// Local variables
+	CrudBackend *be = calloc( 1, sizeof(CrudBackend) );
+	CrudStripeStore *ss = calloc( 1, sizeof(CrudStripeStore) );
+	char *list, *item, *save = NULL;
+	uint32_t v, devices = 0;
+	int failed = 0;
+
+	// Fill in the interface
+	initHashTable( &ss->objects, CRUD_STRIPE_HASH_BITS );
+	ss->next_oid = CRUD_STRIPE_FIRST_OID;
+	ss->priority_oid = CRUD_NO_OBJECT;
+	ss->unit = CRUD_STRIPE_UNIT;
+	ss->copies = 1;
+	be->name = "stripe";
+	be->request = crud_stripe_request;
+	be->batch = crud_stripe_batch;
+	be->save = crud_stripe_save;
+	be->load = crud_stripe_load;
+	be->sync = crud_stripe_sync;
+	be->destroy = crud_stripe_destroy;
+	be->state = ss;
+
+	// Read the settings, making each volume and its worker
+	list = strdup( (arg != NULL) ? arg : "" );
+	for ( item=strtok_r(list, "+", &save); (item != NULL) && !failed; item=strtok_r(NULL, "+", &save) ) {
+		if ( strncmp(item, "map=", 4) == 0 ) {
+			free( ss->map );
+			ss->map = strdup( item + 4 );
+		} else if ( strncmp(item, "unit=", 5) == 0 ) {
+			ss->unit = strtoul( item + 5, NULL, 0 );
+			failed = (ss->unit == 0) || (ss->unit > CRUD_MAX_OBJECT_SIZE);
+		} else if ( strncmp(item, "copies=", 7) == 0 ) {
+			ss->copies = strtoul( item + 7, NULL, 0 );
+		} else if ( ss->count == CRUD_STRIPE_MAX_VOLUMES ) {
+			CRUD_LOG( LOG_ERROR_LEVEL, "CRUD stripe: more than %d volumes", CRUD_STRIPE_MAX_VOLUMES );
+			failed = 1;
+		} else if ( (ss->volumes[ss->count] = crud_backend_create(item)) == NULL ) {
+			failed = 1;
+		} else {
+			devices += (strcmp(ss->volumes[ss->count]->name, "crud") == 0);
+			ss->workers[ss->count] = crud_backend_worker_start( ss->volumes[ss->count] );
+			failed = (ss->workers[ss->count++] == NULL);
+		}
+	}
+	free( list );
+
+	// The CRUD device is one store, it can only be one volume
+	if ( failed || (ss->count == 0) || (devices > 1) || (ss->copies == 0) || (ss->count % ss->copies) ) {
+		CRUD_LOG( LOG_ERROR_LEVEL, "CRUD stripe: bad volumes [%s]", (arg != NULL) ? arg : "" );
+		for ( v=0; v<=ss->count && v<CRUD_STRIPE_MAX_VOLUMES; v++ ) {
+			crud_backend_worker_stop( ss->workers[v] );
+			crud_backend_destroy( ss->volumes[v] );
+		}
+		ss->count = 0;
+		crud_stripe_destroy( be );
+		return( NULL );
+	}
+	ss->columns = ss->count / ss->copies;
+	return( be );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : crud_stripe_utest_fill
+// Description  : Fill a buffer with the contents of a test object
+//
+// Inputs       : buf - the buffer
+//                length - the bytes to fill
+//                seed - what makes the contents differ
+// Outputs      : none
+
+static void crud_stripe_utest_fill( char *buf, uint32_t length, uint32_t seed ) {
+
+	// Local variables
+	uint32_t i;
+
+	for ( i=0; i<length; i++ ) {
+		buf[i] = (char)(i * (seed + 1) + i / 4093 + seed);
+	}
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : crudStripeUnitTest
+// Description  : Stripe objects of every shape over volumes, update, batch,
+//                close and read them back from a new backend; then mirror
+//                them, lose copies and read and heal them
+//
+// Inputs       : none
+// Outputs      : 0 if successful, -1 if failure
+
+int crudStripeUnitTest( void ) {
+
+	// Local variables
+	static const uint32_t lengths[CRUD_STRIPE_UNIT_TEST_OBJECTS] = { 0, 1, CRUD_STRIPE_UNIT_TEST_UNIT, CRUD_STRIPE_UNIT_TEST_UNIT+1,
+			3*CRUD_STRIPE_UNIT_TEST_UNIT+5, 100000, 16, CRUD_MAX_OBJECT_SIZE };
+	const char *spec = "stripe:map=crud_stripe_utest.map+unit=4096+memory:crud_stripe_utest.crd.0+"
+			"memory:crud_stripe_utest.crd.1+memory:crud_stripe_utest.crd.2";
+	CrudOID oids[CRUD_STRIPE_UNIT_TEST_OBJECTS], parts[CRUD_STRIPE_UNIT_TEST_VOLUMES] = { 0, 0, 0 };
+	CrudRequest requests[2];
+	CrudResponse responses[2];
+	CrudStripeStore *ss;
+	CrudStripeObject *obj;
+	CrudResponse response;
+	char *data, *got, name[64];
+	void *bufs[2];
+	CrudBackend *be;
+	uint32_t i, v, w, seed;
+	uint64_t failovers;
+	int pass, ret = 0;
+
+	data = malloc( CRUD_MAX_OBJECT_SIZE );
+	got = malloc( CRUD_MAX_OBJECT_SIZE );
+	for ( pass=0; (pass<2) && (ret==0); pass++ ) {
+
+		// Start the store (a format the first time, the map read back the second)
+		if ( ((be = crud_backend_create(spec)) == NULL) ||
+				(be->request(be, construct_crud_request(0, CRUD_INIT, 0, 0, 0), NULL) & 0x1) ||
+				((pass == 0) && (be->request(be, construct_crud_request(0, CRUD_FORMAT, 0, 0, 0), NULL) & 0x1)) ) {
+			CRUD_LOG( LOG_ERROR_LEVEL, "CRUD stripe unit test: start failed." );
+			ret = -1;
+			break;
+		}
+		ss = be->state;
+
+		// Make the objects (the one of 16 bytes is the priority object)
+		for ( i=0; (pass==0) && (i<CRUD_STRIPE_UNIT_TEST_OBJECTS); i++ ) {
+			crud_stripe_utest_fill( data, lengths[i], i );
+			response = be->request( be, construct_crud_request(0, CRUD_CREATE, lengths[i],
+					(lengths[i] == 16) ? CRUD_PRIORITY_OBJECT : 0, 0), data );
+			oids[i] = (CrudOID)(response >> 32);
+			if ( response & 0x1 ) {
+				ret = -1;
+			}
+		}
+
+		// Update one (a batch with a new object, then its delete)
+		if ( pass == 0 ) {
+			crud_stripe_utest_fill( data, lengths[5], 99 );
+			requests[0] = construct_crud_request( oids[5], CRUD_UPDATE, lengths[5], 0, 0 );
+			requests[1] = construct_crud_request( 0, CRUD_CREATE, lengths[5], 0, 0 );
+			bufs[0] = bufs[1] = data;
+			if ( be->batch(be, requests, bufs, responses, 2) ||
+					(be->request(be, construct_crud_request((CrudOID)(responses[1] >> 32), CRUD_DELETE, 0, 0, 0), NULL) & 0x1) ) {
+				CRUD_LOG( LOG_ERROR_LEVEL, "CRUD stripe unit test: batch failed." );
+				ret = -1;
+			}
+		}
+
+		// Read every object back (the priority one by its flag)
+		for ( i=0; (ret==0) && (i<CRUD_STRIPE_UNIT_TEST_OBJECTS); i++ ) {
+			seed = (i == 5) ? 99 : i;
+			crud_stripe_utest_fill( data, lengths[i], seed );
+			memset( got, 0x0, lengths[i] );
+			response = be->request( be, construct_crud_request((lengths[i] == 16) ? 0 : oids[i], CRUD_READ, CRUD_MAX_OBJECT_SIZE,
+					(lengths[i] == 16) ? CRUD_PRIORITY_OBJECT : 0, 0), got );
+			if ( (response & 0x1) || (((response >> 4) & 0xffffff) != lengths[i]) || memcmp(got, data, lengths[i]) ) {
+				CRUD_LOG( LOG_ERROR_LEVEL, "CRUD stripe unit test: object %u (%u bytes) read back wrong, pass %d.", i, lengths[i], pass );
+				ret = -1;
+			}
+		}
+
+		// The large objects have parts on every volume
+		for ( i=0; (ret==0) && (i<CRUD_STRIPE_UNIT_TEST_OBJECTS); i++ ) {
+			obj = findValueInHashTable( &ss->objects, oids[i] );
+			for ( v=0; v<ss->count; v++ ) {
+				parts[v] += (obj->parts[v] != CRUD_NO_OBJECT);
+			}
+		}
+		for ( v=0; v<CRUD_STRIPE_UNIT_TEST_VOLUMES; v++ ) {
+			if ( (ret == 0) && (parts[v] < 3) ) {
+				CRUD_LOG( LOG_ERROR_LEVEL, "CRUD stripe unit test: volume %u has %u parts.", v, parts[v] );
+				ret = -1;
+			}
+		}
+
+		// Close (writing the volumes and the map)
+		if ( be->request(be, construct_crud_request(0, CRUD_CLOSE, 0, 0, 0), NULL) & 0x1 ) {
+			ret = -1;
+		}
+		crud_backend_destroy( be );
+	}
+
+	// Mirror the objects over two copies of two columns
+	if ( (ret == 0) && (((be = crud_backend_create("stripe:copies=2+unit=4096+memory+memory+memory+memory")) == NULL) ||
+			(be->request(be, construct_crud_request(0, CRUD_INIT, 0, 0, 0), NULL) & 0x1) ||
+			(be->request(be, construct_crud_request(0, CRUD_FORMAT, 0, 0, 0), NULL) & 0x1)) ) {
+		CRUD_LOG( LOG_ERROR_LEVEL, "CRUD stripe unit test: mirror start failed." );
+		ret = -1;
+		be = NULL;
+	}
+	ss = (be != NULL) ? be->state : NULL;
+	for ( i=0; (ret==0) && (i<CRUD_STRIPE_UNIT_TEST_OBJECTS); i++ ) {
+		crud_stripe_utest_fill( data, lengths[i], i );
+		response = be->request( be, construct_crud_request(0, CRUD_CREATE, lengths[i], 0, 0), data );
+		oids[i] = (CrudOID)(response >> 32);
+		obj = findValueInHashTable( &ss->objects, oids[i] );
+		if ( (response & 0x1) || (obj == NULL) || (obj->stale != 0) ) {
+			CRUD_LOG( LOG_ERROR_LEVEL, "CRUD stripe unit test: mirrored object %u not made.", i );
+			ret = -1;
+		}
+	}
+
+	// Lose the copy of the first part a read would go to (of every third
+	// object, each loss is logged by its volume): the read fails over
+	for ( i=1; (ret==0) && (i<CRUD_STRIPE_UNIT_TEST_OBJECTS); i+=3 ) {
+		obj = findValueInHashTable( &ss->objects, oids[i] );
+		v = crud_stripe_copy_to_read( ss, obj, crud_stripe_column(ss, oids[i], 0), 0 );
+		ss->volumes[v]->request( ss->volumes[v], construct_crud_request(obj->parts[v], CRUD_DELETE, 0, 0, 0), NULL );
+		failovers = ss->failovers;
+		crud_stripe_utest_fill( data, lengths[i], i );
+		response = be->request( be, construct_crud_request(oids[i], CRUD_READ, CRUD_MAX_OBJECT_SIZE, 0, 0), got );
+		if ( (response & 0x1) || memcmp(got, data, lengths[i]) || (ss->failovers != failovers + 1) ) {
+			CRUD_LOG( LOG_ERROR_LEVEL, "CRUD stripe unit test: mirrored object %u did not fail over.", i );
+			ret = -1;
+		}
+
+		// The update misses that copy, the next one makes it again
+		crud_stripe_utest_fill( data, lengths[i], i + 50 );
+		response = be->request( be, construct_crud_request(oids[i], CRUD_UPDATE, lengths[i], 0, 0), data );
+		if ( (response & 0x1) || !(obj->stale & (1 << v)) ||
+				(be->request(be, construct_crud_request(oids[i], CRUD_UPDATE, lengths[i], 0, 0), data) & 0x1) ||
+				(obj->stale != 0) ) {
+			CRUD_LOG( LOG_ERROR_LEVEL, "CRUD stripe unit test: mirrored object %u not healed.", i );
+			ret = -1;
+		}
+
+		// Lose the other copy instead: the healed one answers
+		w = (v < ss->columns) ? v + ss->columns : v - ss->columns;
+		ss->volumes[w]->request( ss->volumes[w], construct_crud_request(obj->parts[w], CRUD_DELETE, 0, 0, 0), NULL );
+		memset( got, 0x0, lengths[i] );
+		response = be->request( be, construct_crud_request(oids[i], CRUD_READ, CRUD_MAX_OBJECT_SIZE, 0, 0), got );
+		if ( (ret == 0) && ((response & 0x1) || memcmp(got, data, lengths[i])) ) {
+			CRUD_LOG( LOG_ERROR_LEVEL, "CRUD stripe unit test: mirrored object %u read back wrong.", i );
+			ret = -1;
+		}
+	}
+	if ( be != NULL ) {
+		crud_backend_destroy( be );
+	}
+
+	// Clean up
+	unlink( "crud_stripe_utest.map" );
+	for ( v=0; v<CRUD_STRIPE_UNIT_TEST_VOLUMES; v++ ) {
+		snprintf( name, sizeof(name), "crud_stripe_utest.crd.%u", v );
+		unlink( name );
+	}
+	free( data );
+	free( got );
+	if ( ret == 0 ) {
+		CRUD_LOG( LOG_INFO_LEVEL, "CRUD stripe unit tests completed successfully." );
+	}
+	return( ret );
+}
@@ -0,0 +1,495 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+//  File           : crud_client.c
+//  Description    : This is the implementation of a client of the CRUD
+//                   service.  The process has one connection, used by one
+//                   call at a time; the bytes of a read or write go through
+//                   the data window the server shares, a window at a time.
+//
+//  Last Modified  : Sun Oct 18 19:12:08 EDT 2026
+//
+
+// Includes
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+// Project Includes
+#include <crud_client.h>
+#include <crud_service.h>
+#include <crud_log.h>
+
+// Type definitions
+
+// This is an open directory of the server
+struct CrudClientDirectory {
+	int32_t             handle;  // The directory handle of the server
+	CrudDirectoryEntry  entry;   // The last entry read
+};
+
+//
+// Global data
+
+static int crud_client_sock = -1;       // The connection (-1 if not connected)
+static char *crud_client_window = NULL; // The data window shared with the server
+static pthread_mutex_t crud_client_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+//
+// Functional prototypes
+
+static int crud_client_io( void *buf, size_t len, int sending );
+static int64_t crud_client_call( CrudServiceRequest *request );
+static int64_t crud_client_simple( uint32_t op, int32_t handle, uint32_t offset, const char *path, const char *path2 );
+
+//
+// Functions
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : crud_client_connect
+// Description  : Connect to the server and map the data window it sends
+//
+// Inputs       : path - the socket of the server (NULL for $CRUD_SERVER or
+//                       the default)
+// Outputs      : 0 if successful, -1 if failure
+
+int crud_client_connect( const char *path ) {
+
+	// Local variables
+	char control[CMSG_SPACE(sizeof(int))];
+	struct sockaddr_un addr;
+	CrudServiceHello hello;
+	struct cmsghdr *cmsg;
+	struct msghdr msg;
+	struct iovec iov;
+	int mem = -1, ret = -1;
+
+	pthread_mutex_lock( &crud_client_mutex );
+	if ( crud_client_sock != -1 ) {
+		pthread_mutex_unlock( &crud_client_mutex );
+		return( 0 );
+	}
+	if ( (path == NULL) && ((path = getenv(CRUD_SERVICE_ENV)) == NULL) ) {
+		path = CRUD_SERVICE_SOCKET;
+	}
+
+	// Connect, the greeting carries the window
+	memset( &addr, 0x0, sizeof(addr) );
+	addr.sun_family = AF_UNIX;
+	strncpy( addr.sun_path, path, sizeof(addr.sun_path)-1 );
+	memset( &msg, 0x0, sizeof(msg) );
+	iov.iov_base = &hello;
+	iov.iov_len = sizeof(hello);
+	msg.msg_iov = &iov;
+	msg.msg_iovlen = 1;
+	msg.msg_control = control;
+	msg.msg_controllen = sizeof(control);
+	if ( ((crud_client_sock = socket(AF_UNIX, SOCK_STREAM, 0)) != -1) &&
+			!connect(crud_client_sock, (struct sockaddr *)&addr, sizeof(addr)) &&
+			(recvmsg(crud_client_sock, &msg, MSG_CMSG_CLOEXEC) == sizeof(hello)) &&
+			(hello.magic == CRUD_SERVICE_MAGIC) && (hello.window == CRUD_SERVICE_WINDOW) &&
+			((cmsg = CMSG_FIRSTHDR(&msg)) != NULL) && (cmsg->cmsg_type == SCM_RIGHTS) ) {
+		memcpy( &mem, CMSG_DATA(cmsg), sizeof(int) );
+		crud_client_window = mmap( NULL, CRUD_SERVICE_WINDOW, PROT_READ|PROT_WRITE, MAP_SHARED, mem, 0 );
+		ret = (crud_client_window == MAP_FAILED) ? -1 : 0;
+	}
+	if ( mem != -1 ) {
+		close( mem );
+	}
+	if ( ret ) {
+		CRUD_LOG( LOG_ERROR_LEVEL, "Failure connecting to the CRUD server at [%s], error: %s.", path, strerror(errno) );
+		if ( crud_client_sock != -1 ) {
+			close( crud_client_sock );
+			crud_client_sock = -1;
+		}
+		crud_client_window = NULL;
+	}
+	pthread_mutex_unlock( &crud_client_mutex );
+	return( ret );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : crud_client_disconnect
+// Description  : Disconnect from the server (it closes the files left open)
+//
+// Inputs       : none
+// Outputs      : 0 if successful, -1 if failure
+
+int crud_client_disconnect( void ) {
+
+	pthread_mutex_lock( &crud_client_mutex );
+	if ( crud_client_sock == -1 ) {
+		pthread_mutex_unlock( &crud_client_mutex );
+		return( -1 );
+	}
+	close( crud_client_sock );
+	munmap( crud_client_window, CRUD_SERVICE_WINDOW );
+	crud_client_sock = -1;
+	crud_client_window = NULL;
+	pthread_mutex_unlock( &crud_client_mutex );
+	return( 0 );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : crud_client_io
+// Description  : Send or receive a whole message.  Called with the lock.
+//
+// Inputs       : buf - the message
+//                len - the bytes of the message
+//                sending - nonzero to send, zero to receive
+// Outputs      : 0 if successful, -1 if failure (or the server hung up)
+
+static int crud_client_io( void *buf, size_t len, int sending ) {
+
+	// Local variables
+	size_t done = 0;
+	ssize_t n;
+
+	while ( done < len ) {
+		n = sending ? send( crud_client_sock, (char *)buf + done, len - done, MSG_NOSIGNAL ) :
+				recv( crud_client_sock, (char *)buf + done, len - done, 0 );
+		if ( (n == -1) && (errno == EINTR) ) {
+			continue;
+		}
+		if ( n <= 0 ) {
+			return( -1 );
+		}
+		done += n;
+	}
+	return( 0 );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : crud_client_call
+// Description  : Send a request and wait for its reply.  Called with the lock.
+//
+// Inputs       : request - the request
+// Outputs      : the result of the request, -1 if failure
+
+static int64_t crud_client_call( CrudServiceRequest *request ) {
+
+	// Local variables
+	CrudServiceReply reply;
+
+	if ( crud_client_sock == -1 ) {
+		return( -1 );
+	}
+	if ( crud_client_io(request, sizeof(CrudServiceRequest), 1) || crud_client_io(&reply, sizeof(reply), 0) ) {
+		CRUD_LOG( LOG_ERROR_LEVEL, "Lost the connection to the CRUD server." );
+		return( -1 );
+	}
+	return( reply.result );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : crud_client_simple
+// Description  : Make a request without data
+//
+// Inputs       : op - the request
+//                handle - the handle of the request
+//                offset - the offset or length of the request
+//                path - the path of the request (or NULL)
+//                path2 - the second path of the request (or NULL)
+// Outputs      : the result of the request, -1 if failure
+
+static int64_t crud_client_simple( uint32_t op, int32_t handle, uint32_t offset, const char *path, const char *path2 ) {
+
+	// Local variables
+	CrudServiceRequest request;
+	int64_t result;
+
+	memset( &request, 0x0, sizeof(request) );
+	request.op = op;
+	request.handle = handle;
+	request.count = (op == CRUD_SERVICE_OPEN) ? (int32_t)offset : 0;
+	request.offset = offset;
+	if ( ((path != NULL) && (strlen(path) >= CRUD_MAX_PATH_LENGTH)) || ((path2 != NULL) && (strlen(path2) >= CRUD_MAX_PATH_LENGTH)) ) {
+		return( -1 );
+	}
+	if ( path != NULL ) {
+		strcpy( request.path, path );
+	}
+	if ( path2 != NULL ) {
+		strcpy( request.path2, path2 );
+	}
+	pthread_mutex_lock( &crud_client_mutex );
+	result = crud_client_call( &request );
+	pthread_mutex_unlock( &crud_client_mutex );
+	return( result );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : crud_client_read_file
+// Description  : Read through the window, a window at a time
+//
+// Inputs       : op - CRUD_SERVICE_READ or CRUD_SERVICE_READ_AT
+//                fd - the handle to read
+//                buf - where the bytes go
+//                count - the bytes to read
+//                offset - where to read (CRUD_SERVICE_READ_AT)
+// Outputs      : the bytes read, -1 if failure
+
+static int32_t crud_client_read_file( uint32_t op, int16_t fd, char *buf, int32_t count, uint32_t offset ) {
+
+	// Local variables
+	CrudServiceRequest request;
+	int32_t done = 0;
+	int64_t got = 0;
+
+	if ( count < 0 ) {
+		return( -1 );
+	}
+	memset( &request, 0x0, sizeof(request) );
+	request.op = op;
+	request.handle = fd;
+	pthread_mutex_lock( &crud_client_mutex );
+	do {
+		request.count = (count - done > CRUD_SERVICE_WINDOW) ? CRUD_SERVICE_WINDOW : count - done;
+		request.offset = offset + done;
+		if ( (got = crud_client_call(&request)) <= 0 ) {
+			break;
+		}
+		memcpy( &buf[done], crud_client_window, got );
+		done += got;
+	} while ( (done < count) && (got == request.count) );
+	pthread_mutex_unlock( &crud_client_mutex );
+	return( ((got == -1) && (done == 0)) ? -1 : done );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : crud_client_write_file
+// Description  : Write through the window, a window at a time
+//
+// Inputs       : op - CRUD_SERVICE_WRITE or CRUD_SERVICE_WRITE_AT
+//                fd - the handle to write
+//                buf - the bytes to write
+//                count - the bytes to write
+//                offset - where to write (CRUD_SERVICE_WRITE_AT)
+// Outputs      : the bytes written, -1 if failure
+
+static int32_t crud_client_write_file( uint32_t op, int16_t fd, const char *buf, int32_t count, uint32_t offset ) {
+
+	// Local variables
+	CrudServiceRequest request;
+	int32_t done = 0;
+
+	if ( count < 0 ) {
+		return( -1 );
+	}
+	memset( &request, 0x0, sizeof(request) );
+	request.op = op;
+	request.handle = fd;
+	pthread_mutex_lock( &crud_client_mutex );
+	do {
+		request.count = (count - done > CRUD_SERVICE_WINDOW) ? CRUD_SERVICE_WINDOW : count - done;
+		request.offset = offset + done;
+		if ( crud_client_window != NULL ) {
+			memcpy( crud_client_window, &buf[done], request.count );
+		}
+		if ( crud_client_call(&request) != request.count ) {
+			pthread_mutex_unlock( &crud_client_mutex );
+			return( -1 );
+		}
+		done += request.count;
+	} while ( done < count );
+	pthread_mutex_unlock( &crud_client_mutex );
+	return( done );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : crud_client_* (the file calls)
+// Description  : The crud_file_io.h calls, made by the server
+//
+// Inputs       : those of the crud_file_io.h calls
+// Outputs      : those of the crud_file_io.h calls
+
+int16_t crud_client_format( void ) {
+	return( crud_client_simple(CRUD_SERVICE_FORMAT, 0, 0, NULL, NULL) );
+}
+
+int16_t crud_client_open( char *path, int32_t durability ) {
+	return( crud_client_simple(CRUD_SERVICE_OPEN, 0, durability, path, NULL) );
+}
+
+int16_t crud_client_close( int16_t fd ) {
+	return( crud_client_simple(CRUD_SERVICE_CLOSE, fd, 0, NULL, NULL) );
+}
+
+int32_t crud_client_read( int16_t fd, void *buf, int32_t count ) {
+	return( crud_client_read_file(CRUD_SERVICE_READ, fd, buf, count, 0) );
+}
+
+int32_t crud_client_write( int16_t fd, void *buf, int32_t count ) {
+	return( crud_client_write_file(CRUD_SERVICE_WRITE, fd, buf, count, 0) );
+}
+
+int32_t crud_client_read_at( int16_t fd, void *buf, int32_t count, uint32_t offset ) {
+	return( crud_client_read_file(CRUD_SERVICE_READ_AT, fd, buf, count, offset) );
+}
+
+int32_t crud_client_write_at( int16_t fd, void *buf, int32_t count, uint32_t offset ) {
+	return( crud_client_write_file(CRUD_SERVICE_WRITE_AT, fd, buf, count, offset) );
+}
+
+int32_t crud_client_seek( int16_t fd, uint32_t loc ) {
+	return( crud_client_simple(CRUD_SERVICE_SEEK, fd, loc, NULL, NULL) );
+}
+
+int16_t crud_client_flush( int16_t fd ) {
+	return( crud_client_simple(CRUD_SERVICE_FLUSH, fd, 0, NULL, NULL) );
+}
+
+int16_t crud_client_fsync( int16_t fd ) {
+	return( crud_client_simple(CRUD_SERVICE_FSYNC, fd, 0, NULL, NULL) );
+}
+
+int16_t crud_client_truncate( int16_t fd, uint32_t len ) {
+	return( crud_client_simple(CRUD_SERVICE_TRUNCATE, fd, len, NULL, NULL) );
+}
+
+int16_t crud_client_reserve( int16_t fd, uint32_t len ) {
+	return( crud_client_simple(CRUD_SERVICE_RESERVE, fd, len, NULL, NULL) );
+}
+
+int16_t crud_client_mkdir( char *path ) {
+	return( crud_client_simple(CRUD_SERVICE_MKDIR, 0, 0, path, NULL) );
+}
+
+int16_t crud_client_clone( char *src, char *dst ) {
+	return( crud_client_simple(CRUD_SERVICE_CLONE, 0, 0, src, dst) );
+}
+
+int16_t crud_client_snapshot( char *name ) {
+	return( crud_client_simple(CRUD_SERVICE_SNAPSHOT, 0, 0, name, NULL) );
+}
+
+int crud_client_sync( void ) {
+	return( crud_client_simple(CRUD_SERVICE_SYNC, 0, 0, NULL, NULL) );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : crud_client_opendir
+// Description  : Open a directory of the server
+//
+// Inputs       : path - the path of the directory
+// Outputs      : the directory or NULL if failure
+
+CrudClientDirectory *crud_client_opendir( char *path ) {
+
+	// Local variables
+	CrudClientDirectory *dir;
+	int64_t handle;
+
+	if ( (handle = crud_client_simple(CRUD_SERVICE_OPENDIR, 0, 0, path, NULL)) == -1 ) {
+		return( NULL );
+	}
+	dir = calloc( 1, sizeof(CrudClientDirectory) );
+	dir->handle = handle;
+	return( dir );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : crud_client_readdir
+// Description  : Get the next entry of a directory of the server
+//
+// Inputs       : dir - the directory
+// Outputs      : the entry (valid until the next call) or NULL at the end
+
+CrudDirectoryEntry *crud_client_readdir( CrudClientDirectory *dir ) {
+
+	// Local variables
+	CrudServiceRequest request;
+	int64_t result;
+
+	memset( &request, 0x0, sizeof(request) );
+	request.op = CRUD_SERVICE_READDIR;
+	request.handle = dir->handle;
+	pthread_mutex_lock( &crud_client_mutex );
+	if ( (result = crud_client_call(&request)) == 1 ) {
+		memcpy( &dir->entry, crud_client_window, sizeof(CrudDirectoryEntry) );
+	}
+	pthread_mutex_unlock( &crud_client_mutex );
+	return( (result == 1) ? &dir->entry : NULL );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : crud_client_closedir
+// Description  : Close a directory of the server
+//
+// Inputs       : dir - the directory
+// Outputs      : 0 if successful, -1 if failure
+
+int16_t crud_client_closedir( CrudClientDirectory *dir ) {
+
+	// Local variables
+	int16_t ret;
+
+	ret = crud_client_simple( CRUD_SERVICE_CLOSEDIR, dir->handle, 0, NULL, NULL );
+	free( dir );
+	return( ret );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : crud_client_list
+// Description  : Call a function on the entries the server lists, a window
+//                of them at a time (the function may make client calls, the
+//                entries of a window are copied out first)
+//
+// Inputs       : prefix - the prefix of the names
+//                fn - the function to call
+//                arg - the argument passed to the function
+// Outputs      : the number of entries listed or -1 if failure
+
+int32_t crud_client_list( char *prefix, CrudListFunction fn, void *arg ) {
+
+	// Local variables
+	CrudFileAllocationType *page;
+	CrudServiceRequest request;
+	uint32_t room = CRUD_SERVICE_WINDOW / sizeof(CrudFileAllocationType), got, i;
+	int32_t count = 0;
+	int64_t left;
+
+	if ( strlen(prefix) >= CRUD_MAX_PATH_LENGTH ) {
+		return( -1 );
+	}
+	memset( &request, 0x0, sizeof(request) );
+	request.op = CRUD_SERVICE_LIST;
+	strcpy( request.path, prefix );
+	page = malloc( sizeof(CrudFileAllocationType) * room );
+	do {
+		request.offset = count;
+		pthread_mutex_lock( &crud_client_mutex );
+		if ( (left = crud_client_call(&request)) > 0 ) {
+			got = (left > room) ? room : left;
+			memcpy( page, crud_client_window, sizeof(CrudFileAllocationType) * got );
+		}
+		pthread_mutex_unlock( &crud_client_mutex );
+		if ( left == -1 ) {
+			free( page );
+			return( -1 );
+		}
+		for ( i=0; (left>0) && (i<got); i++ ) {
+			fn( &page[i], arg );
+		}
+		count += (left > 0) ? got : 0;
+	} while ( left > room );
+	free( page );
+	return( count );
+}
@@ -0,0 +1,61 @@
+#ifndef CRUD_CLIENT_INCLUDED
+#define CRUD_CLIENT_INCLUDED
+
+////////////////////////////////////////////////////////////////////////////////
+//
+//  File           : crud_client.h
+//  Description    : This is the interface of a client of the CRUD service
+//                   (crud_server).  The calls are those of crud_file_io.h,
+//                   sent to the server over one connection per process;
+//                   libcrudclient.a also defines the crud_file_io.h names
+//                   themselves, so a program links it in place of the
+//                   driver.  Mount connects, unmount closes the files of the
+//                   process and disconnects (the volume stays mounted).
+//
+//  Last Modified  : Sun Oct 18 19:12:08 EDT 2026
+//
+
+// Includes
+#include <stdint.h>
+
+// Project Includes
+#include <crud_file_io.h>
+
+// Type definitions
+
+// This is an open directory of the server
+typedef struct CrudClientDirectory CrudClientDirectory;
+
+//
+// Client interface
+
+int crud_client_connect( const char *path );
+	// Connect to the server at path (NULL for $CRUD_SERVER or the default)
+
+int crud_client_disconnect( void );
+	// Close the files of the process and disconnect
+
+int16_t crud_client_format( void );
+int16_t crud_client_open( char *path, int32_t durability );
+int16_t crud_client_close( int16_t fd );
+int32_t crud_client_read( int16_t fd, void *buf, int32_t count );
+int32_t crud_client_write( int16_t fd, void *buf, int32_t count );
+int32_t crud_client_read_at( int16_t fd, void *buf, int32_t count, uint32_t offset );
+int32_t crud_client_write_at( int16_t fd, void *buf, int32_t count, uint32_t offset );
+int32_t crud_client_seek( int16_t fd, uint32_t loc );
+int16_t crud_client_flush( int16_t fd );
+int16_t crud_client_fsync( int16_t fd );
+int16_t crud_client_truncate( int16_t fd, uint32_t len );
+int16_t crud_client_reserve( int16_t fd, uint32_t len );
+int16_t crud_client_mkdir( char *path );
+CrudClientDirectory *crud_client_opendir( char *path );
+CrudDirectoryEntry *crud_client_readdir( CrudClientDirectory *dir );
+int16_t crud_client_closedir( CrudClientDirectory *dir );
+int32_t crud_client_list( char *prefix, CrudListFunction fn, void *arg );
+int16_t crud_client_clone( char *src, char *dst );
+int16_t crud_client_snapshot( char *name );
+int crud_client_sync( void );
+	// The crud_file_io.h calls of the same names, made by the server
+	// (durability -1 opens without picking a class, like crud_open)
+
+#endif
@@ -0,0 +1,130 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+//  File           : crud_client_api.c
+//  Description    : This is the crud_file_io.h interface of libcrudclient.a:
+//                   each call is made by the CRUD server (crud_client.c).
+//                   Mount connects (to $CRUD_SERVER or the default socket)
+//                   and unmount disconnects; format formats the volume of
+//                   the server.  The object store calls are not served.
+//
+//  Last Modified  : Sun Oct 18 19:12:08 EDT 2026
+//
+
+// Includes
+#include <stddef.h>
+#include <stdint.h>
+
+// Project Includes
+#include <crud_client.h>
+
+//
+// Functions
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : crud_* (the management calls)
+// Description  : Connect to the server (mount), disconnect (unmount) or have
+//                it format the volume
+//
+// Inputs       : none
+// Outputs      : 0 if successful, -1 if failure
+
+uint16_t crud_format(void) {
+	return( (crud_client_connect(NULL) || crud_client_format()) ? -1 : 0 );
+}
+
+uint16_t crud_mount(void) {
+	return( crud_client_connect(NULL) ? -1 : 0 );
+}
+
+uint16_t crud_unmount(void) {
+	return( crud_client_disconnect() ? -1 : 0 );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : crud_* (the interface calls)
+// Description  : The calls of crud_file_io.h, made by the server
+//
+// Inputs       : those of crud_file_io.h
+// Outputs      : those of crud_file_io.h
+
+int16_t crud_open(char *path) {
+	return( crud_client_open(path, -1) );
+}
+
+int16_t crud_open_durable(char *path, CrudDurability durability) {
+	return( crud_client_open(path, durability) );
+}
+
+int16_t crud_close(int16_t fd) {
+	return( crud_client_close(fd) );
+}
+
+int32_t crud_read(int16_t fd, void *buf, int32_t count) {
+	return( crud_client_read(fd, buf, count) );
+}
+
+int32_t crud_write(int16_t fd, void *buf, int32_t count) {
+	return( crud_client_write(fd, buf, count) );
+}
+
+int32_t crud_read_at(int16_t fd, void *buf, int32_t count, uint32_t offset) {
+	return( crud_client_read_at(fd, buf, count, offset) );
+}
+
+int32_t crud_write_at(int16_t fd, void *buf, int32_t count, uint32_t offset) {
+	return( crud_client_write_at(fd, buf, count, offset) );
+}
+
+int32_t crud_seek(int16_t fd, uint32_t loc) {
+	return( crud_client_seek(fd, loc) );
+}
+
+int16_t crud_flush(int16_t fd) {
+	return( crud_client_flush(fd) );
+}
+
+int16_t crud_fsync(int16_t fd) {
+	return( crud_client_fsync(fd) );
+}
+
+int16_t crud_truncate(int16_t fd, uint32_t len) {
+	return( crud_client_truncate(fd, len) );
+}
+
+int16_t crud_reserve(int16_t fd, uint32_t len) {
+	return( crud_client_reserve(fd, len) );
+}
+
+int16_t crud_mkdir(char *path) {
+	return( crud_client_mkdir(path) );
+}
+
+CrudDirectory *crud_opendir(char *path) {
+	return( (CrudDirectory *)crud_client_opendir(path) );
+}
+
+CrudDirectoryEntry *crud_readdir(CrudDirectory *dir) {
+	return( crud_client_readdir((CrudClientDirectory *)dir) );
+}
+
+int16_t crud_closedir(CrudDirectory *dir) {
+	return( crud_client_closedir((CrudClientDirectory *)dir) );
+}
+
+int32_t crud_list(char *prefix, CrudListFunction fn, void *arg) {
+	return( crud_client_list(prefix, fn, arg) );
+}
+
+int16_t crud_clone(char *src, char *dst) {
+	return( crud_client_clone(src, dst) );
+}
+
+int16_t crud_snapshot(char *name) {
+	return( crud_client_snapshot(name) );
+}
+
+int crud_io_sync( void ) {
+	return( crud_client_sync() );
+}
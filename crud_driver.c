@@ -0,0 +1,1053 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+//  File           : crud_driver.c
+//  Description    : This is the implementation of the CRUD object store.
+//                   Objects are kept in an mmap-backed store file, space is
+//                   handed out by a first-fit free-space allocator, and a
+//                   save writes back only the objects changed since the
+//                   last save.
+//
+//  Last Modified  : Sun Oct 18 09:12:40 EDT 2026
+//
+
+// Needed for mremap
+#define _GNU_SOURCE
+
+// Includes
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+// Project Includes
+#include <crud_driver.h>
+#include <crud_log.h>
+#include <cmpsc311_util.h>
+#include <cmpsc311_hashtable.h>
+
+// Defines
+#define CRUD_STORE_FILENAME "crud_content.crd"
+#define CRUD_STORE_MAGIC "CRUDSTR1"
+#define CRUD_STORE_VERSION 1
+#define CRUD_STORE_HEADER_SIZE 4096        // the header occupies the first page
+#define CRUD_STORE_INITIAL_SLOTS 1024      // directory slots in a new store
+#define CRUD_STORE_ALIGNMENT 16            // alignment of object data
+#define CRUD_STORE_MIN_GROWTH (1024*1024)  // smallest growth of the store
+#define CRUD_STORE_MAX_PATH 256
+#define CRUD_FIRST_OID 4096
+#define CRUD_HASH_BITS 8
+#define CRUD_UNIT_TEST_OBJECTS 64
+#define CRUD_UNIT_TEST_ITERATIONS 2048
+
+// Type definitions
+
+// This is the header at the start of the store file
+typedef struct {
+	char      magic[8];     // CRUD_STORE_MAGIC
+	uint32_t  version;      // Format version of the store
+	CrudOID   next_oid;     // Next object identifier to hand out
+	CrudOID   priority_oid; // The priority object (CRUD_NO_OBJECT if none)
+	uint32_t  dir_slots;    // Number of slots in the object directory
+	uint64_t  dir_offset;   // Offset of the object directory in the store
+	uint64_t  size;         // Size of the store file
+} CrudStoreHeader;
+
+// This is an object directory slot (a free slot has oid CRUD_NO_OBJECT)
+typedef struct {
+	CrudOID   oid;    // The object identifier
+	uint32_t  flags;  // The object flags (CRUD_FLAG_TYPES)
+	uint64_t  offset; // Offset of the object data in the store
+	uint32_t  length; // Length of the object
+	uint32_t  unused; // Padding, keeps the slot layout fixed
+} CrudStoreSlot;
+
+// This is the in-memory record of an object
+typedef struct {
+	CrudOID   oid;   // The object identifier
+	uint32_t  slot;  // The directory slot of the object
+	uint8_t   dirty; // Object data changed since the last save
+} CrudStoreObject;
+
+// This is a range of free space in the store
+typedef struct {
+	uint64_t  offset; // The offset of the free range
+	uint64_t  length; // The length of the free range
+} CrudStoreExtent;
+
+//
+// Global Data
+
+const char *CRUD_REQUEST_TYPE_LABLES[CRUD_MAXVAL] = {
+	"CRUD_INIT", "CRUD_FORMAT", "CRUD_CREATE", "CRUD_READ",
+	"CRUD_UPDATE", "CRUD_DELETE", "CRUD_CLOSE", "CRUD_UNKNOWN"
+};
+const char *CRUD_FLAG_TYPE_LABLES[CRUD_FLAGMAX] = {
+	"CRUD_NULL_FLAG", "CRUD_PRIORITY_OBJECT"
+};
+
+uint8_t crud_driver_initialized;             // Flag indicating the store is ready
+static char *crud_store_map;                 // The mapped store
+static int crud_store_fd = -1;               // The backing store file (-1 if none yet)
+static char crud_store_name[CRUD_STORE_MAX_PATH]; // The name of the backing store file
+static CrudStoreHeader *crud_store_header;   // The header (in the map)
+static HTable crud_store_index;              // The objects, by OID
+static CrudStoreObject **crud_store_slots;   // The objects, by directory slot
+static uint32_t *crud_store_free_slots;      // Stack of free directory slots
+static uint32_t crud_store_nfree_slots;      // Number of free directory slots
+static uint8_t *crud_store_slot_dirty;       // Directory slots changed since the last save
+static uint32_t *crud_store_dirty;           // List of the changed directory slots
+static uint32_t crud_store_ndirty;           // Number of changed directory slots
+static uint8_t crud_store_dir_moved;         // The directory was moved since the last save
+static CrudStoreExtent *crud_store_free;     // Free space, sorted by offset
+static uint32_t crud_store_nfree;            // Number of free ranges
+static uint32_t crud_store_free_size;        // Capacity of the free range list
+
+//
+// Functional Prototypes
+
+CrudRequest construct_crud_request(CrudOID oid, CRUD_REQUEST_TYPES req,
+		uint32_t length, uint8_t flags, uint8_t res);
+int deconstruct_crud_request(CrudRequest request, CrudOID *oid,
+		CRUD_REQUEST_TYPES *req, uint32_t *length, uint8_t *flags,
+		uint8_t *res);
+static int crud_store_new( void );
+static int crud_store_map_file( char *fname );
+static int crud_store_import_legacy( char *fname );
+static void crud_store_release( void );
+static CrudStoreSlot *crud_store_slot( uint32_t slot );
+static int crud_store_grow( uint64_t need );
+static int crud_store_allocate( uint32_t length, uint64_t *offset );
+static void crud_store_deallocate( uint64_t offset, uint32_t length );
+static CrudStoreObject *crud_store_insert( CrudOID oid, uint32_t flags, uint32_t length );
+static void crud_store_mark( uint32_t slot );
+static CrudStoreObject *crud_store_find( CrudOID oid, uint8_t flags );
+
+//
+// Functions
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : crud_bus_request
+// Description  : This is the interface to the CRUD object store
+//
+// Inputs       : request - the request value
+//                buf - the buffer for the request
+// Outputs      : the response value (result bit set on failure)
+
+CrudResponse crud_bus_request( CrudRequest request, void *buf ) {
+
+	// Local variables
+	CrudOID oid;
+	CRUD_REQUEST_TYPES req;
+	uint32_t length;
+	uint8_t flags, res;
+	CrudStoreObject *obj;
+	CrudStoreSlot *slot;
+
+	// Unpack the request, everything but INIT needs a ready store
+	deconstruct_crud_request( request, &oid, &req, &length, &flags, &res );
+	if ( (req != CRUD_INIT) && (! crud_driver_initialized) ) {
+		CRUD_LOG( LOG_ERROR_LEVEL, "CRUD: request [%s] on uninitialized store.",
+				(req < CRUD_MAXVAL) ? CRUD_REQUEST_TYPE_LABLES[req] : "?" );
+		return( construct_crud_request(oid, req, length, flags, 1) );
+	}
+
+	switch ( req ) {
+
+	case CRUD_INIT: // Initialize, load the saved contents if there are any
+		crud_store_release();
+		if ( access(CRUD_STORE_FILENAME, F_OK) == 0 ) {
+			if ( crud_load_store(CRUD_STORE_FILENAME) ) {
+				return( construct_crud_request(oid, req, length, flags, 1) );
+			}
+		} else {
+			CRUD_LOG( LOG_INFO_LEVEL, "CRUD repository file [%s] does not exist, not loading",
+					CRUD_STORE_FILENAME );
+			if ( crud_store_new() ) {
+				return( construct_crud_request(oid, req, length, flags, 1) );
+			}
+		}
+		crud_driver_initialized = 1;
+		CRUD_LOG( LOG_INFO_LEVEL, "CRUD: Object store initialized [first OID %u, bit width=%d]",
+				crud_store_header->next_oid, CRUD_HASH_BITS );
+		return( construct_crud_request(0, req, 0, flags, 0) );
+
+	case CRUD_FORMAT: // Drop every object and the saved contents
+		crud_store_release();
+		unlink( CRUD_STORE_FILENAME );
+		if ( crud_store_new() ) {
+			return( construct_crud_request(oid, req, length, flags, 1) );
+		}
+		crud_driver_initialized = 1;
+		CRUD_LOG( LOG_INFO_LEVEL, "CRUD: Object store formatted." );
+		return( construct_crud_request(0, req, 0, flags, 0) );
+
+	case CRUD_CREATE: // Create the object and copy the data in
+		if ( (flags == CRUD_PRIORITY_OBJECT) && (crud_store_header->priority_oid != CRUD_NO_OBJECT) ) {
+			CRUD_LOG( LOG_ERROR_LEVEL, "CRUD: cannot create priority object, one already exists" );
+			return( construct_crud_request(oid, req, length, flags, 1) );
+		}
+		if ( (length > 0) && (buf == NULL) ) {
+			CRUD_LOG( LOG_ERROR_LEVEL, "CRUD: create of %u bytes with no buffer", length );
+			return( construct_crud_request(oid, req, length, flags, 1) );
+		}
+		if ( (obj = crud_store_insert(crud_store_header->next_oid, flags, length)) == NULL ) {
+			return( construct_crud_request(oid, req, length, flags, 1) );
+		}
+		crud_store_header->next_oid++;
+		if ( flags == CRUD_PRIORITY_OBJECT ) {
+			crud_store_header->priority_oid = obj->oid;
+		}
+		slot = crud_store_slot( obj->slot );
+		if ( length > 0 ) {
+			memcpy( &crud_store_map[slot->offset], buf, length );
+		}
+		CRUD_LOG( LOG_INFO_LEVEL, "CRUD: new object [OID %u], length %u bytes", obj->oid, length );
+		return( construct_crud_request(obj->oid, req, length, flags, 0) );
+
+	case CRUD_READ: // Copy the object out, the length is the buffer size
+		if ( (obj = crud_store_find(oid, flags)) == NULL ) {
+			CRUD_LOG( LOG_ERROR_LEVEL, "CRUD: read non-existent object [OID %u]", oid );
+			return( construct_crud_request(oid, req, length, flags, 1) );
+		}
+		slot = crud_store_slot( obj->slot );
+		if ( slot->length > length ) {
+			CRUD_LOG( LOG_ERROR_LEVEL, "CRUD: read target buffer too small [OID %u<%u]", length, slot->length );
+			return( construct_crud_request(oid, req, length, flags, 1) );
+		}
+		if ( (slot->length > 0) && (buf == NULL) ) {
+			CRUD_LOG( LOG_ERROR_LEVEL, "CRUD: read of %u bytes with no buffer [OID %u]", slot->length, oid );
+			return( construct_crud_request(oid, req, length, flags, 1) );
+		}
+		if ( slot->length > 0 ) {
+			memcpy( buf, &crud_store_map[slot->offset], slot->length );
+		}
+		CRUD_LOG( LOG_INFO_LEVEL, "CRUD: object [OID %u] read %u bytes.", obj->oid, slot->length );
+		return( construct_crud_request(oid, req, slot->length, flags, 0) );
+
+	case CRUD_UPDATE: // Overwrite the object, the size can never change
+		if ( (obj = crud_store_find(oid, flags)) == NULL ) {
+			CRUD_LOG( LOG_ERROR_LEVEL, "CRUD: update non-existent object [OID %u]", oid );
+			return( construct_crud_request(oid, req, length, flags, 1) );
+		}
+		slot = crud_store_slot( obj->slot );
+		if ( slot->length != length ) {
+			CRUD_LOG( LOG_ERROR_LEVEL, "CRUD: update length mismatch [OID %u]", oid );
+			return( construct_crud_request(oid, req, length, flags, 1) );
+		}
+		if ( (length > 0) && (buf == NULL) ) {
+			CRUD_LOG( LOG_ERROR_LEVEL, "CRUD: update of %u bytes with no buffer [OID %u]", length, oid );
+			return( construct_crud_request(oid, req, length, flags, 1) );
+		}
+		if ( length > 0 ) {
+			memcpy( &crud_store_map[slot->offset], buf, length );
+		}
+		crud_store_mark( obj->slot );
+		obj->dirty = 1;
+		CRUD_LOG( LOG_INFO_LEVEL, "CRUD: object [OID %u] update %u bytes.", obj->oid, length );
+		return( construct_crud_request(oid, req, length, flags, 0) );
+
+	case CRUD_DELETE: // Release the object and its space
+		if ( (obj = crud_store_find(oid, flags)) == NULL ) {
+			CRUD_LOG( LOG_ERROR_LEVEL, "CRUD: delete non-existent object [OID %u]", oid );
+			return( construct_crud_request(oid, req, length, flags, 1) );
+		}
+		slot = crud_store_slot( obj->slot );
+		crud_store_deallocate( slot->offset, slot->length );
+		if ( obj->oid == crud_store_header->priority_oid ) {
+			crud_store_header->priority_oid = CRUD_NO_OBJECT;
+		}
+		memset( slot, 0x0, sizeof(CrudStoreSlot) );
+		crud_store_mark( obj->slot );
+		crud_store_slots[obj->slot] = NULL;
+		crud_store_free_slots[crud_store_nfree_slots++] = obj->slot;
+		deleteValueFromHashTable( &crud_store_index, obj->oid );
+		CRUD_LOG( LOG_INFO_LEVEL, "CRUD: object [OID %u] deleted.", obj->oid );
+		free( obj );
+		return( construct_crud_request(oid, req, 0, flags, 0) );
+
+	case CRUD_CLOSE: // Save the contents, the objects stay readable
+		if ( crud_save_store(CRUD_STORE_FILENAME) ) {
+			return( construct_crud_request(oid, req, length, flags, 1) );
+		}
+		CRUD_LOG( LOG_INFO_LEVEL, "CRUD: Object store closed" );
+		return( construct_crud_request(0, req, 0, flags, 0) );
+
+	default: // Unknown request
+		CRUD_LOG( LOG_ERROR_LEVEL, "CRUD: unknown request type [%d]", req );
+		return( construct_crud_request(oid, req, length, flags, 1) );
+	}
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : crud_save_store
+// Description  : Write the contents of the CRUD store to disk file.  Saving
+//                to the file backing the store writes only the changed
+//                objects, any other file gets the whole store.
+//
+// Inputs       : fname - the name of the store file
+// Outputs      : 0 if successful, -1 if failure
+
+int crud_save_store( char *fname ) {
+
+	// Local variables
+	CrudStoreObject *obj;
+	CrudStoreSlot *slot;
+	uint32_t i, written = 0;
+	int fh;
+
+	// Saving to the backing file, write back what changed
+	CRUD_LOG( LOG_INFO_LEVEL, "Storing the CRUD store contents to [%s] ...", fname );
+	if ( (crud_store_fd != -1) && (strcmp(fname, crud_store_name) == 0) ) {
+
+		// Write the changed object data and directory slots
+		for ( i=0; i<crud_store_ndirty; i++ ) {
+			obj = crud_store_slots[crud_store_dirty[i]];
+			if ( (obj != NULL) && (obj->dirty) ) {
+				slot = crud_store_slot( obj->slot );
+				if ( pwrite(crud_store_fd, &crud_store_map[slot->offset], slot->length,
+						slot->offset) != slot->length ) {
+					CRUD_LOG( LOG_ERROR_LEVEL, "CRUD: store write failed [%s]", strerror(errno) );
+					return( -1 );
+				}
+				obj->dirty = 0;
+				written++;
+			}
+			if ( ! crud_store_dir_moved ) {
+				slot = crud_store_slot( crud_store_dirty[i] );
+				if ( pwrite(crud_store_fd, slot, sizeof(CrudStoreSlot),
+						(char *)slot - crud_store_map) != sizeof(CrudStoreSlot) ) {
+					CRUD_LOG( LOG_ERROR_LEVEL, "CRUD: store write failed [%s]", strerror(errno) );
+					return( -1 );
+				}
+			}
+			crud_store_slot_dirty[crud_store_dirty[i]] = 0;
+		}
+		crud_store_ndirty = 0;
+
+		// A moved directory goes out whole, then the header
+		if ( crud_store_dir_moved ) {
+			i = crud_store_header->dir_slots * sizeof(CrudStoreSlot);
+			if ( pwrite(crud_store_fd, crud_store_slot(0), i, crud_store_header->dir_offset) != i ) {
+				CRUD_LOG( LOG_ERROR_LEVEL, "CRUD: store write failed [%s]", strerror(errno) );
+				return( -1 );
+			}
+			crud_store_dir_moved = 0;
+		}
+		if ( (pwrite(crud_store_fd, crud_store_header, sizeof(CrudStoreHeader), 0) != sizeof(CrudStoreHeader)) ||
+			 (fdatasync(crud_store_fd) == -1) ) {
+			CRUD_LOG( LOG_ERROR_LEVEL, "CRUD: store write failed [%s]", strerror(errno) );
+			return( -1 );
+		}
+		CRUD_LOG( LOG_INFO_LEVEL, "Stored the disk array contents successfully (%u objects written).", written );
+		return( 0 );
+	}
+
+	// Another file, write the whole store image
+	if ( (fh = open(fname, O_WRONLY|O_CREAT|O_TRUNC, S_IRUSR|S_IWUSR)) == -1 ) {
+		CRUD_LOG( LOG_ERROR_LEVEL, "CRUD: failed to open store file [%s], %s", fname, strerror(errno) );
+		return( -1 );
+	}
+	if ( (write(fh, crud_store_map, crud_store_header->size) != crud_store_header->size) || (fsync(fh) == -1) ) {
+		CRUD_LOG( LOG_ERROR_LEVEL, "CRUD: store write failed [%s]", strerror(errno) );
+		close( fh );
+		return( -1 );
+	}
+	close( fh );
+
+	// A store that has no backing file yet is now backed by this one
+	if ( crud_store_fd == -1 ) {
+		if ( crud_store_map_file(fname) ) {
+			return( -1 );
+		}
+		crud_driver_initialized = 1;
+	}
+	CRUD_LOG( LOG_INFO_LEVEL, "Stored the disk array contents successfully." );
+	return( 0 );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : crud_load_store
+// Description  : Read the contents of the storage device from a disk file.
+//                Store files in the old flat format are imported.
+//
+// Inputs       : fname - the name of the store file
+// Outputs      : 0 if successful, -1 if failure
+
+int crud_load_store( char *fname ) {
+
+	// Local variables
+	char magic[sizeof(CRUD_STORE_MAGIC)];
+	int fh;
+
+	// Check the format of the file
+	CRUD_LOG( LOG_INFO_LEVEL, "Loading the disk array contents ..." );
+	if ( (fh = open(fname, O_RDONLY)) == -1 ) {
+		CRUD_LOG( LOG_ERROR_LEVEL, "CRUD: failed to open store file [%s], %s", fname, strerror(errno) );
+		return( -1 );
+	}
+	memset( magic, 0x0, sizeof(magic) );
+	if ( read(fh, magic, sizeof(magic)-1) < 0 ) {
+		CRUD_LOG( LOG_ERROR_LEVEL, "CRUD: failed to read store file [%s], %s", fname, strerror(errno) );
+		close( fh );
+		return( -1 );
+	}
+	close( fh );
+
+	// Map the store, or import the old format
+	crud_store_release();
+	if ( strcmp(magic, CRUD_STORE_MAGIC) == 0 ) {
+		if ( crud_store_map_file(fname) ) {
+			return( -1 );
+		}
+	} else if ( crud_store_import_legacy(fname) ) {
+		return( -1 );
+	}
+	crud_driver_initialized = 1;
+	CRUD_LOG( LOG_INFO_LEVEL, "Loaded the disk array contents successfully." );
+	return( 0 );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : construct_crud_request
+// Description  : Pack the fields of a request/response value
+//
+// Inputs       : oid - the object identifier
+//                req - the request type
+//                length - the length field
+//                flags - the flags field
+//                res - the result bit
+// Outputs      : the packed request
+
+CrudRequest construct_crud_request( CrudOID oid, CRUD_REQUEST_TYPES req,
+		uint32_t length, uint8_t flags, uint8_t res ) {
+	return( ((CrudRequest)oid << 32) | ((CrudRequest)(req & 0xf) << 28) |
+			((CrudRequest)(length & 0xffffff) << 4) | ((flags & 0x7) << 1) | (res & 0x1) );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : deconstruct_crud_request
+// Description  : Unpack the fields of a request/response value
+//
+// Inputs       : request - the packed request
+//                oid, req, length, flags, res - the fields (out)
+// Outputs      : 0 always
+
+int deconstruct_crud_request( CrudRequest request, CrudOID *oid,
+		CRUD_REQUEST_TYPES *req, uint32_t *length, uint8_t *flags,
+		uint8_t *res ) {
+	*oid = (CrudOID)(request >> 32);
+	*req = (CRUD_REQUEST_TYPES)((request >> 28) & 0xf);
+	*length = (uint32_t)((request >> 4) & 0xffffff);
+	*flags = (uint8_t)((request >> 1) & 0x7);
+	*res = (uint8_t)(request & 0x1);
+	return( 0 );
+}
+
+//
+// Module local methods
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : crud_store_new
+// Description  : Set up an empty store (not backed by a file until saved)
+//
+// Inputs       : none
+// Outputs      : 0 if successful, -1 if failure
+
+static int crud_store_new( void ) {
+
+	// Local variables
+	uint64_t size = CRUD_STORE_HEADER_SIZE + CRUD_STORE_INITIAL_SLOTS*sizeof(CrudStoreSlot) + CRUD_STORE_MIN_GROWTH;
+	uint32_t i;
+
+	// Map anonymous memory for the store
+	crud_store_map = mmap( NULL, size, PROT_READ|PROT_WRITE, MAP_PRIVATE|MAP_ANONYMOUS, -1, 0 );
+	if ( crud_store_map == MAP_FAILED ) {
+		CRUD_LOG( LOG_ERROR_LEVEL, "CRUD: failed to map store, %s", strerror(errno) );
+		crud_store_map = NULL;
+		return( -1 );
+	}
+
+	// Lay out the header and directory, everything after is free
+	crud_store_header = (CrudStoreHeader *)crud_store_map;
+	memcpy( crud_store_header->magic, CRUD_STORE_MAGIC, sizeof(crud_store_header->magic) );
+	crud_store_header->version = CRUD_STORE_VERSION;
+	crud_store_header->next_oid = CRUD_FIRST_OID;
+	crud_store_header->priority_oid = CRUD_NO_OBJECT;
+	crud_store_header->dir_slots = CRUD_STORE_INITIAL_SLOTS;
+	crud_store_header->dir_offset = CRUD_STORE_HEADER_SIZE;
+	crud_store_header->size = size;
+	initHashTable( &crud_store_index, CRUD_HASH_BITS );
+	crud_store_slots = calloc( CRUD_STORE_INITIAL_SLOTS, sizeof(CrudStoreObject *) );
+	crud_store_free_slots = malloc( CRUD_STORE_INITIAL_SLOTS*sizeof(uint32_t) );
+	crud_store_slot_dirty = calloc( CRUD_STORE_INITIAL_SLOTS, sizeof(uint8_t) );
+	crud_store_dirty = malloc( CRUD_STORE_INITIAL_SLOTS*sizeof(uint32_t) );
+	for ( i=0; i<CRUD_STORE_INITIAL_SLOTS; i++ ) {
+		crud_store_free_slots[i] = CRUD_STORE_INITIAL_SLOTS - i - 1;
+	}
+	crud_store_nfree_slots = CRUD_STORE_INITIAL_SLOTS;
+	crud_store_deallocate( CRUD_STORE_HEADER_SIZE + CRUD_STORE_INITIAL_SLOTS*sizeof(CrudStoreSlot),
+			CRUD_STORE_MIN_GROWTH );
+	return( 0 );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : crud_store_extent_compare
+// Description  : Order extents by offset (qsort comparator)
+//
+// Inputs       : a, b - the extents
+// Outputs      : <0, 0, >0 as a is before, at, after b
+
+static int crud_store_extent_compare( const void *a, const void *b ) {
+	uint64_t x = ((CrudStoreExtent *)a)->offset, y = ((CrudStoreExtent *)b)->offset;
+	return( (x < y) ? -1 : (x > y) );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : crud_store_map_file
+// Description  : Map a store file and index its objects, the store is then
+//                backed by the file (the current store is dropped)
+//
+// Inputs       : fname - the store file
+// Outputs      : 0 if successful, -1 if failure
+
+static int crud_store_map_file( char *fname ) {
+
+	// Local variables
+	CrudStoreHeader header;
+	CrudStoreExtent *used;
+	CrudStoreObject *obj;
+	CrudStoreSlot *slot;
+	uint64_t end;
+	uint32_t i, nused = 0;
+	int fh;
+
+	// Open the file and check the header
+	if ( ((fh = open(fname, O_RDWR)) == -1) ||
+		 (pread(fh, &header, sizeof(header), 0) != sizeof(header)) ||
+		 (memcmp(header.magic, CRUD_STORE_MAGIC, sizeof(header.magic)) != 0) ||
+		 (header.version != CRUD_STORE_VERSION) ) {
+		CRUD_LOG( LOG_ERROR_LEVEL, "CRUD: bad store file [%s]", fname );
+		if ( fh != -1 ) {
+			close( fh );
+		}
+		return( -1 );
+	}
+
+	// Map it, drop whatever store was there before
+	crud_store_release();
+	crud_store_map = mmap( NULL, header.size, PROT_READ|PROT_WRITE, MAP_PRIVATE, fh, 0 );
+	if ( crud_store_map == MAP_FAILED ) {
+		CRUD_LOG( LOG_ERROR_LEVEL, "CRUD: failed to map store [%s], %s", fname, strerror(errno) );
+		crud_store_map = NULL;
+		close( fh );
+		return( -1 );
+	}
+	crud_store_fd = fh;
+	strncpy( crud_store_name, fname, CRUD_STORE_MAX_PATH-1 );
+	crud_store_header = (CrudStoreHeader *)crud_store_map;
+
+	// Index the directory, remembering where objects live
+	initHashTable( &crud_store_index, CRUD_HASH_BITS );
+	crud_store_slots = calloc( header.dir_slots, sizeof(CrudStoreObject *) );
+	crud_store_free_slots = malloc( header.dir_slots*sizeof(uint32_t) );
+	crud_store_slot_dirty = calloc( header.dir_slots, sizeof(uint8_t) );
+	crud_store_dirty = malloc( header.dir_slots*sizeof(uint32_t) );
+	used = malloc( (header.dir_slots+2)*sizeof(CrudStoreExtent) );
+	used[nused].offset = 0;
+	used[nused++].length = CRUD_STORE_HEADER_SIZE;
+	used[nused].offset = header.dir_offset;
+	used[nused++].length = header.dir_slots*sizeof(CrudStoreSlot);
+	for ( i=header.dir_slots; i>0; i-- ) {
+		slot = crud_store_slot( i-1 );
+		if ( slot->oid == CRUD_NO_OBJECT ) {
+			crud_store_free_slots[crud_store_nfree_slots++] = i-1;
+			continue;
+		}
+		obj = malloc( sizeof(CrudStoreObject) );
+		obj->oid = slot->oid;
+		obj->slot = i-1;
+		obj->dirty = 0;
+		crud_store_slots[i-1] = obj;
+		insertValueInHashTable( &crud_store_index, obj->oid, obj );
+		if ( slot->length > 0 ) {
+			used[nused].offset = slot->offset;
+			used[nused++].length = slot->length;
+		}
+	}
+
+	// The gaps between used ranges are the free space
+	qsort( used, nused, sizeof(CrudStoreExtent), crud_store_extent_compare );
+	end = 0;
+	for ( i=0; i<nused; i++ ) {
+		if ( used[i].offset > end ) {
+			crud_store_deallocate( end, used[i].offset - end );
+		}
+		end = used[i].offset + ((used[i].length + CRUD_STORE_ALIGNMENT - 1) & ~(uint64_t)(CRUD_STORE_ALIGNMENT - 1));
+	}
+	if ( header.size > end ) {
+		crud_store_deallocate( end, header.size - end );
+	}
+	free( used );
+	return( 0 );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : crud_store_import_legacy
+// Description  : Load a store file in the old flat format (next OID, object
+//                count, then OID/flags/length/data per object) into a new
+//                store; it is rewritten in the new format on the next save
+//
+// Inputs       : fname - the store file
+// Outputs      : 0 if successful, -1 if failure
+
+static int crud_store_import_legacy( char *fname ) {
+
+	// Local variables
+	CrudStoreObject *obj;
+	uint32_t next_oid, count, length, i;
+	CrudOID oid;
+	uint8_t flags;
+	int fh;
+
+	// Open the file and read the preamble
+	if ( ((fh = open(fname, O_RDONLY)) == -1) ||
+		 (read(fh, &next_oid, sizeof(next_oid)) != sizeof(next_oid)) ||
+		 (read(fh, &count, sizeof(count)) != sizeof(count)) ) {
+		CRUD_LOG( LOG_ERROR_LEVEL, "CRUD: bad store file [%s]", fname );
+		if ( fh != -1 ) {
+			close( fh );
+		}
+		return( -1 );
+	}
+	if ( crud_store_new() ) {
+		close( fh );
+		return( -1 );
+	}
+
+	// Now read each object into the store
+	for ( i=0; i<count; i++ ) {
+		if ( (read(fh, &oid, sizeof(oid)) != sizeof(oid)) ||
+			 (read(fh, &flags, sizeof(flags)) != sizeof(flags)) ||
+			 (read(fh, &length, sizeof(length)) != sizeof(length)) ||
+			 ((obj = crud_store_insert(oid, flags, length)) == NULL) ||
+			 (read(fh, &crud_store_map[crud_store_slot(obj->slot)->offset], length) != length) ) {
+			CRUD_LOG( LOG_ERROR_LEVEL, "CRUD: truncated store file [%s]", fname );
+			close( fh );
+			crud_store_release();
+			return( -1 );
+		}
+		if ( flags == CRUD_PRIORITY_OBJECT ) {
+			crud_store_header->priority_oid = oid;
+		}
+		CRUD_LOG( LOG_INFO_LEVEL, "CRUD: new object [OID %u], length %u bytes", oid, length );
+	}
+	crud_store_header->next_oid = next_oid;
+	close( fh );
+	return( 0 );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : crud_store_release
+// Description  : Drop the store (nothing is saved)
+//
+// Inputs       : none
+// Outputs      : none
+
+static void crud_store_release( void ) {
+
+	// Local variables
+	uint32_t i;
+
+	// Free the objects and the indexes
+	if ( crud_store_map != NULL ) {
+		for ( i=0; i<crud_store_header->dir_slots; i++ ) {
+			if ( crud_store_slots[i] != NULL ) {
+				deleteValueFromHashTable( &crud_store_index, crud_store_slots[i]->oid );
+				free( crud_store_slots[i] );
+			}
+		}
+		cleanupHashTable( &crud_store_index );
+		munmap( crud_store_map, crud_store_header->size );
+	}
+	if ( crud_store_fd != -1 ) {
+		close( crud_store_fd );
+	}
+	free( crud_store_slots );
+	free( crud_store_free_slots );
+	free( crud_store_slot_dirty );
+	free( crud_store_dirty );
+	free( crud_store_free );
+
+	// Reset the state
+	crud_store_map = NULL;
+	crud_store_header = NULL;
+	crud_store_fd = -1;
+	crud_store_name[0] = 0x0;
+	crud_store_slots = NULL;
+	crud_store_free_slots = NULL;
+	crud_store_slot_dirty = NULL;
+	crud_store_dirty = NULL;
+	crud_store_free = NULL;
+	crud_store_nfree_slots = crud_store_ndirty = crud_store_nfree = crud_store_free_size = 0;
+	crud_store_dir_moved = 0;
+	crud_driver_initialized = 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : crud_store_slot
+// Description  : Get a directory slot (in the map)
+//
+// Inputs       : slot - the slot index
+// Outputs      : pointer to the slot
+
+static CrudStoreSlot *crud_store_slot( uint32_t slot ) {
+	return( &((CrudStoreSlot *)&crud_store_map[crud_store_header->dir_offset])[slot] );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : crud_store_grow
+// Description  : Grow the store file and mapping, the new space is free
+//
+// Inputs       : need - the number of bytes needed
+// Outputs      : 0 if successful, -1 if failure
+
+static int crud_store_grow( uint64_t need ) {
+
+	// Local variables
+	uint64_t size = crud_store_header->size, grow;
+	char *map;
+
+	// Grow by half again (at least what is needed), in whole pages
+	grow = size / 2;
+	if ( grow < need ) {
+		grow = need;
+	}
+	if ( grow < CRUD_STORE_MIN_GROWTH ) {
+		grow = CRUD_STORE_MIN_GROWTH;
+	}
+	grow = (grow + CRUD_STORE_HEADER_SIZE - 1) & ~(uint64_t)(CRUD_STORE_HEADER_SIZE - 1);
+
+	// Extend the file first so the new pages are backed
+	if ( (crud_store_fd != -1) && (ftruncate(crud_store_fd, size + grow) == -1) ) {
+		CRUD_LOG( LOG_ERROR_LEVEL, "CRUD: failed to grow store, %s", strerror(errno) );
+		return( -1 );
+	}
+	if ( (map = mremap(crud_store_map, size, size + grow, MREMAP_MAYMOVE)) == MAP_FAILED ) {
+		CRUD_LOG( LOG_ERROR_LEVEL, "CRUD: failed to grow store mapping, %s", strerror(errno) );
+		return( -1 );
+	}
+	crud_store_map = map;
+	crud_store_header = (CrudStoreHeader *)crud_store_map;
+	crud_store_header->size = size + grow;
+	crud_store_deallocate( size, grow );
+	return( 0 );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : crud_store_allocate
+// Description  : Find space for an object (first fit), growing the store if
+//                nothing is big enough
+//
+// Inputs       : length - the number of bytes needed
+//                offset - the offset of the space (out)
+// Outputs      : 0 if successful, -1 if failure
+
+static int crud_store_allocate( uint32_t length, uint64_t *offset ) {
+
+	// Local variables
+	uint64_t need = (length + CRUD_STORE_ALIGNMENT - 1) & ~(uint64_t)(CRUD_STORE_ALIGNMENT - 1);
+	uint32_t i;
+
+	// Empty objects take no space
+	*offset = 0;
+	if ( need == 0 ) {
+		return( 0 );
+	}
+
+	// Take the first range that fits, grow and retry if there is none
+	while ( 1 ) {
+		for ( i=0; i<crud_store_nfree; i++ ) {
+			if ( crud_store_free[i].length >= need ) {
+				*offset = crud_store_free[i].offset;
+				crud_store_free[i].offset += need;
+				crud_store_free[i].length -= need;
+				if ( crud_store_free[i].length == 0 ) {
+					memmove( &crud_store_free[i], &crud_store_free[i+1],
+							(crud_store_nfree-i-1)*sizeof(CrudStoreExtent) );
+					crud_store_nfree--;
+				}
+				return( 0 );
+			}
+		}
+		if ( crud_store_grow(need) ) {
+			return( -1 );
+		}
+	}
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : crud_store_deallocate
+// Description  : Return space to the free list, joining neighbouring ranges
+//
+// Inputs       : offset - the offset of the space
+//                length - the number of bytes
+// Outputs      : none
+
+static void crud_store_deallocate( uint64_t offset, uint32_t length ) {
+
+	// Local variables
+	uint64_t len = (length + CRUD_STORE_ALIGNMENT - 1) & ~(uint64_t)(CRUD_STORE_ALIGNMENT - 1);
+	uint32_t i;
+
+	// Nothing to free for empty objects
+	if ( len == 0 ) {
+		return;
+	}
+
+	// Find the insertion point, join with the range before and/or after
+	for ( i=0; (i<crud_store_nfree) && (crud_store_free[i].offset < offset); i++ );
+	if ( (i > 0) && (crud_store_free[i-1].offset + crud_store_free[i-1].length == offset) ) {
+		crud_store_free[i-1].length += len;
+		if ( (i < crud_store_nfree) && (offset + len == crud_store_free[i].offset) ) {
+			crud_store_free[i-1].length += crud_store_free[i].length;
+			memmove( &crud_store_free[i], &crud_store_free[i+1], (crud_store_nfree-i-1)*sizeof(CrudStoreExtent) );
+			crud_store_nfree--;
+		}
+		return;
+	}
+	if ( (i < crud_store_nfree) && (offset + len == crud_store_free[i].offset) ) {
+		crud_store_free[i].offset = offset;
+		crud_store_free[i].length += len;
+		return;
+	}
+
+	// A new range, make room for it
+	if ( crud_store_nfree == crud_store_free_size ) {
+		crud_store_free_size = (crud_store_free_size == 0) ? 64 : crud_store_free_size * 2;
+		crud_store_free = realloc( crud_store_free, crud_store_free_size*sizeof(CrudStoreExtent) );
+	}
+	memmove( &crud_store_free[i+1], &crud_store_free[i], (crud_store_nfree-i)*sizeof(CrudStoreExtent) );
+	crud_store_free[i].offset = offset;
+	crud_store_free[i].length = len;
+	crud_store_nfree++;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : crud_store_insert
+// Description  : Add an object to the store, giving it space and a directory
+//                slot (the directory is moved to a bigger home when full)
+//
+// Inputs       : oid - the object identifier
+//                flags - the object flags
+//                length - the object length
+// Outputs      : the object, or NULL if failure
+
+static CrudStoreObject *crud_store_insert( CrudOID oid, uint32_t flags, uint32_t length ) {
+
+	// Local variables
+	CrudStoreObject *obj;
+	CrudStoreSlot *slot;
+	uint64_t offset, old_offset;
+	uint32_t old_slots, i;
+
+	// A full directory moves to a space twice as big
+	if ( crud_store_nfree_slots == 0 ) {
+		old_offset = crud_store_header->dir_offset;
+		old_slots = crud_store_header->dir_slots;
+		if ( crud_store_allocate(old_slots*2*sizeof(CrudStoreSlot), &offset) ) {
+			return( NULL );
+		}
+		memcpy( &crud_store_map[offset], &crud_store_map[old_offset], old_slots*sizeof(CrudStoreSlot) );
+		memset( &crud_store_map[offset+old_slots*sizeof(CrudStoreSlot)], 0x0, old_slots*sizeof(CrudStoreSlot) );
+		crud_store_header->dir_offset = offset;
+		crud_store_header->dir_slots = old_slots*2;
+		crud_store_deallocate( old_offset, old_slots*sizeof(CrudStoreSlot) );
+		crud_store_slots = realloc( crud_store_slots, old_slots*2*sizeof(CrudStoreObject *) );
+		memset( &crud_store_slots[old_slots], 0x0, old_slots*sizeof(CrudStoreObject *) );
+		crud_store_free_slots = realloc( crud_store_free_slots, old_slots*2*sizeof(uint32_t) );
+		for ( i=0; i<old_slots; i++ ) {
+			crud_store_free_slots[i] = old_slots*2 - i - 1;
+		}
+		crud_store_nfree_slots = old_slots;
+		crud_store_slot_dirty = realloc( crud_store_slot_dirty, old_slots*2*sizeof(uint8_t) );
+		memset( &crud_store_slot_dirty[old_slots], 0x0, old_slots*sizeof(uint8_t) );
+		crud_store_dirty = realloc( crud_store_dirty, old_slots*2*sizeof(uint32_t) );
+		crud_store_dir_moved = 1;
+	}
+
+	// Get the space, then fill in the slot
+	if ( crud_store_allocate(length, &offset) ) {
+		return( NULL );
+	}
+	obj = malloc( sizeof(CrudStoreObject) );
+	obj->oid = oid;
+	obj->slot = crud_store_free_slots[--crud_store_nfree_slots];
+	obj->dirty = 1;
+	slot = crud_store_slot( obj->slot );
+	slot->oid = oid;
+	slot->flags = flags;
+	slot->offset = offset;
+	slot->length = length;
+	crud_store_slots[obj->slot] = obj;
+	crud_store_mark( obj->slot );
+	insertValueInHashTable( &crud_store_index, oid, obj );
+	return( obj );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : crud_store_mark
+// Description  : Note that a directory slot changed since the last save
+//
+// Inputs       : slot - the slot index
+// Outputs      : none
+
+static void crud_store_mark( uint32_t slot ) {
+	if ( ! crud_store_slot_dirty[slot] ) {
+		crud_store_slot_dirty[slot] = 1;
+		crud_store_dirty[crud_store_ndirty++] = slot;
+	}
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : crud_store_find
+// Description  : Find the object a request is about
+//
+// Inputs       : oid - the object identifier
+//                flags - the request flags (the priority flag picks the
+//                        priority object)
+// Outputs      : the object, or NULL if there is none
+
+static CrudStoreObject *crud_store_find( CrudOID oid, uint8_t flags ) {
+	if ( flags == CRUD_PRIORITY_OBJECT ) {
+		oid = crud_store_header->priority_oid;
+	}
+	if ( oid == CRUD_NO_OBJECT ) {
+		return( NULL );
+	}
+	return( findValueInHashTable(&crud_store_index, oid) );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : crud_unit_test
+// Description  : This function is used to test the CRUD interfaces and
+//                code.  Random objects are created, read, updated and
+//                deleted against a local copy, then the store is saved,
+//                reloaded and checked again.
+//
+// Inputs       : none
+// Outputs      : 0 if successful, -1 if failure
+
+int crud_unit_test( void ) {
+
+	// Local variables
+	char *copies[CRUD_UNIT_TEST_OBJECTS], *tbuf;
+	uint32_t lengths[CRUD_UNIT_TEST_OBJECTS], length, len;
+	CrudOID oids[CRUD_UNIT_TEST_OBJECTS], oid;
+	CRUD_REQUEST_TYPES req;
+	CrudResponse response;
+	uint8_t flags, res;
+	int i, obj, pass;
+
+	// Start with an empty store
+	memset( oids, 0x0, sizeof(oids) );
+	memset( copies, 0x0, sizeof(copies) );
+	tbuf = malloc( CRUD_MAX_OBJECT_SIZE );
+	if ( (crud_bus_request(construct_crud_request(0, CRUD_INIT, 0, 0, 0), NULL) & 0x1) ||
+		 (crud_bus_request(construct_crud_request(0, CRUD_FORMAT, 0, 0, 0), NULL) & 0x1) ) {
+		CRUD_LOG( LOG_ERROR_LEVEL, "CRUD_UNIT_TEST : init/format failed." );
+		return( -1 );
+	}
+
+	// Do random operations on random objects
+	for ( i=0; i<CRUD_UNIT_TEST_ITERATIONS; i++ ) {
+		obj = getRandomValue( 0, CRUD_UNIT_TEST_OBJECTS-1 );
+		if ( oids[obj] == CRUD_NO_OBJECT ) {
+
+			// Create the object with random contents
+			lengths[obj] = getRandomValue( 0, 1<<getRandomValue(0, 16) );
+			copies[obj] = malloc( lengths[obj] + 1 );
+			memset( copies[obj], getRandomValue(0, 0xff), lengths[obj] );
+			response = crud_bus_request( construct_crud_request(0, CRUD_CREATE, lengths[obj], 0, 0), copies[obj] );
+			deconstruct_crud_request( response, &oids[obj], &req, &length, &flags, &res );
+			if ( res || (oids[obj] == CRUD_NO_OBJECT) ) {
+				CRUD_LOG( LOG_ERROR_LEVEL, "CRUD_UNIT_TEST : create failed." );
+				return( -1 );
+			}
+
+		} else if ( getRandomValue(0, 3) == 0 ) {
+
+			// Delete the object
+			response = crud_bus_request( construct_crud_request(oids[obj], CRUD_DELETE, 0, 0, 0), NULL );
+			if ( response & 0x1 ) {
+				CRUD_LOG( LOG_ERROR_LEVEL, "CRUD_UNIT_TEST : delete failed [%u].", oids[obj] );
+				return( -1 );
+			}
+			free( copies[obj] );
+			copies[obj] = NULL;
+			oids[obj] = CRUD_NO_OBJECT;
+
+		} else {
+
+			// Update part of the object
+			if ( lengths[obj] > 0 ) {
+				len = getRandomValue( 0, lengths[obj]-1 );
+				memset( &copies[obj][len], getRandomValue(0, 0xff), getRandomValue(1, lengths[obj]-len) );
+			}
+			response = crud_bus_request( construct_crud_request(oids[obj], CRUD_UPDATE, lengths[obj], 0, 0), copies[obj] );
+			if ( response & 0x1 ) {
+				CRUD_LOG( LOG_ERROR_LEVEL, "CRUD_UNIT_TEST : update failed [%u].", oids[obj] );
+				return( -1 );
+			}
+		}
+	}
+
+	// Check every object, then save and load the store and check again
+	for ( pass=0; pass<2; pass++ ) {
+		for ( obj=0; obj<CRUD_UNIT_TEST_OBJECTS; obj++ ) {
+			if ( oids[obj] == CRUD_NO_OBJECT ) {
+				continue;
+			}
+			response = crud_bus_request( construct_crud_request(oids[obj], CRUD_READ, CRUD_MAX_OBJECT_SIZE, 0, 0), tbuf );
+			deconstruct_crud_request( response, &oid, &req, &length, &flags, &res );
+			if ( res || (length != lengths[obj]) || memcmp(tbuf, copies[obj], length) ) {
+				CRUD_LOG( LOG_ERROR_LEVEL, "CRUD_UNIT_TEST : object mismatch [%u, pass %d].", oids[obj], pass );
+				return( -1 );
+			}
+		}
+		if ( (pass == 0) &&
+			 ((crud_bus_request(construct_crud_request(0, CRUD_CLOSE, 0, 0, 0), NULL) & 0x1) ||
+			  (crud_bus_request(construct_crud_request(0, CRUD_INIT, 0, 0, 0), NULL) & 0x1)) ) {
+			CRUD_LOG( LOG_ERROR_LEVEL, "CRUD_UNIT_TEST : save/load failed." );
+			return( -1 );
+		}
+	}
+
+	// Clean up, return successfully
+	for ( obj=0; obj<CRUD_UNIT_TEST_OBJECTS; obj++ ) {
+		free( copies[obj] );
+	}
+	free( tbuf );
+	CRUD_LOG( LOG_INFO_LEVEL, "CRUD_UNIT_TEST : completed successfully." );
+	return( 0 );
+}
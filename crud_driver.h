@@ -35,7 +35,7 @@ typedef enum {
 	CRUD_UNKNOWN = 7, // Unknown type
 	CRUD_MAXVAL  = 8, // Max value
 } CRUD_REQUEST_TYPES;
-const char *CRUD_REQUEST_TYPE_LABLES[CRUD_MAXVAL];
+extern const char *CRUD_REQUEST_TYPE_LABLES[CRUD_MAXVAL];
 
 // These are the CRUD flags
 typedef enum {
@@ -43,7 +43,7 @@ typedef enum {
 	CRUD_PRIORITY_OBJECT = 1,  // Flag indicating that object is a "priority object"
 	CRUD_FLAGMAX         = 2,  // Max value
 } CRUD_FLAG_TYPES;
-const char *CRUD_FLAG_TYPE_LABLES[CRUD_FLAGMAX];
+extern const char *CRUD_FLAG_TYPE_LABLES[CRUD_FLAGMAX];
 
 // CRUD request and response types
 typedef uint64_t CrudRequest;
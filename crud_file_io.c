@@ -9,17 +9,51 @@
 //
 
 // Includes
+#include <stdio.h>
+#include <stdlib.h>
 #include <malloc.h>
 #include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <stdatomic.h>
 
 // Project Includes
 #include <crud_file_io.h>
-#include <cmpsc311_log.h>
+#include <crud_backend.h>
+#include <crud_arena.h>
+#include <crud_journal.h>
+#include <crud_recycle.h>
+#include <crud_heatmap.h>
+#include <crud_log.h>
+#include <crud_trace.h>
 #include <cmpsc311_util.h>
 
 // Defines
 #define CIO_UNIT_TEST_MAX_WRITE_SIZE 1024
 #define CRUD_IO_UNIT_TEST_ITERATIONS 10240
+#define CRUD_WRITE_BUFFER_SIZE (64*1024)   // bytes of write data held per open file
+#define CRUD_WRITE_BUFFER_EXTENTS 256      // distinct dirty extents held per open file
+#define CRUD_READAHEAD_MIN_WINDOW 4096     // first readahead window for a sequential reader
+#define CRUD_READAHEAD_MAX_WINDOW (256*1024) // largest readahead window
+#define CRUD_READAHEAD_TRIGGER 2           // back-to-back reads before a reader is sequential
+#define CRUD_OPEN_FILES_INITIAL 64         // file handles in the first open file table
+#define CRUD_MAX_OPEN_FILES INT16_MAX      // file handles are int16_t
+#define CRUD_OPEN_HANDLE 0x80000000        // hot flag of a handle in use (never stored)
+#define CRUD_DIR_UNIT_TEST_FILES 300
+#define CRUD_OPEN_UNIT_TEST_FILES 200          // files the open handle test keeps open
+#define CRUD_SPARSE_UNIT_TEST_HOLE (200*1024*1024) // offset of the far write of the sparse test
+#define CRUD_SPARSE_UNIT_TEST_SIZE (4*1024*1024)   // span of the random sparse test
+#define CRUD_SPARSE_UNIT_TEST_ITERATIONS 400
+#define CRUD_DURABILITY_UNIT_TEST_FILES 20     // scratch files of the durability test
+#define CRUD_DURABILITY_UNIT_TEST_SIZE 4096    // bytes written to each file of the durability test
+#define CRUD_COALESCE_UNIT_TEST_READERS 8      // threads reading one object at once
+#define CRUD_COALESCE_UNIT_TEST_SIZE (96*1024) // bytes of the object they read
+#define CRUD_STRESS_OPS 6                      // operations the stress benchmark times
+#define CRUD_STRESS_SUB_BITS 3                 // each power of two of latency is split in 2^bits buckets
+#define CRUD_STRESS_SUB_BUCKETS (1<<CRUD_STRESS_SUB_BITS)
+#define CRUD_STRESS_BUCKETS (64*CRUD_STRESS_SUB_BUCKETS)
+#define CRUD_STRESS_VERIFY_SIZE (64*1024)      // bytes read at a time when verifying a file
 
 // Other definitions
 
@@ -29,11 +63,117 @@ typedef enum {
 	CIO_UNIT_TEST_WRITE  = 1,
 	CIO_UNIT_TEST_APPEND = 2,
 	CIO_UNIT_TEST_SEEK   = 3,
+	CIO_UNIT_TEST_TRUNCATE = 4,
+	CIO_UNIT_TEST_RESERVE  = 5,
 } CRUD_UNIT_TEST_TYPE;
 
+// This is a file of the stress benchmark, mirrored in memory
+typedef struct {
+	char      name[32];  // The name of the file
+	int16_t   fh;        // The handle of the open file
+	char     *mirror;    // What the file should hold
+	uint32_t  length;    // The length of the file
+	uint32_t  position;  // The position of the file
+} CrudStressFile;
+
+// This is a thread of the stress benchmark, with its own files and counters
+typedef struct {
+	const CrudStressParams *params;  // The parameters of the run
+	CrudStressFile *files;           // The files of the thread
+	uint32_t        nfiles;          // The number of files
+	char           *tbuf;            // Read buffer
+	unsigned int    seed;            // Generator state (rand_r)
+	atomic_int     *stop;            // Set when any thread fails
+	int             failed;          // Flag indicating this thread failed
+	uint64_t        read_bytes;      // Bytes read
+	uint64_t        written_bytes;   // Bytes written and appended
+	uint64_t        ops[CRUD_STRESS_OPS];    // Operations timed, by type
+	uint64_t        max_ns[CRUD_STRESS_OPS]; // Slowest operation, by type
+	uint64_t        histogram[CRUD_STRESS_OPS][CRUD_STRESS_BUCKETS]; // Latencies, by type
+} CrudStressThread;
+
+// This is a dirty range of a file held in the write buffer
+typedef struct {
+	uint32_t  offset; // The offset of the range in the file
+	uint32_t  length; // The number of bytes in the range
+	char     *data;   // The bytes of the range (in the buffer arena)
+} CrudWriteExtent;
+
+// This is the per-file write buffer (coalesces writes until flushed)
+typedef struct {
+	char            *arena;         // Storage for the extent data
+	uint32_t         used;          // Number of arena bytes consumed
+	CrudWriteExtent *extents;       // Dirty extents, sorted, never overlapping or adjacent
+	uint16_t         nextents;      // Number of dirty extents
+	uint32_t         stored_length; // Length of the backing object
+} CrudWriteBuffer;
+
+// This is the per-file access pattern and readahead window
+typedef struct {
+	char     *data;   // Bytes of the file prefetched ahead of the reader
+	uint32_t  offset; // The file offset of the prefetched bytes
+	uint32_t  length; // The number of prefetched bytes
+	uint32_t  next;   // The offset a sequential reader will read next
+	uint16_t  streak; // Number of back-to-back sequential reads
+	uint32_t  window; // Current readahead window size
+} CrudReadahead;
+
+// This is the part of an open file every call touches (index is fh), kept
+// apart from the rest so a scan of the handles reads 16 bytes a handle
+typedef struct {
+	CrudOID   object_id; // The object of the file
+	uint32_t  position;  // This is the position of the file
+	uint32_t  length;    // This is the length of the file
+	uint32_t  flags;     // The entry flags (CRUD_FILE_*), with CRUD_OPEN_HANDLE while in use
+} CrudOpenHot;
+
+// This is the rest of an open file (index into the open file table is fh);
+// its name is in the name store, the entry is rebuilt from both to store it
+typedef struct {
+	uint32_t               capacity; // This is the size of the object (>= length)
+	CrudWriteBuffer        wb;       // The write buffer
+	CrudReadahead          ra;       // The readahead state
+	CrudOID               *chunks;   // The chunk map of a sparse file (NULL until read)
+	uint32_t               slots;    // The number of chunks the map holds
+	uint8_t                mapDirty; // Flag indicating the chunk map changed
+	uint32_t               uses;     // Opens, reads and writes since the heatmap was told
+} CrudOpenFile;
+
+// This is an open directory.  Its entries are the table entries named with
+// its prefix, the first name component after the prefix being the name in
+// the directory; an entry with more components stands for a subdirectory,
+// whose whole range is skipped with one seek.
+struct CrudDirectory {
+	char               prefix[CRUD_MAX_PATH_LENGTH];  // The names in the directory start with this
+	uint32_t           plen;                          // The length of the prefix
+	char               next[CRUD_MAX_PATH_LENGTH+1];  // The next entry is the first name not below this
+	CrudTableCursor    cursor;                        // The position of the next entry
+	uint64_t           generation;                    // The table generation the cursor is from
+	CrudDirectoryEntry entry;                         // The entry returned by crud_readdir
+};
+
 // File system Static Data
-// This the definition of the file table
-CrudFileAllocationType crud_file_table[CRUD_MAX_TOTAL_FILES]; // The file handle table
+// The open file table grows as files are opened, the file table itself is
+// paged in from the object store (crud_file_table.c).  It is split in the hot
+// fields, the rest, and the names of the open files with an index of them.
+static CrudOpenHot *crud_open_hot;    // The hot fields of the open files (index is fd)
+static CrudOpenFile *crud_open_files; // The rest of the open file table (index is fd)
+static char (*crud_open_names)[CRUD_MAX_PATH_LENGTH]; // The name of each open file (index is fd)
+static int16_t *crud_open_index;      // Open addressing index of fd + 1 by name (0 is empty)
+static int32_t crud_open_slots;       // The number of handles in the open file table
+
+// The storage backend carrying the bus requests (selected one is bound at init)
+static CrudBackend *crud_backend;          // the backend in use
+static CrudBackend *crud_selected_backend; // the backend to use at the next init
+
+// Bus request accounting, reported at unmount
+static uint64_t crud_io_bus_requests; // requests sent to the object store
+static uint64_t crud_io_writes;       // logical writes performed by callers
+static uint64_t crud_io_syncs;        // times the object store was made durable
+
+// Table changes are committed when an operation is done, not while one
+// made of others (a snapshot) is still going
+static int crud_commit_held;          // nonzero while commits wait for the outer operation
 
 // Pick up these definitions from the unit test of the crud driver
 CrudRequest construct_crud_request(CrudOID oid, CRUD_REQUEST_TYPES req,
@@ -42,52 +182,165 @@ int deconstruct_crud_request(CrudRequest request, CrudOID *oid,
 		CRUD_REQUEST_TYPES *req, uint32_t *length, uint8_t *flags,
 		uint8_t *res);
 
+// The lock serializing the callers of the interface functions, and the lock
+// of the backend.  A reader fetching an object lets go of the first while it
+// waits for the device (holding only the second), so the other callers go on
+// and readers of the same object wait on its fetch instead of sending their
+// own (single flight).  The order is always the interface lock first.
+static pthread_mutex_t crud_io_mutex;
+static pthread_once_t crud_io_mutex_once = PTHREAD_ONCE_INIT;
+static int crud_io_depth;             // times the interface lock is held by its holder
+static pthread_mutex_t crud_backend_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+// This is a fetch of a whole object, shared by every reader asking for the
+// object while it is in flight.  Fetches come from a pool, their data from
+// the scratch arena; all of it is only touched with the interface lock.
+typedef struct CrudFlight {
+	CrudOID            oid;      // The object fetched
+	uint32_t           length;   // The bytes fetched
+	char              *data;     // The object
+	CrudResponse       response; // The response of the read
+	uint16_t           refs;     // Readers using the fetch (the one sending it too)
+	uint8_t            done;     // Flag indicating the data is in
+	uint8_t            stale;    // Flag indicating objects changed during the fetch
+	pthread_cond_t     cond;     // Signalled when the data is in
+	struct CrudFlight *next;     // The next fetch in flight (or in the pool)
+} CrudFlight;
+
+static CrudFlight *crud_flights;      // The fetches in flight
+static CrudFlight *crud_flight_pool;  // Fetches to reuse
+static uint32_t crud_flight_waiters;  // Readers waiting on a fetch (they still use its data)
+static atomic_uint crud_flight_readers; // Readers on a fetch still in flight (seen without the locks)
+static pthread_cond_t crud_flights_idle = PTHREAD_COND_INITIALIZER; // Signalled when the last fetch and waiter are done
+static atomic_uint_fast64_t crud_io_changes; // requests that changed objects (a fetch spanning one is stale)
+static uint64_t crud_io_coalesced;    // reads served by a fetch another reader sent
+
 // Global flag representing the crud interface initialization
 uint8_t crudInitialized;
 
+//
+// Module local prototypes
+
+static uint16_t crud_format_unlocked(void);
+static uint16_t crud_mount_unlocked(void);
+static uint16_t crud_unmount_unlocked(void);
+static int16_t crud_open_unlocked(char *path);
+static int16_t crud_open_durable_unlocked(char *path, CrudDurability durability);
+static int16_t crud_close_unlocked(int16_t fd);
+static int32_t crud_read_unlocked(int16_t fd, void *buf, int32_t count);
+static int32_t crud_read_file( int16_t fd, char *buf, int32_t count, uint32_t position, int shared );
+static int32_t crud_write_file( int16_t fd, char *buf, int32_t count, uint32_t pos );
+static int32_t crud_read_at_unlocked(int16_t fd, void *buf, int32_t count, uint32_t offset);
+static int32_t crud_write_at_unlocked(int16_t fd, void *buf, int32_t count, uint32_t offset);
+static CrudFlight *crud_fetch( CrudOID oid, uint32_t length, int shared );
+static void crud_fetch_release( CrudFlight *flight );
+static int crud_fetch_drain( void );
+static int32_t crud_write_unlocked(int16_t fd, void *buf, int32_t count);
+static int16_t crud_flush_unlocked(int16_t fd);
+static int16_t crud_fsync_unlocked(int16_t fd);
+static int16_t crud_truncate_unlocked(int16_t fd, uint32_t len);
+static int16_t crud_reserve_unlocked(int16_t fd, uint32_t len);
+static int32_t crud_seek_unlocked(int16_t fd, uint32_t loc);
+static int16_t crud_mkdir_unlocked(char *path);
+static CrudDirectory *crud_opendir_unlocked(char *path);
+static CrudDirectoryEntry *crud_readdir_unlocked(CrudDirectory *dir);
+static int16_t crud_closedir_unlocked(CrudDirectory *dir);
+static int32_t crud_list_unlocked(char *prefix, CrudListFunction fn, void *arg);
+static int16_t crud_clone_unlocked(char *src, char *dst);
+static int16_t crud_snapshot_unlocked(char *name);
+static int16_t crud_open_file( char *path, int32_t durability );
+static int crud_set_durability( CrudFileAllocationType *entry, int32_t durability );
+static int crud_drop_scratch( int objects );
+static int crud_drop_entry( const CrudFileAllocationType *entry );
+static int16_t crud_open_grow( void );
+static uint32_t crud_open_hash( const char *name );
+static int16_t crud_open_lookup( const char *name );
+static void crud_open_intern( int16_t fd, const char *name );
+static void crud_open_forget( int16_t fd );
+static void crud_open_entry( int16_t fd, CrudFileAllocationType *entry );
+static int crud_open_update( int16_t fd );
+static int crud_dir_exists( const char *prefix );
+static int crud_resize( int16_t fd, uint32_t capacity );
+static CrudResponse crud_replace_object( CrudOID oid, uint32_t old, uint32_t size, void *buf );
+static int crud_drop_object( CrudOID oid, uint32_t size );
+static int16_t crud_commit( int16_t ret );
+static int crud_clone_entry( const CrudFileAllocationType *src, const char *dst, uint32_t flags );
+static int crud_sparse_map( int16_t fd );
+static int crud_sparse_slots( int16_t fd, uint32_t length );
+static int crud_sparse_write_map( int16_t fd );
+static int crud_sparse_convert( int16_t fd );
+static int crud_sparse_read( int16_t fd, char *buf, uint32_t offset, uint32_t count );
+static int crud_sparse_flush( int16_t fd, uint32_t newLength );
+static int crud_sparse_truncate( int16_t fd, uint32_t len );
+static void crud_sparse_release( int16_t fd );
+static int crud_buffer_write( int16_t fd, char *buf, uint32_t offset, uint32_t count );
+static int crud_buffer_dirty( int16_t fd, uint32_t offset, uint32_t count );
+static void crud_buffer_release( int16_t fd );
+static int crud_readahead_hit( int16_t fd, char *buf, uint32_t offset, uint32_t count );
+static void crud_readahead_fill( int16_t fd, char *object, uint32_t offset );
+static void crud_readahead_release( int16_t fd );
+static void crud_open_touch( int16_t fd );
+
 //
 // Implementation
 
 ////////////////////////////////////////////////////////////////////////////////
 //
-// Function     : crud_format
+// Function     : crud_format_unlocked
 // Description  : This function formats the crud drive, and adds the file
 //                allocation table.
 //
 // Inputs       : none
 // Outputs      : 0 if successful, -1 if failure
 
-uint16_t crud_format(void) {
+static uint16_t crud_format_unlocked(void) {
 	// Declaring Variables
 	CrudRequest request;
 	CrudResponse response; 
+	int i;
+
+	// Waiting for the reads in flight, the open files and their buffers go
+	if( crud_fetch_drain() )
+		return -1;
 
 	// Generating a CRUD_INIT request and checking for success
 	if( crud_init() )
 		return -1; // failed to initialize crud interface
 	else { // Success...continue
 
-		// Generating a CRUD_FORMAT request... clears the object store
+		// Generating a CRUD_FORMAT request... clears the object store (and
+		// the objects kept for reuse and the heatmap with it)
+		crud_recycle_reset();
+		crud_heatmap_reset();
 		request = create_crudrequest( 0, CRUD_FORMAT, 0, CRUD_NULL_FLAG );
-		response = crud_bus_request( request, NULL );
+		response = crud_io_request( request, NULL );
 
 		// Checking for success
 		if ( response & 1 )
 			return -1; // failed crud format request
 		else {
-			// Clearing the crud_file_table.  Each entry in the table has 29 bytes 
-			memset( crud_file_table, 0, sizeof( crud_file_table ) );
-
-			// Creating a priority object (saving the table)
-			request = create_crudrequest( 0, CRUD_CREATE, sizeof( crud_file_table ), CRUD_PRIORITY_OBJECT );
-			response = crud_bus_request( request, crud_file_table );
+			// Closing every handle, the files are gone
+			for( i = 0; i < crud_open_slots; i++ ) {
+				crud_buffer_release( i );
+				crud_readahead_release( i );
+				crud_sparse_release( i );
+			}
+			free( crud_open_hot );
+			free( crud_open_files );
+			free( crud_open_names );
+			free( crud_open_index );
+			crud_open_hot = NULL;
+			crud_open_files = NULL;
+			crud_open_names = NULL;
+			crud_open_index = NULL;
+			crud_open_slots = 0;
 
-			// Checking for success
-			if( response & 1 )
+			// Creating an empty file table (its header is the priority object)
+			if( crud_table_format() )
 				return -1; // failed
 			else {
 				// Log, return successfully
-				logMessage(LOG_INFO_LEVEL, "... formatting complete.");
+				CRUD_LOG(LOG_INFO_LEVEL, "... formatting complete.");
 				return(0);
 			}
 		}
@@ -96,78 +349,93 @@ uint16_t crud_format(void) {
 
 ////////////////////////////////////////////////////////////////////////////////
 //
-// Function     : crud_mount
+// Function     : crud_mount_unlocked
 // Description  : This function mount the current crud file system and loads
 //                the file allocation table.
 //
 // Inputs       : none
 // Outputs      : 0 if successful, -1 if failure
 
-uint16_t crud_mount(void) {
-	// Declaring Variables
-	CrudRequest request;
-	CrudResponse response; 
-
+static uint16_t crud_mount_unlocked(void) {
 	// Initializing crud interface
 	if( !crudInitialized )
 		crud_init();
 
 	if( crudInitialized ) {
-		// reading the content from the priority object into the local file table
-		request = create_crudrequest( 0, CRUD_READ, sizeof( crud_file_table ), CRUD_PRIORITY_OBJECT );
-		response = crud_bus_request( request, crud_file_table );
-
-		// Checking for success
-		if( response & 1 )
+		// reading the file table header, the entries are read as they are used
+		// (the journal gives back the objects kept for reuse); scratch files
+		// left by a crash go (their objects are lost with it); the objects of
+		// the files hottest at the last unmount are read in the background
+		crud_recycle_reset();
+		if( crud_table_mount() || crud_drop_scratch( 0 ) || crud_heatmap_mount() )
 			return -1; // failed
 		else {
 			// Log, return successfully
-			logMessage(LOG_INFO_LEVEL, "... mount complete.");
+			CRUD_LOG(LOG_INFO_LEVEL, "... mount complete.");
 			return(0);
 		}
 	} else return -1; // failed, crud did not initialize
 }
 
+
 ////////////////////////////////////////////////////////////////////////////////
 //
-// Function     : crud_unmount
+// Function     : crud_unmount_unlocked
 // Description  : This function unmounts the current crud file system and
 //                saves the file allocation table.
 //
 // Inputs       : none
 // Outputs      : 0 if successful, -1 if failure
 
-uint16_t crud_unmount(void) {
+static uint16_t crud_unmount_unlocked(void) {
 	// Declaring Variables
 	CrudRequest request;
 	CrudResponse response;
+	int i;
 
 	if( crudInitialized ) {
-		// Generating a CRUD_UPDATE request
-		request = create_crudrequest( 0, CRUD_UPDATE, sizeof( crud_file_table ), CRUD_PRIORITY_OBJECT );
-		response = crud_bus_request( request, crud_file_table );
+		// Waiting for the reads in flight, their buffers are in the arena
+		if( crud_fetch_drain() )
+			return -1;
+
+		// Flushing the write buffers so the table matches the stored objects,
+		// and counting the uses of the files still open
+		for( i = 0; i < crud_open_slots; i++ ) {
+			if( crud_flush( i ) )
+				return -1; // failed to write back buffered data
+			crud_open_touch( i );
+		}
 
-		// checking for success
+		// Dropping the scratch files and writing back the heatmap, deleting the
+		// objects kept for reuse, then writing back the changed parts of the
+		// file table (so the store never saves scratch data, and the journal
+		// left names no object kept)
+		if( crud_drop_scratch( 1 ) || crud_heatmap_unmount() || crud_recycle_drain() || crud_table_unmount() )
+			return -1; // failed saving the file table
+
+		// The scratch arena lives for one mount, returning it to the heap
+		for( i = 0; i < crud_open_slots; i++ ) {
+			crud_buffer_release( i );
+			crud_readahead_release( i );
+		}
+		crud_arena_release();
+
+		// Generating a CRUD_CLOSE request
+		request = create_crudrequest( 0, CRUD_CLOSE, 0, CRUD_NULL_FLAG );
+		response = crud_io_request( request, NULL );
+
+		// Checking for success
 		if( response & 1 )
-			return -1; // crud update request failed
-		else {
-			// Generating a CRUD_CLOSE request
-			request = create_crudrequest( 0, CRUD_CLOSE, 0, CRUD_NULL_FLAG );
-			response = crud_bus_request( request, NULL );
-
-			// Checking for success
-			if( response & 1 )
-				return -1; // crud close request failed
-			else { 
-				// Log, return successfully
-				logMessage(LOG_INFO_LEVEL, "... unmount complete.");
-				return (0);
-			}
+			return -1; // crud close request failed
+		else { 
+			// Log, return successfully
+			CRUD_LOG(LOG_INFO_LEVEL, "... unmount complete (%lu bus requests for %lu writes, %lu syncs, %lu buffer allocations, %lu reads coalesced).",
+					crud_io_bus_requests, crud_io_writes, crud_io_syncs, crud_arena_heap_allocations(), crud_io_coalesced);
+			return (0);
 		}
 	} else return -1; // crud interface not initialized
 }
 
-// Implementation
 
 ////////////////////////////////////////////////////////////////////////////////
 //
@@ -204,10 +472,10 @@ CrudRequest create_crudrequest( CrudOID objID, CRUD_REQUEST_TYPES reqType, uint3
 
 uint8_t extract_crudresponse( CrudResponse response, int16_t fh ) {
 	// checking the success value
-	if( (response & 1) && (fh >= 0) && (fh <= CRUD_MAX_TOTAL_FILES) )
+	if( (response & 1) || (fh < 0) || (fh >= crud_open_slots) )
 		return 1; // failed
 	else {
- 		crud_file_table[fh].object_id = (uint32_t)(response >> 32);
+ 		crud_open_hot[fh].object_id = (uint32_t)(response >> 32);
 		return 0; // success
 	}
 }
@@ -221,9 +489,18 @@ uint8_t extract_crudresponse( CrudResponse response, int16_t fh ) {
 // Outputs      : return -1 if failure, 0 if success
 
 uint8_t crud_init( void ) {
+	// Declaring Variables
+	CrudRequest request;
+	CrudResponse response;
+
+	// Binding the storage backend, the CRUD device unless one was selected
+	if( crud_selected_backend == NULL )
+		crud_selected_backend = crud_backend_create( CRUD_DEFAULT_BACKEND );
+	crud_backend = crud_selected_backend;
+
 	// Generating a request and calling the crud interface
-	CrudRequest request = create_crudrequest( 0, CRUD_INIT, 0, 0 );
-	CrudResponse response = crud_bus_request( request, NULL );
+	request = create_crudrequest( 0, CRUD_INIT, 0, 0 );
+	response = crud_io_request( request, NULL );
 
 	// Checking for success
 	if( response & 1 )
@@ -236,70 +513,160 @@ uint8_t crud_init( void ) {
 
 ////////////////////////////////////////////////////////////////////////////////
 //
-// Function     : crud_open
-// Description  : This function opens the file and returns a file handle
+// Function     : crud_set_backend
+// Description  : This function selects the storage backend the file system
+//                uses from the next crud_init (the file system owns it)
+//
+// Inputs       : be - the backend to use
+// Outputs      : return -1 if failure, 0 if success
+
+int16_t crud_set_backend( CrudBackend *be ) {
+	// Checking the backend is valid
+	if( be == NULL )
+		return -1;
+
+	// Replacing the selection, keeping the backend in use until the next init
+	if( crud_selected_backend != NULL && crud_selected_backend != crud_backend )
+		crud_backend_destroy( crud_selected_backend );
+	crud_selected_backend = be;
+	CRUD_LOG(LOG_INFO_LEVEL, "... using the %s storage backend.", be->name);
+	return 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : crud_open_unlocked
+// Description  : This function opens the file and returns a file handle.  A
+//                file keeps its durability class, a new file is lazy.
+//
+// Inputs       : path - the path "in the storage array"
+// Outputs      : file handle if successful, -1 if failure
+
+static int16_t crud_open_unlocked(char *path) {
+	return( crud_open_file( path, -1 ) );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : crud_open_durable_unlocked
+// Description  : Opens the file and puts it in a durability class: scratch
+//                files are never persisted, lazy ones are persisted when the
+//                store is saved, sync ones also by crud_fsync.  Snapshot
+//                files keep their class.
 //
 // Inputs       : path - the path "in the storage array"
+//                durability - the class of the file
 // Outputs      : file handle if successful, -1 if failure
 
-int16_t crud_open(char *path) {
+static int16_t crud_open_durable_unlocked(char *path, CrudDurability durability) {
+	if( durability < CRUD_DURABILITY_LAZY || durability > CRUD_DURABILITY_SYNC )
+		return -1; // no such class
+	return( crud_open_file( path, durability ) );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : crud_open_file
+// Description  : Opens the file, moving it to a durability class if one is
+//                given
+//
+// Inputs       : path - the path "in the storage array"
+//                durability - the class of the file (-1 to keep it)
+// Outputs      : file handle if successful, -1 if failure
+
+static int16_t crud_open_file( char *path, int32_t durability ) {
 	// Initializing variables
-	CrudRequest request;                 // new crud request
-	CrudResponse response;               // new crud response
-	int i, index = CRUD_MAX_TOTAL_FILES; // for loop interator; index if file path not found in table
-	uint8_t found = 0;                   // flag determining if the file path was found in the file table
+	CrudRequest request;             // new crud request
+	CrudResponse response;           // new crud response
+	CrudFileAllocationType *entry;   // the table entry of the file
+	CrudFileAllocationType copy;     // the entry the handle starts with
+	char dirname[CRUD_MAX_PATH_LENGTH+1]; // the name the path has as a directory
+	int i, index = -1;               // for loop interator; free handle
 
 	// Initializing CRUD interface
 	if( !crudInitialized )
 		crud_init();
  	
-	if( crudInitialized ) {
-		// Searching the file table.  If the file path is already there, set open flag to 1, else allocate a spot in the file table.
-		for( i = 0; i < CRUD_MAX_TOTAL_FILES; i++ ) {
-			if( !strcmp( path, crud_file_table[i].filename ) ) {
-				crud_file_table[i].open = 1;
-				found = 1;
-				break; // once found, exit loop.
-			} 
-			else if( ( i < index ) && ( !strcmp( crud_file_table[i].filename, "" ) ) )
+	if( crudInitialized && path[0] != 0 && strlen( path ) < CRUD_MAX_PATH_LENGTH && path[strlen( path )-1] != '/' ) {
+		// A file that is already open keeps its handle, else take a free one
+		if( (i = crud_open_lookup( path )) != -1 ) {
+			crud_open_entry( i, &copy );
+			if( crud_set_durability( &copy, durability ) )
+				return -1;
+			crud_open_hot[i].flags = copy.flags | CRUD_OPEN_HANDLE;
+			crud_open_files[i].uses++;
+			return i;
+		}
+		for( i = 0; i < crud_open_slots && index == -1; i++ ) {
+			if( !(crud_open_hot[i].flags & CRUD_OPEN_HANDLE) )
 				index = i;
 		}
+		if( index == -1 && (index = crud_open_grow()) == -1 )
+			return -1; // out of file handles
 
-		// File not in table.  Make entry
-		if( !found ) {
+		// Looking the file up in the table.  Not in table, make entry
+		if( (entry = crud_table_find( path )) == NULL ) {
+			snprintf( dirname, sizeof(dirname), "%s/", path );
+			if( crud_table_find( dirname ) != NULL || !strncmp( path, CRUD_SNAPSHOT_DIR, strlen( CRUD_SNAPSHOT_DIR ) ) )
+				return -1; // the path is a directory, or in a snapshot
 			request = create_crudrequest( 0, CRUD_CREATE, 0, 0 ); // crud create request
-			response = crud_bus_request( request, NULL );      // sending request
-			if( !extract_crudresponse( response, index ) ) {
-				strcpy( crud_file_table[index].filename, path );
-				crud_file_table[index].position = 0;
-				crud_file_table[index].length = 0;
-				crud_file_table[index].open = 1;
-				return index;
-			} else return -1; // return failed
-		} else return i; // successfull, returning fd
-	} else return -1; // crud not initialized. Failed.
+			response = crud_io_request( request, NULL );      // sending request
+			if( (response & 1) || (entry = crud_table_insert( path )) == NULL )
+				return -1; // return failed
+			copy = *entry;
+			copy.object_id = (uint32_t)(response >> 32);
+			if( durability == CRUD_DURABILITY_SCRATCH )
+				copy.flags = CRUD_FILE_SCRATCH;
+			else if( durability == CRUD_DURABILITY_SYNC )
+				copy.flags = CRUD_FILE_SYNC;
+			if( crud_commit( crud_table_update( &copy ) ) )
+				return -1;
+		} else {
+			copy = *entry;
+			if( crud_set_durability( &copy, durability ) )
+				return -1;
+		}
+
+		// Opening the handle on a copy of the entry
+		memset( &crud_open_files[index], 0, sizeof(CrudOpenFile) );
+		crud_open_files[index].capacity = copy.capacity;
+		crud_open_files[index].uses = 1;
+		crud_open_hot[index].object_id = copy.object_id;
+		crud_open_hot[index].length = copy.length;
+		crud_open_hot[index].position = 0;
+		crud_open_hot[index].flags = copy.flags | CRUD_OPEN_HANDLE;
+		crud_open_intern( index, path );
+		return index;
+	} else return -1; // crud not initialized or bad path. Failed.
 }
 
+
 ////////////////////////////////////////////////////////////////////////////////
 //
-// Function     : crud_close
+// Function     : crud_close_unlocked
 // Description  : This function closes the file
 //
 // Inputs       : fd - the file handle of the object to close
 // Outputs      : 0 if successful, -1 if failure
 
-int16_t crud_close(int16_t fd) {
+static int16_t crud_close_unlocked(int16_t fd) {
 	// checking parameters
-	if( fd >= 0 && fd <= CRUD_MAX_TOTAL_FILES && crud_file_table[fd].open ) {
-		crud_file_table[fd].open = 0;
-		crud_file_table[fd].position = 0;
+	if( fd >= 0 && fd < crud_open_slots && (crud_open_hot[fd].flags & CRUD_OPEN_HANDLE) ) {
+		// writing back any buffered data before the handle goes away
+		if( crud_flush( fd ) )
+			return -1;
+		crud_open_touch( fd );
+		crud_buffer_release( fd );
+		crud_readahead_release( fd );
+		crud_sparse_release( fd );
+		crud_open_forget( fd );
 		return 0;
 	} else return -1;
 }
 
 ////////////////////////////////////////////////////////////////////////////////
 //
-// Function     : crud_read
+// Function     : crud_read_unlocked
 // Description  : Reads up to "count" bytes from the file handle "fd" into the
 //                buffer  "buf".
 //
@@ -308,362 +675,3521 @@ int16_t crud_close(int16_t fd) {
 //                count - the number of bytes to read
 // Outputs      : the number of bytes read or -1 if failures
 
-int32_t crud_read(int16_t fd, void *buf, int32_t count) {
+static int32_t crud_read_unlocked(int16_t fd, void *buf, int32_t count) {
 	// Declaring and Initializing variables
-	CrudRequest request;
-	CrudResponse response;
-	int32_t readBytes = 0; // determines the number of bytes to read and also the retval
-	char *tempBuf = (char*)malloc(crud_file_table[fd].length); // temp buffer to hold read data from object
+	uint32_t position;
+	int32_t readBytes;
+
+	// reading at the position of the handle, then moving it past the bytes read
+	if( fd < 0 || fd >= crud_open_slots )
+		return -1;
+	position = crud_open_hot[fd].position;
+	readBytes = crud_read_file( fd, buf, count, position, 1 );
+	if( readBytes > 0 )
+		crud_open_hot[fd].position = position + readBytes;
+	return readBytes;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : crud_read_at_unlocked
+// Description  : Reads up to "count" bytes at "offset" from the file handle
+//                "fd" into the buffer "buf", leaving the position alone
+//
+// Inputs       : fd - the file handle of the object to read from
+//                buf - the buffer to place the bytes into
+//                count - the number of bytes to read
+//                offset - where in the file to read from
+// Outputs      : the number of bytes read if successful, -1 if failure
+
+static int32_t crud_read_at_unlocked(int16_t fd, void *buf, int32_t count, uint32_t offset) {
+	return( crud_read_file( fd, buf, count, offset, 1 ) );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : crud_read_file
+// Description  : Reads up to "count" bytes at "position" from the file handle
+//                "fd" into the buffer "buf", fetching the object through a
+//                shared fetch when asked to (the read starts over unshared if
+//                the files changed while the lock was let go)
+//
+// Inputs       : fd - the file handle of the object to read from
+//                buf - the buffer to place the bytes into
+//                count - the number of bytes to read
+//                position - where in the file to read from
+//                shared - nonzero to share the fetch of the object
+// Outputs      : the number of bytes read if successful, -1 if failure
 
+static int32_t crud_read_file( int16_t fd, char *buf, int32_t count, uint32_t position, int shared ) {
+	// Declaring and Initializing variables
+	int32_t readBytes = 0; // determines the number of bytes to read and also the retval
+	uint32_t capacity;     // the size of the object
+	CrudOID oid;           // the object of the file
+	CrudFlight *flight;    // the fetch of the object
+	CrudHeatmapObject *warm; // the object read at mount
 
 	// verifying the crud interface is initialized, fd is valid, and the file is open
-	if( crudInitialized && fd >= 0 && fd <= CRUD_MAX_TOTAL_FILES && crud_file_table[fd].open ) {
+	if( crudInitialized && fd >= 0 && fd < crud_open_slots && (crud_open_hot[fd].flags & CRUD_OPEN_HANDLE) && count >= 0 ) {
+
+		// counting the use for the heatmap (not again when the read starts over unshared)
+		if( shared )
+			crud_open_files[fd].uses++;
 
-		// determining the number of bytes to read
-		if( (crud_file_table[fd].position + count) <= crud_file_table[fd].length )   // can read count bytes
+		// determining the number of bytes to read (none from past LENGTH)
+		if( position >= crud_open_hot[fd].length )
+			readBytes = 0;
+		else if( (uint64_t)position + count <= crud_open_hot[fd].length )   // can read count bytes
 			readBytes = count;
 		else // reading count bytes continues past LENGTH
-			readBytes = crud_file_table[fd].length - crud_file_table[fd].position;
+			readBytes = crud_open_hot[fd].length - position;
+		if( readBytes == 0 )
+			return 0; // nothing to read, no need to touch the object
+
+		// serving the read from the readahead window if it was prefetched
+		if( crud_readahead_hit( fd, buf, position, readBytes ) )
+			return readBytes;
 
-		// generating a crud request and sending the request
-		request = create_crudrequest( crud_file_table[fd].object_id, CRUD_READ, crud_file_table[fd].length, 0 );
-		response = crud_bus_request( request, tempBuf );
+		// reading a range that is still in the write buffer, write it back first
+		if( crud_buffer_dirty( fd, position, readBytes ) && crud_flush( fd ) )
+			return -1;
 
-		// copying correct bytes into buf
-		memcpy( buf, &tempBuf[crud_file_table[fd].position], readBytes );
+		// sparse files read the chunks in range, holes are zeros
+		if( crud_open_hot[fd].flags & CRUD_FILE_SPARSE ) {
+			if( crud_sparse_read( fd, buf, position, readBytes ) )
+				return -1;
+			return readBytes;
+		}
 
-		// checking result of response
-		if( !(response & 1) ) {
-			crud_file_table[fd].position += readBytes;
-			free(tempBuf); // freeing malloced memory
+		// copying from the object read at mount if it is still as read
+		oid = crud_open_hot[fd].object_id;
+		capacity = crud_open_files[fd].capacity;
+		if( (warm = crud_heatmap_warm( oid, capacity )) != NULL ) {
+			memcpy( buf, &warm->data[position], readBytes );
+			crud_readahead_fill( fd, warm->data, position + readBytes );
+			crud_heatmap_release( warm );
 			return readBytes;
 		}
-		else {
-			free(tempBuf);
+
+		// fetching the object (the lock may be let go meanwhile)
+		if( (flight = crud_fetch( oid, capacity, shared )) == NULL )
+			return -1;
+		if( shared && (flight->stale || !(crud_open_hot[fd].flags & CRUD_OPEN_HANDLE) ||
+		    crud_open_hot[fd].object_id != oid || crud_open_files[fd].capacity != capacity) ) {
+			// a writer changed the file meanwhile, the fetch may have read (or
+			// failed on) an object the file no longer names
+			crud_fetch_release( flight );
+			return( crud_read_file( fd, buf, count, position, 0 ) );
+		}
+		if( flight->response & 1 ) {
+			crud_fetch_release( flight );
 			return -1;
 		}
+
+		// copying the bytes read, keeping the next ones for the reader
+		memcpy( buf, &flight->data[position], readBytes );
+		crud_readahead_fill( fd, flight->data, position + readBytes );
+		crud_fetch_release( flight );
+		return readBytes;
+	} else return -1;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : crud_fetch
+// Description  : Reads a whole object.  A shared fetch joins the fetch of the
+//                object in flight, if there is one, and waits for it; else
+//                it sends the read without the interface lock, so readers
+//                coming meanwhile can join it.  Only a caller holding the
+//                interface lock once (a reader) can let go of it.
+//
+// Inputs       : oid - the object
+//                length - the size of the object
+//                shared - nonzero to share the fetch
+// Outputs      : the fetch (release it with crud_fetch_release), NULL if failure
+
+static CrudFlight *crud_fetch( CrudOID oid, uint32_t length, int shared ) {
+	// Declaring and Initializing variables
+	CrudFlight *flight, **link;
+	uint_fast64_t changes;
+
+	// Joining the fetch in flight
+	shared = shared && (crud_io_depth == 1);
+	for( flight = crud_flights; shared && flight != NULL; flight = flight->next ) {
+		if( flight->oid == oid && flight->length == length ) {
+			flight->refs++;
+			crud_io_coalesced++;
+			crud_flight_waiters++;
+			crud_flight_readers++;
+			while( !flight->done ) {
+				crud_io_depth = 0;
+				pthread_cond_wait( &flight->cond, &crud_io_mutex );
+				crud_io_depth = 1;
+			}
+			crud_flight_readers--;
+			if( --crud_flight_waiters == 0 && crud_flights == NULL )
+				pthread_cond_broadcast( &crud_flights_idle );
+			return( flight );
+		}
+	}
+
+	// Else sending one, from the pool
+	if( (flight = crud_flight_pool) != NULL ) {
+		crud_flight_pool = flight->next;
 	} else {
-		// freeing memory allocation
-		free(tempBuf);
-		tempBuf = NULL;
-		return -1;
+		if( (flight = (CrudFlight *)calloc( 1, sizeof(CrudFlight) )) == NULL ) {
+			CRUD_LOG( LOG_ERROR_LEVEL, "CRUD: failure allocating a fetch of object [%u].", oid );
+			return( NULL );
+		}
+		pthread_cond_init( &flight->cond, NULL );
+	}
+	flight->oid = oid;
+	flight->length = length;
+	flight->data = (char *)crud_arena_alloc( length );
+	flight->refs = 1;
+	flight->done = 0;
+	flight->stale = 0;
+	if( !shared ) {
+		flight->response = crud_io_request( create_crudrequest( oid, CRUD_READ, length, 0 ), flight->data );
+		flight->done = 1;
+		return( flight );
+	}
+
+	// Letting go of the lock while the device reads
+	flight->next = crud_flights;
+	crud_flights = flight;
+	changes = crud_io_changes;
+	crud_flight_readers++;
+	crud_io_depth = 0;
+	pthread_mutex_unlock( &crud_io_mutex );
+	flight->response = crud_io_request( create_crudrequest( oid, CRUD_READ, length, 0 ), flight->data );
+	pthread_mutex_lock( &crud_io_mutex );
+	crud_io_depth = 1;
+	crud_flight_readers--;
+
+	// Handing the object to the readers that joined
+	for( link = &crud_flights; *link != flight; link = &(*link)->next );
+	*link = flight->next;
+	flight->stale = (crud_io_changes != changes);
+	flight->done = 1;
+	pthread_cond_broadcast( &flight->cond );
+	if( crud_flights == NULL && crud_flight_waiters == 0 )
+		pthread_cond_broadcast( &crud_flights_idle );
+	return( flight );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : crud_fetch_drain
+// Description  : Waits until no fetch is in flight and no reader is waiting
+//                on one, so the arena and the open files can go (unmount and
+//                format).  Only a caller holding the interface lock once can
+//                let go of it to wait.
+//
+// Inputs       : none
+// Outputs      : 0 if successful, -1 if fetches are in flight and the caller cannot wait
+
+static int crud_fetch_drain( void ) {
+	while( crud_flights != NULL || crud_flight_waiters > 0 ) {
+		if( crud_io_depth != 1 ) {
+			CRUD_LOG( LOG_ERROR_LEVEL, "CRUD: reads in flight, cannot unmount or format inside another call." );
+			return -1;
+		}
+		crud_io_depth = 0;
+		pthread_cond_wait( &crud_flights_idle, &crud_io_mutex );
+		crud_io_depth = 1;
+	}
+	return 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : crud_fetch_release
+// Description  : Drops a reader of a fetch, the last one returns it to the pool
+//
+// Inputs       : flight - the fetch
+// Outputs      : none
+
+static void crud_fetch_release( CrudFlight *flight ) {
+	if( --flight->refs == 0 ) {
+		crud_arena_free( flight->data );
+		flight->data = NULL;
+		flight->next = crud_flight_pool;
+		crud_flight_pool = flight;
 	}
 }
 
 //////////////////////////////////////////////////////////////////////////////////////////
 //
-// Function     : crud_write
+// Function     : crud_write_unlocked
 // Description  : Writes "count" bytes to the file handle "fd" from the
-//                buffer  "buf"
+//                buffer  "buf".  The data is held in the file's write buffer
+//                and reaches the object when the buffer is flushed.
 //
 // Inputs       : fd - the file descriptor for the file to write to
 //                buf - the buffer to write
 //                count - the number of bytes to write
 // Outputs      : the number of bytes written or -1 if failure
 
-int32_t crud_write(int16_t fd, void *buf, int32_t count) {
+static int32_t crud_write_unlocked(int16_t fd, void *buf, int32_t count) {
 	// Declaring and Initializing variables
-	CrudRequest request;
-	CrudResponse response;
-	uint32_t oldPos;                                  // holds the old fd position
-	char oldData[crud_file_table[fd].length];         // creating a buffer to store old data
-	char newData[crud_file_table[fd].length + count]; // creating a buffer for new data
+	uint32_t pos; // the position the write starts at
 
-	// Checking crud interface initialized, valid fd, and the file is open
-	if( crudInitialized && fd >= 0 && fd <= CRUD_MAX_TOTAL_FILES && crud_file_table[fd].open ) {
-
-		// extracting old object data, saving, deleting, and creating a new object
-		oldPos = crud_file_table[fd].position;                  // storing the value of POS
-		crud_file_table[fd].position = 0;                       // updating position to read from the beginning
-		crud_read( fd, oldData, crud_file_table[fd].length );   // old data extracted and stored in "oldData"
-		memcpy( newData, oldData, crud_file_table[fd].length ); // saving old data into new data
-		memcpy( &newData[oldPos], buf, count );                 // saving write data into new buffer
-
-		// number of bytes to write exceeds LENGTH, must delete current object and create a new one
-		if( oldPos + count > crud_file_table[fd].length ) {
-
-			// Creating request to delete object.  If response is successful, create new object with new length 
-			request = create_crudrequest( crud_file_table[fd].object_id, CRUD_DELETE, 0, 0 );
-
-			if( !( crud_bus_request( request, newData ) & 1 ) ) {
-				// Creating request to create a new object
-				request = create_crudrequest( 0, CRUD_CREATE, oldPos + count, 0 ); // creating request
-				response = crud_bus_request( request, newData ); // sending request
-				
-				// checking response and updating table entry if successful
-				if( !extract_crudresponse( response, fd ) ) {
-					crud_file_table[fd].position = oldPos + count; 
-					crud_file_table[fd].length = oldPos + count; 
-					return count;
-				} else return -1; // crud bus request failed
-			} else return -1; // crud bus request failed
-		}
-		// number of bytes to write does not exceed LENGTH, must update object
-		else {
-			// creating new update request and sending request
-			request = create_crudrequest( crud_file_table[fd].object_id, CRUD_UPDATE, crud_file_table[fd].length, 0 );
-			response = crud_bus_request( request, newData ); 
-			
-			// checking response and updating new position if successful
-			if( !extract_crudresponse( response, fd )) {
-				crud_file_table[fd].position = oldPos + count; 
-				return count;
-			} else return -1; // crud bus request failed
-		}
-	} else return -1;
+	// writing at the position of the handle, then moving it past the bytes written
+	if( fd < 0 || fd >= crud_open_slots )
+		return -1;
+	pos = crud_open_hot[fd].position;
+	if( crud_write_file( fd, buf, count, pos ) != count )
+		return -1;
+	crud_open_hot[fd].position = pos + count;
+	return count;
 }
 
-
 ////////////////////////////////////////////////////////////////////////////////
 //
-// Function     : crud_seek
-// Description  : Seek to specific point in the file
+// Function     : crud_write_at_unlocked
+// Description  : Writes "count" bytes at "offset" to the file handle "fd"
+//                from the buffer "buf", leaving the position alone
 //
-// Inputs       : fd - the file descriptor for the file to seek
-//                loc - offset from beginning of file to seek to
-// Outputs      : 0 if successful or -1 if failure
+// Inputs       : fd - the file handle of the object to write to
+//                buf - the buffer of the bytes to write
+//                count - the number of bytes to write
+//                offset - where in the file to write
+// Outputs      : the number of bytes written if successful, -1 if failure
 
-int32_t crud_seek(int16_t fd, uint32_t loc) {
-	// Checking crud interface initialized and fd is valid
-	if( crudInitialized && fd >= 0 && fd <= CRUD_MAX_TOTAL_FILES ) {
-		// checking boundary conditions of loc
-		if( loc <= crud_file_table[fd].length ) {
-			crud_file_table[fd].position = loc;
-			return 0;
-		} else return -1;
-	} else return -1;
+static int32_t crud_write_at_unlocked(int16_t fd, void *buf, int32_t count, uint32_t offset) {
+	return( crud_write_file( fd, buf, count, offset ) );
 }
 
-// Module local methods
-
 ////////////////////////////////////////////////////////////////////////////////
 //
-// Function     : crudIOUnitTest
-// Description  : Perform a test of the CRUD IO implementation
+// Function     : crud_write_file
+// Description  : Writes "count" bytes at "pos" to the file handle "fd" from
+//                the buffer "buf", growing the file if written past LENGTH
 //
-// Inputs       : None
-// Outputs      : 0 if successful or -1 if failure
+// Inputs       : fd - the file handle of the object to write to
+//                buf - the buffer of the bytes to write
+//                count - the number of bytes to write
+//                pos - where in the file to write
+// Outputs      : the number of bytes written if successful, -1 if failure
 
-int crudIOUnitTest(void) {
+static int32_t crud_write_file( int16_t fd, char *buf, int32_t count, uint32_t pos ) {
+	// Checking crud interface initialized, valid fd, and the file is open (and not in a snapshot)
+	if( crudInitialized && fd >= 0 && fd < crud_open_slots && (crud_open_hot[fd].flags & CRUD_OPEN_HANDLE) && count >= 0 &&
+	    !(crud_open_hot[fd].flags & CRUD_FILE_FROZEN) ) {
 
-	// Local variables
-	uint8_t ch;
-	int16_t fh, i;
-	int32_t cio_utest_length, cio_utest_position, count, bytes, expected;
-	char *cio_utest_buffer, *tbuf;
-	CRUD_UNIT_TEST_TYPE cmd;
-	char lstr[1024];
+		// the file can never grow past the largest sparse file
+		if( (uint64_t)pos + count > CRUD_MAX_FILE_SIZE )
+			return -1;
 
-	// Setup some operating buffers, zero out the mirrored file contents
-	cio_utest_buffer = malloc(CRUD_MAX_OBJECT_SIZE);
-	tbuf = malloc(CRUD_MAX_OBJECT_SIZE);
-	memset(cio_utest_buffer, 0x0, CRUD_MAX_OBJECT_SIZE);
-	cio_utest_length = 0;
-	cio_utest_position = 0;
+		// a file outgrowing one object, or written a chunk or more past its
+		// end, becomes sparse so the gap is a hole instead of zeros
+		if( !(crud_open_hot[fd].flags & CRUD_FILE_SPARSE) &&
+		    (pos + count > CRUD_MAX_OBJECT_SIZE || pos >= crud_open_hot[fd].length + CRUD_SPARSE_CHUNK_SIZE) ) {
+			if( crud_flush( fd ) || crud_sparse_convert( fd ) )
+				return -1;
+		}
 
-	// Format and mount the file system
-	if (crud_format() || crud_mount()) {
-		logMessage(LOG_ERROR_LEVEL, "CRUD_IO_UNIT_TEST : Failure on format or mount operation.");
-		return(-1);
-	}
+		// merging the data into the write buffer, prefetched data is now stale
+		crud_io_writes++;
+		crud_open_files[fd].uses++;
+		crud_open_files[fd].ra.length = 0;
+		if( crud_buffer_write( fd, buf, pos, count ) )
+			return -1;
 
-	// Start by opening a file
-	fh = crud_open("temp_file.txt");
-	if (fh == -1) {
-		logMessage(LOG_ERROR_LEVEL, "CRUD_IO_UNIT_TEST : Failure open operation.");
-		return(-1);
-	}
+		// growing the file if written past LENGTH
+		if( pos + count > crud_open_hot[fd].length )
+			crud_open_hot[fd].length = pos + count;
+		return count;
+	} else return -1;
+}
 
-	// Now do a bunch of operations
-	for (i=0; i<CRUD_IO_UNIT_TEST_ITERATIONS; i++) {
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : crud_flush_unlocked
+// Description  : Writes the buffered data of a file back to its object as a
+//                single object update.
+//
+// Inputs       : fd - the file descriptor for the file to flush
+// Outputs      : 0 if successful or -1 if failure
 
-		// Pick a random command
-		if (cio_utest_length == 0) {
-			cmd = CIO_UNIT_TEST_WRITE;
-		} else {
-			cmd = getRandomValue(CIO_UNIT_TEST_READ, CIO_UNIT_TEST_SEEK);
-		}
+static int16_t crud_flush_unlocked(int16_t fd) {
+	// Declaring and Initializing variables
+	CrudRequest request;
+	CrudResponse response;
+	CrudWriteBuffer *wb;
+	CrudWriteExtent *last;
+	uint32_t newLength; // length of the file after the flush
+	uint32_t capacity;  // size of the object after the flush
+	char *image;        // the full contents of the object to write
+	int i;
 
-		// Execute the command
-		switch (cmd) {
+	// Checking crud interface initialized and valid fd
+	if( !crudInitialized || fd < 0 || fd >= crud_open_slots )
+		return -1;
+	wb = &crud_open_files[fd].wb;
+	if( wb->nextents == 0 )
+		return 0; // nothing buffered
 
-		case CIO_UNIT_TEST_READ: // read a random set of data
-			count = getRandomValue(0, cio_utest_length);
-			logMessage(LOG_INFO_LEVEL, "CRUD_IO_UNIT_TEST : read %d at position %d", bytes, cio_utest_position);
-			bytes = crud_read(fh, tbuf, count);
-			if (bytes == -1) {
-				logMessage(LOG_ERROR_LEVEL, "CRUD_IO_UNIT_TEST : Read failure.");
-				return(-1);
-			}
+	// the buffer starts at the length the file had (a truncate flushes it
+	// before changing the length), only the last extent may extend the
+	// object beyond that stored length
+	last = &wb->extents[wb->nextents-1];
+	newLength = wb->stored_length;
+	if( last->offset + last->length > newLength )
+		newLength = last->offset + last->length;
+	if( newLength > crud_open_hot[fd].length )
+		crud_open_hot[fd].length = newLength; // a write going straight through is stored with its length
 
-			// Compare to what we expected
-			if (cio_utest_position+count > cio_utest_length) {
-				expected = cio_utest_length-cio_utest_position;
-			} else {
-				expected = count;
-			}
-			if (bytes != expected) {
-				logMessage(LOG_ERROR_LEVEL, "CRUD_IO_UNIT_TEST : short/long read of [%d!=%d]", bytes, expected);
-				return(-1);
-			}
-			if ( (bytes > 0) && (memcmp(&cio_utest_buffer[cio_utest_position], tbuf, bytes)) ) {
+	// sparse files write each chunk the extents touch
+	if( crud_open_hot[fd].flags & CRUD_FILE_SPARSE ) {
+		if( crud_sparse_flush( fd, newLength ) )
+			return -1;
+		wb->stored_length = newLength;
+		wb->nextents = 0;
+		wb->used = 0;
+		return( crud_commit( crud_open_update( fd ) ) );
+	}
 
-				bufToString((unsigned char *)tbuf, bytes, (unsigned char *)lstr, 1024 );
-				logMessage(LOG_INFO_LEVEL, "CIO_UTEST R: %s", lstr);
-				bufToString((unsigned char *)&cio_utest_buffer[cio_utest_position], bytes, (unsigned char *)lstr, 1024 );
-				logMessage(LOG_INFO_LEVEL, "CIO_UTEST U: %s", lstr);
+	// the object keeps its reserved capacity unless the file grew past it,
+	// then it gets the size class of the new length (sizes that repeat, so
+	// the object of another file can be reused)
+	capacity = crud_open_files[fd].capacity;
+	if( newLength > capacity )
+		capacity = crud_recycle_class( newLength );
 
-				logMessage(LOG_ERROR_LEVEL, "CRUD_IO_UNIT_TEST : read data mismatch (%d)", bytes);
-				return(-1);
+	// a single extent covering the whole object is already the object image
+	if( wb->nextents == 1 && last->offset == 0 && last->length == capacity ) {
+		image = last->data;
+	} else {
+		// read the stored object unless the first extent rewrites all of it,
+		// then lay the dirty extents over it (the tail past the file is zero)
+		image = (char*)crud_arena_alloc(capacity);
+		if( wb->stored_length > 0 && !(wb->extents[0].offset == 0 && wb->extents[0].length >= wb->stored_length) ) {
+			request = create_crudrequest( crud_open_hot[fd].object_id, CRUD_READ, crud_open_files[fd].capacity, 0 );
+			response = crud_io_request( request, image );
+			if( response & 1 ) {
+				crud_arena_free(image);
+				return -1; // crud read request failed
 			}
-			logMessage(LOG_INFO_LEVEL, "CRUD_IO_UNIT_TEST : read %d match", bytes);
-
-
-			// update the position pointer
-			cio_utest_position += bytes;
-			break;
+		}
+		memset( &image[wb->stored_length], 0, capacity - wb->stored_length );
+		for( i = 0; i < wb->nextents; i++ )
+			memcpy( &image[wb->extents[i].offset], wb->extents[i].data, wb->extents[i].length );
+	}
 
-		case CIO_UNIT_TEST_APPEND: // Append data onto the end of the file
-			// Create random block, check to make sure that the write is not too large
-			ch = getRandomValue(0, 0xff);
-			count =  getRandomValue(1, CIO_UNIT_TEST_MAX_WRITE_SIZE);
-			if (cio_utest_length+count >= CRUD_MAX_OBJECT_SIZE) {
-
-				// Log, seek to end of file, create random value
-				logMessage(LOG_INFO_LEVEL, "CRUD_IO_UNIT_TEST : append of %d bytes [%x]", count, ch);
-				logMessage(LOG_INFO_LEVEL, "CRUD_IO_UNIT_TEST : seek to position %d", cio_utest_length);
-				if (crud_seek(fh, cio_utest_length)) {
-					logMessage(LOG_ERROR_LEVEL, "CRUD_IO_UNIT_TEST : seek failed [%d].", cio_utest_length);
-					return(-1);
-				}
-				cio_utest_position = cio_utest_length;
-				memset(&cio_utest_buffer[cio_utest_position], ch, count);
-
-				// Now write
-				bytes = crud_write(fh, &cio_utest_buffer[cio_utest_position], count);
-				if (bytes != count) {
-					logMessage(LOG_ERROR_LEVEL, "CRUD_IO_UNIT_TEST : append failed [%d].", count);
-					return(-1);
-				}
-				cio_utest_length = cio_utest_position += bytes;
-			}
-			break;
+	// object size is immutable, so growing past the capacity needs a new
+	// object, as does writing an object a clone shares
+	if( capacity != crud_open_files[fd].capacity || crud_table_refs( crud_open_hot[fd].object_id ) > 1 ) {
+		response = crud_replace_object( crud_open_hot[fd].object_id, crud_open_files[fd].capacity, capacity, image );
+	} else {
+		request = create_crudrequest( crud_open_hot[fd].object_id, CRUD_UPDATE, capacity, 0 );
+		response = crud_io_request( request, image );
+	}
+	if( image != last->data )
+		crud_arena_free(image);
 
-		case CIO_UNIT_TEST_WRITE: // Write random block to the file
-			ch = getRandomValue(0, 0xff);
-			count =  getRandomValue(1, CIO_UNIT_TEST_MAX_WRITE_SIZE);
-			// Check to make sure that the write is not too large
-			if (cio_utest_length+count < CRUD_MAX_OBJECT_SIZE) {
-				// Log the write, perform it
-				logMessage(LOG_INFO_LEVEL, "CRUD_IO_UNIT_TEST : write of %d bytes [%x]", count, ch);
-				memset(&cio_utest_buffer[cio_utest_position], ch, count);
-				bytes = crud_write(fh, &cio_utest_buffer[cio_utest_position], count);
-				if (bytes!=count) {
-					logMessage(LOG_ERROR_LEVEL, "CRUD_IO_UNIT_TEST : write failed [%d].", count);
-					return(-1);
-				}
-				cio_utest_position += bytes;
-				if (cio_utest_position > cio_utest_length) {
-					cio_utest_length = cio_utest_position;
-				}
-			}
-			break;
+	// checking response and resetting the buffer if successful
+	if( extract_crudresponse( response, fd ) )
+		return -1; // crud bus request failed
+	crud_open_files[fd].capacity = capacity;
+	wb->stored_length = newLength;
+	wb->nextents = 0;
+	wb->used = 0;
+	return( crud_commit( crud_open_update( fd ) ) );
+}
 
-		case CIO_UNIT_TEST_SEEK:
-			count = getRandomValue(0, cio_utest_length);
-			logMessage(LOG_INFO_LEVEL, "CRUD_IO_UNIT_TEST : seek to position %d", count);
-			if (crud_seek(fh, count)) {
-				logMessage(LOG_ERROR_LEVEL, "CRUD_IO_UNIT_TEST : seek failed [%d].", count);
-				return(-1);
-			}
-			cio_utest_position = count;
-			break;
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : crud_fsync_unlocked
+// Description  : Writes back the buffered data of a file and, if it is a sync
+//                file, makes it durable: the table journal is committed and
+//                the object store synced.  A lazy file is persisted at the
+//                next checkpoint, a scratch file never.
+//
+// Inputs       : fd - the file descriptor for the file to sync
+// Outputs      : 0 if successful or -1 if failure
 
-		default: // This should never happen
-			CMPSC_ASSERT0(0, "CRUD_IO_UNIT_TEST : illegal test command.");
-			break;
+static int16_t crud_fsync_unlocked(int16_t fd) {
+	// Checking crud interface initialized, valid fd, and the file is open
+	if( !crudInitialized || fd < 0 || fd >= crud_open_slots || !(crud_open_hot[fd].flags & CRUD_OPEN_HANDLE) )
+		return -1;
+	if( crud_flush( fd ) )
+		return -1;
+	if( !(crud_open_hot[fd].flags & CRUD_FILE_SYNC) )
+		return 0;
+	return( (crud_table_commit( 1 ) || crud_io_sync()) ? -1 : 0 );
+}
 
-		}
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : crud_truncate_unlocked
+// Description  : Sets the length of a file, dropping the data past a shorter
+//                length or adding zeros up to a longer one.  Shrinking also
+//                gives back any capacity reserved past the new length.
+//
+// Inputs       : fd - the file descriptor for the file to truncate
+//                len - the new length of the file
+// Outputs      : 0 if successful or -1 if failure
 
-#if DEEP_DEBUG
-		// VALIDATION STEP: ENSURE OUR LOCAL IS LIKE OBJECT STORE
-		CrudRequest request;
-		CrudResponse response;
-		CrudOID oid;
-		CRUD_REQUEST_TYPES req;
-		uint32_t length;
-		uint8_t res, flags;
-
-		// Make a fake request to get file handle, then check it
-		request = construct_crud_request(crud_file_table[0].object_id, CRUD_READ, CRUD_MAX_OBJECT_SIZE, CRUD_NULL_FLAG, 0);
-		response = crud_bus_request(request, tbuf);
-		if ((deconstruct_crud_request(response, &oid, &req, &length, &flags, &res) != 0) || (res != 0))  {
-			logMessage(LOG_ERROR_LEVEL, "Read failure, bad CRUD response [%x]", response);
-			return(-1);
-		}
-		if ( (cio_utest_length != length) || (memcmp(cio_utest_buffer, tbuf, length)) ) {
-			logMessage(LOG_ERROR_LEVEL, "Buffer/Object cross validation failed [%x]", response);
-			bufToString((unsigned char *)tbuf, length, (unsigned char *)lstr, 1024 );
-			logMessage(LOG_INFO_LEVEL, "CIO_UTEST VR: %s", lstr);
-			bufToString((unsigned char *)cio_utest_buffer, length, (unsigned char *)lstr, 1024 );
-			logMessage(LOG_INFO_LEVEL, "CIO_UTEST VU: %s", lstr);
-			return(-1);
-		}
+static int16_t crud_truncate_unlocked(int16_t fd, uint32_t len) {
+	// Checking crud interface initialized, valid fd, and the file is open (and not in a snapshot)
+	if( !crudInitialized || fd < 0 || fd >= crud_open_slots || !(crud_open_hot[fd].flags & CRUD_OPEN_HANDLE) || len > CRUD_MAX_FILE_SIZE ||
+	    (crud_open_hot[fd].flags & CRUD_FILE_FROZEN) )
+		return -1;
 
-		// Print out the buffer
-		bufToString((unsigned char *)cio_utest_buffer, cio_utest_length, (unsigned char *)lstr, 1024 );
-		logMessage(LOG_INFO_LEVEL, "CIO_UTEST: %s", lstr);
-#endif
+	// the object has to match the table before it is resized
+	if( crud_flush( fd ) )
+		return -1;
+	crud_open_files[fd].ra.length = 0;
 
+	// extending a file past one object, or by a chunk or more, leaves a hole
+	if( !(crud_open_hot[fd].flags & CRUD_FILE_SPARSE) &&
+	    (len > CRUD_MAX_OBJECT_SIZE || len >= crud_open_hot[fd].length + CRUD_SPARSE_CHUNK_SIZE) ) {
+		if( crud_sparse_convert( fd ) )
+			return -1;
 	}
 
-	// Close the files and cleanup buffers, assert on failure
-	if (crud_close(fh)) {
-		logMessage(LOG_ERROR_LEVEL, "CRUD_IO_UNIT_TEST : Failure read comparison block.", fh);
-		return(-1);
+	// shrinking cuts the object down, growing past the capacity enlarges it
+	// (bytes past the length of the file are always zero in the object)
+	if( crud_open_hot[fd].flags & CRUD_FILE_SPARSE ) {
+		if( crud_sparse_truncate( fd, len ) )
+			return -1;
+	} else if( len < crud_open_hot[fd].length || len > crud_open_files[fd].capacity ) {
+		if( crud_resize( fd, len ) )
+			return -1;
 	}
-	free(cio_utest_buffer);
-	free(tbuf);
+	crud_open_hot[fd].length = len;
+	if( crud_open_hot[fd].position > len )
+		crud_open_hot[fd].position = len;
+	return( crud_commit( crud_open_update( fd ) ) );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : crud_reserve_unlocked
+// Description  : Makes the object behind a file at least len bytes, so the
+//                file can be written up to len without replacing its object.
+//                The length of the file does not change.
+//
+// Inputs       : fd - the file descriptor for the file
+//                len - the capacity to reserve
+// Outputs      : 0 if successful or -1 if failure
+
+static int16_t crud_reserve_unlocked(int16_t fd, uint32_t len) {
+	// Checking crud interface initialized, valid fd, and the file is open (and not in a snapshot)
+	if( !crudInitialized || fd < 0 || fd >= crud_open_slots || !(crud_open_hot[fd].flags & CRUD_OPEN_HANDLE) || len > CRUD_MAX_FILE_SIZE ||
+	    (crud_open_hot[fd].flags & CRUD_FILE_FROZEN) )
+		return -1;
+	if( len <= crud_open_files[fd].capacity )
+		return 0; // already there
+
+	// writing back the buffer, then moving the file to a bigger object (a
+	// sparse file only grows its chunk map, the chunks come with the data);
+	// the flush may already have grown the object past len
+	if( crud_flush( fd ) )
+		return -1;
+	if( len <= crud_open_files[fd].capacity )
+		return 0;
+	if( len > CRUD_MAX_OBJECT_SIZE && !(crud_open_hot[fd].flags & CRUD_FILE_SPARSE) && crud_sparse_convert( fd ) )
+		return -1;
+	if( crud_open_hot[fd].flags & CRUD_FILE_SPARSE ) {
+		if( crud_sparse_slots( fd, len ) || crud_sparse_write_map( fd ) )
+			return -1;
+	} else if( crud_resize( fd, len ) )
+		return -1;
+	return( crud_commit( crud_open_update( fd ) ) );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : crud_seek_unlocked
+// Description  : Seek to specific point in the file
+//
+// Inputs       : fd - the file descriptor for the file to seek
+//                loc - offset from beginning of file to seek to
+// Outputs      : 0 if successful or -1 if failure
+
+static int32_t crud_seek_unlocked(int16_t fd, uint32_t loc) {
+	// Checking crud interface initialized and fd is valid
+	if( crudInitialized && fd >= 0 && fd < crud_open_slots ) {
+		// checking boundary conditions of loc (past LENGTH is a hole once written)
+		if( loc <= CRUD_MAX_FILE_SIZE ) {
+			crud_open_hot[fd].position = loc;
+			return 0;
+		} else return -1;
+	} else return -1;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : crud_mkdir_unlocked
+// Description  : Creates a directory.  The directory is a table entry named
+//                with the path and a trailing slash, which sorts right
+//                before the files in it.
+//
+// Inputs       : path - the path of the directory (its parent must exist)
+// Outputs      : 0 if successful or -1 if failure
+
+static int16_t crud_mkdir_unlocked(char *path) {
+	// Declaring and Initializing variables
+	CrudFileAllocationType *entry, copy;
+	char name[CRUD_MAX_PATH_LENGTH+1]; // the table name of the directory
+	char *slash;
+	size_t len = strlen( path );
+
+	// Initializing CRUD interface
+	if( !crudInitialized )
+		crud_init();
+
+	// Checking the path, it must not be taken by a file or directory
+	if( !crudInitialized || len == 0 || len+1 >= CRUD_MAX_PATH_LENGTH || path[len-1] == '/' )
+		return -1;
+	snprintf( name, sizeof(name), "%s/", path );
+	if( crud_table_find( path ) != NULL || crud_table_find( name ) != NULL )
+		return -1;
+
+	// The parent is the prefix up to the last slash
+	if( (slash = strrchr( path, '/' )) != NULL ) {
+		snprintf( name, sizeof(name), "%.*s", (int)(slash - path + 1), path );
+		if( !crud_dir_exists( name ) )
+			return -1; // no parent
+		snprintf( name, sizeof(name), "%s/", path );
+	}
+
+	// Adding the entry, directories have no object
+	if( (entry = crud_table_insert( name )) == NULL )
+		return -1;
+	copy = *entry;
+	copy.flags = CRUD_FILE_DIRECTORY;
+	return( crud_commit( crud_table_update( &copy ) ) );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : crud_opendir_unlocked
+// Description  : Opens a directory for reading its entries.  Directories
+//                made implicitly by files named with slashes open too.
+//
+// Inputs       : path - the path of the directory ("" or "/" for the root)
+// Outputs      : the directory or NULL if failure
+
+static CrudDirectory *crud_opendir_unlocked(char *path) {
+	// Declaring and Initializing variables
+	CrudDirectory *dir;
+	size_t len = strlen( path );
+
+	// Initializing CRUD interface
+	if( !crudInitialized )
+		crud_init();
+
+	// Checking the directory exists (the root always does)
+	while( len > 0 && path[len-1] == '/' )
+		len--;
+	if( !crudInitialized || len+1 >= CRUD_MAX_PATH_LENGTH )
+		return NULL;
+	dir = calloc( 1, sizeof(CrudDirectory) );
+	if( len > 0 ) {
+		memcpy( dir->prefix, path, len );
+		dir->prefix[len] = '/';
+	}
+	dir->plen = strlen( dir->prefix );
+	if( dir->plen > 0 && !crud_dir_exists( dir->prefix ) ) {
+		free( dir );
+		return NULL;
+	}
+
+	// Starting at the first name with the prefix
+	strcpy( dir->next, dir->prefix );
+	dir->generation = crud_table_generation();
+	if( crud_table_seek( &dir->cursor, dir->next ) ) {
+		free( dir );
+		return NULL;
+	}
+	return dir;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : crud_readdir_unlocked
+// Description  : Gets the next entry of a directory in name order.  Each
+//                call costs one step along the table leaves, plus one seek
+//                past the files of a subdirectory.
+//
+// Inputs       : dir - the directory
+// Outputs      : the entry (valid until the next call) or NULL at the end
+
+static CrudDirectoryEntry *crud_readdir_unlocked(CrudDirectory *dir) {
+	// Declaring and Initializing variables
+	CrudFileAllocationType *entry;
+	char *name, *slash;
+
+	// A file added since the last call may have moved the entries
+	if( dir == NULL )
+		return NULL;
+	if( dir->generation != crud_table_generation() ) {
+		dir->generation = crud_table_generation();
+		if( crud_table_seek( &dir->cursor, dir->next ) )
+			return NULL;
+	}
+
+	// Taking the next name with the prefix, skipping the directory itself
+	do {
+		entry = crud_table_next( &dir->cursor );
+		if( entry == NULL || strncmp( entry->filename, dir->prefix, dir->plen ) )
+			return NULL; // past the directory
+		name = &entry->filename[dir->plen];
+	} while( name[0] == 0 );
+
+	// A name with more components is in a subdirectory, the rest of which
+	// sorts before the subdirectory name with the slash bumped to '0'
+	memset( &dir->entry, 0, sizeof(CrudDirectoryEntry) );
+	if( (slash = strchr( name, '/' )) != NULL ) {
+		memcpy( dir->entry.name, name, slash - name );
+		dir->entry.directory = 1;
+		memcpy( dir->next, entry->filename, slash - entry->filename );
+		strcpy( &dir->next[slash - entry->filename], "0" );
+		if( crud_table_seek( &dir->cursor, dir->next ) )
+			return NULL;
+	} else {
+		strcpy( dir->entry.name, name );
+		dir->entry.directory = (entry->flags & CRUD_FILE_DIRECTORY) ? 1 : 0;
+		dir->entry.length = entry->length;
+		snprintf( dir->next, sizeof(dir->next), "%s\x01", entry->filename );
+	}
+	return &dir->entry;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : crud_closedir_unlocked
+// Description  : Closes a directory
+//
+// Inputs       : dir - the directory
+// Outputs      : 0 if successful or -1 if failure
+
+static int16_t crud_closedir_unlocked(CrudDirectory *dir) {
+	// Checking parameters
+	if( dir == NULL )
+		return -1;
+	free( dir );
+	return 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : crud_list_unlocked
+// Description  : Calls a function on every entry whose name starts with a
+//                prefix (files and directories, at any depth) in name order,
+//                in time proportional to the number of entries listed
+//
+// Inputs       : prefix - the prefix of the names
+//                fn - the function to call (it must not create files)
+//                arg - the argument passed to the function
+// Outputs      : the number of entries listed or -1 if failure
+
+static int32_t crud_list_unlocked(char *prefix, CrudListFunction fn, void *arg) {
+	// Declaring and Initializing variables
+	CrudFileAllocationType *entry;
+	CrudTableCursor cursor;
+	size_t len = strlen( prefix );
+	int32_t count = 0;
+
+	// Checking crud interface initialized
+	if( !crudInitialized )
+		crud_init();
+	if( !crudInitialized || crud_table_seek( &cursor, prefix ) )
+		return -1;
+
+	// Walking the leaves from the prefix until the names stop matching
+	while( (entry = crud_table_next( &cursor )) != NULL && !strncmp( entry->filename, prefix, len ) ) {
+		fn( entry, arg );
+		count++;
+	}
+	return count;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : crud_clone_unlocked
+// Description  : Creates a file with the contents of another without copying
+//                them.  The files share their objects until one of them is
+//                written, when the object (or chunk) written is copied.
+//
+// Inputs       : src - the path of the file to clone
+//                dst - the path of the new file (must not exist)
+// Outputs      : 0 if successful or -1 if failure
+
+static int16_t crud_clone_unlocked(char *src, char *dst) {
+	// Declaring and Initializing variables
+	CrudFileAllocationType *entry, copy;
+	char dirname[CRUD_MAX_PATH_LENGTH+1]; // the name dst has as a directory
+	size_t len = strlen( dst );
+	int i;
+
+	// Initializing CRUD interface
+	if( !crudInitialized )
+		crud_init();
+
+	// Checking the new path is free (and not in a snapshot)
+	if( !crudInitialized || len == 0 || len >= CRUD_MAX_PATH_LENGTH || dst[len-1] == '/' ||
+	    !strncmp( dst, CRUD_SNAPSHOT_DIR, strlen( CRUD_SNAPSHOT_DIR ) ) )
+		return -1;
+	snprintf( dirname, sizeof(dirname), "%s/", dst );
+	if( crud_table_find( dst ) != NULL || crud_table_find( dirname ) != NULL )
+		return -1;
+
+	// Writing back the buffered data of the source, so the clone has it
+	if( (i = crud_open_lookup( src )) != -1 && crud_flush( i ) )
+		return -1;
+	if( (entry = crud_table_find( src )) == NULL || (entry->flags & CRUD_FILE_DIRECTORY) )
+		return -1; // no such file
+	copy = *entry;
+	return( crud_commit( crud_clone_entry( &copy, dst, 0 ) ) );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : crud_snapshot_unlocked
+// Description  : Freezes every file as it is now in the read only directory
+//                CRUD_SNAPSHOT_DIR name, each file a clone of the live one
+//                (so the snapshot costs no data until the live files change).
+//                Scratch files are left out.
+//
+// Inputs       : name - the name of the snapshot
+// Outputs      : 0 if successful or -1 if failure
+
+static int16_t crud_snapshot_unlocked(char *name) {
+	// Declaring and Initializing variables
+	CrudFileAllocationType *entry, copy, dir;
+	CrudTableCursor cursor;
+	char prefix[CRUD_MAX_PATH_LENGTH], path[CRUD_MAX_PATH_LENGTH], next[CRUD_MAX_PATH_LENGTH+1];
+	size_t plen;
+	int i, ret = 0;
+
+	// Initializing CRUD interface
+	if( !crudInitialized )
+		crud_init();
+
+	// Checking the name is one path component
+	if( !crudInitialized || name[0] == 0 || strchr( name, '/' ) != NULL ||
+	    strlen( CRUD_SNAPSHOT_DIR ) + strlen( name ) + 1 >= CRUD_MAX_PATH_LENGTH )
+		return -1;
+	snprintf( prefix, sizeof(prefix), "%s%s/", CRUD_SNAPSHOT_DIR, name );
+	plen = strlen( prefix );
+
+	// Every name must still fit under the snapshot directory
+	if( crud_table_seek( &cursor, "" ) )
+		return -1;
+	while( (entry = crud_table_next( &cursor )) != NULL ) {
+		if( strncmp( entry->filename, CRUD_SNAPSHOT_DIR, strlen( CRUD_SNAPSHOT_DIR ) ) &&
+		    plen + strlen( entry->filename ) >= CRUD_MAX_PATH_LENGTH ) {
+			CRUD_LOG( LOG_ERROR_LEVEL, "CRUD snapshot: [%s] is too long to snapshot.", entry->filename );
+			return -1;
+		}
+	}
+
+	// The snapshot captures the buffered data too
+	for( i = 0; i < crud_open_slots; i++ ) {
+		if( (crud_open_hot[i].flags & CRUD_OPEN_HANDLE) && crud_flush( i ) )
+			return -1;
+	}
+
+	// Making the snapshot directory, which must be new (the snapshot is
+	// committed whole, once every file is in it)
+	crud_commit_held = 1;
+	snprintf( path, sizeof(path), "%.*s", (int)strlen( CRUD_SNAPSHOT_DIR ) - 1, CRUD_SNAPSHOT_DIR );
+	if( crud_table_find( CRUD_SNAPSHOT_DIR ) == NULL && crud_mkdir( path ) )
+		ret = -1;
+	snprintf( path, sizeof(path), "%.*s", (int)plen - 1, prefix );
+	if( ret == 0 && crud_mkdir( path ) )
+		ret = -1;
+
+	// Cloning every entry but the snapshots (each clone moves the cursor,
+	// so it seeks again past the entry done, or past the snapshots)
+	if( ret == 0 && crud_table_seek( &cursor, "" ) )
+		ret = -1;
+	while( ret == 0 && (entry = crud_table_next( &cursor )) != NULL ) {
+		if( !strncmp( entry->filename, CRUD_SNAPSHOT_DIR, strlen( CRUD_SNAPSHOT_DIR ) ) ) {
+			snprintf( next, sizeof(next), "%.*s0", (int)strlen( CRUD_SNAPSHOT_DIR ) - 1, CRUD_SNAPSHOT_DIR );
+		} else {
+			copy = *entry;
+			if( snprintf( path, sizeof(path), "%s%s", prefix, copy.filename ) >= (int)sizeof(path) ) {
+				ret = -1;
+				break;
+			}
+			if( copy.flags & CRUD_FILE_DIRECTORY ) {
+				if( (entry = crud_table_insert( path )) == NULL ) {
+					ret = -1;
+					break;
+				}
+				dir = *entry;
+				dir.flags = CRUD_FILE_DIRECTORY | CRUD_FILE_FROZEN;
+				if( crud_table_update( &dir ) ) {
+					ret = -1;
+					break;
+				}
+			} else if( !(copy.flags & CRUD_FILE_SCRATCH) && crud_clone_entry( &copy, path, CRUD_FILE_FROZEN ) ) {
+				ret = -1;
+				break;
+			}
+			snprintf( next, sizeof(next), "%s\x01", copy.filename );
+		}
+		if( crud_table_seek( &cursor, next ) )
+			ret = -1;
+	}
+	crud_commit_held = 0;
+	return( crud_commit( ret ) );
+}
+
+// Module local methods
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : crud_io_request
+// Description  : Sends a request to the object store through the storage
+//                backend, counting it (the file table sends its requests
+//                here too) and tracing it
+//
+// Inputs       : request - the crud request to send
+//                buf - the buffer for the request
+// Outputs      : the crud response
+
+CrudResponse crud_io_request( CrudRequest request, void *buf ) {
+
+	// Local variables
+	CrudResponse response;
+	CRUD_REQUEST_TYPES req;
+	uint32_t length;
+	uint8_t flags, res;
+	CrudOID oid;
+
+	// Sending it with the backend lock, counting the requests that change objects
+	// (and dropping them from the warm cache)
+	deconstruct_crud_request( request, &oid, &req, &length, &flags, &res );
+	pthread_mutex_lock( &crud_backend_mutex );
+	crud_io_bus_requests++;
+	if( req != CRUD_READ ) {
+		crud_io_changes++;
+		crud_heatmap_forget( oid );
+	}
+
+	// Tracing the request as a span of the call that sent it
+	CRUD_TRACE_BEGIN( "bus", CRUD_REQUEST_TYPE_LABLES[req], "{\"oid\":%u,\"length\":%u}", oid, length );
+	response = crud_backend->request( crud_backend, request, buf );
+	CRUD_TRACE_END();
+	pthread_mutex_unlock( &crud_backend_mutex );
+	return( response );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : crud_io_batch
+// Description  : Sends a list of requests to the object store at once
+//                through the storage backend, counted and traced like
+//                crud_io_request
+//
+// Inputs       : requests - the crud requests to send
+//                bufs - the buffer of each request
+//                responses - the crud response of each request (out)
+//                count - the number of requests
+// Outputs      : 0 if every request succeeded, -1 otherwise
+
+int crud_io_batch( CrudRequest *requests, void **bufs, CrudResponse *responses, int count ) {
+
+	// Local variables
+	CRUD_REQUEST_TYPES req;
+	uint32_t length;
+	uint8_t flags, res;
+	CrudOID oid;
+	int i, ret;
+
+	// Sending them with the backend lock, counting the requests that change objects
+	// (and dropping them from the warm cache)
+	pthread_mutex_lock( &crud_backend_mutex );
+	crud_io_bus_requests += count;
+	for( i = 0; i < count; i++ ) {
+		deconstruct_crud_request( requests[i], &oid, &req, &length, &flags, &res );
+		if( req != CRUD_READ ) {
+			crud_io_changes++;
+			crud_heatmap_forget( oid );
+		}
+	}
+	CRUD_TRACE_BEGIN( "bus", "batch", "{\"requests\":%d}", count );
+	ret = crud_backend->batch( crud_backend, requests, bufs, responses, count );
+	CRUD_TRACE_END();
+	pthread_mutex_unlock( &crud_backend_mutex );
+	return( ret );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : crud_io_sync
+// Description  : Makes the object store durable as it is now through the
+//                storage backend
+//
+// Inputs       : none
+// Outputs      : 0 if successful, -1 if failure
+
+int crud_io_sync( void ) {
+
+	// Local variables
+	int ret;
+
+	pthread_mutex_lock( &crud_backend_mutex );
+	crud_io_syncs++;
+	CRUD_TRACE_BEGIN( "bus", "sync", NULL );
+	ret = crud_backend->sync( crud_backend );
+	CRUD_TRACE_END();
+	pthread_mutex_unlock( &crud_backend_mutex );
+	return( ret );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : crud_io_lock_init, crud_io_lock, crud_io_unlock
+// Description  : Serialize the callers of the driver.  The state of the
+//                file system (the open files, the table and its journal,
+//                the arena and the backend) is shared, so every interface
+//                function holds one lock; it is recursive because interface
+//                functions call each other (close flushes).
+//
+// Inputs       : none
+// Outputs      : none
+
+static void crud_io_lock_init( void ) {
+
+	// Local variables
+	pthread_mutexattr_t attr;
+
+	// Making the lock recursive
+	pthread_mutexattr_init( &attr );
+	pthread_mutexattr_settype( &attr, PTHREAD_MUTEX_RECURSIVE );
+	pthread_mutex_init( &crud_io_mutex, &attr );
+	pthread_mutexattr_destroy( &attr );
+}
+
+static void crud_io_lock( void ) {
+	pthread_once( &crud_io_mutex_once, crud_io_lock_init );
+	pthread_mutex_lock( &crud_io_mutex );
+	crud_io_depth++;
+}
+
+static void crud_io_unlock( void ) {
+	crud_io_depth--;
+	pthread_mutex_unlock( &crud_io_mutex );
+}
+
+// The interface functions, each the unlocked one under the lock (and in a
+// trace span when tracing)
+#define CRUD_IO_SERIALIZED( type, name, params, args ) \
+	type name params { \
+		type ret; \
+		crud_io_lock(); \
+		CRUD_TRACE_BEGIN( "driver", #name, NULL ); \
+		ret = name##_unlocked args; \
+		CRUD_TRACE_END(); \
+		crud_io_unlock(); \
+		return( ret ); \
+	}
+
+CRUD_IO_SERIALIZED( uint16_t, crud_format, (void), () )
+CRUD_IO_SERIALIZED( uint16_t, crud_mount, (void), () )
+CRUD_IO_SERIALIZED( uint16_t, crud_unmount, (void), () )
+CRUD_IO_SERIALIZED( int16_t, crud_open, (char *path), (path) )
+CRUD_IO_SERIALIZED( int16_t, crud_open_durable, (char *path, CrudDurability durability), (path, durability) )
+CRUD_IO_SERIALIZED( int16_t, crud_close, (int16_t fd), (fd) )
+CRUD_IO_SERIALIZED( int32_t, crud_read, (int16_t fd, void *buf, int32_t count), (fd, buf, count) )
+CRUD_IO_SERIALIZED( int32_t, crud_write, (int16_t fd, void *buf, int32_t count), (fd, buf, count) )
+CRUD_IO_SERIALIZED( int32_t, crud_read_at, (int16_t fd, void *buf, int32_t count, uint32_t offset), (fd, buf, count, offset) )
+CRUD_IO_SERIALIZED( int32_t, crud_write_at, (int16_t fd, void *buf, int32_t count, uint32_t offset), (fd, buf, count, offset) )
+CRUD_IO_SERIALIZED( int16_t, crud_flush, (int16_t fd), (fd) )
+CRUD_IO_SERIALIZED( int16_t, crud_fsync, (int16_t fd), (fd) )
+CRUD_IO_SERIALIZED( int16_t, crud_truncate, (int16_t fd, uint32_t len), (fd, len) )
+CRUD_IO_SERIALIZED( int16_t, crud_reserve, (int16_t fd, uint32_t len), (fd, len) )
+CRUD_IO_SERIALIZED( int32_t, crud_seek, (int16_t fd, uint32_t loc), (fd, loc) )
+CRUD_IO_SERIALIZED( int16_t, crud_mkdir, (char *path), (path) )
+CRUD_IO_SERIALIZED( CrudDirectory *, crud_opendir, (char *path), (path) )
+CRUD_IO_SERIALIZED( CrudDirectoryEntry *, crud_readdir, (CrudDirectory *dir), (dir) )
+CRUD_IO_SERIALIZED( int16_t, crud_closedir, (CrudDirectory *dir), (dir) )
+CRUD_IO_SERIALIZED( int32_t, crud_list, (char *prefix, CrudListFunction fn, void *arg), (prefix, fn, arg) )
+CRUD_IO_SERIALIZED( int16_t, crud_clone, (char *src, char *dst), (src, dst) )
+CRUD_IO_SERIALIZED( int16_t, crud_snapshot, (char *name), (name) )
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : crud_set_durability
+// Description  : Moves a file to a durability class (a snapshot file cannot
+//                move), storing the entry if it changed
+//
+// Inputs       : entry - the entry of the file (a copy held by a handle)
+//                durability - the class (-1 to keep the one it has)
+// Outputs      : 0 if successful, -1 if failure
+
+static int crud_set_durability( CrudFileAllocationType *entry, int32_t durability ) {
+	// Declaring and Initializing variables
+	uint32_t flags = 0;
+
+	// Working out the flags of the class
+	if( durability == -1 )
+		return 0;
+	if( durability == CRUD_DURABILITY_SCRATCH )
+		flags = CRUD_FILE_SCRATCH;
+	else if( durability == CRUD_DURABILITY_SYNC )
+		flags = CRUD_FILE_SYNC;
+	if( (entry->flags & (CRUD_FILE_SCRATCH | CRUD_FILE_SYNC)) == flags )
+		return 0; // already there
+	if( entry->flags & CRUD_FILE_FROZEN )
+		return -1;
+	entry->flags = (entry->flags & ~(CRUD_FILE_SCRATCH | CRUD_FILE_SYNC)) | flags;
+	return( crud_commit( crud_table_update( entry ) ) );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : crud_drop_scratch
+// Description  : Removes the scratch files from the table, closing their
+//                handles.  Only a table with scratch files is walked.
+//
+// Inputs       : objects - nonzero to drop their objects too (at mount,
+//                          after a crash, the objects may be gone)
+// Outputs      : 0 if successful or -1 if failure
+
+static int crud_drop_scratch( int objects ) {
+	// Declaring and Initializing variables
+	CrudFileAllocationType *entry, copy;
+	CrudTableCursor cursor;
+	int i;
+
+	// Closing the handles (their buffered data is dropped with them)
+	if( crud_table_scratch() == 0 )
+		return 0;
+	for( i = 0; i < crud_open_slots; i++ ) {
+		if( (crud_open_hot[i].flags & CRUD_OPEN_HANDLE) && (crud_open_hot[i].flags & CRUD_FILE_SCRATCH) ) {
+			crud_buffer_release( i );
+			crud_readahead_release( i );
+			crud_sparse_release( i );
+			crud_open_forget( i );
+		}
+	}
+
+	// Removing each entry, then seeking to the entry that took its place
+	if( crud_table_seek( &cursor, "" ) )
+		return -1;
+	while( crud_table_scratch() > 0 && (entry = crud_table_next( &cursor )) != NULL ) {
+		if( !(entry->flags & CRUD_FILE_SCRATCH) )
+			continue;
+		copy = *entry;
+		if( (objects && crud_drop_entry( &copy )) || crud_table_remove( copy.filename ) ||
+		    crud_table_seek( &cursor, copy.filename ) )
+			return -1;
+	}
+	CRUD_LOG( LOG_INFO_LEVEL, "... scratch files dropped." );
+	return 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : crud_drop_entry
+// Description  : Drops the objects of a file: its object, and the chunks of a
+//                sparse file
+//
+// Inputs       : entry - the entry of the file
+// Outputs      : 0 if successful or -1 if failure
+
+static int crud_drop_entry( const CrudFileAllocationType *entry ) {
+	// Declaring and Initializing variables
+	CrudOID *chunks;
+	uint32_t slots, i;
+	int ret = 0;
+
+	// Directories have no object
+	if( (entry->flags & CRUD_FILE_DIRECTORY) || entry->object_id == CRUD_NO_OBJECT )
+		return 0;
+
+	// The chunks named by the map of a sparse file go first
+	if( entry->flags & CRUD_FILE_SPARSE ) {
+		slots = entry->capacity / CRUD_SPARSE_CHUNK_SIZE;
+		chunks = (CrudOID*)calloc( slots, sizeof(CrudOID) );
+		if( crud_io_request( create_crudrequest( entry->object_id, CRUD_READ, slots * sizeof(CrudOID), 0 ), chunks ) & 1 ) {
+			free( chunks );
+			return -1; // crud read request failed
+		}
+		for( i = 0; i < slots; i++ ) {
+			if( chunks[i] != CRUD_NO_OBJECT && crud_drop_object( chunks[i], CRUD_SPARSE_CHUNK_SIZE ) )
+				ret = -1;
+		}
+		free( chunks );
+		if( crud_drop_object( entry->object_id, slots * sizeof(CrudOID) ) )
+			ret = -1;
+	} else if( crud_drop_object( entry->object_id, entry->capacity ) )
+		ret = -1;
+	return ret;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : crud_open_grow
+// Description  : Doubles the open file table
+//
+// Inputs       : none
+// Outputs      : the first new file handle or -1 if the table is at its limit
+
+static int16_t crud_open_grow( void ) {
+	// Declaring and Initializing variables
+	int32_t slots = (crud_open_slots == 0) ? CRUD_OPEN_FILES_INITIAL : crud_open_slots * 2;
+	int32_t first = crud_open_slots;
+	CrudOpenHot *hot;
+	CrudOpenFile *files;
+	char (*names)[CRUD_MAX_PATH_LENGTH];
+	int16_t *index;
+	int32_t i;
+
+	// Checking the handles still fit in a file descriptor
+	if( slots > CRUD_MAX_OPEN_FILES )
+		slots = CRUD_MAX_OPEN_FILES;
+	if( slots <= crud_open_slots )
+		return -1;
+
+	// Adding the new handles, all closed
+	if( (hot = realloc( crud_open_hot, sizeof(CrudOpenHot)*slots )) != NULL )
+		crud_open_hot = hot;
+	if( (files = realloc( crud_open_files, sizeof(CrudOpenFile)*slots )) != NULL )
+		crud_open_files = files;
+	if( (names = realloc( crud_open_names, CRUD_MAX_PATH_LENGTH*slots )) != NULL )
+		crud_open_names = names;
+	if( hot == NULL || files == NULL || names == NULL ||
+	    (index = calloc( slots*2, sizeof(int16_t) )) == NULL )
+		return -1;
+	memset( &hot[first], 0, sizeof(CrudOpenHot)*(slots - first) );
+	memset( &files[first], 0, sizeof(CrudOpenFile)*(slots - first) );
+
+	// Indexing the open files again in the larger index
+	free( crud_open_index );
+	crud_open_index = index;
+	crud_open_slots = slots;
+	for( i = 0; i < first; i++ ) {
+		if( hot[i].flags & CRUD_OPEN_HANDLE )
+			crud_open_intern( i, names[i] );
+	}
+	return( first );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : crud_open_hash
+// Description  : Hashes a name for the index of the open files (FNV-1a)
+//
+// Inputs       : name - the name
+// Outputs      : the hash
+
+static uint32_t crud_open_hash( const char *name ) {
+	// Declaring and Initializing variables
+	uint32_t hash = 2166136261u;
+
+	while( *name )
+		hash = (hash ^ (uint8_t)*name++) * 16777619u;
+	return( hash );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : crud_open_lookup
+// Description  : Finds the handle a file is open on
+//
+// Inputs       : name - the name of the file
+// Outputs      : the file handle or -1 if the file is not open
+
+static int16_t crud_open_lookup( const char *name ) {
+	// Declaring and Initializing variables
+	uint32_t mask = crud_open_slots*2 - 1, i;
+
+	if( crud_open_slots == 0 )
+		return -1;
+	for( i = crud_open_hash( name ) & mask; crud_open_index[i] != 0; i = (i + 1) & mask ) {
+		if( !strcmp( name, crud_open_names[crud_open_index[i] - 1] ) )
+			return( crud_open_index[i] - 1 );
+	}
+	return -1;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : crud_open_intern
+// Description  : Puts the name of a newly opened file in the name store and
+//                the index (the index has twice the slots of the handles, so
+//                there is always room)
+//
+// Inputs       : fd - the file handle
+//                name - the name of the file
+// Outputs      : none
+
+static void crud_open_intern( int16_t fd, const char *name ) {
+	// Declaring and Initializing variables
+	uint32_t mask = crud_open_slots*2 - 1, i;
+
+	if( crud_open_names[fd] != name )
+		strncpy( crud_open_names[fd], name, CRUD_MAX_PATH_LENGTH ); // zero filled, like the table entries
+	for( i = crud_open_hash( name ) & mask; crud_open_index[i] != 0; i = (i + 1) & mask );
+	crud_open_index[i] = fd + 1;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : crud_open_forget
+// Description  : Closes a handle, taking its name out of the index (the
+//                entries after it in the probe run move back into the gap)
+//
+// Inputs       : fd - the file handle
+// Outputs      : none
+
+static void crud_open_forget( int16_t fd ) {
+	// Declaring and Initializing variables
+	uint32_t mask = crud_open_slots*2 - 1, i, j, home;
+
+	crud_open_hot[fd].flags = 0;
+	crud_open_hot[fd].position = 0;
+	for( i = crud_open_hash( crud_open_names[fd] ) & mask; crud_open_index[i] != fd + 1; i = (i + 1) & mask )
+		if( crud_open_index[i] == 0 )
+			return; // not indexed
+	for( j = (i + 1) & mask; crud_open_index[j] != 0; j = (j + 1) & mask ) {
+		home = crud_open_hash( crud_open_names[crud_open_index[j] - 1] ) & mask;
+		if( ((j - home) & mask) >= ((j - i) & mask) ) {
+			crud_open_index[i] = crud_open_index[j];
+			i = j;
+		}
+	}
+	crud_open_index[i] = 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : crud_open_touch
+// Description  : Tells the heatmap the uses of an open file since it was last
+//                told, with the object the next mount would read for it
+//                (none for a sparse file, nothing for a scratch one)
+//
+// Inputs       : fd - the file handle
+// Outputs      : none
+
+static void crud_open_touch( int16_t fd ) {
+	if( (crud_open_hot[fd].flags & CRUD_OPEN_HANDLE) && !(crud_open_hot[fd].flags & CRUD_FILE_SCRATCH) )
+		crud_heatmap_touch( crud_open_names[fd], crud_open_hot[fd].object_id,
+				(crud_open_hot[fd].flags & CRUD_FILE_SPARSE) ? 0 : crud_open_files[fd].capacity, crud_open_files[fd].uses );
+	crud_open_files[fd].uses = 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : crud_open_entry
+// Description  : Rebuilds the table entry of an open file from its parts
+//
+// Inputs       : fd - the file handle
+//                entry - the entry to fill
+// Outputs      : none
+
+static void crud_open_entry( int16_t fd, CrudFileAllocationType *entry ) {
+	memcpy( entry->filename, crud_open_names[fd], CRUD_MAX_PATH_LENGTH );
+	entry->object_id = crud_open_hot[fd].object_id;
+	entry->length = crud_open_hot[fd].length;
+	entry->capacity = crud_open_files[fd].capacity;
+	entry->flags = crud_open_hot[fd].flags & ~CRUD_OPEN_HANDLE;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : crud_open_update
+// Description  : Stores the entry of an open file in the table
+//
+// Inputs       : fd - the file handle
+// Outputs      : 0 if successful, -1 if failure
+
+static int crud_open_update( int16_t fd ) {
+	// Declaring and Initializing variables
+	CrudFileAllocationType entry;
+
+	crud_open_entry( fd, &entry );
+	return( crud_table_update( &entry ) );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : crud_dir_exists
+// Description  : Checks a directory exists, made by crud_mkdir or implied by
+//                the name of a file in it
+//
+// Inputs       : prefix - the path of the directory with a trailing slash
+// Outputs      : 1 if the directory exists, 0 otherwise
+
+static int crud_dir_exists( const char *prefix ) {
+	// Declaring and Initializing variables
+	CrudFileAllocationType *entry;
+	CrudTableCursor cursor;
+
+	// Any name with the prefix will do, the first is the closest
+	if( crud_table_seek( &cursor, prefix ) )
+		return 0;
+	entry = crud_table_next( &cursor );
+	return( entry != NULL && !strncmp( entry->filename, prefix, strlen( prefix ) ) );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : crud_resize
+// Description  : Replaces the object of a file with one of another size,
+//                keeping the data of the file that fits and zeroing the rest
+//                (the write buffer must be empty)
+//
+// Inputs       : fd - the file descriptor of the file
+//                capacity - the size of the new object
+// Outputs      : 0 if successful or -1 if failure
+
+static int crud_resize( int16_t fd, uint32_t capacity ) {
+	// Declaring and Initializing variables
+	CrudRequest request;
+	CrudResponse response;
+	uint32_t keep, size; // bytes of data kept, size of the image buffer
+	char *image;
+
+	// the image must hold both the old and the new object
+	keep = (crud_open_hot[fd].length < capacity) ? crud_open_hot[fd].length : capacity;
+	size = (crud_open_files[fd].capacity > capacity) ? crud_open_files[fd].capacity : capacity;
+	image = (char*)crud_arena_alloc(size);
+	if( keep > 0 ) {
+		request = create_crudrequest( crud_open_hot[fd].object_id, CRUD_READ, crud_open_files[fd].capacity, 0 );
+		response = crud_io_request( request, image );
+		if( response & 1 ) {
+			crud_arena_free(image);
+			return -1; // crud read request failed
+		}
+	}
+	memset( &image[keep], 0, capacity - keep );
+
+	// swapping the objects
+	response = crud_replace_object( crud_open_hot[fd].object_id, crud_open_files[fd].capacity, capacity, image );
+	crud_arena_free(image);
+	if( extract_crudresponse( response, fd ) )
+		return -1; // crud bus request failed
+	crud_open_files[fd].capacity = capacity;
+	return 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : crud_replace_object
+// Description  : Moves a file to a new object holding buf (one given up
+//                earlier if the recycling pool has one of the size), giving
+//                back the old object unless a clone still uses it (with a
+//                journal, once the move is committed)
+//
+// Inputs       : oid - the object the file leaves
+//                old - the size of that object
+//                size - the size of the new object
+//                buf - the contents of the new object
+// Outputs      : the response of the create
+
+static CrudResponse crud_replace_object( CrudOID oid, uint32_t old, uint32_t size, void *buf ) {
+	// Declaring and Initializing variables
+	CrudResponse response;
+
+	// the new object first, then the old one stays with its other users or
+	// is given back
+	response = crud_recycle_create( size, buf );
+	if( response & 1 )
+		return response;
+	if( crud_table_refs( oid ) > 1 )
+		crud_table_unref( oid );
+	else if( crud_journal_free( oid, old ) )
+		response |= 1;
+	return response;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : crud_drop_object
+// Description  : Drops the use of an object by a file, giving the object
+//                back unless a clone still uses it
+//
+// Inputs       : oid - the object
+//                size - its size
+// Outputs      : 0 if successful or -1 if failure
+
+static int crud_drop_object( CrudOID oid, uint32_t size ) {
+	// the last user gives the object back, once the table no longer names it
+	if( crud_table_unref( oid ) > 0 )
+		return 0;
+	return( crud_journal_free( oid, size ) );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : crud_commit
+// Description  : Ends an operation that changed the file table, committing
+//                the journal if a group is due (unless an outer operation
+//                holds the commit)
+//
+// Inputs       : ret - the result of the operation
+// Outputs      : ret, or -1 if the commit fails
+
+static int16_t crud_commit( int16_t ret ) {
+	if( ret == 0 && !crud_commit_held && crud_table_commit( 0 ) )
+		return -1;
+	return ret;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : crud_clone_entry
+// Description  : Adds a file sharing the objects of an entry.  A file in one
+//                object shares it, a sparse file gets its own copy of the
+//                chunk map and shares the chunks.
+//
+// Inputs       : src - the entry of the file cloned (flushed)
+//                dst - the name of the new file (must not exist)
+//                flags - entry flags added to the new file
+// Outputs      : 0 if successful or -1 if failure
+
+static int crud_clone_entry( const CrudFileAllocationType *src, const char *dst, uint32_t flags ) {
+	// Declaring and Initializing variables
+	CrudFileAllocationType *entry, copy;
+	CrudOID object = src->object_id, *chunks = NULL;
+	CrudResponse response;
+	uint32_t slots = 0, i, shared = 0;
+	int ret = 0;
+
+	// Sharing the data objects
+	if( src->flags & CRUD_FILE_SPARSE ) {
+		slots = src->capacity / CRUD_SPARSE_CHUNK_SIZE;
+		chunks = (CrudOID*)calloc( slots + 1, sizeof(CrudOID) );
+		response = crud_io_request( create_crudrequest( src->object_id, CRUD_READ, slots * sizeof(CrudOID), 0 ), chunks );
+		if( response & 1 ) {
+			free( chunks );
+			return -1; // crud read request failed
+		}
+		for( shared = 0; shared < slots && ret == 0; shared++ ) {
+			if( chunks[shared] != CRUD_NO_OBJECT )
+				ret = crud_table_ref( chunks[shared] );
+		}
+		if( ret == 0 ) {
+			response = crud_io_request( create_crudrequest( 0, CRUD_CREATE, slots * sizeof(CrudOID), 0 ), chunks );
+			object = (CrudOID)(response >> 32);
+			ret = (response & 1) ? -1 : 0;
+		} else shared--; // the failed chunk was not shared
+	} else ret = crud_table_ref( src->object_id );
+
+	// Adding the entry, giving the objects back if that fails
+	if( ret == 0 && (entry = crud_table_insert( dst )) != NULL ) {
+		copy = *entry;
+		copy.object_id = object;
+		copy.length = src->length;
+		copy.capacity = src->capacity;
+		copy.flags = (src->flags & ~CRUD_FILE_FROZEN) | flags;
+		free( chunks );
+		return( crud_table_update( &copy ) );
+	}
+	if( src->flags & CRUD_FILE_SPARSE ) {
+		for( i = 0; i < shared; i++ ) {
+			if( chunks[i] != CRUD_NO_OBJECT )
+				crud_table_unref( chunks[i] );
+		}
+		if( ret == 0 )
+			crud_drop_object( object, slots * sizeof(CrudOID) );
+	} else if( ret == 0 )
+		crud_table_unref( src->object_id );
+	free( chunks );
+	return -1;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : crud_sparse_map
+// Description  : Reads the chunk map of a sparse file, if not read yet.  The
+//                map object holds the OID of each chunk of the file, with
+//                CRUD_NO_OBJECT for the holes.
+//
+// Inputs       : fd - the file descriptor of the file
+// Outputs      : 0 if successful or -1 if failure
+
+static int crud_sparse_map( int16_t fd ) {
+	// Declaring and Initializing variables
+	CrudOpenFile *of = &crud_open_files[fd];
+	CrudOpenHot *oh = &crud_open_hot[fd];
+	CrudRequest request;
+	CrudResponse response;
+
+	// The map is sized by the capacity, one chunk per slot
+	if( of->chunks != NULL )
+		return 0;
+	of->slots = of->capacity / CRUD_SPARSE_CHUNK_SIZE;
+	of->chunks = (CrudOID*)calloc( of->slots + 1, sizeof(CrudOID) );
+	of->mapDirty = 0;
+	request = create_crudrequest( oh->object_id, CRUD_READ, of->slots * sizeof(CrudOID), 0 );
+	response = crud_io_request( request, of->chunks );
+	if( response & 1 ) {
+		crud_sparse_release( fd );
+		return -1; // crud read request failed
+	}
+	return 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : crud_sparse_slots
+// Description  : Grows the chunk map of a sparse file to cover a length,
+//                doubling it so a growing file rarely replaces its map
+//
+// Inputs       : fd - the file descriptor of the file
+//                length - the length to cover
+// Outputs      : 0 if successful or -1 if failure
+
+static int crud_sparse_slots( int16_t fd, uint32_t length ) {
+	// Declaring and Initializing variables
+	CrudOpenFile *of = &crud_open_files[fd];
+	uint32_t need = (length + CRUD_SPARSE_CHUNK_SIZE - 1) / CRUD_SPARSE_CHUNK_SIZE;
+	uint32_t slots;
+	CrudOID *chunks;
+
+	// Checking the map is there and too small
+	if( crud_sparse_map( fd ) )
+		return -1;
+	if( need <= of->slots )
+		return 0;
+
+	// Adding empty slots (holes)
+	slots = (of->slots * 2 > need) ? of->slots * 2 : need;
+	if( slots > CRUD_SPARSE_MAX_CHUNKS )
+		slots = CRUD_SPARSE_MAX_CHUNKS;
+	if( (chunks = realloc( of->chunks, (slots + 1) * sizeof(CrudOID) )) == NULL )
+		return -1;
+	memset( &chunks[of->slots], 0, (slots - of->slots) * sizeof(CrudOID) );
+	of->chunks = chunks;
+	of->slots = slots;
+	of->mapDirty = 1;
+	return 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : crud_sparse_write_map
+// Description  : Writes a changed chunk map back to its object, replacing
+//                the object when the map grew (a map is never shared)
+//
+// Inputs       : fd - the file descriptor of the file
+// Outputs      : 0 if successful or -1 if failure
+
+static int crud_sparse_write_map( int16_t fd ) {
+	// Declaring and Initializing variables
+	CrudOpenFile *of = &crud_open_files[fd];
+	CrudOpenHot *oh = &crud_open_hot[fd];
+	CrudRequest request;
+	CrudResponse response;
+
+	// Nothing to do for an unchanged map
+	if( !of->mapDirty )
+		return 0;
+
+	// Same size, update in place, else swap the objects in one batch
+	if( of->slots == of->capacity / CRUD_SPARSE_CHUNK_SIZE ) {
+		request = create_crudrequest( oh->object_id, CRUD_UPDATE, of->slots * sizeof(CrudOID), 0 );
+		response = crud_io_request( request, of->chunks );
+	} else {
+		response = crud_replace_object( oh->object_id, (of->capacity / CRUD_SPARSE_CHUNK_SIZE) * sizeof(CrudOID), of->slots * sizeof(CrudOID), of->chunks );
+	}
+	if( extract_crudresponse( response, fd ) )
+		return -1; // crud bus request failed
+	of->capacity = of->slots * CRUD_SPARSE_CHUNK_SIZE;
+	of->mapDirty = 0;
+	return 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : crud_sparse_convert
+// Description  : Turns a file into a sparse file, moving each chunk of its
+//                object that holds data into a chunk object (chunks of
+//                zeros become holes).  The write buffer must be empty.
+//
+// Inputs       : fd - the file descriptor of the file
+// Outputs      : 0 if successful or -1 if failure
+
+static int crud_sparse_convert( int16_t fd ) {
+	// Declaring and Initializing variables
+	CrudOpenFile *of = &crud_open_files[fd];
+	CrudOpenHot *oh = &crud_open_hot[fd];
+	CrudRequest request;
+	CrudResponse response;
+	CrudOID object = oh->object_id;
+	uint32_t c, lo, n, i;
+	char *image, *chunk;
+
+	// Reading the object, the map gets a slot per chunk of the file
+	image = (char*)crud_arena_alloc( of->capacity );
+	if( oh->length > 0 ) {
+		request = create_crudrequest( object, CRUD_READ, of->capacity, 0 );
+		response = crud_io_request( request, image );
+		if( response & 1 ) {
+			crud_arena_free( image );
+			return -1; // crud read request failed
+		}
+	}
+	of->slots = (oh->length + CRUD_SPARSE_CHUNK_SIZE - 1) / CRUD_SPARSE_CHUNK_SIZE;
+	if( of->slots == 0 )
+		of->slots = 1;
+	of->chunks = (CrudOID*)calloc( of->slots + 1, sizeof(CrudOID) );
+
+	// Copying out every chunk with a nonzero byte
+	chunk = (char*)crud_arena_alloc( CRUD_SPARSE_CHUNK_SIZE );
+	for( c = 0; c * CRUD_SPARSE_CHUNK_SIZE < oh->length; c++ ) {
+		lo = c * CRUD_SPARSE_CHUNK_SIZE;
+		n = (oh->length - lo < CRUD_SPARSE_CHUNK_SIZE) ? oh->length - lo : CRUD_SPARSE_CHUNK_SIZE;
+		for( i = 0; i < n && image[lo+i] == 0; i++ );
+		if( i == n )
+			continue; // all zeros, a hole
+		memcpy( chunk, &image[lo], n );
+		memset( &chunk[n], 0, CRUD_SPARSE_CHUNK_SIZE - n );
+		response = crud_recycle_create( CRUD_SPARSE_CHUNK_SIZE, chunk );
+		if( response & 1 ) {
+			crud_arena_free( chunk );
+			crud_arena_free( image );
+			return -1; // crud create request failed
+		}
+		of->chunks[c] = (CrudOID)(response >> 32);
+	}
+	crud_arena_free( chunk );
+	crud_arena_free( image );
+
+	// The map replaces the object of the file
+	request = create_crudrequest( 0, CRUD_CREATE, of->slots * sizeof(CrudOID), 0 );
+	response = crud_io_request( request, of->chunks );
+	if( extract_crudresponse( response, fd ) )
+		return -1; // crud create request failed
+	if( crud_drop_object( object, of->capacity ) )
+		return -1; // crud delete request failed
+	of->capacity = of->slots * CRUD_SPARSE_CHUNK_SIZE;
+	oh->flags |= CRUD_FILE_SPARSE;
+	of->mapDirty = 0;
+	of->ra.length = 0;
+	return( crud_open_update( fd ) );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : crud_sparse_read
+// Description  : Reads a range of a sparse file, chunk by chunk.  Holes are
+//                zeros without a request, and the last chunk read is kept in
+//                the readahead window for the reads that follow.
+//
+// Inputs       : fd - the file descriptor of the file
+//                buf - the buffer to place the bytes into
+//                offset - the file offset of the read (within the file)
+//                count - the number of bytes to read
+// Outputs      : 0 if successful or -1 if failure
+
+static int crud_sparse_read( int16_t fd, char *buf, uint32_t offset, uint32_t count ) {
+	// Declaring and Initializing variables
+	CrudOpenFile *of = &crud_open_files[fd];
+	CrudOpenHot *oh = &crud_open_hot[fd];
+	CrudRequest request;
+	CrudResponse response;
+	uint32_t c, lo, n;
+	char *chunk = NULL;
+
+	// Walking the chunks in the range
+	if( crud_sparse_map( fd ) )
+		return -1;
+	while( count > 0 ) {
+		c = offset / CRUD_SPARSE_CHUNK_SIZE;
+		lo = c * CRUD_SPARSE_CHUNK_SIZE;
+		n = (lo + CRUD_SPARSE_CHUNK_SIZE - offset < count) ? lo + CRUD_SPARSE_CHUNK_SIZE - offset : count;
+		if( c >= of->slots || of->chunks[c] == CRUD_NO_OBJECT ) {
+			memset( buf, 0, n );
+		} else {
+			if( chunk == NULL )
+				chunk = (char*)crud_arena_alloc( CRUD_SPARSE_CHUNK_SIZE );
+			request = create_crudrequest( of->chunks[c], CRUD_READ, CRUD_SPARSE_CHUNK_SIZE, 0 );
+			response = crud_io_request( request, chunk );
+			if( response & 1 ) {
+				crud_arena_free( chunk );
+				return -1; // crud read request failed
+			}
+			memcpy( buf, &chunk[offset - lo], n );
+
+			// keeping the chunk while nothing in the file is buffered
+			if( of->wb.nextents == 0 ) {
+				if( of->ra.data == NULL )
+					of->ra.data = (char*)crud_arena_alloc( CRUD_READAHEAD_MAX_WINDOW );
+				of->ra.offset = lo;
+				of->ra.length = (oh->length - lo < CRUD_SPARSE_CHUNK_SIZE) ? oh->length - lo : CRUD_SPARSE_CHUNK_SIZE;
+				memcpy( of->ra.data, chunk, of->ra.length );
+			}
+		}
+		buf += n;
+		offset += n;
+		count -= n;
+	}
+	crud_arena_free( chunk );
+	return 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : crud_sparse_flush
+// Description  : Writes the buffered extents of a sparse file into the chunks
+//                they touch, creating the chunks of holes written to
+//
+// Inputs       : fd - the file descriptor of the file
+//                newLength - the length of the file after the flush
+// Outputs      : 0 if successful or -1 if failure
+
+static int crud_sparse_flush( int16_t fd, uint32_t newLength ) {
+	// Declaring and Initializing variables
+	CrudOpenFile *of = &crud_open_files[fd];
+	CrudWriteBuffer *wb = &of->wb;
+	CrudWriteExtent *ext;
+	CrudRequest request;
+	CrudResponse response;
+	uint32_t c, lo, hi, keep, s, e;
+	int i = 0, j, reread;
+	char *chunk;
+
+	// The map must cover the new length
+	if( crud_sparse_slots( fd, newLength ) )
+		return -1;
+	chunk = (char*)crud_arena_alloc( CRUD_SPARSE_CHUNK_SIZE );
+	c = wb->extents[0].offset / CRUD_SPARSE_CHUNK_SIZE;
+	while( i < wb->nextents ) {
+		// the stored bytes of the chunk are kept unless one extent covers them
+		lo = c * CRUD_SPARSE_CHUNK_SIZE;
+		hi = lo + CRUD_SPARSE_CHUNK_SIZE;
+		keep = (wb->stored_length > lo) ? ((wb->stored_length < hi) ? wb->stored_length : hi) : lo;
+		reread = (of->chunks[c] != CRUD_NO_OBJECT && keep > lo);
+		for( j = i; j < wb->nextents && wb->extents[j].offset < hi; j++ ) {
+			ext = &wb->extents[j];
+			if( ext->offset <= lo && ext->offset + ext->length >= keep )
+				reread = 0;
+		}
+		if( reread ) {
+			request = create_crudrequest( of->chunks[c], CRUD_READ, CRUD_SPARSE_CHUNK_SIZE, 0 );
+			response = crud_io_request( request, chunk );
+			if( response & 1 ) {
+				crud_arena_free( chunk );
+				return -1; // crud read request failed
+			}
+		} else memset( chunk, 0, CRUD_SPARSE_CHUNK_SIZE );
+
+		// laying the extents over the chunk
+		for( j = i; j < wb->nextents && wb->extents[j].offset < hi; j++ ) {
+			ext = &wb->extents[j];
+			s = (ext->offset > lo) ? ext->offset : lo;
+			e = (ext->offset + ext->length < hi) ? ext->offset + ext->length : hi;
+			memcpy( &chunk[s - lo], &ext->data[s - ext->offset], e - s );
+		}
+
+		// a hole written to gets its chunk object, a shared chunk a copy
+		if( of->chunks[c] == CRUD_NO_OBJECT || crud_table_refs( of->chunks[c] ) > 1 ) {
+			response = crud_recycle_create( CRUD_SPARSE_CHUNK_SIZE, chunk );
+			if( !(response & 1) ) {
+				if( of->chunks[c] != CRUD_NO_OBJECT )
+					crud_table_unref( of->chunks[c] );
+				of->chunks[c] = (CrudOID)(response >> 32);
+				of->mapDirty = 1;
+			}
+		} else {
+			request = create_crudrequest( of->chunks[c], CRUD_UPDATE, CRUD_SPARSE_CHUNK_SIZE, 0 );
+			response = crud_io_request( request, chunk );
+		}
+		if( response & 1 ) {
+			crud_arena_free( chunk );
+			return -1; // crud bus request failed
+		}
+
+		// moving on to the next chunk with buffered data
+		while( i < wb->nextents && wb->extents[i].offset + wb->extents[i].length <= hi )
+			i++;
+		if( i < wb->nextents )
+			c = (wb->extents[i].offset / CRUD_SPARSE_CHUNK_SIZE > c + 1) ? wb->extents[i].offset / CRUD_SPARSE_CHUNK_SIZE : c + 1;
+	}
+	crud_arena_free( chunk );
+	return( crud_sparse_write_map( fd ) );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : crud_sparse_truncate
+// Description  : Sets the length of a sparse file.  Growing adds a hole,
+//                shrinking drops the chunks past the end and zeros the tail
+//                of the last one (copying it if shared).  The write buffer
+//                must be empty.
+//
+// Inputs       : fd - the file descriptor of the file
+//                len - the new length of the file
+// Outputs      : 0 if successful or -1 if failure
+
+static int crud_sparse_truncate( int16_t fd, uint32_t len ) {
+	// Declaring and Initializing variables
+	CrudOpenFile *of = &crud_open_files[fd];
+	CrudOpenHot *oh = &crud_open_hot[fd];
+	CrudRequest request;
+	CrudResponse response;
+	uint32_t c, first;
+	char *chunk;
+
+	// The map must cover the new length
+	if( crud_sparse_slots( fd, len ) )
+		return -1;
+
+	// Dropping whole chunks past the new end
+	first = (len + CRUD_SPARSE_CHUNK_SIZE - 1) / CRUD_SPARSE_CHUNK_SIZE;
+	for( c = first; c < of->slots; c++ ) {
+		if( of->chunks[c] != CRUD_NO_OBJECT ) {
+			if( crud_drop_object( of->chunks[c], CRUD_SPARSE_CHUNK_SIZE ) )
+				return -1; // crud delete request failed
+			of->chunks[c] = CRUD_NO_OBJECT;
+			of->mapDirty = 1;
+		}
+	}
+
+	// Zeroing the tail of a chunk the new end falls in
+	c = len / CRUD_SPARSE_CHUNK_SIZE;
+	if( len < oh->length && len % CRUD_SPARSE_CHUNK_SIZE && of->chunks[c] != CRUD_NO_OBJECT ) {
+		chunk = (char*)crud_arena_alloc( CRUD_SPARSE_CHUNK_SIZE );
+		request = create_crudrequest( of->chunks[c], CRUD_READ, CRUD_SPARSE_CHUNK_SIZE, 0 );
+		response = crud_io_request( request, chunk );
+		if( !(response & 1) ) {
+			memset( &chunk[len % CRUD_SPARSE_CHUNK_SIZE], 0, CRUD_SPARSE_CHUNK_SIZE - len % CRUD_SPARSE_CHUNK_SIZE );
+			if( crud_table_refs( of->chunks[c] ) > 1 ) {
+				response = crud_recycle_create( CRUD_SPARSE_CHUNK_SIZE, chunk );
+				if( !(response & 1) ) {
+					crud_table_unref( of->chunks[c] );
+					of->chunks[c] = (CrudOID)(response >> 32);
+					of->mapDirty = 1;
+				}
+			} else {
+				request = create_crudrequest( of->chunks[c], CRUD_UPDATE, CRUD_SPARSE_CHUNK_SIZE, 0 );
+				response = crud_io_request( request, chunk );
+			}
+		}
+		crud_arena_free( chunk );
+		if( response & 1 )
+			return -1; // crud bus request failed
+	}
+	return( crud_sparse_write_map( fd ) );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : crud_sparse_release
+// Description  : Frees the chunk map of a file (it is read again when used)
+//
+// Inputs       : fd - the file descriptor of the file
+// Outputs      : none
+
+static void crud_sparse_release( int16_t fd ) {
+	free( crud_open_files[fd].chunks );
+	crud_open_files[fd].chunks = NULL;
+	crud_open_files[fd].slots = 0;
+	crud_open_files[fd].mapDirty = 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : crud_buffer_write
+// Description  : Merges a write into the write buffer of a file, joining it
+//                with any extents it overlaps or touches.  The buffer is
+//                flushed when it runs out of room.
+//
+// Inputs       : fd - the file descriptor of the file written
+//                buf - the data written
+//                offset - the file offset of the write
+//                count - the number of bytes written
+// Outputs      : 0 if successful or -1 if failure
+
+static int crud_buffer_write( int16_t fd, char *buf, uint32_t offset, uint32_t count ) {
+	// Declaring and Initializing variables
+	CrudWriteBuffer *wb = &crud_open_files[fd].wb;
+	CrudWriteExtent *ext;
+	uint32_t lo, hi; // the file range covered after the merge
+	char *data;
+	int first, last, i;
+
+	// Setting up the buffer on the first write to the file
+	if( wb->arena == NULL ) {
+		wb->arena = (char*)crud_arena_alloc(CRUD_WRITE_BUFFER_SIZE);
+		wb->extents = (CrudWriteExtent*)crud_arena_alloc(sizeof(CrudWriteExtent)*CRUD_WRITE_BUFFER_EXTENTS);
+		wb->used = 0;
+		wb->nextents = 0;
+	}
+	if( wb->nextents == 0 )
+		wb->stored_length = crud_open_hot[fd].length;
+	if( count == 0 )
+		return 0;
+
+	// Writes larger than the buffer go straight to the object
+	if( count > CRUD_WRITE_BUFFER_SIZE ) {
+		if( crud_flush( fd ) )
+			return -1;
+		wb->extents[0].offset = offset;
+		wb->extents[0].length = count;
+		wb->extents[0].data = buf;
+		wb->nextents = 1;
+		if( crud_flush( fd ) ) {
+			// the extent points at the caller's buffer, never keep it
+			wb->nextents = 0;
+			wb->used = 0;
+			return -1;
+		}
+		return 0;
+	}
+
+	// Finding the extents that overlap or touch [offset, offset+count]
+	for( first = 0; first < wb->nextents; first++ ) {
+		if( wb->extents[first].offset + wb->extents[first].length >= offset )
+			break;
+	}
+	for( last = first; last < wb->nextents; last++ ) {
+		if( wb->extents[last].offset > offset + count )
+			break;
+	}
+	last--;
+
+	// Overwrite inside one extent, copy in place
+	ext = &wb->extents[first];
+	if( first == last && offset >= ext->offset && offset + count <= ext->offset + ext->length ) {
+		memcpy( &ext->data[offset - ext->offset], buf, count );
+		return 0;
+	}
+
+	// Extending the extent at the end of the arena, grow it in place
+	if( first == last && offset >= ext->offset && ext->data + ext->length == wb->arena + wb->used ) {
+		hi = offset + count - (ext->offset + ext->length); // bytes added to the arena
+		if( wb->used + hi <= CRUD_WRITE_BUFFER_SIZE ) {
+			memcpy( &ext->data[offset - ext->offset], buf, count );
+			wb->used += hi;
+			ext->length += hi;
+			return 0;
+		}
+	}
+
+	// Otherwise the merged range is rebuilt at the end of the arena
+	lo = offset;
+	hi = offset + count;
+	if( first <= last ) {
+		if( wb->extents[first].offset < lo )
+			lo = wb->extents[first].offset;
+		if( wb->extents[last].offset + wb->extents[last].length > hi )
+			hi = wb->extents[last].offset + wb->extents[last].length;
+	}
+	if( (wb->used + (hi - lo) > CRUD_WRITE_BUFFER_SIZE) ||
+	    (first > last && wb->nextents == CRUD_WRITE_BUFFER_EXTENTS) ) {
+		// Buffer full, write it back and start over with an empty buffer
+		if( crud_flush( fd ) )
+			return -1;
+		return( crud_buffer_write( fd, buf, offset, count ) );
+	}
+	data = &wb->arena[wb->used];
+	wb->used += hi - lo;
+	for( i = first; i <= last; i++ )
+		memcpy( &data[wb->extents[i].offset - lo], wb->extents[i].data, wb->extents[i].length );
+	memcpy( &data[offset - lo], buf, count );
+
+	// Replacing the merged extents with the new one
+	if( first > last ) {
+		memmove( &wb->extents[first+1], &wb->extents[first], sizeof(CrudWriteExtent)*(wb->nextents-first) );
+		wb->nextents++;
+	} else if( last > first ) {
+		memmove( &wb->extents[first+1], &wb->extents[last+1], sizeof(CrudWriteExtent)*(wb->nextents-last-1) );
+		wb->nextents -= last - first;
+	}
+	wb->extents[first].offset = lo;
+	wb->extents[first].length = hi - lo;
+	wb->extents[first].data = data;
+	return 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : crud_buffer_dirty
+// Description  : Checks if a range of a file has data that is still only in
+//                the write buffer
+//
+// Inputs       : fd - the file descriptor of the file
+//                offset - the file offset of the range
+//                count - the number of bytes in the range
+// Outputs      : 1 if the range is dirty, 0 otherwise
+
+static int crud_buffer_dirty( int16_t fd, uint32_t offset, uint32_t count ) {
+	// Declaring and Initializing variables
+	CrudWriteBuffer *wb = &crud_open_files[fd].wb;
+	int i;
+
+	// Nothing buffered, nothing dirty
+	if( wb->nextents == 0 )
+		return 0;
+
+	// Anything past the stored object only exists in the buffer
+	if( offset + count > wb->stored_length )
+		return 1;
+	for( i = 0; i < wb->nextents; i++ ) {
+		if( wb->extents[i].offset < offset + count && wb->extents[i].offset + wb->extents[i].length > offset )
+			return 1;
+	}
+	return 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : crud_buffer_release
+// Description  : Frees the write buffer of a file (buffered data is dropped)
+//
+// Inputs       : fd - the file descriptor of the file
+// Outputs      : none
+
+static void crud_buffer_release( int16_t fd ) {
+	// Handing the arena and extent list back to the scratch arena
+	crud_arena_free( crud_open_files[fd].wb.arena );
+	crud_arena_free( crud_open_files[fd].wb.extents );
+	memset( &crud_open_files[fd].wb, 0, sizeof(CrudWriteBuffer) );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : crud_readahead_hit
+// Description  : Tracks the access pattern of a read and serves it from the
+//                readahead window when the bytes were prefetched
+//
+// Inputs       : fd - the file descriptor of the file
+//                buf - the buffer to place the bytes into
+//                offset - the file offset of the read
+//                count - the number of bytes read
+// Outputs      : 1 if the read was served, 0 if the object must be read
+
+static int crud_readahead_hit( int16_t fd, char *buf, uint32_t offset, uint32_t count ) {
+	// Declaring and Initializing variables
+	CrudReadahead *ra = &crud_open_files[fd].ra;
+
+	// A read that picks up where the last one ended is sequential, anything
+	// else restarts detection and drops the window back to the minimum
+	if( offset == ra->next && ra->streak > 0 ) {
+		ra->streak++;
+	} else {
+		ra->streak = 1;
+		ra->window = CRUD_READAHEAD_MIN_WINDOW;
+	}
+	ra->next = offset + count;
+
+	// Checking if the bytes are in the window
+	if( ra->length > 0 && offset >= ra->offset && offset + count <= ra->offset + ra->length ) {
+		memcpy( buf, &ra->data[offset - ra->offset], count );
+		return 1;
+	}
+	return 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : crud_readahead_fill
+// Description  : Keeps the bytes after a read of a sequential reader so the
+//                next reads are served without going to the object store.
+//                The window doubles each time it is used up.
+//
+// Inputs       : fd - the file descriptor of the file
+//                object - the object contents just read
+//                offset - the file offset the reader will read next
+// Outputs      : none
+
+static void crud_readahead_fill( int16_t fd, char *object, uint32_t offset ) {
+	// Declaring and Initializing variables
+	CrudReadahead *ra = &crud_open_files[fd].ra;
+	CrudWriteBuffer *wb = &crud_open_files[fd].wb;
+	uint32_t count;
+	int i;
+
+	// Random readers do not get a window
+	if( ra->streak < CRUD_READAHEAD_TRIGGER ) {
+		ra->length = 0;
+		return;
+	}
+
+	// A reader that consumed the last window gets a bigger one
+	if( ra->length > 0 && ra->window < CRUD_READAHEAD_MAX_WINDOW )
+		ra->window *= 2;
+	if( ra->data == NULL )
+		ra->data = (char*)crud_arena_alloc(CRUD_READAHEAD_MAX_WINDOW);
+
+	// Keeping the window, clipped to the end of the file and to the first
+	// byte that is still only in the write buffer (the object is stale there)
+	count = crud_open_hot[fd].length - offset;
+	if( count > ra->window )
+		count = ra->window;
+	if( wb->nextents > 0 ) {
+		if( offset >= wb->stored_length )
+			count = 0;
+		else if( offset + count > wb->stored_length )
+			count = wb->stored_length - offset;
+		for( i = 0; i < wb->nextents; i++ ) {
+			if( wb->extents[i].offset + wb->extents[i].length <= offset )
+				continue;
+			if( wb->extents[i].offset <= offset )
+				count = 0;
+			else if( wb->extents[i].offset - offset < count )
+				count = wb->extents[i].offset - offset;
+			break;
+		}
+	}
+	memcpy( ra->data, &object[offset], count );
+	ra->offset = offset;
+	ra->length = count;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : crud_readahead_release
+// Description  : Frees the readahead window of a file and resets detection
+//
+// Inputs       : fd - the file descriptor of the file
+// Outputs      : none
+
+static void crud_readahead_release( int16_t fd ) {
+	// Handing the window back to the scratch arena
+	crud_arena_free( crud_open_files[fd].ra.data );
+	memset( &crud_open_files[fd].ra, 0, sizeof(CrudReadahead) );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : crud_stress_random
+// Description  : Draw a random value from a stress thread's generator
+//
+// Inputs       : st - the stress thread
+//                min - the smallest value
+//                max - the largest value
+// Outputs      : the value
+
+static uint32_t crud_stress_random( CrudStressThread *st, uint32_t min, uint32_t max ) {
+	return( min + (uint32_t)rand_r(&st->seed) % (max - min + 1) );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : crud_stress_bucket, crud_stress_bucket_ns
+// Description  : Map a latency to its histogram bucket (powers of two split
+//                into CRUD_STRESS_SUB_BUCKETS), and a bucket to its top
+//
+// Inputs       : ns - the latency in nanoseconds / bucket - the bucket
+// Outputs      : the bucket / the largest latency of the bucket
+
+static uint32_t crud_stress_bucket( uint64_t ns ) {
+
+	// Local variables
+	uint32_t msb, bucket;
+
+	if ( ns < CRUD_STRESS_SUB_BUCKETS ) {
+		return( (uint32_t)ns );
+	}
+	msb = 63 - __builtin_clzll( ns );
+	bucket = (msb - CRUD_STRESS_SUB_BITS + 1) * CRUD_STRESS_SUB_BUCKETS +
+		(uint32_t)((ns >> (msb - CRUD_STRESS_SUB_BITS)) & (CRUD_STRESS_SUB_BUCKETS - 1));
+	return( (bucket < CRUD_STRESS_BUCKETS) ? bucket : CRUD_STRESS_BUCKETS - 1 );
+}
+
+static uint64_t crud_stress_bucket_ns( uint32_t bucket ) {
+
+	// Local variables
+	uint32_t shift;
+
+	if ( bucket < CRUD_STRESS_SUB_BUCKETS ) {
+		return( bucket );
+	}
+	shift = bucket / CRUD_STRESS_SUB_BUCKETS - 1;
+	return( (((uint64_t)CRUD_STRESS_SUB_BUCKETS + bucket % CRUD_STRESS_SUB_BUCKETS + 1) << shift) - 1 );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : crud_stress_time
+// Description  : Record the latency of an operation that began at start
+//
+// Inputs       : st - the stress thread
+//                op - the operation
+//                start - when the operation began
+// Outputs      : none
+
+static void crud_stress_time( CrudStressThread *st, CRUD_UNIT_TEST_TYPE op, struct timespec *start ) {
+
+	// Local variables
+	struct timespec end;
+	uint64_t ns;
+
+	clock_gettime( CLOCK_MONOTONIC, &end );
+	ns = (uint64_t)(end.tv_sec - start->tv_sec) * 1000000000ULL + end.tv_nsec - start->tv_nsec;
+	st->ops[op]++;
+	st->histogram[op][crud_stress_bucket(ns)]++;
+	if ( ns > st->max_ns[op] ) {
+		st->max_ns[op] = ns;
+	}
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : crud_stress_verify
+// Description  : Read back every file of a stress thread and compare it to
+//                the mirror, leaving each file where it was
+//
+// Inputs       : st - the stress thread
+// Outputs      : 0 if successful or -1 if failure
+
+static int crud_stress_verify( CrudStressThread *st ) {
+
+	// Local variables
+	CrudStressFile *sf;
+	uint32_t i, offset, count;
+	int32_t bytes;
+
+	for ( i=0; i<st->nfiles; i++ ) {
+		sf = &st->files[i];
+		if ( crud_seek(sf->fh, 0) ) {
+			CRUD_LOG( LOG_ERROR_LEVEL, "CRUD_IO_UNIT_TEST : verify seek failed [%s].", sf->name );
+			return( -1 );
+		}
+		for ( offset=0; offset<=sf->length; offset+=count ) {
+			count = (sf->length - offset < CRUD_STRESS_VERIFY_SIZE) ? sf->length - offset : CRUD_STRESS_VERIFY_SIZE;
+			bytes = crud_read( sf->fh, st->tbuf, CRUD_STRESS_VERIFY_SIZE );
+			if ( (bytes != (int32_t)count) || memcmp(&sf->mirror[offset], st->tbuf, count) ) {
+				CRUD_LOG( LOG_ERROR_LEVEL, "CRUD_IO_UNIT_TEST : verify of [%s] failed at %u [%d!=%u]",
+						sf->name, offset, bytes, count );
+				return( -1 );
+			}
+			if ( count == 0 ) {
+				break;
+			}
+		}
+		if ( crud_seek(sf->fh, sf->position) ) {
+			CRUD_LOG( LOG_ERROR_LEVEL, "CRUD_IO_UNIT_TEST : verify seek failed [%s].", sf->name );
+			return( -1 );
+		}
+	}
+	return( 0 );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : crud_stress_step
+// Description  : Perform one random operation on one of a thread's files and
+//                check it against the mirror
+//
+// Inputs       : st - the stress thread
+// Outputs      : 0 if successful or -1 if failure
+
+static int crud_stress_step( CrudStressThread *st ) {
+
+	// Local variables
+	const CrudStressParams *params = st->params;
+	CrudStressFile *sf;
+	struct timespec start;
+	uint32_t count, expected;
+	int32_t bytes;
+	uint8_t ch;
+	CRUD_UNIT_TEST_TYPE cmd;
+	char lstr[1024];
+
+	// Pick a file and a random command
+	sf = &st->files[crud_stress_random(st, 0, st->nfiles - 1)];
+	if ( sf->length == 0 ) {
+		cmd = CIO_UNIT_TEST_WRITE;
+	} else {
+		cmd = crud_stress_random( st, CIO_UNIT_TEST_READ, CIO_UNIT_TEST_SEEK );
+		if ( crud_stress_random(st, 0, 31) == 0 ) {
+			cmd = crud_stress_random( st, CIO_UNIT_TEST_TRUNCATE, CIO_UNIT_TEST_RESERVE );
+		}
+	}
+
+	// Execute the command
+	clock_gettime( CLOCK_MONOTONIC, &start );
+	switch ( cmd ) {
+
+	case CIO_UNIT_TEST_READ: // read a random set of data
+		count = crud_stress_random( st, 0, (sf->length < params->max_read) ? sf->length : params->max_read );
+		CRUD_LOG( LOG_INFO_LEVEL, "CRUD_IO_UNIT_TEST : read %u at position %u", count, sf->position );
+		bytes = crud_read( sf->fh, st->tbuf, count );
+		crud_stress_time( st, cmd, &start );
+		if ( bytes == -1 ) {
+			CRUD_LOG( LOG_ERROR_LEVEL, "CRUD_IO_UNIT_TEST : Read failure." );
+			return( -1 );
+		}
+
+		// Compare to what we expected
+		expected = (sf->position + count > sf->length) ? sf->length - sf->position : count;
+		if ( bytes != (int32_t)expected ) {
+			CRUD_LOG( LOG_ERROR_LEVEL, "CRUD_IO_UNIT_TEST : short/long read of [%d!=%u]", bytes, expected );
+			return( -1 );
+		}
+		if ( (bytes > 0) && (memcmp(&sf->mirror[sf->position], st->tbuf, bytes)) ) {
+			bufToString( (unsigned char *)st->tbuf, bytes, (unsigned char *)lstr, 1024 );
+			CRUD_LOG( LOG_INFO_LEVEL, "CIO_UTEST R: %s", lstr );
+			bufToString( (unsigned char *)&sf->mirror[sf->position], bytes, (unsigned char *)lstr, 1024 );
+			CRUD_LOG( LOG_INFO_LEVEL, "CIO_UTEST U: %s", lstr );
+			CRUD_LOG( LOG_ERROR_LEVEL, "CRUD_IO_UNIT_TEST : read data mismatch (%d)", bytes );
+			return( -1 );
+		}
+		CRUD_LOG( LOG_INFO_LEVEL, "CRUD_IO_UNIT_TEST : read %d match", bytes );
+		sf->position += bytes;
+		st->read_bytes += bytes;
+		break;
+
+	case CIO_UNIT_TEST_APPEND: // Append data onto the end of the file
+		// Create random block, check to make sure that the write is not too large
+		ch = crud_stress_random( st, 0, 0xff );
+		count = crud_stress_random( st, 1, params->max_write );
+		if ( sf->length + count < params->max_size ) {
+
+			// Log, seek to end of file, create random value
+			CRUD_LOG( LOG_INFO_LEVEL, "CRUD_IO_UNIT_TEST : append of %u bytes [%x] at %u", count, ch, sf->length );
+			memset( &sf->mirror[sf->length], ch, count );
+			if ( crud_seek(sf->fh, sf->length) ) {
+				CRUD_LOG( LOG_ERROR_LEVEL, "CRUD_IO_UNIT_TEST : seek failed [%u].", sf->length );
+				return( -1 );
+			}
+			sf->position = sf->length;
+
+			// Now write
+			bytes = crud_write( sf->fh, &sf->mirror[sf->position], count );
+			crud_stress_time( st, cmd, &start );
+			if ( bytes != (int32_t)count ) {
+				CRUD_LOG( LOG_ERROR_LEVEL, "CRUD_IO_UNIT_TEST : append failed [%u].", count );
+				return( -1 );
+			}
+			sf->length = sf->position += bytes;
+			st->written_bytes += bytes;
+		}
+		break;
+
+	case CIO_UNIT_TEST_WRITE: // Write random block to the file
+		ch = crud_stress_random( st, 0, 0xff );
+		count = crud_stress_random( st, 1, params->max_write );
+		// Check to make sure that the write is not too large
+		if ( sf->length + count < params->max_size ) {
+			// Log the write, perform it
+			CRUD_LOG( LOG_INFO_LEVEL, "CRUD_IO_UNIT_TEST : write of %u bytes [%x]", count, ch );
+			memset( &sf->mirror[sf->position], ch, count );
+			bytes = crud_write( sf->fh, &sf->mirror[sf->position], count );
+			crud_stress_time( st, cmd, &start );
+			if ( bytes != (int32_t)count ) {
+				CRUD_LOG( LOG_ERROR_LEVEL, "CRUD_IO_UNIT_TEST : write failed [%u].", count );
+				return( -1 );
+			}
+			sf->position += bytes;
+			if ( sf->position > sf->length ) {
+				sf->length = sf->position;
+			}
+			st->written_bytes += bytes;
+		}
+		break;
+
+	case CIO_UNIT_TEST_SEEK:
+		count = crud_stress_random( st, 0, sf->length );
+		CRUD_LOG( LOG_INFO_LEVEL, "CRUD_IO_UNIT_TEST : seek to position %u", count );
+		if ( crud_seek(sf->fh, count) ) {
+			CRUD_LOG( LOG_ERROR_LEVEL, "CRUD_IO_UNIT_TEST : seek failed [%u].", count );
+			return( -1 );
+		}
+		crud_stress_time( st, cmd, &start );
+		sf->position = count;
+		break;
+
+	case CIO_UNIT_TEST_TRUNCATE: // Shrink or extend the file
+		count = crud_stress_random( st, 0, sf->length + params->max_write );
+		if ( count < params->max_size ) {
+			CRUD_LOG( LOG_INFO_LEVEL, "CRUD_IO_UNIT_TEST : truncate to %u bytes", count );
+			if ( crud_truncate(sf->fh, count) ) {
+				CRUD_LOG( LOG_ERROR_LEVEL, "CRUD_IO_UNIT_TEST : truncate failed [%u].", count );
+				return( -1 );
+			}
+			crud_stress_time( st, cmd, &start );
+			if ( count < sf->length ) {
+				memset( &sf->mirror[count], 0x0, sf->length - count );
+			}
+			sf->length = count;
+			if ( sf->position > count ) {
+				sf->position = count;
+			}
+		}
+		break;
+
+	case CIO_UNIT_TEST_RESERVE: // Preallocate the object, the contents stay
+		count = crud_stress_random( st, 0, (params->max_size < CRUD_MAX_OBJECT_SIZE) ? params->max_size : CRUD_MAX_OBJECT_SIZE );
+		CRUD_LOG( LOG_INFO_LEVEL, "CRUD_IO_UNIT_TEST : reserve %u bytes", count );
+		if ( crud_reserve(sf->fh, count) ) {
+			CRUD_LOG( LOG_ERROR_LEVEL, "CRUD_IO_UNIT_TEST : reserve failed [%u].", count );
+			return( -1 );
+		}
+		crud_stress_time( st, cmd, &start );
+		break;
+
+	default: // This should never happen
+		CMPSC_ASSERT0(0, "CRUD_IO_UNIT_TEST : illegal test command.");
+		break;
+
+	}
+
+#if DEEP_DEBUG
+	// VALIDATION STEP: ENSURE OUR LOCAL IS LIKE OBJECT STORE
+	CrudRequest request;
+	CrudResponse response;
+	CrudOID oid;
+	CRUD_REQUEST_TYPES req;
+	uint32_t length;
+	uint8_t res, flags;
+
+	// Make a fake request to get file handle, then check it (single threaded only)
+	crud_flush( sf->fh );
+	request = construct_crud_request( crud_open_hot[sf->fh].object_id, CRUD_READ, CRUD_MAX_OBJECT_SIZE, CRUD_NULL_FLAG, 0 );
+	response = crud_backend->request( crud_backend, request, st->tbuf );
+	if ( (deconstruct_crud_request(response, &oid, &req, &length, &flags, &res) != 0) || (res != 0) ) {
+		CRUD_LOG( LOG_ERROR_LEVEL, "Read failure, bad CRUD response [%x]", response );
+		return( -1 );
+	}
+	if ( (sf->length != length) || (memcmp(sf->mirror, st->tbuf, length)) ) {
+		CRUD_LOG( LOG_ERROR_LEVEL, "Buffer/Object cross validation failed [%x]", response );
+		bufToString( (unsigned char *)st->tbuf, length, (unsigned char *)lstr, 1024 );
+		CRUD_LOG( LOG_INFO_LEVEL, "CIO_UTEST VR: %s", lstr );
+		bufToString( (unsigned char *)sf->mirror, length, (unsigned char *)lstr, 1024 );
+		CRUD_LOG( LOG_INFO_LEVEL, "CIO_UTEST VU: %s", lstr );
+		return( -1 );
+	}
+
+	// Print out the buffer
+	bufToString( (unsigned char *)sf->mirror, sf->length, (unsigned char *)lstr, 1024 );
+	CRUD_LOG( LOG_INFO_LEVEL, "CIO_UTEST: %s", lstr );
+#endif
+
+	// Return successfully
+	return( 0 );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : crud_stress_thread
+// Description  : Run the operations of one stress thread, stopping early
+//                when another thread fails
+//
+// Inputs       : arg - the stress thread
+// Outputs      : NULL
+
+static void *crud_stress_thread( void *arg ) {
+
+	// Local variables
+	CrudStressThread *st = arg;
+	uint32_t i;
+
+	for ( i=0; (i<st->params->iterations) && (st->failed == 0); i++ ) {
+		if ( atomic_load(st->stop) ) {
+			return( NULL );
+		}
+		if ( crud_stress_step(st) ||
+				((st->params->verify > 0) && ((i+1) % st->params->verify == 0) && crud_stress_verify(st)) ) {
+			st->failed = 1;
+		}
+	}
+	if ( (st->failed == 0) && crud_stress_verify(st) ) {
+		st->failed = 1;
+	}
+	if ( st->failed ) {
+		atomic_store( st->stop, 1 );
+	}
+	return( NULL );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : crud_stress_report
+// Description  : Log the throughput and the latency percentiles of a run
+//
+// Inputs       : params - the parameters of the run
+//                threads - the stress threads
+//                seed - the seed the run used
+//                seconds - the time the run took
+// Outputs      : none
+
+static void crud_stress_report( const CrudStressParams *params, CrudStressThread *threads,
+		unsigned int seed, double seconds ) {
+
+	// Local variables
+	static const char *names[CRUD_STRESS_OPS] = { "read", "write", "append", "seek", "truncate", "reserve" };
+	static const double pcts[3] = { 0.50, 0.99, 0.999 };
+	uint64_t histogram[CRUD_STRESS_BUCKETS], ops, total = 0, max, seen, read = 0, written = 0;
+	double at[3];
+	uint32_t i, t, b, p;
+
+	// The totals first
+	for ( t=0; t<params->threads; t++ ) {
+		for ( i=0; i<CRUD_STRESS_OPS; i++ ) {
+			total += threads[t].ops[i];
+		}
+		read += threads[t].read_bytes;
+		written += threads[t].written_bytes;
+	}
+	CRUD_LOG( LOG_OUTPUT_LEVEL, "CRUD stress: %u threads, %u files, %lu operations in %.3f seconds (%.0f ops/sec, seed %u)",
+			params->threads, params->files, total, seconds, total / seconds, seed );
+	CRUD_LOG( LOG_OUTPUT_LEVEL, "CRUD stress: wrote %.1f MB (%.1f MB/sec), read %.1f MB (%.1f MB/sec)",
+			written / 1048576.0, written / 1048576.0 / seconds, read / 1048576.0, read / 1048576.0 / seconds );
+
+	// Then the latencies of each operation, merged over the threads
+	for ( i=0; i<CRUD_STRESS_OPS; i++ ) {
+		memset( histogram, 0x0, sizeof(histogram) );
+		for ( t=0, ops=0, max=0; t<params->threads; t++ ) {
+			for ( b=0; b<CRUD_STRESS_BUCKETS; b++ ) {
+				histogram[b] += threads[t].histogram[i][b];
+			}
+			ops += threads[t].ops[i];
+			max = (threads[t].max_ns[i] > max) ? threads[t].max_ns[i] : max;
+		}
+		if ( ops == 0 ) {
+			continue;
+		}
+		for ( p=0, b=0, seen=0; p<3; p++ ) {
+			while ( (b < CRUD_STRESS_BUCKETS - 1) && (seen + histogram[b] < pcts[p] * ops) ) {
+				seen += histogram[b++];
+			}
+			at[p] = ((crud_stress_bucket_ns(b) < max) ? crud_stress_bucket_ns(b) : max) / 1000.0;
+		}
+		CRUD_LOG( LOG_OUTPUT_LEVEL, "CRUD stress: %-8s %9lu ops  p50 %9.1f us  p99 %9.1f us  p99.9 %9.1f us  max %9.1f us",
+				names[i], ops, at[0], at[1], at[2], max / 1000.0 );
+	}
+}
+
+//
+// Stress benchmark
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : crud_stress_params
+// Description  : Read the settings of a stress run onto the defaults
+//
+// Inputs       : spec - comma separated files=, threads=, iterations=,
+//                       write=, read=, size=, verify=, seed= (NULL for the
+//                       defaults)
+//                params - the parameters to fill
+// Outputs      : 0 if successful, -1 if failure
+
+int crud_stress_params( const char *spec, CrudStressParams *params ) {
+
+	// Local variables
+	char *copy, *key, *value, *save = NULL;
+	unsigned long number;
+	int ret = 0;
+
+	// The defaults are the unit test of the file interface
+	memset( params, 0x0, sizeof(CrudStressParams) );
+	params->files = 1;
+	params->threads = 1;
+	params->iterations = CRUD_IO_UNIT_TEST_ITERATIONS;
+	params->max_write = CIO_UNIT_TEST_MAX_WRITE_SIZE;
+	params->max_read = CRUD_MAX_OBJECT_SIZE;
+	params->max_size = CRUD_MAX_OBJECT_SIZE;
+	if ( spec == NULL ) {
+		return( 0 );
+	}
+
+	// Walk the comma separated list of settings
+	copy = strdup( spec );
+	for ( key = strtok_r(copy, ",", &save); (key != NULL) && (ret == 0); key = strtok_r(NULL, ",", &save) ) {
+		if ( (value = strchr(key, '=')) == NULL ) {
+			ret = -1;
+			break;
+		}
+		*value++ = 0x0;
+		number = strtoul( value, NULL, 10 );
+		if ( strcmp(key, "files") == 0 ) {
+			params->files = number;
+		} else if ( strcmp(key, "threads") == 0 ) {
+			params->threads = number;
+		} else if ( strcmp(key, "iterations") == 0 ) {
+			params->iterations = number;
+		} else if ( strcmp(key, "write") == 0 ) {
+			params->max_write = number;
+		} else if ( strcmp(key, "read") == 0 ) {
+			params->max_read = number;
+		} else if ( strcmp(key, "size") == 0 ) {
+			params->max_size = number;
+		} else if ( strcmp(key, "verify") == 0 ) {
+			params->verify = number;
+		} else if ( strcmp(key, "seed") == 0 ) {
+			params->seed = number;
+		} else {
+			ret = -1;
+		}
+	}
+	free( copy );
+
+	// Check the settings make a run
+	if ( (ret == 0) && ((params->files == 0) || (params->threads == 0) || (params->threads > params->files) ||
+			(params->max_write == 0) || (params->max_size <= params->max_write) ||
+			(params->max_size > CRUD_MAX_FILE_SIZE)) ) {
+		ret = -1;
+	}
+	if ( ret ) {
+		CRUD_LOG( LOG_ERROR_LEVEL, "CRUD stress: bad settings [%s]", spec );
+	}
+	return( ret );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : crud_stress
+// Description  : Run random reads, writes, appends, seeks, truncates and
+//                reserves over a set of files from a number of threads (each
+//                with its own files), checking every read and the final
+//                contents against a mirror of each file
+//
+// Inputs       : params - the parameters of the run
+// Outputs      : 0 if successful or -1 if failure
+
+int crud_stress( const CrudStressParams *params ) {
+
+	// Local variables
+	CrudStressThread *threads;
+	CrudStressFile *files;
+	pthread_t *tids;
+	struct timespec start, end;
+	atomic_int stop = 0;
+	unsigned int seed;
+	uint32_t i, t;
+	int ret = 0;
 
 	// Format and mount the file system
+	if ( crud_format() || crud_mount() ) {
+		CRUD_LOG( LOG_ERROR_LEVEL, "CRUD_IO_UNIT_TEST : Failure on format or mount operation." );
+		return( -1 );
+	}
+
+	// Open the files, each with a zeroed mirror of its contents
+	files = calloc( params->files, sizeof(CrudStressFile) );
+	for ( i=0; i<params->files; i++ ) {
+		files[i].fh = -1;
+	}
+	for ( i=0; (i<params->files) && (ret == 0); i++ ) {
+		snprintf( files[i].name, sizeof(files[i].name), (params->files == 1) ? "temp_file.txt" : "stress_%05u.dat", i );
+		files[i].mirror = calloc( params->max_size + params->max_write, 1 );
+		if ( (files[i].fh = crud_open(files[i].name)) == -1 ) {
+			CRUD_LOG( LOG_ERROR_LEVEL, "CRUD_IO_UNIT_TEST : Failure open operation." );
+			ret = -1;
+		}
+	}
+
+	// Give each thread its own run of files and its own generator
+	seed = (params->seed != 0) ? params->seed : (unsigned int)time(NULL) ^ (unsigned int)getpid();
+	threads = calloc( params->threads, sizeof(CrudStressThread) );
+	tids = calloc( params->threads, sizeof(pthread_t) );
+	for ( t=0; t<params->threads; t++ ) {
+		threads[t].params = params;
+		threads[t].files = &files[t * params->files / params->threads];
+		threads[t].nfiles = (t+1) * params->files / params->threads - t * params->files / params->threads;
+		threads[t].tbuf = malloc( (params->max_read > CRUD_STRESS_VERIFY_SIZE) ? params->max_read : CRUD_STRESS_VERIFY_SIZE );
+		threads[t].seed = seed + t * 0x9e3779b9;
+		threads[t].stop = &stop;
+	}
+
+	// Run the threads (the first on this one)
+	clock_gettime( CLOCK_MONOTONIC, &start );
+	for ( t=1; (t<params->threads) && (ret == 0); t++ ) {
+		if ( pthread_create(&tids[t], NULL, crud_stress_thread, &threads[t]) ) {
+			CRUD_LOG( LOG_ERROR_LEVEL, "CRUD stress: thread creation failed." );
+			atomic_store( &stop, 1 );
+			ret = -1;
+		}
+	}
+	if ( ret == 0 ) {
+		crud_stress_thread( &threads[0] );
+	}
+	while ( --t > 0 ) {
+		pthread_join( tids[t], NULL );
+	}
+	clock_gettime( CLOCK_MONOTONIC, &end );
+	for ( t=0; t<params->threads; t++ ) {
+		if ( threads[t].failed ) {
+			ret = -1;
+		}
+	}
+	if ( ret ) {
+		CRUD_LOG( LOG_ERROR_LEVEL, "CRUD stress: run failed (seed %u)", seed );
+	} else if ( params->report ) {
+		crud_stress_report( params, threads, seed,
+				(end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1000000000.0 );
+	}
+
+	// Close the files and cleanup buffers
+	for ( i=0; i<params->files; i++ ) {
+		if ( (files[i].fh != -1) && crud_close(files[i].fh) ) {
+			CRUD_LOG( LOG_ERROR_LEVEL, "CRUD_IO_UNIT_TEST : close of file handle [%d] failed.", files[i].fh );
+			ret = -1;
+		}
+		free( files[i].mirror );
+	}
+	for ( t=0; t<params->threads; t++ ) {
+		free( threads[t].tbuf );
+	}
+	free( threads );
+	free( tids );
+	free( files );
+
+	// Unmount the file system
+	if ( crud_unmount() ) {
+		CRUD_LOG( LOG_ERROR_LEVEL, "CRUD_IO_UNIT_TEST : Failure on unmount operation." );
+		return( -1 );
+	}
+	return( ret );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : crudIOUnitTest
+// Description  : Perform a test of the CRUD IO implementation
+//
+// Inputs       : None
+// Outputs      : 0 if successful or -1 if failure
+
+int crudIOUnitTest(void) {
+
+	// Local variables
+	CrudStressParams params;
+	int16_t fh[CRUD_OPEN_UNIT_TEST_FILES];
+	char name[16];
+	int i;
+
+	// One file on one thread, then a few threads sharing the driver
+	crud_stress_params( NULL, &params );
+	if ( crud_stress(&params) ) {
+		return( -1 );
+	}
+	if ( crud_stress_params("files=8,threads=4,iterations=2048,size=262144,verify=512", &params) ||
+			crud_stress(&params) ) {
+		return( -1 );
+	}
+
+	// The handles of open files are found by name, closed ones are reused
+	if ( crud_format() || crud_mount() ) {
+		return( -1 );
+	}
+	for ( i=0; i<CRUD_OPEN_UNIT_TEST_FILES; i++ ) {
+		snprintf( name, sizeof(name), "open_%03d", i );
+		if ( (fh[i] = crud_open(name)) == -1 ) {
+			return( -1 );
+		}
+	}
+	for ( i=0; i<CRUD_OPEN_UNIT_TEST_FILES; i+=3 ) {
+		crud_write( fh[i], name, 4 );
+		if ( crud_close(fh[i]) ) {
+			return( -1 );
+		}
+	}
+	for ( i=0; i<CRUD_OPEN_UNIT_TEST_FILES; i++ ) {
+		snprintf( name, sizeof(name), "open_%03d", i );
+		if ( (crud_open(name) != fh[i]) && ((i % 3) != 0) ) {
+			CRUD_LOG( LOG_ERROR_LEVEL, "CRUD_IO_UNIT_TEST : open file [%s] got a new handle.", name );
+			return( -1 );
+		}
+	}
+	if ( crud_unmount() ) {
+		return( -1 );
+	}
+
+	// Return successfully
+	return( 0 );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : crud_dir_utest_count
+// Description  : Counts the entries crud_list calls it on
+//
+// Inputs       : entry - the entry listed
+//                arg - the count
+// Outputs      : none
+
+static void crud_dir_utest_count( const CrudFileAllocationType *entry, void *arg ) {
+	(*(int32_t *)arg)++;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : crud_dir_utest_expect
+// Description  : Reads a directory and compares it to the expected entries
+//
+// Inputs       : path - the directory
+//                names - the expected names, in order ("/" ending directories)
+//                count - the number of names
+// Outputs      : 0 if successful or -1 if failure
+
+static int crud_dir_utest_expect( char *path, const char **names, int count ) {
+	// Declaring and Initializing variables
+	CrudDirectory *dir;
+	CrudDirectoryEntry *ent;
+	char name[CRUD_MAX_PATH_LENGTH+1];
+	int i = 0;
+
+	// Reading every entry
+	if( (dir = crud_opendir( path )) == NULL ) {
+		CRUD_LOG(LOG_ERROR_LEVEL, "CRUD_DIR_UNIT_TEST : opendir of [%s] failed.", path);
+		return(-1);
+	}
+	while( (ent = crud_readdir( dir )) != NULL ) {
+		snprintf( name, sizeof(name), "%s%s", ent->name, ent->directory ? "/" : "" );
+		if( i >= count || strcmp( name, names[i] ) ) {
+			CRUD_LOG(LOG_ERROR_LEVEL, "CRUD_DIR_UNIT_TEST : [%s] has [%s] at %d, expected [%s].",
+					path, name, i, (i < count) ? names[i] : "end");
+			return(-1);
+		}
+		i++;
+	}
+	crud_closedir( dir );
+	if( i != count ) {
+		CRUD_LOG(LOG_ERROR_LEVEL, "CRUD_DIR_UNIT_TEST : [%s] has %d entries, expected %d.", path, i, count);
+		return(-1);
+	}
+	return(0);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : crudDirectoryUnitTest
+// Description  : Perform a test of the CRUD directories
+//
+// Inputs       : None
+// Outputs      : 0 if successful or -1 if failure
+
+int crudDirectoryUnitTest(void) {
+
+	// Local variables
+	const char *root[] = { "imp/", "logs/", "readme" };
+	const char *logs[] = { "2025/", "2026/", "top.txt" };
+	const char *imp[] = { "q/" };
+	CrudDirectory *dir;
+	CrudDirectoryEntry *ent;
+	char name[CRUD_MAX_PATH_LENGTH], data[CRUD_DIR_UNIT_TEST_FILES];
+	int32_t count, i;
+	int16_t fh;
+	uint64_t loaded;
+
+	// Format and mount the file system, make a few directories
+	if (crud_format() || crud_mount() || crud_mkdir("logs") || crud_mkdir("logs/2026") || crud_mkdir("logs/2025")) {
+		CRUD_LOG(LOG_ERROR_LEVEL, "CRUD_DIR_UNIT_TEST : Failure on format, mount or mkdir.");
+		return(-1);
+	}
+	if (!crud_mkdir("logs") || !crud_mkdir("none/sub") || !crud_mkdir("logs/") || crud_opendir("none") != NULL) {
+		CRUD_LOG(LOG_ERROR_LEVEL, "CRUD_DIR_UNIT_TEST : bad mkdir or opendir succeeded.");
+		return(-1);
+	}
+
+	// Fill them, along with a directory only implied by a file name
+	memset(data, 'd', CRUD_DIR_UNIT_TEST_FILES);
+	for (i=0; i<CRUD_DIR_UNIT_TEST_FILES; i++) {
+		snprintf(name, CRUD_MAX_PATH_LENGTH, "logs/2026/day%03d", CRUD_DIR_UNIT_TEST_FILES-1-i);
+		if (((fh = crud_open(name)) == -1) || (crud_write(fh, data, i) != i) || crud_close(fh)) {
+			CRUD_LOG(LOG_ERROR_LEVEL, "CRUD_DIR_UNIT_TEST : create of [%s] failed.", name);
+			return(-1);
+		}
+	}
+	if (((fh = crud_open("logs/top.txt")) == -1) || crud_close(fh) || ((fh = crud_open("readme")) == -1) ||
+			crud_close(fh) || ((fh = crud_open("imp/q/r")) == -1) || crud_close(fh) ||
+			((fh = crud_open("logs/2025/x")) == -1) || crud_close(fh) || (crud_open("logs/2026") != -1) ) {
+		CRUD_LOG(LOG_ERROR_LEVEL, "CRUD_DIR_UNIT_TEST : create of files failed.");
+		return(-1);
+	}
+
+	// The directories list their own entries in order, after a remount
+	if (crud_unmount() || crud_mount() || crud_dir_utest_expect("", root, 3) || crud_dir_utest_expect("/", root, 3) ||
+			crud_dir_utest_expect("logs", logs, 3) || crud_dir_utest_expect("imp/", imp, 1)) {
+		CRUD_LOG(LOG_ERROR_LEVEL, "CRUD_DIR_UNIT_TEST : listing failed.");
+		return(-1);
+	}
+
+	// A listing after a remount only reads the nodes on the way to its entries
+	if (crud_unmount() || crud_mount()) {
+		CRUD_LOG(LOG_ERROR_LEVEL, "CRUD_DIR_UNIT_TEST : Failure on remount.");
+		return(-1);
+	}
+	count = 0;
+	if ((crud_list("logs/2025/", crud_dir_utest_count, &count) != 2) || (count != 2) ||
+			((loaded = crud_table_loaded()) > crud_table_height()+1)) {
+		CRUD_LOG(LOG_ERROR_LEVEL, "CRUD_DIR_UNIT_TEST : prefix listing failed (%d entries).", count);
+		return(-1);
+	}
+	count = 0;
+	if ((crud_list("logs/2026/day1", crud_dir_utest_count, &count) != 100) || (count != 100)) {
+		CRUD_LOG(LOG_ERROR_LEVEL, "CRUD_DIR_UNIT_TEST : prefix listing of day1 failed (%d entries).", count);
+		return(-1);
+	}
+
+	// Reading a directory while files are added keeps the order
+	if ((dir = crud_opendir("logs/2026")) == NULL) {
+		CRUD_LOG(LOG_ERROR_LEVEL, "CRUD_DIR_UNIT_TEST : opendir failed.");
+		return(-1);
+	}
+	for (i=0; (ent = crud_readdir(dir)) != NULL; i++) {
+		snprintf(name, CRUD_MAX_PATH_LENGTH, "day%03d", i);
+		if (strcmp(ent->name, name) || ent->directory || (ent->length != CRUD_DIR_UNIT_TEST_FILES-1-i)) {
+			CRUD_LOG(LOG_ERROR_LEVEL, "CRUD_DIR_UNIT_TEST : read [%s], expected [%s].", ent->name, name);
+			return(-1);
+		}
+		if (i == 10) {
+			if (((fh = crud_open("logs/2026/a")) == -1) || crud_close(fh)) {
+				CRUD_LOG(LOG_ERROR_LEVEL, "CRUD_DIR_UNIT_TEST : create during read failed.");
+				return(-1);
+			}
+		}
+	}
+	crud_closedir(dir);
+	if (i != CRUD_DIR_UNIT_TEST_FILES) {
+		CRUD_LOG(LOG_ERROR_LEVEL, "CRUD_DIR_UNIT_TEST : read %d entries.", i);
+		return(-1);
+	}
+
+	// Unmount, return successfully
 	if (crud_unmount()) {
-		logMessage(LOG_ERROR_LEVEL, "CRUD_IO_UNIT_TEST : Failure on unmount operation.");
+		CRUD_LOG(LOG_ERROR_LEVEL, "CRUD_DIR_UNIT_TEST : Failure on unmount operation.");
 		return(-1);
 	}
+	return(0);
+}
 
-	// Return successfully
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : crud_sparse_utest_check
+// Description  : Reads a range of a file and compares it to what it should be
+//
+// Inputs       : fh - the file to read
+//                offset - the offset of the range
+//                expected - the bytes the range should hold
+//                count - the number of bytes in the range
+// Outputs      : 0 if successful or -1 if failure
+
+static int crud_sparse_utest_check( int16_t fh, uint32_t offset, char *expected, int32_t count ) {
+	// Local variables
+	char *buf = malloc(count+1);
+	int32_t bytes;
+
+	// Reading and comparing
+	bytes = -1;
+	if (crud_seek(fh, offset) == 0)
+		bytes = crud_read(fh, buf, count);
+	if ((bytes != count) || ((count > 0) && memcmp(buf, expected, count))) {
+		CRUD_LOG(LOG_ERROR_LEVEL, "CRUD_SPARSE_UNIT_TEST : read of %d at %u mismatched (%d read).", count, offset, bytes);
+		free(buf);
+		return(-1);
+	}
+	free(buf);
+	return(0);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : crudSparseUnitTest
+// Description  : Perform a test of the CRUD sparse files
+//
+// Inputs       : None
+// Outputs      : 0 if successful or -1 if failure
+
+int crudSparseUnitTest(void) {
+
+	// Local variables
+	char *mirror, *data, *zeros;
+	int32_t length, offset, count, i, chunks;
+	uint64_t requests;
+	int16_t fh;
+
+	// Setup some operating buffers
+	mirror = calloc(CRUD_SPARSE_UNIT_TEST_SIZE, 1);
+	data = malloc(CRUD_SPARSE_UNIT_TEST_SIZE);
+	zeros = calloc(CRUD_SPARSE_UNIT_TEST_SIZE, 1);
+	count = getRandomValue(0, 254);
+	for (i=0; i<CRUD_SPARSE_UNIT_TEST_SIZE; i++)
+		data[i] = (char)((i / 7 + count) % 255 + 1); // never zero, unlike a hole
+
+	// A write far past the end leaves a hole, only the written chunks exist
+	if (crud_format() || crud_mount() || ((fh = crud_open("far")) == -1) || (crud_write(fh, data, 1000) != 1000) ||
+			crud_seek(fh, CRUD_SPARSE_UNIT_TEST_HOLE) || (crud_write(fh, data, 1000) != 1000) || crud_flush(fh)) {
+		CRUD_LOG(LOG_ERROR_LEVEL, "CRUD_SPARSE_UNIT_TEST : Failure writing past the end of the file.");
+		return(-1);
+	}
+	for (i=0, chunks=0; i<crud_open_files[fh].slots; i++)
+		chunks += (crud_open_files[fh].chunks[i] != CRUD_NO_OBJECT);
+	if (!(crud_open_hot[fh].flags & CRUD_FILE_SPARSE) || (chunks != 2) ||
+			(crud_open_hot[fh].length != CRUD_SPARSE_UNIT_TEST_HOLE+1000)) {
+		CRUD_LOG(LOG_ERROR_LEVEL, "CRUD_SPARSE_UNIT_TEST : file has %d chunks, length %u.", chunks, crud_open_hot[fh].length);
+		return(-1);
+	}
+
+	// Holes read back as zeros without going to the device
+	requests = crud_io_bus_requests;
+	if (crud_sparse_utest_check(fh, CRUD_SPARSE_UNIT_TEST_HOLE/2, zeros, CRUD_SPARSE_UNIT_TEST_SIZE) ||
+			crud_sparse_utest_check(fh, CRUD_SPARSE_CHUNK_SIZE, zeros, 4096) || (crud_io_bus_requests != requests)) {
+		CRUD_LOG(LOG_ERROR_LEVEL, "CRUD_SPARSE_UNIT_TEST : hole read failed or touched the device.");
+		return(-1);
+	}
+
+	// The data and the holes survive a remount
+	if (crud_unmount() || crud_mount() || ((fh = crud_open("far")) == -1) ||
+			crud_sparse_utest_check(fh, 0, data, 1000) || crud_sparse_utest_check(fh, CRUD_SPARSE_UNIT_TEST_HOLE, data, 1000) ||
+			crud_sparse_utest_check(fh, CRUD_SPARSE_UNIT_TEST_HOLE-4096, zeros, 4096) ||
+			crud_sparse_utest_check(fh, CRUD_SPARSE_UNIT_TEST_HOLE+1000, zeros, 0)) {
+		CRUD_LOG(LOG_ERROR_LEVEL, "CRUD_SPARSE_UNIT_TEST : Failure reading back after remount.");
+		return(-1);
+	}
+
+	// Random writes, reads and truncates of a sparse file against a mirror
+	length = 0;
+	if (((fh = crud_open("mirror")) == -1) || crud_truncate(fh, CRUD_SPARSE_UNIT_TEST_SIZE/2)) {
+		CRUD_LOG(LOG_ERROR_LEVEL, "CRUD_SPARSE_UNIT_TEST : Failure creating the mirrored file.");
+		return(-1);
+	}
+	length = CRUD_SPARSE_UNIT_TEST_SIZE/2;
+	for (i=0; i<CRUD_SPARSE_UNIT_TEST_ITERATIONS; i++) {
+		switch (getRandomValue(0, 9)) {
+		case 0: // truncate to a random length
+			count = getRandomValue(0, CRUD_SPARSE_UNIT_TEST_SIZE);
+			if (crud_truncate(fh, count)) {
+				CRUD_LOG(LOG_ERROR_LEVEL, "CRUD_SPARSE_UNIT_TEST : truncate to %d failed.", count);
+				return(-1);
+			}
+			if (count < length)
+				memset(&mirror[count], 0, length - count);
+			length = count;
+			break;
+
+		case 1: // remount
+			if (crud_unmount() || crud_mount() || ((fh = crud_open("mirror")) == -1)) {
+				CRUD_LOG(LOG_ERROR_LEVEL, "CRUD_SPARSE_UNIT_TEST : Failure on remount.");
+				return(-1);
+			}
+			break;
+
+		case 2: case 3: case 4: case 5: // write a random range
+			offset = getRandomValue(0, CRUD_SPARSE_UNIT_TEST_SIZE-1);
+			count = getRandomValue(1, (getRandomValue(0, 3) == 0) ? 200*1024 : 4096);
+			if (offset + count > CRUD_SPARSE_UNIT_TEST_SIZE)
+				count = CRUD_SPARSE_UNIT_TEST_SIZE - offset;
+			if (crud_seek(fh, offset) || (crud_write(fh, &data[offset], count) != count)) {
+				CRUD_LOG(LOG_ERROR_LEVEL, "CRUD_SPARSE_UNIT_TEST : write of %d at %d failed.", count, offset);
+				return(-1);
+			}
+			memcpy(&mirror[offset], &data[offset], count);
+			if (offset + count > length)
+				length = offset + count;
+			break;
+
+		default: // read a random range
+			offset = getRandomValue(0, length);
+			count = getRandomValue(0, (getRandomValue(0, 3) == 0) ? 300*1024 : 4096);
+			if (offset + count > length)
+				count = length - offset;
+			if (crud_sparse_utest_check(fh, offset, &mirror[offset], count))
+				return(-1);
+			break;
+		}
+	}
+	if (crud_sparse_utest_check(fh, 0, mirror, length) || (crud_open_hot[fh].length != length)) {
+		CRUD_LOG(LOG_ERROR_LEVEL, "CRUD_SPARSE_UNIT_TEST : final read back failed.");
+		return(-1);
+	}
+
+	// Unmount, return successfully
+	free(mirror);
+	free(data);
+	free(zeros);
+	if (crud_unmount()) {
+		CRUD_LOG(LOG_ERROR_LEVEL, "CRUD_SPARSE_UNIT_TEST : Failure on unmount operation.");
+		return(-1);
+	}
 	return(0);
 }
 
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : crudCloneUnitTest
+// Description  : Perform a test of the CRUD clones and snapshots
+//
+// Inputs       : None
+// Outputs      : 0 if successful or -1 if failure
+
+int crudCloneUnitTest(void) {
+
+	// Local variables
+	char *data, *zeros;
+	int32_t count, i;
+	uint64_t requests;
+	CrudOID object;
+	int16_t fh, ch;
+
+	// Setup some operating buffers
+	data = malloc(CRUD_MAX_OBJECT_SIZE);
+	zeros = calloc(CRUD_MAX_OBJECT_SIZE, 1);
+	count = getRandomValue(0, 254);
+	for (i=0; i<CRUD_MAX_OBJECT_SIZE; i++)
+		data[i] = (char)((i / 5 + count) % 255 + 1);
+
+	// A clone of a file in one object shares it, no data moves
+	if (crud_format() || crud_mount() || ((fh = crud_open("orig")) == -1) || (crud_write(fh, data, 5000) != 5000)) {
+		CRUD_LOG(LOG_ERROR_LEVEL, "CRUD_CLONE_UNIT_TEST : Failure creating the file to clone.");
+		return(-1);
+	}
+	if (crud_flush(fh) || ((requests = crud_io_bus_requests), crud_clone("orig", "copy")) || (crud_io_bus_requests != requests) ||
+			(crud_table_refs(crud_open_hot[fh].object_id) != 2) || !crud_clone("orig", "copy") || !crud_clone("none", "x")) {
+		CRUD_LOG(LOG_ERROR_LEVEL, "CRUD_CLONE_UNIT_TEST : clone failed or copied data.");
+		return(-1);
+	}
 
+	// Writing the clone copies the object, the original is unchanged
+	object = crud_open_hot[fh].object_id;
+	if (((ch = crud_open("copy")) == -1) || crud_sparse_utest_check(ch, 0, data, 5000) || crud_seek(ch, 100) ||
+			(crud_write(ch, zeros, 100) != 100) || crud_flush(ch) || (crud_table_refs(object) != 1) ||
+			crud_sparse_utest_check(fh, 0, data, 5000) || crud_sparse_utest_check(ch, 100, zeros, 100) ||
+			crud_sparse_utest_check(ch, 200, &data[200], 4800)) {
+		CRUD_LOG(LOG_ERROR_LEVEL, "CRUD_CLONE_UNIT_TEST : copy on write of the clone failed.");
+		return(-1);
+	}
 
+	// A sparse clone shares the chunks, writing one copies only that chunk
+	if (((fh = crud_open("big")) == -1) || (crud_write(fh, data, 1000) != 1000) || crud_seek(fh, 10*1024*1024) ||
+			(crud_write(fh, data, 1000) != 1000) || crud_clone("big", "big2") || ((ch = crud_open("big2")) == -1) ||
+			crud_seek(ch, 10*1024*1024+10) || (crud_write(ch, zeros, 10) != 10) || crud_flush(ch) ||
+			(crud_table_refs(crud_open_files[ch].chunks[0]) != 2) ||
+			(crud_open_files[ch].chunks[160] == crud_open_files[fh].chunks[160]) ||
+			crud_sparse_utest_check(fh, 10*1024*1024, data, 1000) || crud_sparse_utest_check(ch, 10*1024*1024+10, zeros, 10) ||
+			crud_sparse_utest_check(ch, 0, data, 1000)) {
+		CRUD_LOG(LOG_ERROR_LEVEL, "CRUD_CLONE_UNIT_TEST : sparse clone failed.");
+		return(-1);
+	}
 
+	// A snapshot freezes every file, buffered data included, and survives
+	// the live files changing and a remount
+	if (crud_mkdir("dir") || ((fh = crud_open("dir/f")) == -1) || (crud_write(fh, data, 300) != 300) || crud_snapshot("s1") ||
+			!crud_snapshot("s1") || crud_truncate(fh, 0) || ((fh = crud_open("orig")) == -1) || crud_seek(fh, 0) || (crud_write(fh, zeros, 5000) != 5000) ||
+			((fh = crud_open("big")) == -1) || crud_truncate(fh, 0) || crud_unmount() || crud_mount()) {
+		CRUD_LOG(LOG_ERROR_LEVEL, "CRUD_CLONE_UNIT_TEST : snapshot failed.");
+		return(-1);
+	}
+	// (the first chunk of big is still used by big2 and both their snapshots)
+	count = 0;
+	if ((crud_list(CRUD_SNAPSHOT_DIR "s1/", crud_dir_utest_count, &count) != 7) || (count != 7) ||
+			((fh = crud_open(CRUD_SNAPSHOT_DIR "s1/orig")) == -1) || crud_sparse_utest_check(fh, 0, data, 5000) ||
+			((fh = crud_open(CRUD_SNAPSHOT_DIR "s1/dir/f")) == -1) || crud_sparse_utest_check(fh, 0, data, 300) ||
+			(crud_write(fh, data, 1) != -1) || !crud_truncate(fh, 0) || (crud_open(CRUD_SNAPSHOT_DIR "s1/new") != -1) ||
+			((fh = crud_open(CRUD_SNAPSHOT_DIR "s1/big")) == -1) || crud_sparse_utest_check(fh, 10*1024*1024, data, 1000) ||
+			crud_sparse_utest_check(fh, 1000, zeros, 4096) ||
+			(crud_table_refs(crud_open_files[fh].chunks[0]) != 3) || ((ch = crud_open("orig")) == -1) || crud_sparse_utest_check(ch, 0, zeros, 5000)) {
+		CRUD_LOG(LOG_ERROR_LEVEL, "CRUD_CLONE_UNIT_TEST : snapshot read back failed (%d entries).", count);
+		return(-1);
+	}
 
+	// A clone of a snapshot file is writable
+	if (crud_clone(CRUD_SNAPSHOT_DIR "s1/orig", "restored") || ((fh = crud_open("restored")) == -1) ||
+			(crud_write(fh, data, 10) != 10) || crud_sparse_utest_check(fh, 0, data, 5000)) {
+		CRUD_LOG(LOG_ERROR_LEVEL, "CRUD_CLONE_UNIT_TEST : restore from the snapshot failed.");
+		return(-1);
+	}
 
+	// Unmount, return successfully
+	free(data);
+	free(zeros);
+	if (crud_unmount()) {
+		CRUD_LOG(LOG_ERROR_LEVEL, "CRUD_CLONE_UNIT_TEST : Failure on unmount operation.");
+		return(-1);
+	}
+	return(0);
+}
 
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : crud_durability_utest_crash
+// Description  : Lose everything the object store has not made durable: the
+//                handles go and the store is read back from its file
+//
+// Inputs       : None
+// Outputs      : 0 if successful or -1 if failure
 
+static int crud_durability_utest_crash(void) {
 
+	// Local variables
+	int i;
 
+	// Drop the handles and the objects kept for reuse, then initialize the
+	// store again (reading what it saved) and mount the table
+	for (i=0; i<crud_open_slots; i++) {
+		crud_buffer_release(i);
+		crud_readahead_release(i);
+		crud_sparse_release(i);
+		crud_open_forget(i);
+	}
+	crud_recycle_reset();
+	if ((crud_io_request(create_crudrequest(0, CRUD_INIT, 0, 0), NULL) & 0x1) || crud_mount()) {
+		return(-1);
+	}
+	return(0);
+}
 
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : crudDurabilityUnitTest
+// Description  : Perform a test of the CRUD durability classes: a sync file
+//                survives a crash as it was at its last crud_fsync, scratch
+//                files never survive and cost no journal records
+//
+// Inputs       : None
+// Outputs      : 0 if successful or -1 if failure
 
+int crudDurabilityUnitTest(void) {
 
+	// Local variables
+	int16_t sync, lazy, scratch;
+	char data[CRUD_DURABILITY_UNIT_TEST_SIZE], buf[CRUD_DURABILITY_UNIT_TEST_SIZE];
+	uint32_t bytes, i;
 
+	// Format and mount the file system, then make a file of each class
+	for (i=0; i<CRUD_DURABILITY_UNIT_TEST_SIZE; i++) {
+		data[i] = (char)(i%251+1);
+	}
+	if (crud_format() || crud_mount()) {
+		CRUD_LOG(LOG_ERROR_LEVEL, "CRUD_DURABILITY_UNIT_TEST : Failure on format or mount operation.");
+		return(-1);
+	}
+	if (((sync = crud_open_durable("sync", CRUD_DURABILITY_SYNC)) == -1) ||
+			((lazy = crud_open_durable("lazy", CRUD_DURABILITY_LAZY)) == -1) ||
+			(crud_open_durable("bad", 3) != -1) || crud_table_commit(1)) {
+		CRUD_LOG(LOG_ERROR_LEVEL, "CRUD_DURABILITY_UNIT_TEST : open failed.");
+		return(-1);
+	}
 
+	// Scratch files add nothing to the journal, but the pool records of the
+	// objects they give up and take (each file resizes its object twice)
+	bytes = crud_journal_bytes();
+	for (i=0; i<CRUD_DURABILITY_UNIT_TEST_FILES; i++) {
+		snprintf(buf, CRUD_MAX_PATH_LENGTH, "tmp%u", i);
+		if (((scratch = crud_open_durable(buf, CRUD_DURABILITY_SCRATCH)) == -1) ||
+				(crud_write(scratch, data, CRUD_DURABILITY_UNIT_TEST_SIZE) != CRUD_DURABILITY_UNIT_TEST_SIZE) ||
+				crud_fsync(scratch) || crud_truncate(scratch, i) || ((i%2) && crud_close(scratch))) {
+			CRUD_LOG(LOG_ERROR_LEVEL, "CRUD_DURABILITY_UNIT_TEST : scratch file [%s] failed.", buf);
+			return(-1);
+		}
+	}
+	if (crud_table_commit(1) || (crud_journal_bytes() - bytes > CRUD_DURABILITY_UNIT_TEST_FILES * 2 *
+				(2 * sizeof(CrudJournalRecord) + sizeof(CrudRecycleObject) + sizeof(CrudOID))) ||
+			(crud_table_scratch() != CRUD_DURABILITY_UNIT_TEST_FILES)) {
+		CRUD_LOG(LOG_ERROR_LEVEL, "CRUD_DURABILITY_UNIT_TEST : scratch files were journaled (%u bytes).",
+				crud_journal_bytes() - bytes);
+		return(-1);
+	}
 
+	// A checkpoint now saves the scratch entries in the table
+	if (crud_table_unmount() || crud_table_mount() || (crud_table_scratch() != CRUD_DURABILITY_UNIT_TEST_FILES)) {
+		CRUD_LOG(LOG_ERROR_LEVEL, "CRUD_DURABILITY_UNIT_TEST : checkpoint failed.");
+		return(-1);
+	}
 
+	// Sync the sync file, then change it without syncing and crash
+	if ((crud_write(sync, data, CRUD_DURABILITY_UNIT_TEST_SIZE) != CRUD_DURABILITY_UNIT_TEST_SIZE) ||
+			(crud_write(lazy, data, 100) != 100) || crud_fsync(lazy) || crud_fsync(sync) ||
+			crud_seek(sync, 0) || (crud_write(sync, buf, 100) != 100) || crud_truncate(sync, 10) ||
+			crud_flush(sync) || crud_durability_utest_crash()) {
+		CRUD_LOG(LOG_ERROR_LEVEL, "CRUD_DURABILITY_UNIT_TEST : sync or crash failed.");
+		return(-1);
+	}
+	if (((sync = crud_open("sync")) == -1) || (crud_read(sync, buf, CRUD_DURABILITY_UNIT_TEST_SIZE) != CRUD_DURABILITY_UNIT_TEST_SIZE) ||
+			memcmp(buf, data, CRUD_DURABILITY_UNIT_TEST_SIZE) || (crud_table_find("tmp0") != NULL) ||
+			(crud_table_scratch() != 0) || (crud_table_files() != 2)) {
+		CRUD_LOG(LOG_ERROR_LEVEL, "CRUD_DURABILITY_UNIT_TEST : the crash lost the sync file or kept the scratch ones.");
+		return(-1);
+	}
 
+	// Scratch files go at unmount, a file moves between classes
+	if (((scratch = crud_open_durable("tmp", CRUD_DURABILITY_SCRATCH)) == -1) ||
+			(crud_write(scratch, data, 10) != 10) || (crud_open_durable("sync", CRUD_DURABILITY_SCRATCH) != sync) ||
+			(crud_open_durable("sync", CRUD_DURABILITY_SYNC) != sync) || crud_unmount() || crud_mount() ||
+			(crud_table_find("tmp") != NULL) || (crud_table_files() != 2) ||
+			((sync = crud_open("sync")) == -1) || !(crud_open_hot[sync].flags & CRUD_FILE_SYNC)) {
+		CRUD_LOG(LOG_ERROR_LEVEL, "CRUD_DURABILITY_UNIT_TEST : scratch file survived the unmount.");
+		return(-1);
+	}
 
+	// Unmount, return successfully
+	if (crud_unmount()) {
+		CRUD_LOG(LOG_ERROR_LEVEL, "CRUD_DURABILITY_UNIT_TEST : Failure on unmount operation.");
+		return(-1);
+	}
+	return(0);
+}
 
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : crud_coalesce_utest_reader
+// Description  : Reads a whole file (a reader of the coalescing test)
+//
+// Inputs       : arg - the file handle (in a pointer)
+// Outputs      : the file contents (NULL on failure)
 
+static void *crud_coalesce_utest_reader( void *arg ) {
 
+	// Local variables
+	char *buf = malloc( CRUD_COALESCE_UNIT_TEST_SIZE );
 
+	if ( crud_read((int16_t)(intptr_t)arg, buf, CRUD_COALESCE_UNIT_TEST_SIZE) != CRUD_COALESCE_UNIT_TEST_SIZE ) {
+		free( buf );
+		return( NULL );
+	}
+	return( buf );
+}
 
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : crud_coalesce_utest_unmounter
+// Description  : Unmounts (while the readers of the coalescing test wait)
+//
+// Inputs       : arg - unused
+// Outputs      : the result of the unmount (in a pointer)
 
+static void *crud_coalesce_utest_unmounter( void *arg ) {
+	return( (void *)(intptr_t)crud_unmount() );
+}
 
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : crudCoalesceUnitTest
+// Description  : Perform a test of the single flight reads: readers of
+//                clones (one shared object) start while the device is held
+//                busy, so they all wait on the first one's fetch; then an
+//                unmount started while they wait lets them finish first.
+//                First the coalesced writes of a file truncated with dirty
+//                extents buffered must flush to the truncated length.
+//
+// Inputs       : None
+// Outputs      : 0 if successful or -1 if failure
 
+int crudCoalesceUnitTest(void) {
 
+	// Local variables
+	pthread_t readers[CRUD_COALESCE_UNIT_TEST_READERS], unmounter;
+	int16_t fh[CRUD_COALESCE_UNIT_TEST_READERS], tf;
+	uint64_t requests, coalesced;
+	char *data, *got, name[16];
+	int i, waited, joined = 0, ret = 0;
+	void *unmounted;
 
+	// Write the file, then clone it once per reader and open the clones
+	data = malloc( CRUD_COALESCE_UNIT_TEST_SIZE );
+	for (i=0; i<CRUD_COALESCE_UNIT_TEST_SIZE; i++) {
+		data[i] = (char)(i * 7 + i / 251);
+	}
+	if (crud_format() || crud_mount() || ((fh[0] = crud_open("shared")) == -1) ||
+			(crud_write(fh[0], data, CRUD_COALESCE_UNIT_TEST_SIZE) != CRUD_COALESCE_UNIT_TEST_SIZE) || crud_close(fh[0])) {
+		CRUD_LOG(LOG_ERROR_LEVEL, "CRUD_COALESCE_UNIT_TEST : Failure writing the shared file.");
+		free(data);
+		return(-1);
+	}
 
+	// Truncate below a dirty extent, buffer writes below and across the new
+	// length, then check the length and bytes they flush to (and that the
+	// bytes past it are zeros when the file grows again)
+	got = malloc(CRUD_COALESCE_UNIT_TEST_SIZE);
+	if (((tf = crud_open("truncated")) == -1) || (crud_write(tf, data, 1000) != 1000) || crud_fsync(tf) ||
+			crud_seek(tf, 900) || (crud_write(tf, &data[900], 10) != 10) || crud_truncate(tf, 300) ||
+			crud_seek(tf, 100) || (crud_write(tf, &data[100], 10) != 10) ||
+			crud_seek(tf, 280) || (crud_write(tf, &data[280], 40) != 40) || crud_fsync(tf) || crud_close(tf) ||
+			((tf = crud_open("truncated")) == -1) || (crud_read(tf, got, 1000) != 320) || memcmp(got, data, 320) ||
+			crud_truncate(tf, 400) || crud_seek(tf, 0) || (crud_read(tf, got, 1000) != 400) ||
+			memcmp(got, data, 320) || crud_close(tf)) {
+		CRUD_LOG(LOG_ERROR_LEVEL, "CRUD_COALESCE_UNIT_TEST : buffered writes of a truncated file flushed wrong.");
+		free(got);
+		free(data);
+		return(-1);
+	}
+	for (i=320; i<400; i++) {
+		if (got[i] != 0) {
+			CRUD_LOG(LOG_ERROR_LEVEL, "CRUD_COALESCE_UNIT_TEST : byte %d past the truncated length is not zero.", i);
+			free(got);
+			free(data);
+			return(-1);
+		}
+	}
+	free(got);
+	for (i=0; i<CRUD_COALESCE_UNIT_TEST_READERS; i++) {
+		snprintf(name, sizeof(name), "reader%d", i);
+		if (crud_clone("shared", name) || ((fh[i] = crud_open(name)) == -1)) {
+			CRUD_LOG(LOG_ERROR_LEVEL, "CRUD_COALESCE_UNIT_TEST : Failure cloning [%s].", name);
+			free(data);
+			return(-1);
+		}
+	}
 
+	// Hold the device, start the readers and wait for all of them to be
+	// on the fetch of the first (counted without the interface lock, it
+	// cannot be taken while holding the backend one)
+	requests = crud_io_bus_requests;
+	coalesced = crud_io_coalesced;
+	pthread_mutex_lock(&crud_backend_mutex);
+	for (i=0; i<CRUD_COALESCE_UNIT_TEST_READERS; i++) {
+		pthread_create(&readers[i], NULL, crud_coalesce_utest_reader, (void *)(intptr_t)fh[i]);
+	}
+	for (waited=0; (waited < 5000) && (joined < CRUD_COALESCE_UNIT_TEST_READERS); waited++) {
+		joined = crud_flight_readers;
+		usleep(1000);
+	}
+	pthread_mutex_unlock(&crud_backend_mutex);
 
+	// Every reader gets the file, from one read of the device
+	for (i=0; i<CRUD_COALESCE_UNIT_TEST_READERS; i++) {
+		pthread_join(readers[i], (void **)&got);
+		if ((got == NULL) || memcmp(got, data, CRUD_COALESCE_UNIT_TEST_SIZE)) {
+			ret = -1;
+		}
+		free(got);
+	}
+	if ((ret != 0) || (joined != CRUD_COALESCE_UNIT_TEST_READERS) || (crud_io_bus_requests - requests != 1) ||
+			(crud_io_coalesced - coalesced != CRUD_COALESCE_UNIT_TEST_READERS - 1)) {
+		CRUD_LOG(LOG_ERROR_LEVEL, "CRUD_COALESCE_UNIT_TEST : %d readers joined, %lu requests, %lu coalesced.",
+				joined, crud_io_bus_requests - requests, crud_io_coalesced - coalesced);
+		ret = -1;
+	}
 
+	// Again from the start of the files, with an unmount started while the
+	// readers wait: it waits for them, and they get the file
+	for (i=0; i<CRUD_COALESCE_UNIT_TEST_READERS; i++) {
+		snprintf(name, sizeof(name), "reader%d", i);
+		if (crud_close(fh[i]) || ((fh[i] = crud_open(name)) == -1)) {
+			CRUD_LOG(LOG_ERROR_LEVEL, "CRUD_COALESCE_UNIT_TEST : Failure opening [%s].", name);
+			free(data);
+			return(-1);
+		}
+	}
+	pthread_mutex_lock(&crud_backend_mutex);
+	for (i=0; i<CRUD_COALESCE_UNIT_TEST_READERS; i++) {
+		pthread_create(&readers[i], NULL, crud_coalesce_utest_reader, (void *)(intptr_t)fh[i]);
+	}
+	for (waited=0, joined=0; (waited < 5000) && (joined < CRUD_COALESCE_UNIT_TEST_READERS); waited++) {
+		joined = crud_flight_readers;
+		usleep(1000);
+	}
+	pthread_create(&unmounter, NULL, crud_coalesce_utest_unmounter, NULL);
+	usleep(10000);
+	pthread_mutex_unlock(&crud_backend_mutex);
+	for (i=0; i<CRUD_COALESCE_UNIT_TEST_READERS; i++) {
+		pthread_join(readers[i], (void **)&got);
+		if ((got == NULL) || memcmp(got, data, CRUD_COALESCE_UNIT_TEST_SIZE)) {
+			CRUD_LOG(LOG_ERROR_LEVEL, "CRUD_COALESCE_UNIT_TEST : reader %d got the wrong file during the unmount.", i);
+			ret = -1;
+		}
+		free(got);
+	}
+	pthread_join(unmounter, &unmounted);
+	free(data);
+	if (joined != CRUD_COALESCE_UNIT_TEST_READERS) {
+		CRUD_LOG(LOG_ERROR_LEVEL, "CRUD_COALESCE_UNIT_TEST : %d readers joined before the unmount.", joined);
+		ret = -1;
+	}
+	if (unmounted != NULL) {
+		CRUD_LOG(LOG_ERROR_LEVEL, "CRUD_COALESCE_UNIT_TEST : Failure on unmount operation.");
+		return(-1);
+	}
+	if (ret == 0) {
+		CRUD_LOG(LOG_INFO_LEVEL, "CRUD coalescing unit tests completed successfully.");
+	}
+	return(ret);
+}
@@ -16,21 +16,49 @@
 
 // Project include files
 #include <crud_driver.h>
+#include <crud_backend.h>
+#include <crud_file_table.h>
 
 // Defines
-#define CRUD_MAX_TOTAL_FILES 1024
-#define CRUD_MAX_PATH_LENGTH 128
+#define CRUD_SPARSE_CHUNK_SIZE (64*1024)  // bytes of a sparse file kept per object
+#define CRUD_SPARSE_MAX_CHUNKS 16384      // chunks in the largest sparse file
+#define CRUD_MAX_FILE_SIZE (CRUD_SPARSE_CHUNK_SIZE*CRUD_SPARSE_MAX_CHUNKS)
+#define CRUD_SNAPSHOT_DIR ".snap/"        // snapshots are the directories in here
 
 // Type definitions
 
-// This is the basic file handle structure (note: index into file table is fh)
+// These are the durability classes of files, picked at open
+typedef enum {
+	CRUD_DURABILITY_LAZY    = 0, // persisted when the store is saved (checkpoints and unmount)
+	CRUD_DURABILITY_SCRATCH = 1, // never persisted, dropped at unmount
+	CRUD_DURABILITY_SYNC    = 2, // persisted by crud_fsync
+} CrudDurability;
+
+// These are the parameters of the stress benchmark (crud_stress)
+typedef struct {
+	uint32_t      files;       // The files, split between the threads
+	uint32_t      threads;     // The threads, each working on its own files
+	uint32_t      iterations;  // The operations of each thread
+	uint32_t      max_write;   // The largest write or append
+	uint32_t      max_read;    // The largest read
+	uint32_t      max_size;    // The largest file
+	uint32_t      verify;      // Operations between read backs of all the files (0 for only at the end)
+	unsigned int  seed;        // The seed of the operations (0 to pick one, it is logged)
+	int           report;      // Flag to log the throughput and latencies
+} CrudStressParams;
+
+// This is an entry returned by crud_readdir
 typedef struct {
-	char      filename[CRUD_MAX_PATH_LENGTH]; // The filename of the data to be manipulated
-	CrudOID   object_id;                      // The handle of the object
-	uint32_t  position;                       // This is the position of the file
-	uint32_t  length;                         // This is the length of the file
-	uint8_t   open;                           // Flag indicating the file is currently open
-} CrudFileAllocationType;
+	char      name[CRUD_MAX_PATH_LENGTH]; // The name within the directory
+	uint8_t   directory;                  // Flag indicating the entry is a directory
+	uint32_t  length;                     // The length of the file (zero for directories)
+} CrudDirectoryEntry;
+
+// This is an open directory (opaque)
+typedef struct CrudDirectory CrudDirectory;
+
+// This is the function crud_list calls for each entry (it must not create files)
+typedef void (*CrudListFunction)( const CrudFileAllocationType *entry, void *arg );
 
 //
 // Management operations
@@ -50,6 +78,9 @@ uint16_t crud_unmount(void);
 int16_t crud_open(char *path);
 	// This function opens the file and returns a file handle
 
+int16_t crud_open_durable(char *path, CrudDurability durability);
+	// Opens the file, putting it in a durability class
+
 int16_t crud_close(int16_t fd);
 	// This function closes the file
 
@@ -59,9 +90,48 @@ int32_t crud_read(int16_t fd, void *buf, int32_t count);
 int32_t crud_write(int16_t fd, void *buf, int32_t count);
 	// Writes "count" bytes to the file handle "fh" from the buffer  "buf"
 
+int32_t crud_read_at(int16_t fd, void *buf, int32_t count, uint32_t offset);
+	// Reads "count" bytes at "offset" without moving the position of "fd"
+
+int32_t crud_write_at(int16_t fd, void *buf, int32_t count, uint32_t offset);
+	// Writes "count" bytes at "offset" without moving the position of "fd"
+
 int32_t crud_seek(int16_t fd, uint32_t loc);
 	// Seek to specific point in the file
 
+int16_t crud_flush(int16_t fd);
+	// Write the buffered data of the file back to the object store
+
+int16_t crud_fsync(int16_t fd);
+	// Flush the file and, for a sync file, make it durable
+
+int16_t crud_truncate(int16_t fd, uint32_t len);
+	// Shrink or extend the file to "len" bytes
+
+int16_t crud_reserve(int16_t fd, uint32_t len);
+	// Preallocate an object of at least "len" bytes for the file
+
+int16_t crud_mkdir(char *path);
+	// Create a directory (its parent must exist)
+
+CrudDirectory *crud_opendir(char *path);
+	// Open a directory for reading its entries ("" or "/" is the root)
+
+CrudDirectoryEntry *crud_readdir(CrudDirectory *dir);
+	// Get the next entry of the directory in name order (NULL at the end)
+
+int16_t crud_closedir(CrudDirectory *dir);
+	// Close the directory
+
+int32_t crud_list(char *prefix, CrudListFunction fn, void *arg);
+	// Call "fn" on every entry whose name starts with "prefix", in name order
+
+int16_t crud_clone(char *src, char *dst);
+	// Create the file "dst" sharing the data of "src" (copied on write)
+
+int16_t crud_snapshot(char *name);
+	// Freeze every file as the read only directory CRUD_SNAPSHOT_DIR "name"
+
 CrudRequest create_crudrequest( CrudOID, CRUD_REQUEST_TYPES, uint32_t, uint8_t );
 	// packs the request according to the spec
 
@@ -70,12 +140,49 @@ uint8_t extract_crudresponse( CrudResponse, int16_t );
 
 uint8_t crud_init( void );
 	// creates an initialize crud request
+
+int16_t crud_set_backend( CrudBackend *be );
+	// selects the storage backend used from the next initialization
+
+CrudResponse crud_io_request( CrudRequest request, void *buf );
+	// sends a request to the object store through the storage backend
+
+int crud_io_batch( CrudRequest *requests, void **bufs, CrudResponse *responses, int count );
+	// sends a list of requests to the object store at once through the storage backend
+
+int crud_io_sync( void );
+	// makes the object store durable through the storage backend
+
+//
+// Stress benchmark
+
+int crud_stress_params( const char *spec, CrudStressParams *params );
+	// Read comma separated key=value settings (NULL for the defaults) into params
+
+int crud_stress( const CrudStressParams *params );
+	// Run the multi-file, multi-threaded stress benchmark on a freshly formatted store
+
 //
 // Unit testing for the module
 
 int crudIOUnitTest(void);
 	// Perform a test of the CRUD IO implementation
 
+int crudDirectoryUnitTest(void);
+	// Perform a test of the CRUD directories
+
+int crudSparseUnitTest(void);
+	// Perform a test of the CRUD sparse files
+
+int crudCloneUnitTest(void);
+	// Perform a test of the CRUD clones and snapshots
+
+int crudDurabilityUnitTest(void);
+	// Perform a test of the CRUD durability classes
+
+int crudCoalesceUnitTest(void);
+	// Perform a test of the CRUD single flight reads
+
 #endif
 
 
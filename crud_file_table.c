@@ -0,0 +1,1286 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+//  File           : crud_file_table.c
+//  Description    : This is the file allocation table of the CRUD file
+//                   system.  The entries live in the leaves of a B+tree
+//                   ordered by filename; every node is its own object, read
+//                   the first time a lookup passes through it and kept until
+//                   unmount, so mounting costs one read and memory grows
+//                   with the part of the namespace that is used.  Changed
+//                   nodes are written back at unmount (a checkpoint), along
+//                   with the table header in the priority object and the
+//                   counts of the objects clones share.  In between, every
+//                   change is a record in the metadata journal, which mount
+//                   replays over the last checkpoint.
+//
+//  Last Modified  : Sun Oct 18 23:41:17 EDT 2026
+//
+
+// Includes
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stddef.h>
+
+// Project Includes
+#include <crud_file_table.h>
+#include <crud_file_io.h>
+#include <crud_arena.h>
+#include <crud_journal.h>
+#include <crud_log.h>
+#include <cmpsc311_hashtable.h>
+#include <cmpsc311_util.h>
+
+// Defines
+#define CRUD_TABLE_HASH_BITS 10
+#define CRUD_TABLE_UNIT_TEST_FILES 20000
+#define CRUD_TABLE_UNIT_TEST_LOOKUPS 256
+#define CRUD_TABLE_UNIT_TEST_HANDLES 1536
+
+// Type definitions
+
+// This is a table node in memory
+typedef struct {
+	CrudOID        oid;   // The object holding the node
+	uint8_t        dirty; // Flag indicating the node changed since it was written
+	CrudTableNode  node;  // The node contents
+} CrudTablePage;
+
+// This is the entry of the fixed table saved by older drivers (the whole
+// table was the priority object, CRUD_TABLE_LEGACY_FILES of these)
+typedef struct {
+	char      filename[CRUD_MAX_PATH_LENGTH];
+	CrudOID   object_id;
+	uint32_t  position;
+	uint32_t  length;
+	uint32_t  open     : 8;
+	uint32_t  capacity : 24;
+} CrudLegacyFileAllocationType;
+
+// Module local data
+static HTable crud_table_pages;          // The nodes in memory, by OID
+static uint8_t crud_table_ready;         // Flag indicating the page table is set up
+static CrudTableHeader crud_table_header; // The table header
+static uint32_t crud_table_header_length; // The size of the priority object
+static uint64_t crud_table_changes;        // Changes that moved entries (cursors go stale)
+static HTable crud_table_shared;           // The counts of shared objects, by OID
+static uint8_t crud_table_shared_dirty;    // Flag indicating the counts changed
+
+//
+// Module local methods
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : crud_table_reset
+// Description  : Drop the nodes in memory (changes not written are lost) and
+//                start over with an empty table
+//
+// Inputs       : none
+// Outputs      : none
+
+static void crud_table_reset( void ) {
+
+	// Local variables
+	CrudTablePage *page;
+	HtIterator it;
+	CrudTableRef *ref;
+	CrudOID *oids;
+	uint32_t i, n = 0;
+
+	// Set up the page and count tables on first use
+	if ( !crud_table_ready ) {
+		initHashTable( &crud_table_pages, CRUD_TABLE_HASH_BITS );
+		initHashTable( &crud_table_shared, CRUD_TABLE_HASH_BITS );
+		crud_table_ready = 1;
+	}
+
+	// Collect the OIDs first, the tables cannot change while iterating
+	oids = malloc( (crud_table_pages.elements+crud_table_shared.elements+1) * sizeof(CrudOID) );
+	initHashTableIterator( &crud_table_pages, &it );
+	while ( (page = iterateHashTable(&it)) != NULL ) {
+		oids[n++] = page->oid;
+	}
+	for ( i=0; i<n; i++ ) {
+		free( deleteValueFromHashTable(&crud_table_pages, oids[i]) );
+	}
+	n = 0;
+	initHashTableIterator( &crud_table_shared, &it );
+	while ( (ref = iterateHashTable(&it)) != NULL ) {
+		oids[n++] = ref->oid;
+	}
+	for ( i=0; i<n; i++ ) {
+		free( deleteValueFromHashTable(&crud_table_shared, oids[i]) );
+	}
+	free( oids );
+	crud_table_shared_dirty = 0;
+
+	// An empty table has no root
+	crud_table_changes++;
+	memset( &crud_table_header, 0x0, sizeof(CrudTableHeader) );
+	memcpy( crud_table_header.magic, CRUD_TABLE_MAGIC, sizeof(crud_table_header.magic) );
+	crud_table_header.version = CRUD_TABLE_VERSION;
+	crud_table_header.node_size = sizeof(CrudTableNode);
+	crud_table_header.root = CRUD_NO_OBJECT;
+	crud_table_header.refs = CRUD_NO_OBJECT;
+	crud_table_header.journal = CRUD_NO_OBJECT;
+	crud_table_header.heatmap = CRUD_NO_OBJECT;
+	crud_journal_reset();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : crud_table_page
+// Description  : Get a node, reading it from its object if not in memory
+//
+// Inputs       : oid - the object of the node
+// Outputs      : the node or NULL if failure
+
+static CrudTablePage *crud_table_page( CrudOID oid ) {
+
+	// Local variables
+	CrudTablePage *page;
+	CrudResponse response;
+
+	// Nodes stay in memory once read
+	if ( (page = findValueInHashTable(&crud_table_pages, oid)) != NULL ) {
+		return( page );
+	}
+	page = malloc( sizeof(CrudTablePage) );
+	response = crud_io_request( create_crudrequest(oid, CRUD_READ, sizeof(CrudTableNode), CRUD_NULL_FLAG), &page->node );
+	if ( response & 0x1 ) {
+		CRUD_LOG( LOG_ERROR_LEVEL, "CRUD table: failed reading node [OID %u]", oid );
+		free( page );
+		return( NULL );
+	}
+	page->oid = oid;
+	page->dirty = 0;
+	insertValueInHashTable( &crud_table_pages, oid, page );
+	return( page );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : crud_table_new_page
+// Description  : Create an empty node and the object holding it
+//
+// Inputs       : leaf - nonzero for a leaf
+// Outputs      : the node or NULL if failure
+
+static CrudTablePage *crud_table_new_page( uint16_t leaf ) {
+
+	// Local variables
+	CrudTablePage *page = calloc( 1, sizeof(CrudTablePage) );
+	CrudResponse response;
+
+	// The object is created empty, the node is written at unmount
+	page->node.leaf = leaf;
+	response = crud_io_request( create_crudrequest(0, CRUD_CREATE, sizeof(CrudTableNode), CRUD_NULL_FLAG), &page->node );
+	if ( response & 0x1 ) {
+		CRUD_LOG( LOG_ERROR_LEVEL, "CRUD table: failed creating node" );
+		free( page );
+		return( NULL );
+	}
+	page->oid = (CrudOID)(response >> 32);
+	page->dirty = 1;
+	insertValueInHashTable( &crud_table_pages, page->oid, page );
+	return( page );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : crud_table_slot
+// Description  : Find where a filename belongs in a node, the first entry
+//                not below it (leaves) or the last link not above it (inner
+//                nodes)
+//
+// Inputs       : node - the node to search
+//                filename - the filename
+// Outputs      : the index in the node
+
+static int crud_table_slot( CrudTableNode *node, const char *filename ) {
+
+	// Local variables
+	int lo, hi, mid;
+
+	// Binary search of the entries
+	if ( node->leaf ) {
+		lo = 0;
+		hi = node->count;
+		while ( lo < hi ) {
+			mid = (lo + hi) / 2;
+			if ( strcmp(node->entries[mid].filename, filename) < 0 ) {
+				lo = mid + 1;
+			} else {
+				hi = mid;
+			}
+		}
+		return( lo );
+	}
+
+	// Binary search of the links (the first link covers everything below)
+	lo = 0;
+	hi = node->count;
+	while ( hi - lo > 1 ) {
+		mid = (lo + hi) / 2;
+		if ( strcmp(node->links[mid].key, filename) <= 0 ) {
+			lo = mid;
+		} else {
+			hi = mid;
+		}
+	}
+	return( lo );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : crud_table_leaf
+// Description  : Walk down the table to the leaf a filename belongs in
+//
+// Inputs       : filename - the filename
+// Outputs      : the leaf or NULL if the table is empty or a node failed
+
+static CrudTablePage *crud_table_leaf( const char *filename ) {
+
+	// Local variables
+	CrudTablePage *page;
+	uint32_t level;
+
+	// Follow the links from the root
+	if ( crud_table_header.root == CRUD_NO_OBJECT ) {
+		return( NULL );
+	}
+	page = crud_table_page( crud_table_header.root );
+	for ( level=crud_table_header.height; (page != NULL) && (level > 1); level-- ) {
+		page = crud_table_page( page->node.links[crud_table_slot(&page->node, filename)].child );
+	}
+	return( page );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : crud_table_add
+// Description  : Add a new entry under a node, splitting the nodes that are
+//                full on the way back up
+//
+// Inputs       : page - the node
+//                level - the level of the node (1 for leaves)
+//                filename - the filename of the entry (not in the table)
+//                split - the link to a new right sibling, if the node split
+// Outputs      : 1 if the node split, 0 if not, -1 if failure
+
+static int crud_table_add( CrudTablePage *page, uint32_t level, const char *filename, CrudTableLink *split ) {
+
+	// Local variables
+	CrudTableNode *node = &page->node, *target;
+	CrudTablePage *child, *sibling = NULL;
+	CrudTableLink link;
+	int pos, half, ret;
+
+	// Inner nodes pass the entry down, then take in the link of a split child
+	pos = crud_table_slot( node, filename );
+	if ( !node->leaf ) {
+		if ( (child = crud_table_page(node->links[pos].child)) == NULL ) {
+			return( -1 );
+		}
+		if ( (ret = crud_table_add(child, level-1, filename, &link)) != 1 ) {
+			return( ret );
+		}
+		pos++;
+	}
+	page->dirty = 1;
+
+	// A full node moves its upper half to a new right sibling first
+	target = node;
+	if ( node->count == (node->leaf ? CRUD_TABLE_LEAF_ENTRIES : CRUD_TABLE_NODE_LINKS) ) {
+		if ( (sibling = crud_table_new_page(node->leaf)) == NULL ) {
+			return( -1 );
+		}
+		half = node->count / 2;
+		sibling->node.count = node->count - half;
+		node->count = half;
+		if ( node->leaf ) {
+			memcpy( sibling->node.entries, &node->entries[half], sizeof(CrudFileAllocationType)*sibling->node.count );
+			sibling->node.next = node->next;
+			node->next = sibling->oid;
+		} else {
+			memcpy( sibling->node.links, &node->links[half], sizeof(CrudTableLink)*sibling->node.count );
+		}
+		if ( pos > half ) {
+			target = &sibling->node;
+			pos -= half;
+		}
+	}
+
+	// Open a slot and fill it
+	if ( target->leaf ) {
+		memmove( &target->entries[pos+1], &target->entries[pos], sizeof(CrudFileAllocationType)*(target->count-pos) );
+		memset( &target->entries[pos], 0x0, sizeof(CrudFileAllocationType) );
+		strncpy( target->entries[pos].filename, filename, CRUD_MAX_PATH_LENGTH-1 );
+	} else {
+		memmove( &target->links[pos+1], &target->links[pos], sizeof(CrudTableLink)*(target->count-pos) );
+		target->links[pos] = link;
+	}
+	target->count++;
+
+	// The parent links to the sibling by its lowest filename
+	if ( sibling == NULL ) {
+		return( 0 );
+	}
+	memset( split, 0x0, sizeof(CrudTableLink) );
+	strcpy( split->key, sibling->node.leaf ? sibling->node.entries[0].filename : sibling->node.links[0].key );
+	split->child = sibling->oid;
+	return( 1 );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : crud_table_write_shared
+// Description  : Write the counts of the shared objects to their object,
+//                replacing it when the number of shared objects changed
+//
+// Inputs       : old - set to the object replaced, deleted by the caller
+//                      once the header names the new one
+// Outputs      : 0 if successful, -1 if failure
+
+static int crud_table_write_shared( CrudOID *old ) {
+
+	// Local variables
+	CrudTableRef *refs, *ref;
+	CrudResponse response;
+	HtIterator it;
+	uint32_t n = 0;
+
+	// Laying the counts out in an array
+	refs = crud_arena_alloc( (crud_table_shared.elements+1) * sizeof(CrudTableRef) );
+	initHashTableIterator( &crud_table_shared, &it );
+	while ( (ref = iterateHashTable(&it)) != NULL ) {
+		refs[n++] = *ref;
+	}
+
+	// Same number of counts, update in place, else swap the objects
+	if ( (crud_table_header.refs != CRUD_NO_OBJECT) && (n == crud_table_header.shared) ) {
+		response = crud_io_request( create_crudrequest(crud_table_header.refs, CRUD_UPDATE, n * sizeof(CrudTableRef), CRUD_NULL_FLAG), refs );
+	} else {
+		response = 0;
+		if ( n > 0 ) {
+			response = crud_io_request( create_crudrequest(0, CRUD_CREATE, n * sizeof(CrudTableRef), CRUD_NULL_FLAG), refs );
+		}
+		if ( !(response & 0x1) ) {
+			*old = crud_table_header.refs;
+			crud_table_header.refs = (n > 0) ? (CrudOID)(response >> 32) : CRUD_NO_OBJECT;
+		}
+	}
+	crud_arena_free( refs );
+	if ( response & 0x1 ) {
+		return( -1 );
+	}
+	crud_table_header.shared = n;
+	crud_table_shared_dirty = 0;
+	return( 0 );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : crud_table_write
+// Description  : Write the changed nodes and the header to their objects
+//
+// Inputs       : none
+// Outputs      : 0 if successful, -1 if failure
+
+static int crud_table_write( void ) {
+
+	// Local variables
+	CrudTablePage *page;
+	CrudResponse response;
+	CrudOID refs = CRUD_NO_OBJECT;
+	HtIterator it;
+	char *header;
+	uint32_t written = 0;
+
+	// Each changed node is an update of its object
+	initHashTableIterator( &crud_table_pages, &it );
+	while ( (page = iterateHashTable(&it)) != NULL ) {
+		if ( page->dirty ) {
+			response = crud_io_request( create_crudrequest(page->oid, CRUD_UPDATE, sizeof(CrudTableNode), CRUD_NULL_FLAG), &page->node );
+			if ( response & 0x1 ) {
+				CRUD_LOG( LOG_ERROR_LEVEL, "CRUD table: failed writing node [OID %u]", page->oid );
+				return( -1 );
+			}
+			page->dirty = 0;
+			written++;
+		}
+	}
+
+	// The counts of shared objects are rewritten whole when they changed
+	if ( crud_table_shared_dirty && crud_table_write_shared(&refs) ) {
+		CRUD_LOG( LOG_ERROR_LEVEL, "CRUD table: failed writing the shared object counts" );
+		return( -1 );
+	}
+
+	// A table saved before it had a journal gets one, if the header has room
+	if ( (crud_table_header.journal == CRUD_NO_OBJECT) && (crud_table_header_length >= sizeof(CrudTableHeader)) &&
+			crud_journal_format(&crud_table_header.journal) ) {
+		return( -1 );
+	}
+
+	// The header goes at the start of the priority object, which keeps its
+	// size (a header from before the counts existed has no room for them)
+	header = crud_arena_alloc( crud_table_header_length );
+	memset( header, 0x0, crud_table_header_length );
+	memcpy( header, &crud_table_header, (crud_table_header_length < sizeof(CrudTableHeader)) ?
+			crud_table_header_length : sizeof(CrudTableHeader) );
+	response = crud_io_request( create_crudrequest(0, CRUD_UPDATE, crud_table_header_length, CRUD_PRIORITY_OBJECT), header );
+	crud_arena_free( header );
+	if ( response & 0x1 ) {
+		CRUD_LOG( LOG_ERROR_LEVEL, "CRUD table: failed writing the table header" );
+		return( -1 );
+	}
+
+	// The journal is in the table now, it starts over
+	if ( crud_journal_checkpoint() ) {
+		return( -1 );
+	}
+	if ( (refs != CRUD_NO_OBJECT) && (crud_io_request(create_crudrequest(refs, CRUD_DELETE, 0, CRUD_NULL_FLAG), NULL) & 0x1) ) {
+		CRUD_LOG( LOG_ERROR_LEVEL, "CRUD table: failed deleting the old shared object counts [OID %u]", refs );
+		return( -1 );
+	}
+	CRUD_LOG( LOG_INFO_LEVEL, "... file table saved (%lu files, %u levels, %u nodes written).",
+			crud_table_header.files, crud_table_header.height, written );
+	return( 0 );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : crud_table_read_shared
+// Description  : Read the counts of the shared objects named by the header
+//
+// Inputs       : none
+// Outputs      : 0 if successful, -1 if failure
+
+static int crud_table_read_shared( void ) {
+
+	// Local variables
+	CrudTableRef *refs, *ref;
+	CrudResponse response;
+	uint32_t i;
+
+	// Every count in the object goes in the count table
+	refs = crud_arena_alloc( (crud_table_header.shared+1) * sizeof(CrudTableRef) );
+	response = crud_io_request( create_crudrequest(crud_table_header.refs, CRUD_READ, crud_table_header.shared * sizeof(CrudTableRef), CRUD_NULL_FLAG), refs );
+	if ( response & 0x1 ) {
+		CRUD_LOG( LOG_ERROR_LEVEL, "CRUD table: failed reading the shared object counts [OID %u]", crud_table_header.refs );
+		crud_arena_free( refs );
+		return( -1 );
+	}
+	for ( i=0; i<crud_table_header.shared; i++ ) {
+		ref = malloc( sizeof(CrudTableRef) );
+		*ref = refs[i];
+		insertValueInHashTable( &crud_table_shared, ref->oid, ref );
+	}
+	crud_arena_free( refs );
+	return( 0 );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : crud_table_log
+// Description  : Add the record of a changed entry to the journal
+//
+// Inputs       : entry - the entry as it is now
+// Outputs      : 0 if successful, -1 if failure
+
+static int crud_table_log( const CrudFileAllocationType *entry ) {
+
+	// Local variables
+	char record[sizeof(CrudJournalPut) + CRUD_MAX_PATH_LENGTH];
+	CrudJournalPut put;
+	uint16_t len = strlen( entry->filename ) + 1;
+
+	// The fields, then the name
+	put.object_id = entry->object_id;
+	put.length = entry->length;
+	put.capacity = entry->capacity;
+	put.flags = entry->flags;
+	memcpy( record, &put, sizeof(CrudJournalPut) );
+	memcpy( &record[sizeof(CrudJournalPut)], entry->filename, len );
+	return( crud_journal_append(CRUD_JOURNAL_PUT, record, sizeof(CrudJournalPut) + len) );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : crud_table_replay
+// Description  : Apply a journal record to the table
+//
+// Inputs       : type - the CrudJournalRecordType
+//                payload - the record contents
+//                size - the bytes of payload
+// Outputs      : 0 if successful, -1 if failure
+
+static int crud_table_replay( uint16_t type, const void *payload, uint16_t size ) {
+
+	// Local variables (the payload may sit at any offset of the segment,
+	// its fields are copied out)
+	CrudJournalPut put;
+	CrudTableRef count;
+	CrudFileAllocationType *entry, changed;
+	CrudTableRef *ref;
+	const char *name = (const char *)payload + sizeof(CrudJournalPut);
+
+	// An entry is added if it is new, then set
+	if ( type == CRUD_JOURNAL_PUT ) {
+		if ( (size <= sizeof(CrudJournalPut)) || (size > sizeof(CrudJournalPut) + CRUD_MAX_PATH_LENGTH) ||
+				(name[size - sizeof(CrudJournalPut) - 1] != 0x0) || ((entry = crud_table_insert(name)) == NULL) ) {
+			return( -1 );
+		}
+		memcpy( &put, payload, sizeof(CrudJournalPut) );
+		changed = *entry;
+		changed.object_id = put.object_id;
+		changed.length = put.length;
+		changed.capacity = put.capacity;
+		changed.flags = put.flags;
+		return( crud_table_update(&changed) );
+	}
+
+	// A count is set, an object down to one user is no longer shared
+	if ( (type == CRUD_JOURNAL_REF) && (size == sizeof(CrudTableRef)) ) {
+		memcpy( &count, payload, sizeof(CrudTableRef) );
+		if ( (ref = findValueInHashTable(&crud_table_shared, count.oid)) == NULL ) {
+			ref = malloc( sizeof(CrudTableRef) );
+			ref->oid = count.oid;
+			insertValueInHashTable( &crud_table_shared, ref->oid, ref );
+		}
+		ref->count = count.count;
+		if ( ref->count <= 1 ) {
+			free( deleteValueFromHashTable(&crud_table_shared, count.oid) );
+		}
+		crud_table_shared_dirty = 1;
+		return( 0 );
+	}
+
+	// A removed entry goes again (it is gone if a checkpoint came after)
+	if ( type == CRUD_JOURNAL_DEL ) {
+		if ( (size == 0) || (size > CRUD_MAX_PATH_LENGTH) || (((const char *)payload)[size-1] != 0x0) ) {
+			return( -1 );
+		}
+		return( (crud_table_find(payload) == NULL) ? 0 : crud_table_remove(payload) );
+	}
+	return( -1 );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : crud_table_convert
+// Description  : Load the fixed table older drivers saved as the priority
+//                object into a new table, and save it
+//
+// Inputs       : legacy - the contents of the priority object
+// Outputs      : 0 if successful, -1 if failure
+
+static int crud_table_convert( CrudLegacyFileAllocationType *legacy ) {
+
+	// Local variables
+	CrudFileAllocationType *entry;
+	int i;
+
+	// Every named slot becomes an entry, files saved before the capacity
+	// existed have objects exactly the length of the file
+	crud_table_reset();
+	for ( i=0; i<CRUD_TABLE_LEGACY_FILES; i++ ) {
+		if ( legacy[i].filename[0] == 0x0 ) {
+			continue;
+		}
+		legacy[i].filename[CRUD_MAX_PATH_LENGTH-1] = 0x0;
+		if ( (entry = crud_table_insert(legacy[i].filename)) == NULL ) {
+			return( -1 );
+		}
+		entry->object_id = legacy[i].object_id;
+		entry->length = legacy[i].length;
+		entry->capacity = (legacy[i].capacity < legacy[i].length) ? legacy[i].length : legacy[i].capacity;
+	}
+
+	// Saving right away, so the conversion only ever happens once
+	CRUD_LOG( LOG_INFO_LEVEL, "... converting the fixed file table (%lu files).", crud_table_header.files );
+	return( crud_table_write() );
+}
+
+//
+// Functions
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : crud_table_format
+// Description  : Create an empty table (the object store has just been
+//                formatted)
+//
+// Inputs       : none
+// Outputs      : 0 if successful, -1 if failure
+
+int crud_table_format( void ) {
+
+	// Local variables
+	CrudResponse response;
+	char *header;
+
+	// The priority object holds the header of the empty table, with room
+	// for fields later drivers add, and names the empty journal
+	crud_table_reset();
+	if ( crud_journal_format(&crud_table_header.journal) ) {
+		return( -1 );
+	}
+	crud_table_header_length = CRUD_TABLE_HEADER_SIZE;
+	header = crud_arena_alloc( crud_table_header_length );
+	memset( header, 0x0, crud_table_header_length );
+	memcpy( header, &crud_table_header, sizeof(CrudTableHeader) );
+	response = crud_io_request( create_crudrequest(0, CRUD_CREATE, crud_table_header_length, CRUD_PRIORITY_OBJECT), header );
+	crud_arena_free( header );
+	return( (response & 0x1) ? -1 : 0 );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : crud_table_mount
+// Description  : Read the table header, converting a fixed table saved by
+//                older drivers, and replay the journal.  No node is read
+//                until a lookup needs it.
+//
+// Inputs       : none
+// Outputs      : 0 if successful, -1 if failure
+
+int crud_table_mount( void ) {
+
+	// Local variables
+	uint32_t size = CRUD_TABLE_LEGACY_FILES * sizeof(CrudLegacyFileAllocationType);
+	CrudResponse response;
+	char *buf;
+	int ret = 0;
+
+	// Reading the priority object, which is at most the size of the old table
+	crud_table_reset();
+	buf = crud_arena_alloc( size );
+	response = crud_io_request( create_crudrequest(0, CRUD_READ, size, CRUD_PRIORITY_OBJECT), buf );
+	if ( response & 0x1 ) {
+		crud_arena_free( buf );
+		return( -1 );
+	}
+	crud_table_header_length = (uint32_t)((response >> 4) & 0xffffff);
+
+	// Either a table header (shorter from before the shared counts), or
+	// the whole table of an older driver
+	if ( (crud_table_header_length >= offsetof(CrudTableHeader, refs)) && (memcmp(buf, CRUD_TABLE_MAGIC, 8) == 0) ) {
+		memcpy( &crud_table_header, buf, (crud_table_header_length < sizeof(CrudTableHeader)) ?
+				crud_table_header_length : sizeof(CrudTableHeader) );
+		if ( (crud_table_header.version != CRUD_TABLE_VERSION) || (crud_table_header.node_size != sizeof(CrudTableNode)) ) {
+			CRUD_LOG( LOG_ERROR_LEVEL, "CRUD table: unsupported table version %u (node size %u)",
+					crud_table_header.version, crud_table_header.node_size );
+			ret = -1;
+		} else if ( (crud_table_header.refs != CRUD_NO_OBJECT) && crud_table_read_shared() ) {
+			ret = -1;
+		} else {
+			ret = crud_journal_mount( crud_table_header.journal, crud_table_replay );
+		}
+	} else if ( crud_table_header_length == size ) {
+		ret = crud_table_convert( (CrudLegacyFileAllocationType *)buf );
+	} else {
+		CRUD_LOG( LOG_ERROR_LEVEL, "CRUD table: bad priority object (%u bytes)", crud_table_header_length );
+		ret = -1;
+	}
+	crud_arena_free( buf );
+	return( ret );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : crud_table_unmount
+// Description  : Write back the changed nodes and the header, then drop the
+//                loaded nodes
+//
+// Inputs       : none
+// Outputs      : 0 if successful, -1 if failure
+
+int crud_table_unmount( void ) {
+
+	// Save, then forget the table (the next mount reads it again)
+	if ( crud_table_write() ) {
+		return( -1 );
+	}
+	crud_table_reset();
+	return( 0 );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : crud_table_find
+// Description  : Find the entry of a file
+//
+// Inputs       : filename - the filename
+// Outputs      : the entry (valid until the next insert) or NULL if none
+
+CrudFileAllocationType *crud_table_find( const char *filename ) {
+
+	// Local variables
+	CrudTablePage *page;
+	int pos;
+
+	// Searching the leaf the filename belongs in
+	if ( (page = crud_table_leaf(filename)) == NULL ) {
+		return( NULL );
+	}
+	pos = crud_table_slot( &page->node, filename );
+	if ( (pos < page->node.count) && (strcmp(page->node.entries[pos].filename, filename) == 0) ) {
+		return( &page->node.entries[pos] );
+	}
+	return( NULL );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : crud_table_insert
+// Description  : Find the entry of a file, adding an empty one if there is
+//                none (the table grows a level when the root splits).  The
+//                entry is journaled when the caller stores its fields.
+//
+// Inputs       : filename - the filename
+// Outputs      : the entry (valid until the next insert) or NULL if failure
+
+CrudFileAllocationType *crud_table_insert( const char *filename ) {
+
+	// Local variables
+	CrudFileAllocationType *entry;
+	CrudTablePage *page, *root;
+	CrudTableLink split;
+	int ret;
+
+	// Checking the name, returning an existing entry
+	if ( strlen(filename) >= CRUD_MAX_PATH_LENGTH ) {
+		return( NULL );
+	}
+	if ( (entry = crud_table_find(filename)) != NULL ) {
+		return( entry );
+	}
+
+	// The first file makes a root leaf
+	if ( crud_table_header.root == CRUD_NO_OBJECT ) {
+		if ( (page = crud_table_new_page(1)) == NULL ) {
+			return( NULL );
+		}
+		crud_table_header.root = page->oid;
+		crud_table_header.height = 1;
+	} else if ( (page = crud_table_page(crud_table_header.root)) == NULL ) {
+		return( NULL );
+	}
+
+	// Adding the entry, a split root gets a new root above it
+	if ( (ret = crud_table_add(page, crud_table_header.height, filename, &split)) == -1 ) {
+		return( NULL );
+	}
+	if ( ret == 1 ) {
+		if ( (root = crud_table_new_page(0)) == NULL ) {
+			return( NULL );
+		}
+		root->node.count = 2;
+		root->node.links[0].child = page->oid;
+		root->node.links[1] = split;
+		crud_table_header.root = root->oid;
+		crud_table_header.height++;
+	}
+	crud_table_header.files++;
+	crud_table_changes++;
+	return( crud_table_find(filename) );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : crud_table_update
+// Description  : Store a changed entry in the table (and the journal, unless
+//                it stays a scratch file)
+//
+// Inputs       : entry - the entry (matched by filename)
+// Outputs      : 0 if successful, -1 if the file is not in the table
+
+int crud_table_update( const CrudFileAllocationType *entry ) {
+
+	// Local variables
+	CrudTablePage *page;
+	uint32_t flags;
+	int pos, fresh;
+
+	// Overwriting the entry in its leaf, if it changed
+	if ( (page = crud_table_leaf(entry->filename)) == NULL ) {
+		return( -1 );
+	}
+	pos = crud_table_slot( &page->node, entry->filename );
+	if ( (pos == page->node.count) || (strcmp(page->node.entries[pos].filename, entry->filename) != 0) ) {
+		return( -1 );
+	}
+	if ( memcmp(&page->node.entries[pos], entry, sizeof(CrudFileAllocationType)) != 0 ) {
+		flags = page->node.entries[pos].flags;
+		fresh = (flags == 0) && (page->node.entries[pos].object_id == CRUD_NO_OBJECT) && (page->node.entries[pos].length == 0);
+		if ( (flags ^ entry->flags) & CRUD_FILE_SCRATCH ) {
+			if ( entry->flags & CRUD_FILE_SCRATCH ) {
+				crud_table_header.scratch++;
+			} else {
+				crud_table_header.scratch--;
+			}
+		}
+		page->node.entries[pos] = *entry;
+		page->dirty = 1;
+
+		// Scratch entries are never journaled, nor is the empty entry one
+		// replaces when it is created (a file made scratch later is)
+		if ( (entry->flags & CRUD_FILE_SCRATCH) && ((flags & CRUD_FILE_SCRATCH) || fresh) ) {
+			return( 0 );
+		}
+		return( crud_table_log(entry) );
+	}
+	return( 0 );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : crud_table_remove
+// Description  : Remove the entry of a file from its leaf.  Leaves are not
+//                merged, one left empty stays in the table for the names
+//                that sort into it.
+//
+// Inputs       : filename - the filename
+// Outputs      : 0 if successful, -1 if the file is not in the table
+
+int crud_table_remove( const char *filename ) {
+
+	// Local variables
+	CrudTablePage *page;
+	uint32_t flags;
+	int pos;
+
+	// Finding the entry, then closing the gap it leaves
+	if ( (page = crud_table_leaf(filename)) == NULL ) {
+		return( -1 );
+	}
+	pos = crud_table_slot( &page->node, filename );
+	if ( (pos == page->node.count) || (strcmp(page->node.entries[pos].filename, filename) != 0) ) {
+		return( -1 );
+	}
+	flags = page->node.entries[pos].flags;
+	memmove( &page->node.entries[pos], &page->node.entries[pos+1],
+			(page->node.count - pos - 1) * sizeof(CrudFileAllocationType) );
+	page->node.count--;
+	page->dirty = 1;
+	crud_table_header.files--;
+	crud_table_changes++;
+
+	// A scratch file was never journaled, its removal is not either
+	if ( flags & CRUD_FILE_SCRATCH ) {
+		crud_table_header.scratch--;
+		return( 0 );
+	}
+	return( crud_journal_append(CRUD_JOURNAL_DEL, filename, strlen(filename) + 1) );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : crud_table_seek
+// Description  : Position a cursor at the first entry whose filename is not
+//                below key, so the entries sharing a prefix are walked by
+//                seeking to the prefix
+//
+// Inputs       : cursor - the cursor
+//                key - the filename (or prefix) to start at
+// Outputs      : 0 if successful, -1 if failure
+
+int crud_table_seek( CrudTableCursor *cursor, const char *key ) {
+
+	// Local variables
+	CrudTablePage *page;
+
+	// An empty table has nothing to walk
+	cursor->leaf = CRUD_NO_OBJECT;
+	cursor->pos = 0;
+	if ( crud_table_header.root == CRUD_NO_OBJECT ) {
+		return( 0 );
+	}
+	if ( (page = crud_table_leaf(key)) == NULL ) {
+		return( -1 );
+	}
+	cursor->leaf = page->oid;
+	cursor->pos = crud_table_slot( &page->node, key );
+	return( 0 );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : crud_table_next
+// Description  : Get the entry at a cursor and advance it, following the
+//                leaves in filename order
+//
+// Inputs       : cursor - the cursor
+// Outputs      : the entry (valid until the next insert) or NULL at the end
+
+CrudFileAllocationType *crud_table_next( CrudTableCursor *cursor ) {
+
+	// Local variables
+	CrudTablePage *page;
+
+	// Moving to the next leaf when this one is used up
+	while ( cursor->leaf != CRUD_NO_OBJECT ) {
+		if ( (page = crud_table_page(cursor->leaf)) == NULL ) {
+			cursor->leaf = CRUD_NO_OBJECT;
+			return( NULL );
+		}
+		if ( cursor->pos < page->node.count ) {
+			return( &page->node.entries[cursor->pos++] );
+		}
+		cursor->leaf = page->node.next;
+		cursor->pos = 0;
+	}
+	return( NULL );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : crud_table_generation
+// Description  : Get the count of changes that moved entries, a cursor taken
+//                before the count changed must seek again
+//
+// Inputs       : none
+// Outputs      : the count
+
+uint64_t crud_table_generation( void ) {
+	return( crud_table_changes );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : crud_table_files
+// Description  : Get the number of files in the table
+//
+// Inputs       : none
+// Outputs      : the number of files
+
+uint64_t crud_table_files( void ) {
+	return( crud_table_header.files );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : crud_table_scratch
+// Description  : Get the number of scratch entries in the table
+//
+// Inputs       : none
+// Outputs      : the number of scratch entries
+
+uint32_t crud_table_scratch( void ) {
+	return( crud_table_header.scratch );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : crud_table_height
+// Description  : Get the number of levels in the table
+//
+// Inputs       : none
+// Outputs      : the number of levels (0 when empty)
+
+uint32_t crud_table_height( void ) {
+	return( crud_table_header.height );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : crud_table_loaded
+// Description  : Get the number of table nodes in memory
+//
+// Inputs       : none
+// Outputs      : the number of nodes
+
+uint64_t crud_table_loaded( void ) {
+	return( crud_table_ready ? crud_table_pages.elements : 0 );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : crud_table_commit
+// Description  : Make the changes to the table durable: the journal records
+//                are group committed when a group is due (or when forced),
+//                and the table is written whole when the journal is large
+//                enough that replaying it would be slow.  Such a checkpoint
+//                also makes the store durable (the lazy files with it).
+//                Without a journal only a forced commit writes the table.
+//
+// Inputs       : force - nonzero to commit even if no group is due
+// Outputs      : 0 if successful, -1 if failure
+
+int crud_table_commit( int force ) {
+
+	// Without a journal the only way is the whole table
+	if ( !crud_journal_active() ) {
+		return( force ? crud_table_write() : 0 );
+	}
+
+	// Committing the group, then checkpointing a long journal
+	if ( !force && !crud_journal_due() ) {
+		return( 0 );
+	}
+	if ( crud_journal_commit() ) {
+		return( -1 );
+	}
+	if ( crud_journal_bytes() < CRUD_JOURNAL_CHECKPOINT_SIZE ) {
+		return( 0 );
+	}
+	return( (crud_table_write() || crud_io_sync()) ? -1 : 0 );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : crud_table_heatmap
+// Description  : Get the object of the access heatmap saved at the last
+//                unmount
+//
+// Inputs       : none
+// Outputs      : the object (CRUD_NO_OBJECT if none)
+
+CrudOID crud_table_heatmap( void ) {
+	return( crud_table_header.heatmap );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : crud_table_set_heatmap
+// Description  : Name the object of the access heatmap in the header, which
+//                is written at the next checkpoint or unmount
+//
+// Inputs       : oid - the object (CRUD_NO_OBJECT for none)
+// Outputs      : 0 if successful, -1 if the header has no room for it
+
+int crud_table_set_heatmap( CrudOID oid ) {
+
+	// A header from before the heatmap existed has no room for it
+	if ( crud_table_header_length < sizeof(CrudTableHeader) ) {
+		return( -1 );
+	}
+	crud_table_header.heatmap = oid;
+	return( 0 );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : crud_table_refs
+// Description  : Get the number of users of an object
+//
+// Inputs       : oid - the object
+// Outputs      : the number of users (1 unless the object is shared)
+
+uint32_t crud_table_refs( CrudOID oid ) {
+
+	// Local variables
+	CrudTableRef *ref;
+
+	// Only shared objects have a count
+	if ( !crud_table_ready || ((ref = findValueInHashTable(&crud_table_shared, oid)) == NULL) ) {
+		return( 1 );
+	}
+	return( ref->count );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : crud_table_ref
+// Description  : Add a user to an object
+//
+// Inputs       : oid - the object
+// Outputs      : 0 if successful, -1 if failure
+
+int crud_table_ref( CrudOID oid ) {
+
+	// Local variables
+	CrudTableRef *ref;
+
+	// The counts need room in the header, and fit in one object
+	if ( crud_table_header_length < sizeof(CrudTableHeader) ) {
+		CRUD_LOG( LOG_ERROR_LEVEL, "CRUD table: the table header has no room for shared objects, format to share." );
+		return( -1 );
+	}
+
+	// An object shared for the first time has two users
+	if ( (ref = findValueInHashTable(&crud_table_shared, oid)) != NULL ) {
+		ref->count++;
+	} else {
+		if ( crud_table_shared.elements >= CRUD_TABLE_MAX_SHARED ) {
+			CRUD_LOG( LOG_ERROR_LEVEL, "CRUD table: too many shared objects." );
+			return( -1 );
+		}
+		ref = malloc( sizeof(CrudTableRef) );
+		ref->oid = oid;
+		ref->count = 2;
+		insertValueInHashTable( &crud_table_shared, oid, ref );
+	}
+	crud_table_shared_dirty = 1;
+	return( crud_journal_append(CRUD_JOURNAL_REF, ref, sizeof(CrudTableRef)) );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : crud_table_unref
+// Description  : Drop a user of an object
+//
+// Inputs       : oid - the object
+// Outputs      : the users left, 0 when the object should be deleted
+
+uint32_t crud_table_unref( CrudOID oid ) {
+
+	// Local variables
+	CrudTableRef *ref;
+	uint32_t count;
+
+	// An object with one user is no longer used
+	if ( !crud_table_ready || ((ref = findValueInHashTable(&crud_table_shared, oid)) == NULL) ) {
+		return( 0 );
+	}
+	count = --ref->count;
+	crud_journal_append( CRUD_JOURNAL_REF, ref, sizeof(CrudTableRef) );
+	if ( count == 1 ) {
+		free( deleteValueFromHashTable(&crud_table_shared, oid) );
+	}
+	crud_table_shared_dirty = 1;
+	return( count );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : crudTableUnitTest
+// Description  : Perform a test of the file table: fill it far past the old
+//                fixed table, check the leaves are in order, and check a
+//                lookup after a remount only reads the nodes on its path
+//
+// Inputs       : none
+// Outputs      : 0 if successful, -1 if failure
+
+int crudTableUnitTest( void ) {
+
+	// Local variables
+	CrudFileAllocationType *entry;
+	CrudTablePage *page;
+	char name[CRUD_MAX_PATH_LENGTH], last[CRUD_MAX_PATH_LENGTH];
+	uint32_t *order, i, j, tmp, val;
+	int16_t fh;
+	uint64_t count;
+
+	// Start with an empty file system
+	if ( crud_format() || crud_mount() ) {
+		CRUD_LOG( LOG_ERROR_LEVEL, "CRUD_TABLE_UNIT_TEST : format or mount failed." );
+		return( -1 );
+	}
+
+	// Add the files in a random order, tagging each entry with its number
+	order = malloc( CRUD_TABLE_UNIT_TEST_FILES * sizeof(uint32_t) );
+	for ( i=0; i<CRUD_TABLE_UNIT_TEST_FILES; i++ ) {
+		order[i] = i;
+	}
+	for ( i=CRUD_TABLE_UNIT_TEST_FILES-1; i>0; i-- ) {
+		j = getRandomValue( 0, i );
+		tmp = order[i];
+		order[i] = order[j];
+		order[j] = tmp;
+	}
+	for ( i=0; i<CRUD_TABLE_UNIT_TEST_FILES; i++ ) {
+		snprintf( name, CRUD_MAX_PATH_LENGTH, "dir%02u/file%06u.dat", order[i]%17, order[i] );
+		if ( (entry = crud_table_insert(name)) == NULL ) {
+			CRUD_LOG( LOG_ERROR_LEVEL, "CRUD_TABLE_UNIT_TEST : insert of [%s] failed.", name );
+			return( -1 );
+		}
+		entry->object_id = order[i] + 1;
+		entry->length = order[i];
+		entry->capacity = order[i];
+		if ( crud_table_insert(name) != entry ) {
+			CRUD_LOG( LOG_ERROR_LEVEL, "CRUD_TABLE_UNIT_TEST : second insert of [%s] added an entry.", name );
+			return( -1 );
+		}
+	}
+	if ( crud_table_files() != CRUD_TABLE_UNIT_TEST_FILES ) {
+		CRUD_LOG( LOG_ERROR_LEVEL, "CRUD_TABLE_UNIT_TEST : bad file count [%lu].", crud_table_files() );
+		return( -1 );
+	}
+
+	// Walk the leaves from the leftmost, the names must be strictly increasing
+	page = crud_table_page( crud_table_header.root );
+	for ( i=crud_table_header.height; i>1; i-- ) {
+		page = crud_table_page( page->node.links[0].child );
+	}
+	count = 0;
+	last[0] = 0x0;
+	while ( page != NULL ) {
+		for ( i=0; i<page->node.count; i++ ) {
+			if ( strcmp(last, page->node.entries[i].filename) >= 0 ) {
+				CRUD_LOG( LOG_ERROR_LEVEL, "CRUD_TABLE_UNIT_TEST : leaves out of order at [%s].", page->node.entries[i].filename );
+				return( -1 );
+			}
+			strcpy( last, page->node.entries[i].filename );
+			count++;
+		}
+		page = (page->node.next == CRUD_NO_OBJECT) ? NULL : crud_table_page( page->node.next );
+	}
+	if ( count != CRUD_TABLE_UNIT_TEST_FILES ) {
+		CRUD_LOG( LOG_ERROR_LEVEL, "CRUD_TABLE_UNIT_TEST : leaves hold %lu files.", count );
+		return( -1 );
+	}
+
+	// After a remount nothing is loaded, a lookup reads one node per level
+	if ( crud_unmount() || crud_mount() || (crud_table_loaded() != 0) ) {
+		CRUD_LOG( LOG_ERROR_LEVEL, "CRUD_TABLE_UNIT_TEST : remount failed." );
+		return( -1 );
+	}
+	for ( i=0; i<CRUD_TABLE_UNIT_TEST_LOOKUPS; i++ ) {
+		j = getRandomValue( 0, CRUD_TABLE_UNIT_TEST_FILES-1 );
+		snprintf( name, CRUD_MAX_PATH_LENGTH, "dir%02u/file%06u.dat", j%17, j );
+		entry = crud_table_find( name );
+		if ( (entry == NULL) || (entry->object_id != j+1) || (entry->length != j) ) {
+			CRUD_LOG( LOG_ERROR_LEVEL, "CRUD_TABLE_UNIT_TEST : lookup of [%s] failed after remount.", name );
+			return( -1 );
+		}
+		if ( (i == 0) && (crud_table_loaded() != crud_table_header.height) ) {
+			CRUD_LOG( LOG_ERROR_LEVEL, "CRUD_TABLE_UNIT_TEST : lookup read %lu nodes for %u levels.",
+					crud_table_loaded(), crud_table_header.height );
+			return( -1 );
+		}
+	}
+	if ( crud_table_find("dir00/missing") != NULL ) {
+		CRUD_LOG( LOG_ERROR_LEVEL, "CRUD_TABLE_UNIT_TEST : found a file never added." );
+		return( -1 );
+	}
+	free( order );
+
+	// Hold more files open at once than the old table had entries
+	for ( i=0; i<CRUD_TABLE_UNIT_TEST_HANDLES; i++ ) {
+		snprintf( name, CRUD_MAX_PATH_LENGTH, "open/file%06u", i );
+		if ( ((fh = crud_open(name)) != i) || (crud_write(fh, &i, sizeof(i)) != sizeof(i)) ) {
+			CRUD_LOG( LOG_ERROR_LEVEL, "CRUD_TABLE_UNIT_TEST : open/write of [%s] failed.", name );
+			return( -1 );
+		}
+	}
+	for ( i=0; i<CRUD_TABLE_UNIT_TEST_HANDLES; i++ ) {
+		if ( crud_close(i) ) {
+			CRUD_LOG( LOG_ERROR_LEVEL, "CRUD_TABLE_UNIT_TEST : close of [%u] failed.", i );
+			return( -1 );
+		}
+	}
+	if ( crud_unmount() || crud_mount() ) {
+		CRUD_LOG( LOG_ERROR_LEVEL, "CRUD_TABLE_UNIT_TEST : remount failed." );
+		return( -1 );
+	}
+	for ( i=0; i<CRUD_TABLE_UNIT_TEST_HANDLES; i+=7 ) {
+		snprintf( name, CRUD_MAX_PATH_LENGTH, "open/file%06u", i );
+		if ( ((fh = crud_open(name)) == -1) || (crud_read(fh, &val, sizeof(val)) != sizeof(val)) ||
+				(val != i) || crud_close(fh) ) {
+			CRUD_LOG( LOG_ERROR_LEVEL, "CRUD_TABLE_UNIT_TEST : read back of [%s] failed.", name );
+			return( -1 );
+		}
+	}
+
+	// Leave the file system unmounted
+	CRUD_LOG( LOG_INFO_LEVEL, "CRUD_TABLE_UNIT_TEST : %u files in %u levels, test successful.",
+			CRUD_TABLE_UNIT_TEST_FILES, crud_table_header.height );
+	if ( crud_unmount() ) {
+		CRUD_LOG( LOG_ERROR_LEVEL, "CRUD_TABLE_UNIT_TEST : unmount failed." );
+		return( -1 );
+	}
+	return( 0 );
+}
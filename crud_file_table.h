@@ -0,0 +1,170 @@
+#ifndef CRUD_FILE_TABLE_INCLUDED
+#define CRUD_FILE_TABLE_INCLUDED
+
+////////////////////////////////////////////////////////////////////////////////
+//
+//  File           : crud_file_table.h
+//  Description    : This is the interface for the file allocation table of
+//                   the CRUD file system.  The table is a B+tree ordered by
+//                   filename whose nodes are each kept in their own object,
+//                   read on demand and written back at unmount.  The
+//                   priority object holds the table header.  The table
+//                   also counts the users of objects shared by clones, and
+//                   journals its changes between checkpoints, and names
+//                   the access heatmap of the files.
+//
+//  Last Modified  : Sun Oct 18 23:41:17 EDT 2026
+//
+
+// Includes
+#include <stdint.h>
+
+// Project Includes
+#include <crud_driver.h>
+
+// Defines
+#define CRUD_MAX_PATH_LENGTH 128
+#define CRUD_TABLE_MAGIC "CRUDFAT2"
+#define CRUD_TABLE_VERSION 2
+#define CRUD_TABLE_NODE_SIZE 16384     // bytes in a table node (and its object)
+#define CRUD_TABLE_NODE_HEADER 8       // bytes of the node before the entries
+#define CRUD_TABLE_LEAF_ENTRIES ((CRUD_TABLE_NODE_SIZE-CRUD_TABLE_NODE_HEADER)/sizeof(CrudFileAllocationType))
+#define CRUD_TABLE_NODE_LINKS ((CRUD_TABLE_NODE_SIZE-CRUD_TABLE_NODE_HEADER)/sizeof(CrudTableLink))
+#define CRUD_TABLE_LEGACY_FILES 1024   // entries of the fixed table older drivers saved
+#define CRUD_TABLE_HEADER_SIZE 256     // bytes of the priority object (room for the header to grow)
+#define CRUD_TABLE_MAX_SHARED (CRUD_MAX_OBJECT_SIZE/sizeof(CrudTableRef))
+
+// Entry flags
+#define CRUD_FILE_DIRECTORY 0x1        // the entry is a directory ("name/", no object)
+#define CRUD_FILE_SPARSE 0x2           // the object is the chunk map of a sparse file
+#define CRUD_FILE_FROZEN 0x4           // the file is part of a snapshot (read only)
+#define CRUD_FILE_SCRATCH 0x8          // the file is never persisted (dropped at unmount and mount)
+#define CRUD_FILE_SYNC 0x10            // crud_fsync makes the file durable
+
+// Type definitions
+
+// This is the table entry of a file (kept in the leaves, sorted by filename)
+typedef struct {
+	char      filename[CRUD_MAX_PATH_LENGTH]; // The filename of the data to be manipulated
+	CrudOID   object_id;                      // The handle of the object
+	uint32_t  length;                         // This is the length of the file
+	uint32_t  capacity;                       // This is the size of the object (>= length)
+	uint32_t  flags;                          // Flags of the entry (CRUD_FILE_*)
+} CrudFileAllocationType;
+
+// This is a link from an inner node to a child, keyed by the smallest
+// filename under the child (the first link of the leftmost nodes is "")
+typedef struct {
+	char      key[CRUD_MAX_PATH_LENGTH]; // The lowest filename in the child
+	CrudOID   child;                     // The object of the child node
+} CrudTableLink;
+
+// This is a table node, the contents of its object
+typedef struct {
+	uint16_t  leaf;  // Nonzero for leaves (entries), zero for inner nodes (links)
+	uint16_t  count; // The number of entries or links
+	CrudOID   next;  // The next leaf in filename order (leaves only)
+	union {
+		CrudFileAllocationType entries[CRUD_TABLE_LEAF_ENTRIES];
+		CrudTableLink          links[CRUD_TABLE_NODE_LINKS];
+	};
+} CrudTableNode;
+
+// This is a position in the table for walking entries in filename order
+// (only valid while no entry is added, see crud_table_generation)
+typedef struct {
+	CrudOID   leaf;       // The leaf of the next entry (CRUD_NO_OBJECT at the end)
+	uint16_t  pos;        // The index of the next entry in the leaf
+} CrudTableCursor;
+
+// This is the number of users of a shared object (kept for counts above 1)
+typedef struct {
+	CrudOID   oid;       // The shared object
+	uint32_t  count;     // The number of files (or chunk maps) using it
+} CrudTableRef;
+
+// This is the table header kept at the start of the priority object
+typedef struct {
+	char      magic[8];  // CRUD_TABLE_MAGIC
+	uint32_t  version;   // CRUD_TABLE_VERSION
+	uint32_t  node_size; // CRUD_TABLE_NODE_SIZE
+	CrudOID   root;      // The root node (CRUD_NO_OBJECT if the table is empty)
+	uint32_t  height;    // The number of levels (1 when the root is a leaf)
+	uint64_t  files;     // The number of entries in the table
+	CrudOID   refs;      // The object of the shared object counts (CRUD_NO_OBJECT if none)
+	uint32_t  shared;    // The number of CrudTableRef in it
+	CrudOID   journal;   // The anchor of the metadata journal (CRUD_NO_OBJECT if none)
+	uint32_t  scratch;   // The number of scratch entries (dropped at mount)
+	CrudOID   heatmap;   // The object of the access heatmap (CRUD_NO_OBJECT if none)
+} CrudTableHeader;
+
+//
+// Table interface
+
+int crud_table_format( void );
+	// Create an empty table (the object store has just been formatted)
+
+int crud_table_mount( void );
+	// Read the table header, converting a fixed table saved by older drivers
+
+int crud_table_unmount( void );
+	// Write back the changed nodes and the header, then drop the loaded nodes
+
+CrudFileAllocationType *crud_table_find( const char *filename );
+	// Find the entry of a file (NULL if none), valid until the next insert
+
+CrudFileAllocationType *crud_table_insert( const char *filename );
+	// Find the entry of a file, adding an empty one if there is none
+
+int crud_table_update( const CrudFileAllocationType *entry );
+	// Store a changed entry (matched by filename) in the table
+
+int crud_table_remove( const char *filename );
+	// Remove the entry of a file (its objects are the caller's to drop)
+
+int crud_table_commit( int force );
+	// Group commit the journal when due (or forced), checkpointing a long one
+
+int crud_table_seek( CrudTableCursor *cursor, const char *key );
+	// Position a cursor at the first entry not below key
+
+CrudFileAllocationType *crud_table_next( CrudTableCursor *cursor );
+	// Get the entry at the cursor and advance it (NULL at the end)
+
+uint64_t crud_table_generation( void );
+	// Count of changes that move entries (cursors from before a change are stale)
+
+uint64_t crud_table_files( void );
+	// Number of files in the table
+
+uint32_t crud_table_scratch( void );
+	// Number of scratch entries in the table
+
+uint32_t crud_table_height( void );
+	// Number of levels in the table
+
+uint64_t crud_table_loaded( void );
+	// Number of table nodes in memory
+
+CrudOID crud_table_heatmap( void );
+	// The object of the access heatmap saved at the last unmount
+
+int crud_table_set_heatmap( CrudOID oid );
+	// Name the object of the access heatmap in the header written next
+
+uint32_t crud_table_refs( CrudOID oid );
+	// Number of users of an object (1 unless a clone shares it)
+
+int crud_table_ref( CrudOID oid );
+	// Add a user to an object, which is now shared
+
+uint32_t crud_table_unref( CrudOID oid );
+	// Drop a user of an object, returning the users left (0: delete the object)
+
+//
+// Unit testing for the module
+
+int crudTableUnitTest( void );
+	// Perform a test of the file table
+
+#endif
@@ -0,0 +1,832 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+//  File           : crud_heatmap.c
+//  Description    : This is the access heatmap of the CRUD file system.  A
+//                   file counts its reads and writes while it is open, and
+//                   each close adds them to the file's count in the
+//                   heatmap, which is halved for every CRUD_HEATMAP_HALF_LIFE
+//                   closes of files since the file was last used (so the
+//                   count weighs how often and how lately).  At unmount
+//                   the hottest files are saved, with the object and size
+//                   each had, in an object the table header names.  The
+//                   next mount reads it back and starts a thread reading
+//                   the objects of the hottest files into a warm cache;
+//                   a read of an object there copies it instead of going
+//                   to the device.  Every request changing an object drops
+//                   it from the cache, so the cache never holds stale data
+//                   (the objects saved may no longer be the files', they
+//                   are then never asked for).
+//
+//  Last Modified  : Sun Oct 18 23:41:17 EDT 2026
+//
+
+// Includes
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <stdatomic.h>
+
+// Project Includes
+#include <crud_heatmap.h>
+#include <crud_file_io.h>
+#include <crud_file_table.h>
+#include <crud_journal.h>
+#include <crud_recycle.h>
+#include <crud_log.h>
+#include <cmpsc311_hashtable.h>
+
+// Defines
+#define CRUD_HEATMAP_HASH_BITS 8                // bits of the hash table of the warm cache
+#define CRUD_HEATMAP_UNIT_TEST_HOT 4            // hot files of the test
+#define CRUD_HEATMAP_UNIT_TEST_SIZE 5000        // bytes in each file of the test
+#define CRUD_HEATMAP_UNIT_TEST_USES 20          // times the test opens each hot file
+#define CRUD_HEATMAP_UNIT_TEST_WAIT 5000        // milliseconds the test waits for the cache to warm
+
+// Type definitions
+
+// This is a file in the heatmap
+typedef struct {
+	char      filename[CRUD_MAX_PATH_LENGTH]; // The name of the file
+	CrudOID   oid;                            // The object it had when last used
+	uint32_t  size;                           // The size of the object (0 to never read it)
+	uint32_t  count;                          // The uses, halved every CRUD_HEATMAP_HALF_LIFE closes
+	uint32_t  last;                           // The clock when last used
+} CrudHeatmapFile;
+
+// This is the start of the saved heatmap, followed by a record of each
+// file: a CrudHeatmapRecord, the length of the name (one byte) and the name
+typedef struct {
+	char      magic[8];  // CRUD_HEATMAP_MAGIC
+	uint32_t  clock;     // The clock (closes of files counted so far)
+	uint32_t  files;     // The number of records, hottest first
+} CrudHeatmapHeader;
+
+// This is the fixed part of the saved record of a file
+typedef struct {
+	CrudOID   oid;       // The object of the file
+	uint32_t  size;      // Its size
+	uint32_t  count;     // The uses of the file
+	uint32_t  last;      // The clock when last used
+} CrudHeatmapRecord;
+
+//
+// Module local data
+
+// The heatmap, only touched by the callers of the driver (with its lock)
+static CrudHeatmapFile *crud_heatmap_files;    // The files
+static uint32_t crud_heatmap_nfiles;           // The number of files
+static uint32_t crud_heatmap_file_slots;       // The size of the array
+static int32_t *crud_heatmap_index;            // Open addressing index of file + 1 by name (0 is empty)
+static uint32_t crud_heatmap_index_slots;      // The size of the index (a power of two)
+static uint32_t crud_heatmap_clock;            // Closes of files counted
+static uint8_t crud_heatmap_touched;           // Flag indicating files were used since the heatmap was read
+static CrudOID crud_heatmap_saved;             // The object the heatmap was read from
+static uint32_t crud_heatmap_saved_size;       // Its size
+
+// The warm cache and the thread filling it
+static pthread_mutex_t crud_heatmap_mutex = PTHREAD_MUTEX_INITIALIZER; // Guards the cache
+static HTable crud_heatmap_cache;              // The objects in the cache by OID
+static uint8_t crud_heatmap_ready;             // Flag indicating the hash table is set up
+static atomic_uint crud_heatmap_cached;        // The number of objects in the cache (no lock needed to see it is empty)
+static CrudRecycleObject *crud_heatmap_queue;  // The objects to read, hottest first
+static uint32_t crud_heatmap_nqueue;           // The number of objects to read
+static pthread_t crud_heatmap_thread;          // The thread reading them
+static uint8_t crud_heatmap_running;           // Flag indicating the thread was started
+static uint8_t crud_heatmap_stopping;          // Flag telling the thread to finish
+static uint8_t crud_heatmap_idle;              // Flag indicating the thread is done
+static uint64_t crud_heatmap_prefetched;       // Objects read into the cache
+static uint64_t crud_heatmap_bytes;            // Their bytes
+static uint64_t crud_heatmap_hits;             // Reads served by the cache
+
+//
+// Module local methods
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : crud_heatmap_hash
+// Description  : Hashes a name for the index of the heatmap (FNV-1a)
+//
+// Inputs       : name - the name
+// Outputs      : the hash
+
+static uint32_t crud_heatmap_hash( const char *name ) {
+
+	// Local variables
+	uint32_t hash = 2166136261u;
+
+	while ( *name ) {
+		hash = (hash ^ (uint8_t)*name++) * 16777619u;
+	}
+	return( hash );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : crud_heatmap_score
+// Description  : Get the count of a file as of now, halved once for every
+//                CRUD_HEATMAP_HALF_LIFE closes since the file was last used
+//
+// Inputs       : file - the file
+// Outputs      : the count
+
+static uint32_t crud_heatmap_score( const CrudHeatmapFile *file ) {
+
+	// Local variables
+	uint32_t halvings = (crud_heatmap_clock - file->last) / CRUD_HEATMAP_HALF_LIFE;
+
+	return( (halvings >= 32) ? 0 : (file->count >> halvings) );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : crud_heatmap_compare
+// Description  : Order files hottest first, the most lately used first when
+//                the counts are the same (for qsort)
+//
+// Inputs       : a, b - the files
+// Outputs      : <0 if a comes first, >0 if b does, 0 if the same
+
+static int crud_heatmap_compare( const void *a, const void *b ) {
+
+	// Local variables
+	const CrudHeatmapFile *fa = a, *fb = b;
+	uint32_t sa = crud_heatmap_score( fa ), sb = crud_heatmap_score( fb );
+
+	if ( sa != sb ) {
+		return( (sa > sb) ? -1 : 1 );
+	}
+	return( (int32_t)(fb->last - fa->last) );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : crud_heatmap_reindex
+// Description  : Rebuild the index of the files by name, twice the size of
+//                the array so probes stay short
+//
+// Inputs       : none
+// Outputs      : none
+
+static void crud_heatmap_reindex( void ) {
+
+	// Local variables
+	uint32_t i, j, mask;
+
+	free( crud_heatmap_index );
+	crud_heatmap_index_slots = 16;
+	while ( crud_heatmap_index_slots < crud_heatmap_file_slots * 2 ) {
+		crud_heatmap_index_slots *= 2;
+	}
+	crud_heatmap_index = calloc( crud_heatmap_index_slots, sizeof(int32_t) );
+	mask = crud_heatmap_index_slots - 1;
+	for ( i=0; i<crud_heatmap_nfiles; i++ ) {
+		for ( j=crud_heatmap_hash(crud_heatmap_files[i].filename)&mask; crud_heatmap_index[j]!=0; j=(j+1)&mask );
+		crud_heatmap_index[j] = i + 1;
+	}
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : crud_heatmap_trim
+// Description  : Sort the files hottest first and keep the hottest
+//
+// Inputs       : keep - the number of files to keep
+// Outputs      : none
+
+static void crud_heatmap_trim( uint32_t keep ) {
+	qsort( crud_heatmap_files, crud_heatmap_nfiles, sizeof(CrudHeatmapFile), crud_heatmap_compare );
+	if ( crud_heatmap_nfiles > keep ) {
+		crud_heatmap_nfiles = keep;
+	}
+	crud_heatmap_reindex();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : crud_heatmap_find
+// Description  : Find the file of a name, adding it if it is not there
+//
+// Inputs       : filename - the name of the file
+// Outputs      : the file
+
+static CrudHeatmapFile *crud_heatmap_find( const char *filename ) {
+
+	// Local variables
+	uint32_t i, mask;
+	CrudHeatmapFile *file;
+
+	// Looking the name up
+	if ( crud_heatmap_index != NULL ) {
+		mask = crud_heatmap_index_slots - 1;
+		for ( i=crud_heatmap_hash(filename)&mask; crud_heatmap_index[i]!=0; i=(i+1)&mask ) {
+			file = &crud_heatmap_files[crud_heatmap_index[i]-1];
+			if ( strcmp(file->filename, filename) == 0 ) {
+				return( file );
+			}
+		}
+	}
+
+	// Adding it, keeping the hottest files when the array is full of cold ones
+	if ( crud_heatmap_nfiles == CRUD_HEATMAP_FILES * 2 ) {
+		crud_heatmap_trim( CRUD_HEATMAP_FILES );
+	}
+	if ( crud_heatmap_nfiles == crud_heatmap_file_slots ) {
+		crud_heatmap_file_slots = (crud_heatmap_file_slots == 0) ? 64 : crud_heatmap_file_slots * 2;
+		crud_heatmap_files = realloc( crud_heatmap_files, crud_heatmap_file_slots * sizeof(CrudHeatmapFile) );
+		crud_heatmap_reindex();
+	}
+	file = &crud_heatmap_files[crud_heatmap_nfiles++];
+	memset( file, 0x0, sizeof(CrudHeatmapFile) );
+	strncpy( file->filename, filename, CRUD_MAX_PATH_LENGTH-1 );
+	file->last = crud_heatmap_clock;
+	mask = crud_heatmap_index_slots - 1;
+	for ( i=crud_heatmap_hash(filename)&mask; crud_heatmap_index[i]!=0; i=(i+1)&mask );
+	crud_heatmap_index[i] = crud_heatmap_nfiles;
+	return( file );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : crud_heatmap_unref
+// Description  : Drop a user of an object of the warm cache, the last one
+//                frees it (the lock is held)
+//
+// Inputs       : object - the object
+// Outputs      : none
+
+static void crud_heatmap_unref( CrudHeatmapObject *object ) {
+	if ( --object->refs == 0 ) {
+		free( object->data );
+		free( object );
+	}
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : crud_heatmap_run
+// Description  : The background thread: read the queued objects, hottest
+//                first, into the warm cache.  Each object is in the cache
+//                (with no data) while it is read, so a change meanwhile
+//                drops it and the data read is thrown away.
+//
+// Inputs       : arg - unused
+// Outputs      : NULL
+
+static void *crud_heatmap_run( void *arg ) {
+
+	// Local variables
+	CrudHeatmapObject *object;
+	CrudResponse response;
+	uint32_t i;
+	char *data;
+
+	for ( i=0; i<crud_heatmap_nqueue; i++ ) {
+
+		// Put the object in the cache, held for the read
+		pthread_mutex_lock( &crud_heatmap_mutex );
+		if ( crud_heatmap_stopping ) {
+			pthread_mutex_unlock( &crud_heatmap_mutex );
+			break;
+		}
+		object = calloc( 1, sizeof(CrudHeatmapObject) );
+		object->oid = crud_heatmap_queue[i].oid;
+		object->size = crud_heatmap_queue[i].size;
+		object->refs = 2;
+		insertValueInHashTable( &crud_heatmap_cache, object->oid, object );
+		crud_heatmap_cached++;
+		pthread_mutex_unlock( &crud_heatmap_mutex );
+
+		// Read it, keeping the data only if it is still in the cache
+		data = malloc( object->size );
+		response = crud_io_request( create_crudrequest(object->oid, CRUD_READ, object->size, CRUD_NULL_FLAG), data );
+		pthread_mutex_lock( &crud_heatmap_mutex );
+		if ( findValueInHashTable(&crud_heatmap_cache, object->oid) == object ) {
+			if ( (response & 0x1) || ((uint32_t)((response >> 4) & 0xffffff) != object->size) ) {
+				deleteValueFromHashTable( &crud_heatmap_cache, object->oid );
+				crud_heatmap_cached--;
+				crud_heatmap_unref( object );
+			} else {
+				object->data = data;
+				data = NULL;
+				crud_heatmap_prefetched++;
+				crud_heatmap_bytes += object->size;
+			}
+		}
+		crud_heatmap_unref( object );
+		pthread_mutex_unlock( &crud_heatmap_mutex );
+		free( data );
+	}
+	pthread_mutex_lock( &crud_heatmap_mutex );
+	crud_heatmap_idle = 1;
+	pthread_mutex_unlock( &crud_heatmap_mutex );
+	return( NULL );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : crud_heatmap_stop
+// Description  : Stop the background thread and empty the warm cache
+//
+// Inputs       : none
+// Outputs      : none
+
+static void crud_heatmap_stop( void ) {
+
+	// Local variables
+	CrudHeatmapObject *object;
+	HtIterator it;
+	CrudOID *oids;
+	uint32_t i, n = 0;
+
+	// Set up the cache on first use
+	pthread_mutex_lock( &crud_heatmap_mutex );
+	if ( !crud_heatmap_ready ) {
+		initHashTable( &crud_heatmap_cache, CRUD_HEATMAP_HASH_BITS );
+		crud_heatmap_ready = 1;
+	}
+
+	// The thread finishes the object it is reading
+	crud_heatmap_stopping = 1;
+	pthread_mutex_unlock( &crud_heatmap_mutex );
+	if ( crud_heatmap_running ) {
+		pthread_join( crud_heatmap_thread, NULL );
+		crud_heatmap_running = 0;
+	}
+	free( crud_heatmap_queue );
+	crud_heatmap_queue = NULL;
+	crud_heatmap_nqueue = 0;
+
+	// Collect the OIDs first, the cache cannot change while iterating
+	pthread_mutex_lock( &crud_heatmap_mutex );
+	oids = malloc( (crud_heatmap_cache.elements+1) * sizeof(CrudOID) );
+	initHashTableIterator( &crud_heatmap_cache, &it );
+	while ( (object = iterateHashTable(&it)) != NULL ) {
+		oids[n++] = object->oid;
+	}
+	for ( i=0; i<n; i++ ) {
+		crud_heatmap_unref( deleteValueFromHashTable(&crud_heatmap_cache, oids[i]) );
+	}
+	free( oids );
+	crud_heatmap_cached = 0;
+	crud_heatmap_stopping = 0;
+	crud_heatmap_idle = 0;
+	pthread_mutex_unlock( &crud_heatmap_mutex );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : crud_heatmap_load
+// Description  : Read the heatmap from its object
+//
+// Inputs       : oid - the object
+// Outputs      : 0 if successful, -1 if failure
+
+static int crud_heatmap_load( CrudOID oid ) {
+
+	// Local variables
+	CrudHeatmapHeader header;
+	CrudHeatmapRecord record;
+	CrudHeatmapFile *file;
+	CrudResponse response;
+	uint32_t i, length, pos;
+	char name[CRUD_MAX_PATH_LENGTH];
+	uint8_t namelen;
+	char *buf;
+
+	// The object is read whole, its length is in the response
+	buf = malloc( CRUD_MAX_OBJECT_SIZE );
+	response = crud_io_request( create_crudrequest(oid, CRUD_READ, CRUD_MAX_OBJECT_SIZE, CRUD_NULL_FLAG), buf );
+	if ( response & 0x1 ) {
+		CRUD_LOG( LOG_ERROR_LEVEL, "CRUD heatmap: failed reading the heatmap [OID %u]", oid );
+		free( buf );
+		return( -1 );
+	}
+	length = (uint32_t)((response >> 4) & 0xffffff);
+	crud_heatmap_saved = oid;
+	crud_heatmap_saved_size = length;
+
+	// Each record is checked against the end of the object
+	if ( length >= sizeof(CrudHeatmapHeader) ) {
+		memcpy( &header, buf, sizeof(CrudHeatmapHeader) );
+	}
+	if ( (length < sizeof(CrudHeatmapHeader)) || memcmp(header.magic, CRUD_HEATMAP_MAGIC, 8) ) {
+		CRUD_LOG( LOG_ERROR_LEVEL, "CRUD heatmap: bad heatmap [OID %u]", oid );
+		free( buf );
+		return( -1 );
+	}
+	crud_heatmap_clock = header.clock;
+	pos = sizeof(CrudHeatmapHeader);
+	for ( i=0; i<header.files; i++ ) {
+		if ( pos + sizeof(CrudHeatmapRecord) + 1 > length ) {
+			break;
+		}
+		memcpy( &record, &buf[pos], sizeof(CrudHeatmapRecord) );
+		namelen = (uint8_t)buf[pos+sizeof(CrudHeatmapRecord)];
+		pos += sizeof(CrudHeatmapRecord) + 1;
+		if ( (namelen == 0) || (namelen >= CRUD_MAX_PATH_LENGTH) || (pos + namelen > length) ) {
+			break;
+		}
+		memcpy( name, &buf[pos], namelen );
+		name[namelen] = 0x0;
+		file = crud_heatmap_find( name );
+		file->oid = record.oid;
+		file->size = record.size;
+		file->count = record.count;
+		file->last = record.last;
+		pos += namelen;
+	}
+	free( buf );
+	if ( i < header.files ) {
+		CRUD_LOG( LOG_ERROR_LEVEL, "CRUD heatmap: heatmap [OID %u] cut short at file %u of %u", oid, i, header.files );
+	}
+
+	// Hottest first, as they are read into the cache
+	crud_heatmap_trim( CRUD_HEATMAP_FILES );
+	return( 0 );
+}
+
+//
+// Functions
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : crud_heatmap_touch
+// Description  : Add the uses of a file (while it was open) to its count,
+//                and remember the object it had
+//
+// Inputs       : filename - the name of the file
+//                oid - its object
+//                size - the size of the object (0 if it is not to be read)
+//                uses - the uses
+// Outputs      : none
+
+void crud_heatmap_touch( const char *filename, CrudOID oid, uint32_t size, uint32_t uses ) {
+
+	// Local variables
+	CrudHeatmapFile *file;
+	uint32_t count;
+
+	if ( uses == 0 ) {
+		return;
+	}
+	file = crud_heatmap_find( filename );
+	count = crud_heatmap_score( file );
+	file->count = (count > UINT32_MAX - uses) ? UINT32_MAX : count + uses;
+	file->last = crud_heatmap_clock++;
+	file->oid = oid;
+	file->size = size;
+	crud_heatmap_touched = 1;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : crud_heatmap_mount
+// Description  : Read the heatmap the table header names, and start reading
+//                the objects of its hottest files (within the budget) into
+//                the warm cache.  A heatmap that cannot be read is
+//                reported and the mount goes on cold.
+//
+// Inputs       : none
+// Outputs      : 0 if successful, -1 if failure
+
+int crud_heatmap_mount( void ) {
+
+	// Local variables
+	CrudOID oid = crud_table_heatmap();
+	uint64_t bytes = 0;
+	uint32_t i, j;
+
+	crud_heatmap_reset();
+	if ( (oid == CRUD_NO_OBJECT) || crud_heatmap_load(oid) ) {
+		return( 0 );
+	}
+
+	// The hottest objects that fit, once each (clones share them)
+	crud_heatmap_queue = malloc( CRUD_HEATMAP_PREFETCH_FILES * sizeof(CrudRecycleObject) );
+	for ( i=0; (i<crud_heatmap_nfiles) && (crud_heatmap_nqueue<CRUD_HEATMAP_PREFETCH_FILES); i++ ) {
+		if ( (crud_heatmap_files[i].size == 0) || (crud_heatmap_files[i].size > CRUD_MAX_OBJECT_SIZE) ||
+				(crud_heatmap_score(&crud_heatmap_files[i]) == 0) ||
+				(bytes + crud_heatmap_files[i].size > CRUD_HEATMAP_PREFETCH_BYTES) ) {
+			continue;
+		}
+		for ( j=0; (j<crud_heatmap_nqueue) && (crud_heatmap_queue[j].oid!=crud_heatmap_files[i].oid); j++ );
+		if ( j == crud_heatmap_nqueue ) {
+			crud_heatmap_queue[crud_heatmap_nqueue].oid = crud_heatmap_files[i].oid;
+			crud_heatmap_queue[crud_heatmap_nqueue].size = crud_heatmap_files[i].size;
+			crud_heatmap_nqueue++;
+			bytes += crud_heatmap_files[i].size;
+		}
+	}
+	if ( crud_heatmap_nqueue == 0 ) {
+		return( 0 );
+	}
+	if ( pthread_create(&crud_heatmap_thread, NULL, crud_heatmap_run, NULL) ) {
+		CRUD_LOG( LOG_ERROR_LEVEL, "CRUD heatmap: failed starting the prefetch thread, mounting cold" );
+		return( 0 );
+	}
+	crud_heatmap_running = 1;
+	CRUD_LOG( LOG_INFO_LEVEL, "CRUD heatmap: %u files in the heatmap, prefetching %u objects (%lu bytes).",
+			crud_heatmap_nfiles, crud_heatmap_nqueue, bytes );
+	return( 0 );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : crud_heatmap_unmount
+// Description  : Stop warming the cache and empty it, then save the hottest
+//                files in a new object the table header names (before the
+//                table is written); the old object is given up once the
+//                table no longer names it
+//
+// Inputs       : none
+// Outputs      : 0 if successful, -1 if failure
+
+int crud_heatmap_unmount( void ) {
+
+	// Local variables
+	CrudHeatmapHeader header;
+	CrudHeatmapRecord record;
+	CrudResponse response;
+	uint32_t i, length, size;
+	uint8_t namelen;
+	CrudOID oid;
+	char *buf;
+
+	crud_heatmap_stop();
+	if ( crud_heatmap_prefetched + crud_heatmap_hits > 0 ) {
+		CRUD_LOG( LOG_INFO_LEVEL, "CRUD heatmap: %lu objects prefetched (%lu bytes), %lu reads served warm.",
+				crud_heatmap_prefetched, crud_heatmap_bytes, crud_heatmap_hits );
+	}
+	if ( !crud_heatmap_touched ) {
+		return( 0 ); // the heatmap saved is still the one
+	}
+
+	// The hottest files, hottest first
+	crud_heatmap_trim( CRUD_HEATMAP_FILES );
+	buf = malloc( sizeof(CrudHeatmapHeader) + crud_heatmap_nfiles * (sizeof(CrudHeatmapRecord) + CRUD_MAX_PATH_LENGTH) );
+	memcpy( header.magic, CRUD_HEATMAP_MAGIC, sizeof(header.magic) );
+	header.clock = crud_heatmap_clock;
+	header.files = crud_heatmap_nfiles;
+	memcpy( buf, &header, sizeof(CrudHeatmapHeader) );
+	length = sizeof(CrudHeatmapHeader);
+	for ( i=0; i<crud_heatmap_nfiles; i++ ) {
+		record.oid = crud_heatmap_files[i].oid;
+		record.size = crud_heatmap_files[i].size;
+		record.count = crud_heatmap_files[i].count;
+		record.last = crud_heatmap_files[i].last;
+		namelen = (uint8_t)strlen( crud_heatmap_files[i].filename );
+		memcpy( &buf[length], &record, sizeof(CrudHeatmapRecord) );
+		buf[length+sizeof(CrudHeatmapRecord)] = (char)namelen;
+		memcpy( &buf[length+sizeof(CrudHeatmapRecord)+1], crud_heatmap_files[i].filename, namelen );
+		length += sizeof(CrudHeatmapRecord) + 1 + namelen;
+	}
+
+	// Written to an object of its size class (so the next one can reuse it)
+	size = crud_recycle_class( length );
+	buf = realloc( buf, size );
+	memset( &buf[length], 0x0, size - length );
+	response = crud_recycle_create( size, buf );
+	free( buf );
+	oid = (CrudOID)(response >> 32);
+	if ( response & 0x1 ) {
+		CRUD_LOG( LOG_ERROR_LEVEL, "CRUD heatmap: failed writing the heatmap" );
+		return( -1 );
+	}
+	if ( crud_table_set_heatmap(oid) ) {
+		CRUD_LOG( LOG_INFO_LEVEL, "CRUD heatmap: the table header has no room for the heatmap, format to keep it." );
+		return( crud_journal_free(oid, size) );
+	}
+	if ( (crud_heatmap_saved != CRUD_NO_OBJECT) && crud_journal_free(crud_heatmap_saved, crud_heatmap_saved_size) ) {
+		return( -1 );
+	}
+	crud_heatmap_saved = oid;
+	crud_heatmap_saved_size = size;
+	crud_heatmap_touched = 0;
+	return( 0 );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : crud_heatmap_reset
+// Description  : Stop warming the cache, empty it, and forget the heatmap
+//                and the counts
+//
+// Inputs       : none
+// Outputs      : none
+
+void crud_heatmap_reset( void ) {
+	crud_heatmap_stop();
+	free( crud_heatmap_files );
+	free( crud_heatmap_index );
+	crud_heatmap_files = NULL;
+	crud_heatmap_index = NULL;
+	crud_heatmap_nfiles = 0;
+	crud_heatmap_file_slots = 0;
+	crud_heatmap_index_slots = 0;
+	crud_heatmap_clock = 0;
+	crud_heatmap_touched = 0;
+	crud_heatmap_saved = CRUD_NO_OBJECT;
+	crud_heatmap_saved_size = 0;
+	crud_heatmap_prefetched = 0;
+	crud_heatmap_bytes = 0;
+	crud_heatmap_hits = 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : crud_heatmap_warm
+// Description  : Get an object from the warm cache, if it was read in whole
+//                and has not changed since
+//
+// Inputs       : oid - the object
+//                size - its size
+// Outputs      : the object (release it with crud_heatmap_release), or NULL
+
+CrudHeatmapObject *crud_heatmap_warm( CrudOID oid, uint32_t size ) {
+
+	// Local variables
+	CrudHeatmapObject *object;
+
+	if ( crud_heatmap_cached == 0 ) {
+		return( NULL );
+	}
+	pthread_mutex_lock( &crud_heatmap_mutex );
+	object = findValueInHashTable( &crud_heatmap_cache, oid );
+	if ( (object != NULL) && (object->data != NULL) && (object->size == size) ) {
+		object->refs++;
+		crud_heatmap_hits++;
+	} else {
+		object = NULL;
+	}
+	pthread_mutex_unlock( &crud_heatmap_mutex );
+	return( object );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : crud_heatmap_release
+// Description  : Drop a reader of an object from the warm cache
+//
+// Inputs       : object - the object
+// Outputs      : none
+
+void crud_heatmap_release( CrudHeatmapObject *object ) {
+	pthread_mutex_lock( &crud_heatmap_mutex );
+	crud_heatmap_unref( object );
+	pthread_mutex_unlock( &crud_heatmap_mutex );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : crud_heatmap_forget
+// Description  : Drop an object from the warm cache because a request is
+//                changing it (called with the backend lock, so no read of
+//                the object is in flight)
+//
+// Inputs       : oid - the object
+// Outputs      : none
+
+void crud_heatmap_forget( CrudOID oid ) {
+
+	// Local variables
+	CrudHeatmapObject *object;
+
+	if ( crud_heatmap_cached == 0 ) {
+		return;
+	}
+	pthread_mutex_lock( &crud_heatmap_mutex );
+	if ( (object = deleteValueFromHashTable(&crud_heatmap_cache, oid)) != NULL ) {
+		crud_heatmap_cached--;
+		crud_heatmap_unref( object );
+	}
+	pthread_mutex_unlock( &crud_heatmap_mutex );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : crud_heatmap_settle
+// Description  : Wait for the background thread to read every object (for
+//                the unit test)
+//
+// Inputs       : none
+// Outputs      : 0 if it did in time, -1 otherwise
+
+static int crud_heatmap_settle( void ) {
+
+	// Local variables
+	int i, idle = 0;
+
+	for ( i=0; (i<CRUD_HEATMAP_UNIT_TEST_WAIT) && !idle; i++ ) {
+		pthread_mutex_lock( &crud_heatmap_mutex );
+		idle = crud_heatmap_idle || !crud_heatmap_running;
+		pthread_mutex_unlock( &crud_heatmap_mutex );
+		if ( !idle ) {
+			usleep( 1000 );
+		}
+	}
+	return( idle ? 0 : -1 );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : crudHeatmapUnitTest
+// Description  : Perform a test of the heatmap: counts halve as other files
+//                are used, the hottest files are saved at unmount and read
+//                into the warm cache at the next mount, their reads are
+//                served from it, and a file changed after the mount reads
+//                back what was written
+//
+// Inputs       : none
+// Outputs      : 0 if successful, -1 if failure
+
+int crudHeatmapUnitTest( void ) {
+
+	// Local variables
+	char data[CRUD_HEATMAP_UNIT_TEST_SIZE], got[CRUD_HEATMAP_UNIT_TEST_SIZE], name[CRUD_MAX_PATH_LENGTH];
+	CrudHeatmapFile *file;
+	uint64_t hits;
+	uint32_t i;
+	int16_t fh;
+	int f;
+
+	// A count halves for every CRUD_HEATMAP_HALF_LIFE closes of other files
+	if ( crud_format() || crud_mount() ) {
+		CRUD_LOG( LOG_ERROR_LEVEL, "CRUD_HEATMAP_UNIT_TEST : Failure on format or mount." );
+		return( -1 );
+	}
+	crud_heatmap_touch( "decay", CRUD_NO_OBJECT, 0, 1000 );
+	for ( i=0; i<CRUD_HEATMAP_HALF_LIFE*2; i++ ) {
+		crud_heatmap_touch( "other", CRUD_NO_OBJECT, 0, 1 );
+	}
+	file = crud_heatmap_find( "decay" );
+	if ( (crud_heatmap_nfiles != 2) || (crud_heatmap_score(file) != 250) ) {
+		CRUD_LOG( LOG_ERROR_LEVEL, "CRUD_HEATMAP_UNIT_TEST : count %u after two half lives, not 250.", crud_heatmap_score(file) );
+		return( -1 );
+	}
+	crud_heatmap_reset();
+
+	// Hot files used many times, a cold one once
+	for ( f=0; f<=CRUD_HEATMAP_UNIT_TEST_HOT; f++ ) {
+		snprintf( name, CRUD_MAX_PATH_LENGTH, "heat.%d", f );
+		memset( data, 'a' + f, CRUD_HEATMAP_UNIT_TEST_SIZE );
+		if ( ((fh = crud_open(name)) == -1) || (crud_write(fh, data, CRUD_HEATMAP_UNIT_TEST_SIZE) != CRUD_HEATMAP_UNIT_TEST_SIZE) ||
+				crud_close(fh) ) {
+			CRUD_LOG( LOG_ERROR_LEVEL, "CRUD_HEATMAP_UNIT_TEST : failed writing %s.", name );
+			return( -1 );
+		}
+	}
+	for ( i=0; i<CRUD_HEATMAP_UNIT_TEST_USES; i++ ) {
+		for ( f=0; f<CRUD_HEATMAP_UNIT_TEST_HOT; f++ ) {
+			snprintf( name, CRUD_MAX_PATH_LENGTH, "heat.%d", f );
+			if ( ((fh = crud_open(name)) == -1) || (crud_read(fh, got, 100) != 100) || crud_close(fh) ) {
+				CRUD_LOG( LOG_ERROR_LEVEL, "CRUD_HEATMAP_UNIT_TEST : failed reading %s.", name );
+				return( -1 );
+			}
+		}
+	}
+
+	// Saved hottest first, and read back at the next mount
+	if ( crud_unmount() || crud_mount() || (crud_table_heatmap() == CRUD_NO_OBJECT) || crud_heatmap_settle() ) {
+		CRUD_LOG( LOG_ERROR_LEVEL, "CRUD_HEATMAP_UNIT_TEST : heatmap not saved or not read back." );
+		return( -1 );
+	}
+	snprintf( name, CRUD_MAX_PATH_LENGTH, "heat.%d", CRUD_HEATMAP_UNIT_TEST_HOT );
+	if ( (crud_heatmap_nfiles != CRUD_HEATMAP_UNIT_TEST_HOT+1) || strcmp(crud_heatmap_files[crud_heatmap_nfiles-1].filename, name) ||
+			(crud_heatmap_prefetched != CRUD_HEATMAP_UNIT_TEST_HOT+1) || (crud_heatmap_cached != CRUD_HEATMAP_UNIT_TEST_HOT+1) ) {
+		CRUD_LOG( LOG_ERROR_LEVEL, "CRUD_HEATMAP_UNIT_TEST : %u files in the heatmap, %lu objects prefetched.",
+				crud_heatmap_nfiles, crud_heatmap_prefetched );
+		return( -1 );
+	}
+
+	// The first file changes before it is read, the others are warm
+	memset( data, 'z', CRUD_HEATMAP_UNIT_TEST_SIZE );
+	if ( ((fh = crud_open("heat.0")) == -1) || (crud_write(fh, data, CRUD_HEATMAP_UNIT_TEST_SIZE) != CRUD_HEATMAP_UNIT_TEST_SIZE) ||
+			crud_close(fh) ) {
+		CRUD_LOG( LOG_ERROR_LEVEL, "CRUD_HEATMAP_UNIT_TEST : failed rewriting heat.0." );
+		return( -1 );
+	}
+	hits = crud_heatmap_hits;
+	for ( f=0; f<CRUD_HEATMAP_UNIT_TEST_HOT; f++ ) {
+		snprintf( name, CRUD_MAX_PATH_LENGTH, "heat.%d", f );
+		memset( data, (f == 0) ? 'z' : 'a' + f, CRUD_HEATMAP_UNIT_TEST_SIZE );
+		if ( ((fh = crud_open(name)) == -1) || (crud_read(fh, got, CRUD_HEATMAP_UNIT_TEST_SIZE) != CRUD_HEATMAP_UNIT_TEST_SIZE) ||
+				memcmp(got, data, CRUD_HEATMAP_UNIT_TEST_SIZE) || crud_close(fh) ) {
+			CRUD_LOG( LOG_ERROR_LEVEL, "CRUD_HEATMAP_UNIT_TEST : %s read back wrong.", name );
+			return( -1 );
+		}
+	}
+	if ( crud_heatmap_hits != hits + CRUD_HEATMAP_UNIT_TEST_HOT - 1 ) {
+		CRUD_LOG( LOG_ERROR_LEVEL, "CRUD_HEATMAP_UNIT_TEST : %lu reads served warm, not %u.", crud_heatmap_hits - hits, CRUD_HEATMAP_UNIT_TEST_HOT - 1 );
+		return( -1 );
+	}
+
+	// Unmount (saving the heatmap again), return successfully
+	if ( crud_unmount() ) {
+		CRUD_LOG( LOG_ERROR_LEVEL, "CRUD_HEATMAP_UNIT_TEST : Failure on unmount operation." );
+		return( -1 );
+	}
+	CRUD_LOG( LOG_INFO_LEVEL, "CRUD heatmap unit tests completed successfully." );
+	return( 0 );
+}
@@ -0,0 +1,69 @@
+#ifndef CRUD_HEATMAP_INCLUDED
+#define CRUD_HEATMAP_INCLUDED
+
+////////////////////////////////////////////////////////////////////////////////
+//
+//  File           : crud_heatmap.h
+//  Description    : This is the interface for the access heatmap of the CRUD
+//                   file system.  How often and how lately each file was
+//                   used is counted while mounted and saved at unmount; the
+//                   next mount reads the objects of the hottest files in
+//                   the background into a warm cache the first reads use.
+//
+//  Last Modified  : Sun Oct 18 23:41:17 EDT 2026
+//
+
+// Includes
+#include <stdint.h>
+
+// Project Includes
+#include <crud_driver.h>
+
+// Defines
+#define CRUD_HEATMAP_MAGIC "CRUDHOT1"
+#define CRUD_HEATMAP_FILES 1024                     // files the saved heatmap keeps (the hottest)
+#define CRUD_HEATMAP_HALF_LIFE 1024                 // uses of files after which a count is halved
+#define CRUD_HEATMAP_PREFETCH_FILES 64              // objects of the hottest files read at mount
+#define CRUD_HEATMAP_PREFETCH_BYTES (16*1024*1024)  // bytes of them read at mount
+
+// Type definitions
+
+// This is an object in the warm cache, shared by the cache and its readers
+typedef struct {
+	CrudOID   oid;   // The object
+	uint32_t  size;  // Its size
+	char     *data;  // The object (NULL while it is being read)
+	uint16_t  refs;  // The cache (while the object is in it) and its readers
+} CrudHeatmapObject;
+
+//
+// Heatmap interface
+
+void crud_heatmap_touch( const char *filename, CrudOID oid, uint32_t size, uint32_t uses );
+	// Count uses of a file (its object and size are what the next mount reads)
+
+int crud_heatmap_mount( void );
+	// Read the heatmap saved at the last unmount and start warming the cache
+
+int crud_heatmap_unmount( void );
+	// Stop warming the cache, drop it, and save the heatmap (before the table)
+
+void crud_heatmap_reset( void );
+	// Stop warming the cache, drop it, and forget the heatmap (the store was formatted)
+
+CrudHeatmapObject *crud_heatmap_warm( CrudOID oid, uint32_t size );
+	// Get an object from the warm cache (NULL if not there), release it after
+
+void crud_heatmap_release( CrudHeatmapObject *object );
+	// Drop a reader of an object from the warm cache
+
+void crud_heatmap_forget( CrudOID oid );
+	// Drop an object from the warm cache (it changed), called for every change
+
+//
+// Unit testing for the module
+
+int crudHeatmapUnitTest( void );
+	// Perform a test of the access heatmap and the warm cache
+
+#endif
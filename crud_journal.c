@@ -0,0 +1,744 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+//  File           : crud_journal.c
+//  Description    : This is the metadata journal of the CRUD file system.
+//                   Records are collected in memory and group committed as
+//                   one segment object per commit, chained backwards from
+//                   the anchor object, so a commit costs the records and a
+//                   small anchor update.  Objects the changes free are only
+//                   deleted (or reused) once the records are written, so a
+//                   crash never leaves the replayed table naming an object
+//                   deleted or rewritten for another file.  The objects
+//                   given to the recycling pool and taken out of it are
+//                   recorded too, so the replay gives the pool back.  A
+//                   checkpoint (the table written whole) starts the journal
+//                   over with the objects the pool keeps, which keeps the
+//                   replay at mount bounded.
+//
+//  Last Modified  : Sun Oct 18 22:36:41 EDT 2026
+//
+
+// Includes
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+// Project Includes
+#include <crud_journal.h>
+#include <crud_recycle.h>
+#include <crud_file_io.h>
+#include <crud_log.h>
+#include <cmpsc311_util.h>
+
+// Defines
+#define CRUD_JOURNAL_UNIT_TEST_FILES 200
+#define CRUD_JOURNAL_UNIT_TEST_UPDATES 20000
+
+// Type definitions
+
+// This is a record of the recycling pool found by the replay
+typedef struct {
+	CrudOID   oid;
+	uint32_t  size;   // The size of the object (FREE records)
+	uint32_t  seq;    // The order of the record in the journal
+	uint32_t  kept;   // Nonzero for a FREE record, zero for a TAKE
+} CrudJournalPoolRecord;
+
+//
+// Module local data
+
+static CrudOID crud_journal_anchor_oid;      // The anchor object (CRUD_NO_OBJECT: no journal)
+static CrudJournalAnchor crud_journal_anchor; // The anchor as last written
+static CrudOID *crud_journal_segments;       // The segments since the checkpoint, oldest first
+static uint32_t crud_journal_segment_slots;  // The size of the segment list
+static char *crud_journal_pending;           // The segment being collected (head and records)
+static uint32_t crud_journal_pending_bytes;  // The bytes of records pending
+static struct timespec crud_journal_pending_since; // When the oldest pending record was added
+static CrudRecycleObject *crud_journal_frees; // The objects to give back after the next commit
+static uint32_t crud_journal_nfrees;         // The number of objects to give back
+static uint32_t crud_journal_free_slots;     // The size of the free list
+static uint8_t crud_journal_replaying;       // Flag indicating records come from the replay
+static CrudJournalPoolRecord *crud_journal_pool; // The pool records replayed
+static uint32_t crud_journal_npool;          // The number of pool records
+static uint32_t crud_journal_pool_slots;     // The size of the pool record list
+
+//
+// Module local methods
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : crud_journal_write_anchor
+// Description  : Write the anchor object
+//
+// Inputs       : anchor - the new anchor
+// Outputs      : 0 if successful, -1 if failure
+
+static int crud_journal_write_anchor( CrudJournalAnchor *anchor ) {
+
+	// Local variables
+	CrudResponse response;
+
+	// The anchor is the same size always, an update in place
+	response = crud_io_request( create_crudrequest(crud_journal_anchor_oid, CRUD_UPDATE, sizeof(CrudJournalAnchor), CRUD_NULL_FLAG), anchor );
+	if ( response & 0x1 ) {
+		CRUD_LOG( LOG_ERROR_LEVEL, "CRUD journal: failed writing the anchor [OID %u]", crud_journal_anchor_oid );
+		return( -1 );
+	}
+	crud_journal_anchor = *anchor;
+	return( 0 );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : crud_journal_write_segment
+// Description  : Write the pending records as a new segment and point the
+//                anchor at it
+//
+// Inputs       : none
+// Outputs      : 0 if successful, -1 if failure
+
+static int crud_journal_write_segment( void ) {
+
+	// Local variables
+	CrudJournalSegment *segment = (CrudJournalSegment *)crud_journal_pending;
+	CrudJournalAnchor anchor;
+	CrudResponse response;
+	CrudOID *segments;
+
+	// Nothing pending, nothing to write
+	if ( crud_journal_pending_bytes == 0 ) {
+		return( 0 );
+	}
+
+	// The segment follows the last one
+	segment->prev = crud_journal_anchor.tail;
+	segment->bytes = crud_journal_pending_bytes;
+	response = crud_io_request( create_crudrequest(0, CRUD_CREATE, sizeof(CrudJournalSegment) + crud_journal_pending_bytes, CRUD_NULL_FLAG), segment );
+	if ( response & 0x1 ) {
+		CRUD_LOG( LOG_ERROR_LEVEL, "CRUD journal: failed writing a segment (%u bytes)", crud_journal_pending_bytes );
+		return( -1 );
+	}
+	if ( crud_journal_anchor.segments == crud_journal_segment_slots ) {
+		crud_journal_segment_slots = (crud_journal_segment_slots == 0) ? 16 : crud_journal_segment_slots * 2;
+		segments = realloc( crud_journal_segments, crud_journal_segment_slots * sizeof(CrudOID) );
+		crud_journal_segments = segments;
+	}
+	crud_journal_segments[crud_journal_anchor.segments] = (CrudOID)(response >> 32);
+
+	// The records are durable once the anchor names the segment
+	anchor.tail = (CrudOID)(response >> 32);
+	anchor.segments = crud_journal_anchor.segments + 1;
+	anchor.bytes = crud_journal_anchor.bytes + crud_journal_pending_bytes;
+	anchor.reserved = 0;
+	if ( crud_journal_write_anchor(&anchor) ) {
+		return( -1 );
+	}
+	crud_journal_pending_bytes = 0;
+	return( 0 );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : crud_journal_delete
+// Description  : Delete a list of objects
+//
+// Inputs       : oids - the objects
+//                count - the number of objects
+// Outputs      : 0 if successful, -1 if failure
+
+static int crud_journal_delete( CrudOID *oids, uint32_t count ) {
+
+	// Local variables
+	uint32_t i;
+	int ret = 0;
+
+	// Every object is deleted, the failures are reported together
+	for ( i=0; i<count; i++ ) {
+		if ( crud_io_request(create_crudrequest(oids[i], CRUD_DELETE, 0, CRUD_NULL_FLAG), NULL) & 0x1 ) {
+			CRUD_LOG( LOG_ERROR_LEVEL, "CRUD journal: failed deleting [OID %u]", oids[i] );
+			ret = -1;
+		}
+	}
+	return( ret );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : crud_journal_release
+// Description  : Give the freed objects back to the recycling pool (without
+//                a journal nothing would name them after a crash, they are
+//                given with no size, to be deleted)
+//
+// Inputs       : none
+// Outputs      : 0 if successful, -1 if failure
+
+static int crud_journal_release( void ) {
+
+	// Local variables
+	uint32_t i;
+	int ret = 0;
+
+	for ( i=0; i<crud_journal_nfrees; i++ ) {
+		ret |= crud_recycle_free( crud_journal_frees[i].oid,
+				(crud_journal_anchor_oid == CRUD_NO_OBJECT) ? 0 : crud_journal_frees[i].size );
+	}
+	crud_journal_nfrees = 0;
+	return( ret );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : crud_journal_replay_pool
+// Description  : Collect a record of the recycling pool found by the replay
+//
+// Inputs       : type - CRUD_JOURNAL_FREE or CRUD_JOURNAL_TAKE
+//                payload - the record contents
+//                size - the bytes of payload
+// Outputs      : 0 if successful, -1 if failure
+
+static int crud_journal_replay_pool( uint16_t type, const void *payload, uint16_t size ) {
+
+	// Local variables
+	CrudJournalPoolRecord *pool, *record;
+	CrudRecycleObject object;
+	uint32_t slots;
+
+	// Checking the record
+	if ( ((type == CRUD_JOURNAL_FREE) && (size != sizeof(CrudRecycleObject))) ||
+			((type == CRUD_JOURNAL_TAKE) && (size != sizeof(CrudOID))) ) {
+		return( -1 );
+	}
+	if ( crud_journal_npool == crud_journal_pool_slots ) {
+		slots = (crud_journal_pool_slots == 0) ? 256 : crud_journal_pool_slots * 2;
+		if ( (pool = realloc(crud_journal_pool, slots * sizeof(CrudJournalPoolRecord))) == NULL ) {
+			CRUD_LOG( LOG_ERROR_LEVEL, "CRUD journal: no memory for the pool records" );
+			return( -1 );
+		}
+		crud_journal_pool = pool;
+		crud_journal_pool_slots = slots;
+	}
+	record = &crud_journal_pool[crud_journal_npool];
+	if ( type == CRUD_JOURNAL_FREE ) {
+		memcpy( &object, payload, sizeof(CrudRecycleObject) );
+		record->oid = object.oid;
+		record->size = object.size;
+		record->kept = 1;
+	} else {
+		memcpy( &record->oid, payload, sizeof(CrudOID) );
+		record->size = 0;
+		record->kept = 0;
+	}
+	record->seq = crud_journal_npool++;
+	return( 0 );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : crud_journal_compare_pool
+// Description  : Order pool records by object, then as they were written
+//
+// Inputs       : a, b - the records
+// Outputs      : <0, 0 or >0 as a sorts before, with or after b
+
+static int crud_journal_compare_pool( const void *a, const void *b ) {
+
+	// Local variables
+	const CrudJournalPoolRecord *x = a, *y = b;
+
+	if ( x->oid != y->oid ) {
+		return( (x->oid < y->oid) ? -1 : 1 );
+	}
+	return( (x->seq < y->seq) ? -1 : (x->seq > y->seq) );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : crud_journal_restore_pool
+// Description  : Give back to the recycling pool the objects whose last
+//                record says the pool keeps them
+//
+// Inputs       : none
+// Outputs      : the number of objects given back
+
+static uint32_t crud_journal_restore_pool( void ) {
+
+	// Local variables
+	uint32_t i, kept = 0;
+
+	qsort( crud_journal_pool, crud_journal_npool, sizeof(CrudJournalPoolRecord), crud_journal_compare_pool );
+	for ( i=0; i<crud_journal_npool; i++ ) {
+		if ( ((i+1 == crud_journal_npool) || (crud_journal_pool[i+1].oid != crud_journal_pool[i].oid)) &&
+				crud_journal_pool[i].kept ) {
+			crud_recycle_free( crud_journal_pool[i].oid, crud_journal_pool[i].size );
+			kept++;
+		}
+	}
+	free( crud_journal_pool );
+	crud_journal_pool = NULL;
+	crud_journal_npool = 0;
+	crud_journal_pool_slots = 0;
+	return( kept );
+}
+
+//
+// Functions
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : crud_journal_format
+// Description  : Create the anchor of an empty journal
+//
+// Inputs       : anchor - set to the anchor object
+// Outputs      : 0 if successful, -1 if failure
+
+int crud_journal_format( CrudOID *anchor ) {
+
+	// Local variables
+	CrudResponse response;
+
+	// An empty journal is an anchor with no segment
+	crud_journal_reset();
+	memset( &crud_journal_anchor, 0x0, sizeof(CrudJournalAnchor) );
+	crud_journal_anchor.tail = CRUD_NO_OBJECT;
+	response = crud_io_request( create_crudrequest(0, CRUD_CREATE, sizeof(CrudJournalAnchor), CRUD_NULL_FLAG), &crud_journal_anchor );
+	if ( response & 0x1 ) {
+		CRUD_LOG( LOG_ERROR_LEVEL, "CRUD journal: failed creating the anchor" );
+		return( -1 );
+	}
+	crud_journal_anchor_oid = (CrudOID)(response >> 32);
+	*anchor = crud_journal_anchor_oid;
+	return( 0 );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : crud_journal_mount
+// Description  : Read the segments of the journal, newest to oldest along
+//                the chain, and replay their records oldest first (the
+//                records of the recycling pool here, giving it back the
+//                objects it kept)
+//
+// Inputs       : anchor - the anchor object (CRUD_NO_OBJECT: no journal)
+//                fn - the function replaying a record
+// Outputs      : 0 if successful, -1 if failure
+
+int crud_journal_mount( CrudOID anchor, CrudJournalReplayFunction fn ) {
+
+	// Local variables
+	CrudJournalSegment **segments;
+	CrudJournalRecord record;
+	const char *payload;
+	CrudResponse response;
+	CrudOID oid;
+	uint32_t i, pos, kept, records = 0;
+	int ret = 0;
+
+	// Reading the anchor, the pool starts over from what the journal names
+	crud_journal_reset();
+	crud_recycle_reset();
+	if ( anchor == CRUD_NO_OBJECT ) {
+		return( 0 );
+	}
+	crud_journal_anchor_oid = anchor;
+	response = crud_io_request( create_crudrequest(anchor, CRUD_READ, sizeof(CrudJournalAnchor), CRUD_NULL_FLAG), &crud_journal_anchor );
+	if ( response & 0x1 ) {
+		CRUD_LOG( LOG_ERROR_LEVEL, "CRUD journal: failed reading the anchor [OID %u]", anchor );
+		crud_journal_anchor_oid = CRUD_NO_OBJECT;
+		return( -1 );
+	}
+	if ( crud_journal_anchor.segments == 0 ) {
+		return( 0 );
+	}
+
+	// Following the chain back from the last segment
+	crud_journal_segment_slots = crud_journal_anchor.segments;
+	crud_journal_segments = malloc( crud_journal_segment_slots * sizeof(CrudOID) );
+	segments = calloc( crud_journal_anchor.segments, sizeof(CrudJournalSegment *) );
+	oid = crud_journal_anchor.tail;
+	for ( i=crud_journal_anchor.segments; (i > 0) && (ret == 0); i-- ) {
+		segments[i-1] = malloc( sizeof(CrudJournalSegment) + CRUD_JOURNAL_SEGMENT_SIZE );
+		response = crud_io_request( create_crudrequest(oid, CRUD_READ, sizeof(CrudJournalSegment) + CRUD_JOURNAL_SEGMENT_SIZE, CRUD_NULL_FLAG), segments[i-1] );
+		if ( (response & 0x1) || (segments[i-1]->bytes > CRUD_JOURNAL_SEGMENT_SIZE) ) {
+			CRUD_LOG( LOG_ERROR_LEVEL, "CRUD journal: failed reading segment [OID %u]", oid );
+			ret = -1;
+		}
+		crud_journal_segments[i-1] = oid;
+		oid = segments[i-1]->prev;
+	}
+
+	// Replaying the records in the order they were added (records are packed
+	// at any offset, so the heads are copied out and the payloads are only
+	// ever copied from)
+	crud_journal_replaying = 1;
+	for ( i=0; (i < crud_journal_anchor.segments) && (ret == 0); i++ ) {
+		for ( pos=0; (pos < segments[i]->bytes) && (ret == 0); pos += sizeof(CrudJournalRecord) + record.size ) {
+			if ( pos + sizeof(CrudJournalRecord) > segments[i]->bytes ) {
+				CRUD_LOG( LOG_ERROR_LEVEL, "CRUD journal: bad record in segment [OID %u]", crud_journal_segments[i] );
+				ret = -1;
+				break;
+			}
+			memcpy( &record, (char *)(segments[i]+1) + pos, sizeof(CrudJournalRecord) );
+			payload = (char *)(segments[i]+1) + pos + sizeof(CrudJournalRecord);
+			if ( (pos + sizeof(CrudJournalRecord) + record.size > segments[i]->bytes) ||
+					(((record.type == CRUD_JOURNAL_FREE) || (record.type == CRUD_JOURNAL_TAKE)) ?
+						crud_journal_replay_pool(record.type, payload, record.size) : fn(record.type, payload, record.size)) ) {
+				CRUD_LOG( LOG_ERROR_LEVEL, "CRUD journal: bad record in segment [OID %u]", crud_journal_segments[i] );
+				ret = -1;
+				break;
+			}
+			records++;
+		}
+	}
+	crud_journal_replaying = 0;
+	for ( i=0; i<crud_journal_anchor.segments; i++ ) {
+		free( segments[i] );
+	}
+	free( segments );
+	kept = crud_journal_restore_pool();
+	if ( ret == 0 ) {
+		CRUD_LOG( LOG_INFO_LEVEL, "... journal replayed (%u records in %u segments, %u bytes, %u objects given back to the pool).",
+				records, crud_journal_anchor.segments, crud_journal_anchor.bytes, kept );
+	}
+	return( ret );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : crud_journal_append
+// Description  : Add a record to the pending segment, spilling the segment
+//                when it is full
+//
+// Inputs       : type - the CrudJournalRecordType
+//                payload - the record contents
+//                size - the bytes of payload
+// Outputs      : 0 if successful, -1 if failure
+
+int crud_journal_append( uint16_t type, const void *payload, uint16_t size ) {
+
+	// Local variables
+	CrudJournalRecord record;
+	char *at;
+
+	// Nothing is logged without a journal, or while replaying it
+	if ( (crud_journal_anchor_oid == CRUD_NO_OBJECT) || crud_journal_replaying ) {
+		return( 0 );
+	}
+	if ( crud_journal_pending == NULL ) {
+		crud_journal_pending = malloc( sizeof(CrudJournalSegment) + CRUD_JOURNAL_SEGMENT_SIZE );
+	}
+	if ( (crud_journal_pending_bytes + sizeof(CrudJournalRecord) + size > CRUD_JOURNAL_SEGMENT_SIZE) && crud_journal_write_segment() ) {
+		return( -1 );
+	}
+
+	// The first record pending starts the group commit timer
+	if ( crud_journal_pending_bytes == 0 ) {
+		clock_gettime( CLOCK_MONOTONIC, &crud_journal_pending_since );
+	}
+	at = crud_journal_pending + sizeof(CrudJournalSegment) + crud_journal_pending_bytes;
+	record.type = type;
+	record.size = size;
+	memcpy( at, &record, sizeof(CrudJournalRecord) );
+	memcpy( at + sizeof(CrudJournalRecord), payload, size );
+	crud_journal_pending_bytes += sizeof(CrudJournalRecord) + size;
+	return( 0 );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : crud_journal_due
+// Description  : Check if the pending records should be committed, because
+//                they fill a group or the oldest has waited long enough
+//
+// Inputs       : none
+// Outputs      : 1 if a commit is due, 0 otherwise
+
+int crud_journal_due( void ) {
+
+	// Local variables
+	struct timespec now;
+	int64_t msec;
+
+	// Checking the size, then the age of the group
+	if ( crud_journal_pending_bytes == 0 ) {
+		return( crud_journal_nfrees > 0 );
+	}
+	if ( crud_journal_pending_bytes >= CRUD_JOURNAL_GROUP_SIZE ) {
+		return( 1 );
+	}
+	clock_gettime( CLOCK_MONOTONIC, &now );
+	msec = (now.tv_sec - crud_journal_pending_since.tv_sec) * 1000 + (now.tv_nsec - crud_journal_pending_since.tv_nsec) / 1000000;
+	return( msec >= CRUD_JOURNAL_GROUP_MSEC );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : crud_journal_commit
+// Description  : Write the pending records, then give back the objects
+//                freed by the changes they record, and let the pool delete
+//                the objects it gave up before
+//
+// Inputs       : none
+// Outputs      : 0 if successful, -1 if failure
+
+int crud_journal_commit( void ) {
+
+	// Local variables
+	uint32_t i;
+
+	// The frees are recorded after the records naming the objects that
+	// replaced them, and given back once written
+	for ( i=0; i<crud_journal_nfrees; i++ ) {
+		if ( crud_journal_append(CRUD_JOURNAL_FREE, &crud_journal_frees[i], sizeof(CrudRecycleObject)) ) {
+			return( -1 );
+		}
+	}
+	if ( crud_journal_write_segment() ) {
+		return( -1 );
+	}
+	crud_recycle_commit();
+	return( crud_journal_release() );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : crud_journal_free
+// Description  : Give an object no longer used back to the recycling pool,
+//                once the records of the change are written (without a
+//                journal, once the table is written whole)
+//
+// Inputs       : oid - the object
+//                size - its size
+// Outputs      : 0 if successful, -1 if failure
+
+int crud_journal_free( CrudOID oid, uint32_t size ) {
+
+	// Local variables
+	CrudRecycleObject *frees;
+	uint32_t slots;
+
+	// Held until the table saved last no longer names the object
+	if ( crud_journal_nfrees == crud_journal_free_slots ) {
+		slots = (crud_journal_free_slots == 0) ? 64 : crud_journal_free_slots * 2;
+		if ( (frees = realloc(crud_journal_frees, slots * sizeof(CrudRecycleObject))) == NULL ) {
+			CRUD_LOG( LOG_ERROR_LEVEL, "CRUD journal: no memory to hold [OID %u], left in the store", oid );
+			return( -1 );
+		}
+		crud_journal_frees = frees;
+		crud_journal_free_slots = slots;
+	}
+	crud_journal_frees[crud_journal_nfrees].oid = oid;
+	crud_journal_frees[crud_journal_nfrees].size = size;
+	crud_journal_nfrees++;
+	return( 0 );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : crud_journal_checkpoint
+// Description  : Start the journal over after the table was written whole
+//                (the pending records are in the table): give back the
+//                freed objects, write a segment naming the objects the pool
+//                keeps (or an empty journal), then delete the old segments
+//
+// Inputs       : none
+// Outputs      : 0 if successful, -1 if failure
+
+int crud_journal_checkpoint( void ) {
+
+	// Local variables
+	CrudJournalAnchor anchor;
+	CrudRecycleObject *kept;
+	CrudOID *segments;
+	uint32_t i, count, nsegments;
+	int ret;
+
+	// Without a journal the freed objects are deleted
+	crud_journal_pending_bytes = 0;
+	if ( crud_journal_anchor_oid == CRUD_NO_OBJECT ) {
+		ret = crud_journal_release();
+		crud_recycle_commit();
+		return( ret );
+	}
+
+	// The new journal starts empty, the old segments are garbage once the
+	// anchor names it
+	segments = crud_journal_segments;
+	nsegments = crud_journal_anchor.segments;
+	crud_journal_segments = NULL;
+	crud_journal_segment_slots = 0;
+	crud_journal_anchor.tail = CRUD_NO_OBJECT;
+	crud_journal_anchor.segments = 0;
+	crud_journal_anchor.bytes = 0;
+
+	// The freed objects join the pool first, then the pool is named whole
+	// (the objects it queued to make room are left out)
+	ret = crud_journal_release();
+	crud_journal_pending_bytes = 0;
+	count = crud_recycle_kept( &kept );
+	for ( i=0; (i<count) && (ret == 0); i++ ) {
+		ret = crud_journal_append( CRUD_JOURNAL_FREE, &kept[i], sizeof(CrudRecycleObject) );
+	}
+	free( kept );
+	if ( (ret == 0) && (crud_journal_pending_bytes > 0) ) {
+		ret = crud_journal_write_segment();
+	} else if ( (ret == 0) && (nsegments > 0) ) {
+		memset( &anchor, 0x0, sizeof(CrudJournalAnchor) );
+		anchor.tail = CRUD_NO_OBJECT;
+		ret = crud_journal_write_anchor( &anchor );
+	}
+
+	// The objects queued can be deleted now
+	if ( ret == 0 ) {
+		ret = crud_journal_delete( segments, nsegments );
+		crud_recycle_commit();
+	}
+	free( segments );
+	return( ret );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : crud_journal_reset
+// Description  : Forget the journal in memory (records and frees pending are
+//                lost, the objects of lost frees are left in the store)
+//
+// Inputs       : none
+// Outputs      : none
+
+void crud_journal_reset( void ) {
+
+	// Handing the lists back to the heap
+	free( crud_journal_segments );
+	free( crud_journal_frees );
+	free( crud_journal_pending );
+	crud_journal_segments = NULL;
+	crud_journal_frees = NULL;
+	crud_journal_pending = NULL;
+	crud_journal_segment_slots = 0;
+	crud_journal_free_slots = 0;
+	crud_journal_nfrees = 0;
+	crud_journal_pending_bytes = 0;
+	crud_journal_anchor_oid = CRUD_NO_OBJECT;
+	memset( &crud_journal_anchor, 0x0, sizeof(CrudJournalAnchor) );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : crud_journal_active
+// Description  : Check there is a journal
+//
+// Inputs       : none
+// Outputs      : 1 if there is a journal, 0 otherwise
+
+int crud_journal_active( void ) {
+	return( crud_journal_anchor_oid != CRUD_NO_OBJECT );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : crud_journal_bytes
+// Description  : Get the bytes of records written since the checkpoint,
+//                which is what the next mount would replay
+//
+// Inputs       : none
+// Outputs      : the number of bytes
+
+uint32_t crud_journal_bytes( void ) {
+	return( crud_journal_anchor.bytes );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : crudJournalUnitTest
+// Description  : Perform a test of the journal: changes committed before a
+//                crash (the table lost without unmounting) are replayed at
+//                the next mount, and the journal stays bounded
+//
+// Inputs       : none
+// Outputs      : 0 if successful, -1 if failure
+
+int crudJournalUnitTest( void ) {
+
+	// Local variables
+	CrudFileAllocationType *entry;
+	char name[CRUD_MAX_PATH_LENGTH], data[CRUD_JOURNAL_UNIT_TEST_FILES], buf[CRUD_JOURNAL_UNIT_TEST_FILES];
+	uint32_t i, max = 0;
+	int16_t fh;
+
+	// Create some files, committing without writing the table
+	memset( data, 'j', CRUD_JOURNAL_UNIT_TEST_FILES );
+	if ( crud_format() || crud_mount() || !crud_journal_active() ) {
+		CRUD_LOG( LOG_ERROR_LEVEL, "CRUD_JOURNAL_UNIT_TEST : Failure on format or mount." );
+		return( -1 );
+	}
+	for ( i=0; i<CRUD_JOURNAL_UNIT_TEST_FILES; i++ ) {
+		snprintf( name, CRUD_MAX_PATH_LENGTH, "journal/%03u", i );
+		if ( ((fh = crud_open(name)) == -1) || (crud_write(fh, data, i) != i) || crud_close(fh) ) {
+			CRUD_LOG( LOG_ERROR_LEVEL, "CRUD_JOURNAL_UNIT_TEST : create of [%s] failed.", name );
+			return( -1 );
+		}
+	}
+	if ( (crud_mkdir("journal") == -1) || crud_table_commit(1) || (crud_journal_bytes() == 0) ) {
+		CRUD_LOG( LOG_ERROR_LEVEL, "CRUD_JOURNAL_UNIT_TEST : commit failed." );
+		return( -1 );
+	}
+
+	// Crash: the table is read again as the last checkpoint left it, and
+	// the journal brings back the files
+	if ( crud_table_mount() || (crud_table_files() != CRUD_JOURNAL_UNIT_TEST_FILES+1) ) {
+		CRUD_LOG( LOG_ERROR_LEVEL, "CRUD_JOURNAL_UNIT_TEST : replay failed (%lu files).", crud_table_files() );
+		return( -1 );
+	}
+	for ( i=0; i<CRUD_JOURNAL_UNIT_TEST_FILES; i++ ) {
+		snprintf( name, CRUD_MAX_PATH_LENGTH, "journal/%03u", i );
+		if ( ((entry = crud_table_find(name)) == NULL) || (entry->length != i) || ((fh = crud_open(name)) == -1) ||
+				(crud_read(fh, buf, CRUD_JOURNAL_UNIT_TEST_FILES) != i) || memcmp(buf, data, i) || crud_close(fh) ) {
+			CRUD_LOG( LOG_ERROR_LEVEL, "CRUD_JOURNAL_UNIT_TEST : [%s] not replayed.", name );
+			return( -1 );
+		}
+	}
+
+	// Many small changes keep the journal bounded by checkpoints, and each
+	// truncated or grown file frees the object it had (given back once committed)
+	for ( i=0; i<CRUD_JOURNAL_UNIT_TEST_UPDATES; i++ ) {
+		snprintf( name, CRUD_MAX_PATH_LENGTH, "journal/%03u", getRandomValue(0, CRUD_JOURNAL_UNIT_TEST_FILES-1) );
+		if ( ((fh = crud_open(name)) == -1) || crud_truncate(fh, 0) || (crud_write(fh, data, getRandomValue(1, CRUD_JOURNAL_UNIT_TEST_FILES)) == -1) ||
+				crud_close(fh) ) {
+			CRUD_LOG( LOG_ERROR_LEVEL, "CRUD_JOURNAL_UNIT_TEST : update of [%s] failed.", name );
+			return( -1 );
+		}
+		if ( crud_journal_bytes() > max ) {
+			max = crud_journal_bytes();
+		}
+	}
+	if ( max > CRUD_JOURNAL_CHECKPOINT_SIZE + CRUD_JOURNAL_SEGMENT_SIZE ) {
+		CRUD_LOG( LOG_ERROR_LEVEL, "CRUD_JOURNAL_UNIT_TEST : journal grew to %u bytes.", max );
+		return( -1 );
+	}
+
+	// Crash again, every file reads back, then a clean unmount leaves no journal
+	if ( crud_table_commit(1) || crud_table_mount() ) {
+		CRUD_LOG( LOG_ERROR_LEVEL, "CRUD_JOURNAL_UNIT_TEST : second replay failed." );
+		return( -1 );
+	}
+	for ( i=0; i<CRUD_JOURNAL_UNIT_TEST_FILES; i++ ) {
+		snprintf( name, CRUD_MAX_PATH_LENGTH, "journal/%03u", i );
+		if ( ((entry = crud_table_find(name)) == NULL) || ((fh = crud_open(name)) == -1) ||
+				(crud_read(fh, buf, CRUD_JOURNAL_UNIT_TEST_FILES) != entry->length) || memcmp(buf, data, entry->length) || crud_close(fh) ) {
+			CRUD_LOG( LOG_ERROR_LEVEL, "CRUD_JOURNAL_UNIT_TEST : [%s] lost after the second replay.", name );
+			return( -1 );
+		}
+	}
+	if ( crud_unmount() || crud_mount() || (crud_journal_bytes() != 0) || (crud_table_files() != CRUD_JOURNAL_UNIT_TEST_FILES+1) ) {
+		CRUD_LOG( LOG_ERROR_LEVEL, "CRUD_JOURNAL_UNIT_TEST : unmount left %u journal bytes.", crud_journal_bytes() );
+		return( -1 );
+	}
+
+	// Unmount, return successfully
+	if ( crud_unmount() ) {
+		CRUD_LOG( LOG_ERROR_LEVEL, "CRUD_JOURNAL_UNIT_TEST : Failure on unmount operation." );
+		return( -1 );
+	}
+	return( 0 );
+}
@@ -0,0 +1,114 @@
+#ifndef CRUD_JOURNAL_INCLUDED
+#define CRUD_JOURNAL_INCLUDED
+
+////////////////////////////////////////////////////////////////////////////////
+//
+//  File           : crud_journal.h
+//  Description    : This is the interface for the metadata journal of the
+//                   CRUD file system.  Changes to the file table are
+//                   appended as small records and group committed as
+//                   journal segments, so they are durable without writing
+//                   the table; mount replays the segments written since the
+//                   last checkpoint (the last time the table was written).
+//                   The journal also names the objects the recycling pool
+//                   keeps, which the replay gives back to it.
+//
+//  Last Modified  : Sun Oct 18 22:36:41 EDT 2026
+//
+
+// Includes
+#include <stdint.h>
+
+// Project Includes
+#include <crud_driver.h>
+
+// Defines
+#define CRUD_JOURNAL_GROUP_SIZE (16*1024)   // pending record bytes that force a commit
+#define CRUD_JOURNAL_GROUP_MSEC 50          // age of the oldest pending record that forces a commit
+#define CRUD_JOURNAL_SEGMENT_SIZE (256*1024) // largest segment (pending records spill at this size)
+#define CRUD_JOURNAL_CHECKPOINT_SIZE (512*1024) // journal bytes that make a checkpoint due
+
+// Type definitions
+
+// These are the kinds of journal records
+typedef enum {
+	CRUD_JOURNAL_PUT = 1, // A table entry (CrudJournalPut and the filename)
+	CRUD_JOURNAL_REF = 2, // The count of a shared object (CrudTableRef)
+	CRUD_JOURNAL_DEL = 3, // A removed entry (the filename with the terminator)
+	CRUD_JOURNAL_FREE = 4, // An object given to the recycling pool (CrudRecycleObject)
+	CRUD_JOURNAL_TAKE = 5, // An object the pool gave up, reused or to be deleted (CrudOID)
+} CrudJournalRecordType;
+
+// This is the head of every record in a segment
+typedef struct {
+	uint16_t  type;   // CrudJournalRecordType
+	uint16_t  size;   // The bytes of the payload that follows
+} CrudJournalRecord;
+
+// This is the payload of a PUT record, followed by the filename (with the
+// terminator), so a record is only as long as its name
+typedef struct {
+	CrudOID   object_id;
+	uint32_t  length;
+	uint32_t  capacity;
+	uint32_t  flags;
+} CrudJournalPut;
+
+// This is the head of a segment object, the records follow
+typedef struct {
+	CrudOID   prev;   // The segment written before (CRUD_NO_OBJECT for the first)
+	uint32_t  bytes;  // The bytes of records in the segment
+} CrudJournalSegment;
+
+// This is the anchor object naming the last segment, the only object
+// rewritten by a commit (the table header names the anchor)
+typedef struct {
+	CrudOID   tail;     // The last segment (CRUD_NO_OBJECT when the journal is empty)
+	uint32_t  segments; // The number of segments since the checkpoint
+	uint32_t  bytes;    // The bytes of records in them
+	uint32_t  reserved;
+} CrudJournalAnchor;
+
+// This is the function mount calls on each record, oldest first
+typedef int (*CrudJournalReplayFunction)( uint16_t type, const void *payload, uint16_t size );
+
+//
+// Journal interface
+
+int crud_journal_format( CrudOID *anchor );
+	// Create the anchor of an empty journal
+
+int crud_journal_mount( CrudOID anchor, CrudJournalReplayFunction fn );
+	// Replay the journal of the anchor (CRUD_NO_OBJECT: no journal)
+
+int crud_journal_append( uint16_t type, const void *payload, uint16_t size );
+	// Add a record, durable at the next commit (ignored without a journal)
+
+int crud_journal_due( void );
+	// Check if the pending records are a full group or old enough to commit
+
+int crud_journal_commit( void );
+	// Write the pending records as a segment, then give back the objects freed before
+
+int crud_journal_free( CrudOID oid, uint32_t size );
+	// Give back an object no longer used (crud_recycle_free), once the records saying so are written
+
+int crud_journal_checkpoint( void );
+	// The table was written: start the journal over with the objects kept, giving back the freed ones
+
+void crud_journal_reset( void );
+	// Forget the journal in memory (records not committed are lost)
+
+int crud_journal_active( void );
+	// Check there is a journal (tables saved with no room for one have none)
+
+uint32_t crud_journal_bytes( void );
+	// Number of record bytes written since the checkpoint
+
+//
+// Unit testing for the module
+
+int crudJournalUnitTest( void );
+	// Perform a test of the journal
+
+#endif
@@ -0,0 +1,517 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+//  File           : crud_log.c
+//  Description    : This is the implementation of the CRUD logging front end
+//                   and its asynchronous logger.  A message is captured as a
+//                   binary record: the format pointer, the raw value of each
+//                   argument and a copy of each string argument.  Records go
+//                   through a bounded lock-free ring (per-slot sequence
+//                   numbers, any number of producers, one consumer) to a
+//                   background thread that formats and writes them.  When
+//                   the ring is full the caller yields until the consumer
+//                   frees a slot, so no message is lost.
+//
+//  Last Modified  : Sun Oct 18 13:05:51 EDT 2026
+//
+
+// Includes
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include <time.h>
+#include <sched.h>
+
+// Project Includes
+#include <crud_log.h>
+
+// Defines
+#define CRUD_LOG_LINE_SIZE MAX_LOG_MESSAGE_SIZE
+#define CRUD_LOG_SPEC_SIZE 32
+#define CRUD_LOG_IDLE_NS 1000000 // consumer nap when the ring is empty
+
+// Type definitions
+
+// These are the kinds of captured argument
+typedef enum {
+	CRUD_LOG_ARG_INT    = 0, // int (and smaller, promoted)
+	CRUD_LOG_ARG_LONG   = 1, // long, long long, size_t, intmax_t, ptrdiff_t
+	CRUD_LOG_ARG_DOUBLE = 2, // double
+	CRUD_LOG_ARG_STRING = 3, // string, copied into the record
+	CRUD_LOG_ARG_PTR    = 4, // pointer
+} CRUD_LOG_ARG_TYPES;
+
+// This is a captured message
+typedef struct {
+	unsigned long  lvl;                          // The level of the message
+	const char    *fmt;                          // The format (a literal)
+	uint8_t        nargs;                        // Number of arguments captured
+	uint8_t        types[CRUD_LOG_MAX_ARGS];     // Kind of each argument
+	union {
+		long long  i;
+		double     d;
+		const void *p;
+		uint16_t   s;                            // Offset of a string copy
+	} args[CRUD_LOG_MAX_ARGS];
+	uint16_t       used;                         // Bytes of string space used
+	char           strings[CRUD_LOG_STRING_SPACE];
+} CrudLogRecord;
+
+// This is a slot of the ring
+typedef struct {
+	atomic_size_t  seq;    // Which lap of the ring the slot is ready for
+	CrudLogRecord  rec;    // The message
+} CrudLogSlot;
+
+//
+// Global Data
+
+static CrudLogSlot   *crud_log_ring;        // The ring (NULL when synchronous)
+static size_t         crud_log_mask;        // Ring size - 1
+static atomic_size_t  crud_log_tail;        // Next slot a producer claims
+static size_t         crud_log_head;        // Next slot the consumer reads
+static atomic_int     crud_log_running;     // Consumer keeps going while set
+static pthread_t      crud_log_thread;      // The consumer
+static atomic_ulong   crud_log_stalls;      // Times a producer found the ring full
+static unsigned long  crud_log_written;     // Messages written by the consumer
+static pthread_mutex_t crud_log_mutex = PTHREAD_MUTEX_INITIALIZER; // Serializes the cmpsc311 log when synchronous
+
+//
+// Module local methods
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : crud_log_spec
+// Description  : Find the end of the conversion at fmt (just past the '%')
+//
+// Inputs       : fmt - the conversion after the '%'
+//                type - the kind of argument it takes (out, -1 for none)
+// Outputs      : pointer to the conversion character
+
+static const char *crud_log_spec( const char *fmt, int *type ) {
+
+	// Local variables
+	int longs = 0;
+
+	// Skip flags, width and precision, then the length modifiers
+	while ( (*fmt != 0x0) && (strchr("-+ #0123456789.*'", *fmt) != NULL) ) {
+		fmt++;
+	}
+	while ( (*fmt != 0x0) && (strchr("hlLqjzt", *fmt) != NULL) ) {
+		longs |= (strchr("lqjzt", *fmt) != NULL);
+		fmt++;
+	}
+
+	// The conversion picks the argument kind
+	if ( *fmt == 0x0 ) {
+		*type = -1;
+		return( fmt - 1 );
+	}
+	if ( strchr("diouxXc", *fmt) != NULL ) {
+		*type = longs ? CRUD_LOG_ARG_LONG : CRUD_LOG_ARG_INT;
+	} else if ( strchr("eEfFgGaA", *fmt) != NULL ) {
+		*type = CRUD_LOG_ARG_DOUBLE;
+	} else if ( *fmt == 's' ) {
+		*type = CRUD_LOG_ARG_STRING;
+	} else if ( *fmt == 'p' ) {
+		*type = CRUD_LOG_ARG_PTR;
+	} else {
+		*type = -1; // %% and anything unsupported
+	}
+	return( fmt );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : crud_log_capture
+// Description  : Copy a message into a binary record
+//
+// Inputs       : rec - the record
+//                lvl - the level of the message
+//                fmt - the format
+//                args - the arguments
+// Outputs      : none
+
+static void crud_log_capture( CrudLogRecord *rec, unsigned long lvl, const char *fmt, va_list args ) {
+
+	// Local variables
+	const char *p, *s;
+	size_t len;
+	int type;
+
+	// Walk the conversions, taking each argument by its kind
+	rec->lvl = lvl;
+	rec->fmt = fmt;
+	rec->nargs = 0;
+	rec->used = 0;
+	for ( p = strchr(fmt, '%'); (p != NULL) && (rec->nargs < CRUD_LOG_MAX_ARGS); p = strchr(p+1, '%') ) {
+		p = crud_log_spec( p+1, &type );
+		if ( type == -1 ) {
+			continue;
+		}
+		rec->types[rec->nargs] = type;
+		switch ( type ) {
+		case CRUD_LOG_ARG_INT:
+			rec->args[rec->nargs].i = va_arg( args, int );
+			break;
+		case CRUD_LOG_ARG_LONG:
+			rec->args[rec->nargs].i = va_arg( args, long long );
+			break;
+		case CRUD_LOG_ARG_DOUBLE:
+			rec->args[rec->nargs].d = va_arg( args, double );
+			break;
+		case CRUD_LOG_ARG_PTR:
+			rec->args[rec->nargs].p = va_arg( args, void * );
+			break;
+		case CRUD_LOG_ARG_STRING: // copy what fits, truncating the rest
+			s = va_arg( args, const char * );
+			s = (s == NULL) ? "(null)" : s;
+			len = strlen( s );
+			if ( len > CRUD_LOG_STRING_SPACE - 1 - rec->used ) {
+				len = CRUD_LOG_STRING_SPACE - 1 - rec->used;
+			}
+			memcpy( &rec->strings[rec->used], s, len );
+			rec->strings[rec->used+len] = 0x0;
+			rec->args[rec->nargs].s = rec->used;
+			rec->used += len + ((rec->used + len < CRUD_LOG_STRING_SPACE - 1) ? 1 : 0);
+			break;
+		}
+		rec->nargs++;
+	}
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : crud_log_render
+// Description  : Format a captured record, one conversion at a time
+//
+// Inputs       : rec - the record
+//                out - the buffer for the text
+//                size - the size of the buffer
+// Outputs      : none
+
+static void crud_log_render( CrudLogRecord *rec, char *out, size_t size ) {
+
+	// Local variables
+	char spec[CRUD_LOG_SPEC_SIZE];
+	const char *p = rec->fmt, *end;
+	size_t len = 0, n;
+	int type, arg = 0;
+
+	// Copy the text between conversions, format each conversion alone
+	out[0] = 0x0;
+	while ( (*p != 0x0) && (len < size - 1) ) {
+		if ( *p != '%' ) {
+			out[len++] = *p++;
+			continue;
+		}
+		end = crud_log_spec( p+1, &type );
+		n = end - p + 1;
+		if ( (n >= CRUD_LOG_SPEC_SIZE) || ((type != -1) && (arg >= rec->nargs)) ) {
+			break; // malformed or more conversions than captured
+		}
+		memcpy( spec, p, n );
+		spec[n] = 0x0;
+		switch ( type ) {
+		case CRUD_LOG_ARG_INT:
+			snprintf( &out[len], size-len, spec, (int)rec->args[arg++].i );
+			break;
+		case CRUD_LOG_ARG_LONG:
+			snprintf( &out[len], size-len, spec, rec->args[arg++].i );
+			break;
+		case CRUD_LOG_ARG_DOUBLE:
+			snprintf( &out[len], size-len, spec, rec->args[arg++].d );
+			break;
+		case CRUD_LOG_ARG_STRING:
+			snprintf( &out[len], size-len, spec, &rec->strings[rec->args[arg++].s] );
+			break;
+		case CRUD_LOG_ARG_PTR:
+			snprintf( &out[len], size-len, spec, rec->args[arg++].p );
+			break;
+		default: // %% and unsupported conversions are copied as they are
+			snprintf( &out[len], size-len, "%s", (strcmp(spec, "%%") == 0) ? "%" : spec );
+			break;
+		}
+		len += strlen( &out[len] );
+		p = end + 1;
+	}
+	out[len] = 0x0;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : crud_log_enqueue
+// Description  : Claim a slot of the ring and capture the message into it
+//
+// Inputs       : lvl - the level of the message
+//                fmt - the format
+//                args - the arguments
+// Outputs      : 0 if queued
+
+static int crud_log_enqueue( unsigned long lvl, const char *fmt, va_list args ) {
+
+	// Local variables
+	CrudLogSlot *slot;
+	size_t pos, seq;
+
+	// Claim the tail slot once the consumer has freed it for this lap
+	pos = atomic_load_explicit( &crud_log_tail, memory_order_relaxed );
+	for ( ;; ) {
+		slot = &crud_log_ring[pos & crud_log_mask];
+		seq = atomic_load_explicit( &slot->seq, memory_order_acquire );
+		if ( seq == pos ) {
+			if ( atomic_compare_exchange_weak_explicit(&crud_log_tail, &pos, pos+1,
+					memory_order_relaxed, memory_order_relaxed) ) {
+				break;
+			}
+		} else if ( (intptr_t)(seq - pos) < 0 ) {
+			atomic_fetch_add( &crud_log_stalls, 1 );
+			sched_yield(); // full, wait for the consumer
+			pos = atomic_load_explicit( &crud_log_tail, memory_order_relaxed );
+		} else {
+			pos = atomic_load_explicit( &crud_log_tail, memory_order_relaxed );
+		}
+	}
+
+	// Fill it in, then hand it to the consumer
+	crud_log_capture( &slot->rec, lvl, fmt, args );
+	atomic_store_explicit( &slot->seq, pos+1, memory_order_release );
+	return( 0 );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : crud_log_drain
+// Description  : Format and write every record that is ready
+//
+// Inputs       : none
+// Outputs      : the number of records written
+
+static int crud_log_drain( void ) {
+
+	// Local variables
+	char line[CRUD_LOG_LINE_SIZE];
+	CrudLogSlot *slot;
+	int count = 0;
+
+	// Take records in order until the next one is not ready
+	for ( ;; ) {
+		slot = &crud_log_ring[crud_log_head & crud_log_mask];
+		if ( atomic_load_explicit(&slot->seq, memory_order_acquire) != crud_log_head+1 ) {
+			return( count );
+		}
+		crud_log_render( &slot->rec, line, sizeof(line) );
+		logMessage( slot->rec.lvl, "%s", line );
+		atomic_store_explicit( &slot->seq, crud_log_head+crud_log_mask+1, memory_order_release );
+		crud_log_head++;
+		crud_log_written++;
+		count++;
+	}
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : crud_log_consumer
+// Description  : The background thread writing the queued messages
+//
+// Inputs       : arg - unused
+// Outputs      : NULL
+
+static void *crud_log_consumer( void *arg ) {
+
+	// Local variables
+	struct timespec nap = { 0, CRUD_LOG_IDLE_NS };
+
+	// Drain the ring, napping while it is empty
+	while ( atomic_load(&crud_log_running) ) {
+		if ( crud_log_drain() == 0 ) {
+			nanosleep( &nap, NULL );
+		}
+	}
+	crud_log_drain();
+	return( NULL );
+}
+
+//
+// Functions
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : crud_log_message
+// Description  : Log a message now, through the asynchronous logger if it
+//                is running (callers use CRUD_LOG to skip disabled levels)
+//
+// Inputs       : lvl - the level of the message
+//                fmt - the printf-style format
+//                ... - the arguments
+// Outputs      : 0 if successful, -1 if failure
+
+int crud_log_message( unsigned long lvl, const char *fmt, ... ) {
+
+	// Local variables
+	va_list args;
+	int ret;
+
+	// Queue the record, or write it out directly (one thread at a time, the
+	// cmpsc311 log is not thread safe and background threads log too)
+	va_start( args, fmt );
+	if ( crud_log_ring != NULL ) {
+		ret = crud_log_enqueue( lvl, fmt, args );
+	} else {
+		pthread_mutex_lock( &crud_log_mutex );
+		ret = vlogMessage( lvl, fmt, args );
+		pthread_mutex_unlock( &crud_log_mutex );
+	}
+	va_end( args );
+	return( ret );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : crud_log_async_start
+// Description  : Start the asynchronous logger
+//
+// Inputs       : records - the records in the ring (rounded up to a power
+//                          of two, 0 for CRUD_LOG_RING_RECORDS)
+// Outputs      : 0 if successful, -1 if failure
+
+int crud_log_async_start( uint32_t records ) {
+
+	// Local variables
+	size_t size = 2, i;
+
+	// Only one logger runs at a time
+	if ( crud_log_ring != NULL ) {
+		return( -1 );
+	}
+	while ( size < ((records == 0) ? CRUD_LOG_RING_RECORDS : records) ) {
+		size <<= 1;
+	}
+
+	// Set up the ring, each slot ready for the first lap
+	crud_log_ring = malloc( size * sizeof(CrudLogSlot) );
+	for ( i=0; i<size; i++ ) {
+		atomic_init( &crud_log_ring[i].seq, i );
+	}
+	crud_log_mask = size - 1;
+	atomic_store( &crud_log_tail, 0 );
+	crud_log_head = 0;
+	atomic_store( &crud_log_stalls, 0 );
+	crud_log_written = 0;
+	atomic_store( &crud_log_running, 1 );
+	if ( pthread_create(&crud_log_thread, NULL, crud_log_consumer, NULL) != 0 ) {
+		free( crud_log_ring );
+		crud_log_ring = NULL;
+		logMessage( LOG_ERROR_LEVEL, "CRUD log: cannot start the logger thread" );
+		return( -1 );
+	}
+	return( 0 );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : crud_log_async_stop
+// Description  : Write out the queued messages and stop the logger (the
+//                producers must be done logging)
+//
+// Inputs       : none
+// Outputs      : 0 if successful, -1 if failure
+
+int crud_log_async_stop( void ) {
+
+	// Let the consumer finish the ring, then go back to synchronous
+	if ( crud_log_ring == NULL ) {
+		return( -1 );
+	}
+	atomic_store( &crud_log_running, 0 );
+	pthread_join( crud_log_thread, NULL );
+	free( crud_log_ring );
+	crud_log_ring = NULL;
+	if ( atomic_load(&crud_log_stalls) > 0 ) {
+		logMessage( LOG_INFO_LEVEL, "CRUD log: %lu messages written, producers waited on a full ring %lu times",
+				crud_log_written, atomic_load(&crud_log_stalls) );
+	}
+	return( 0 );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : crud_log_roundtrip
+// Description  : Capture and render a message the way the logger does
+//
+// Inputs       : out - the buffer for the text
+//                size - the size of the buffer
+//                fmt - the format
+//                ... - the arguments
+// Outputs      : none
+
+static void crud_log_roundtrip( char *out, size_t size, const char *fmt, ... ) {
+
+	// Local variables
+	CrudLogRecord rec;
+	va_list args;
+
+	// Capture then render
+	va_start( args, fmt );
+	crud_log_capture( &rec, LOG_INFO_LEVEL, fmt, args );
+	va_end( args );
+	crud_log_render( &rec, out, size );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : crudLogUnitTest
+// Description  : Check captured messages render like printf and that every
+//                message sent through a small ring is written
+//
+// Inputs       : none
+// Outputs      : 0 if successful, -1 if failure
+
+int crudLogUnitTest( void ) {
+
+	// Local variables
+	char got[CRUD_LOG_LINE_SIZE], want[CRUD_LOG_LINE_SIZE], name[16];
+	unsigned long quiet, sent = 20000, i;
+	int evaluated = 0;
+
+	// Binary capture must render the same text as printf
+	strcpy( name, "hamlet.txt" );
+	crud_log_roundtrip( got, sizeof(got), "File [%s], command [%s], len=%d, offset=%-6d|%5.2f %lu%% %c %x %p",
+			name, "WRITE", -42, 17, 3.14159, 1UL<<40, 'z', 0xbeef, (void *)got );
+	snprintf( want, sizeof(want), "File [%s], command [%s], len=%d, offset=%-6d|%5.2f %lu%% %c %x %p",
+			name, "WRITE", -42, 17, 3.14159, 1UL<<40, 'z', 0xbeef, (void *)got );
+	if ( strcmp(got, want) != 0 ) {
+		logMessage( LOG_ERROR_LEVEL, "CRUD_LOG_UNIT_TEST : rendered [%s], expected [%s]", got, want );
+		return( -1 );
+	}
+
+	// A disabled level must not evaluate the arguments
+	quiet = registerLogLevel( "CRUD_LOG_TEST", 0 );
+	CRUD_LOG( quiet, "never written %d", ++evaluated );
+	if ( evaluated ) {
+		logMessage( LOG_ERROR_LEVEL, "CRUD_LOG_UNIT_TEST : disabled message evaluated its arguments" );
+		return( -1 );
+	}
+
+	// Flood a small ring, every message must come out (the ring test is
+	// skipped if the logger is already in use)
+	if ( crud_log_ring == NULL ) {
+		if ( crud_log_async_start(64) ) {
+			return( -1 );
+		}
+		for ( i=0; i<sent; i++ ) {
+			crud_log_message( quiet, "record %lu of [%s]", i, name );
+		}
+		crud_log_async_stop();
+		if ( crud_log_written != sent ) {
+			logMessage( LOG_ERROR_LEVEL, "CRUD_LOG_UNIT_TEST : %lu written != %lu sent",
+					crud_log_written, sent );
+			return( -1 );
+		}
+	}
+
+	// Log, return successfully
+	logMessage( LOG_INFO_LEVEL, "CRUD log unit tests completed successfully." );
+	return( 0 );
+}
@@ -0,0 +1,53 @@
+#ifndef CRUD_LOG_INCLUDED
+#define CRUD_LOG_INCLUDED
+
+////////////////////////////////////////////////////////////////////////////////
+//
+//  File           : crud_log.h
+//  Description    : This is the logging front end of the CRUD code.  The
+//                   CRUD_LOG macro checks the level before the arguments of
+//                   the message are evaluated, so a disabled level costs a
+//                   single test.  Messages go to the cmpsc311 log, or to the
+//                   asynchronous logger when it is running: the caller only
+//                   copies a binary record (format, raw arguments, copies of
+//                   the strings) into a lock-free ring and a background
+//                   thread does the formatting and writing.
+//
+//  Last Modified  : Sun Oct 18 13:05:51 EDT 2026
+//
+
+// Include files
+#include <stdint.h>
+
+// Project include files
+#include <cmpsc311_log.h>
+
+// Defines
+#define CRUD_LOG_RING_RECORDS 4096  // default number of records in the ring
+#define CRUD_LOG_MAX_ARGS 12        // arguments kept per message
+#define CRUD_LOG_STRING_SPACE 256   // bytes of string arguments kept per message
+
+// Log a message if its level is enabled (arguments are only evaluated then)
+#define CRUD_LOG(lvl, ...) \
+	do { if ( levelEnabled(lvl) ) crud_log_message( (lvl), __VA_ARGS__ ); } while (0)
+
+//
+// Logging interface
+
+int crud_log_message( unsigned long lvl, const char *fmt, ... )
+		__attribute__((format(printf, 2, 3)));
+	// Log a message now (use CRUD_LOG), through the asynchronous logger if running
+
+int crud_log_async_start( uint32_t records );
+	// Start the asynchronous logger with a ring of records (power of two, 0 for default)
+
+int crud_log_async_stop( void );
+	// Write out the queued messages and stop the asynchronous logger
+
+//
+// Unit testing for the module
+
+int crudLogUnitTest( void );
+	// Perform a test of the asynchronous logger
+
+#endif
@@ -0,0 +1,640 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+//  File           : crud_recycle.c
+//  Description    : This is the object recycling pool of the CRUD file
+//                   system.  An object cannot change size, so a file that
+//                   grows moves to a new object and gives up the old one.
+//                   Instead of deleting the objects given up (once the
+//                   journal no longer needs them), the pool keeps the most
+//                   recent ones, and the next object of the same size is
+//                   made by a CRUD_UPDATE of one of them instead of a
+//                   CRUD_CREATE.  Grown files get sizes rounded up to a few
+//                   size classes per power of two, so the sizes repeat.
+//                   The objects the pool has no room for are queued and
+//                   deleted in batches by a background thread.  The journal
+//                   records the objects given to the pool and the ones
+//                   taken out of it (reused, or queued to be deleted), so a
+//                   mount after a crash finds the pool again, and an object
+//                   queued is only deleted once the journal no longer names
+//                   it as kept.
+//
+//  Last Modified  : Sun Oct 18 22:36:41 EDT 2026
+//
+
+// Includes
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+// Project Includes
+#include <crud_recycle.h>
+#include <crud_journal.h>
+#include <crud_file_io.h>
+#include <crud_file_table.h>
+#include <crud_log.h>
+
+// Defines
+#define CRUD_RECYCLE_UNIT_TEST_SIZE 1000          // bytes of the objects recycled by the test
+#define CRUD_RECYCLE_UNIT_TEST_EXTRA 40           // objects the test frees past the pool
+#define CRUD_RECYCLE_UNIT_TEST_GROWTH 50          // times each file of the test grows
+#define CRUD_RECYCLE_UNIT_TEST_STEP 700           // bytes each growth adds
+
+//
+// Module local data
+
+static pthread_mutex_t crud_recycle_mutex = PTHREAD_MUTEX_INITIALIZER; // Guards the pool and the queue
+static pthread_cond_t crud_recycle_queued = PTHREAD_COND_INITIALIZER;  // Signals a batch queued (or a stop)
+static CrudRecycleObject crud_recycle_pool[CRUD_RECYCLE_POOL_OBJECTS]; // The objects kept, oldest first
+static uint32_t crud_recycle_pooled;           // The number of objects kept
+static uint64_t crud_recycle_pool_bytes;       // Their bytes
+static CrudOID *crud_recycle_deletes;          // The objects waiting to be deleted
+static uint32_t crud_recycle_ndeletes;         // The number waiting
+static uint32_t crud_recycle_nready;           // Of those, the first ones the journal has written as taken
+static uint32_t crud_recycle_delete_slots;     // The size of the queue
+static pthread_t crud_recycle_thread;          // The thread deleting the queue
+static uint8_t crud_recycle_running;           // Flag indicating the thread was started
+static uint8_t crud_recycle_stopping;          // Flag telling the thread to empty the queue and finish
+static uint8_t crud_recycle_closed;            // Flag indicating the pool was drained (objects given back are deleted)
+static uint64_t crud_recycle_creates;          // Objects made
+static uint64_t crud_recycle_reused;           // Of those, the objects made by updating a kept one
+static uint64_t crud_recycle_deleted;          // Objects deleted
+static uint64_t crud_recycle_batches;          // Batches they were deleted in
+
+//
+// Module local methods
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : crud_recycle_delete
+// Description  : Delete a list of objects in one batch
+//
+// Inputs       : oids - the objects
+//                count - the number of objects
+// Outputs      : 0 if successful, -1 if failure
+
+static int crud_recycle_delete( CrudOID *oids, uint32_t count ) {
+
+	// Local variables
+	CrudRequest *requests;
+	CrudResponse *responses;
+	void **bufs;
+	uint32_t i;
+	int ret = 0;
+
+	if ( count == 0 ) {
+		return( 0 );
+	}
+	requests = malloc( count * sizeof(CrudRequest) );
+	responses = malloc( count * sizeof(CrudResponse) );
+	bufs = calloc( count, sizeof(void *) );
+	for ( i=0; i<count; i++ ) {
+		requests[i] = create_crudrequest( oids[i], CRUD_DELETE, 0, CRUD_NULL_FLAG );
+	}
+
+	// Every object is deleted, the failures are reported together
+	if ( crud_io_batch(requests, bufs, responses, count) ) {
+		for ( i=0; i<count; i++ ) {
+			if ( responses[i] & 0x1 ) {
+				CRUD_LOG( LOG_ERROR_LEVEL, "CRUD recycle: failed deleting [OID %u]", oids[i] );
+			}
+		}
+		ret = -1;
+	}
+	pthread_mutex_lock( &crud_recycle_mutex );
+	crud_recycle_deleted += count;
+	crud_recycle_batches++;
+	pthread_mutex_unlock( &crud_recycle_mutex );
+	free( requests );
+	free( responses );
+	free( bufs );
+	return( ret );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : crud_recycle_take
+// Description  : Take the ready part of the queue to delete it, leaving the
+//                objects the journal still names as kept (the lock is held)
+//
+// Inputs       : count - set to the number of objects taken
+// Outputs      : the objects taken (the caller frees the list)
+
+static CrudOID *crud_recycle_take( uint32_t *count ) {
+
+	// Local variables
+	CrudOID *oids = crud_recycle_deletes, *rest;
+	uint32_t left = crud_recycle_ndeletes - crud_recycle_nready;
+
+	// The rest move to a list of their own (or go too, if there is no room)
+	*count = crud_recycle_ndeletes;
+	crud_recycle_deletes = NULL;
+	crud_recycle_ndeletes = 0;
+	crud_recycle_nready = 0;
+	if ( left > 0 ) {
+		if ( (rest = malloc(crud_recycle_delete_slots * sizeof(CrudOID))) == NULL ) {
+			CRUD_LOG( LOG_ERROR_LEVEL, "CRUD recycle: no memory to split the delete queue, deleting all of it" );
+		} else {
+			memcpy( rest, &oids[*count-left], left * sizeof(CrudOID) );
+			crud_recycle_deletes = rest;
+			crud_recycle_ndeletes = left;
+			*count -= left;
+			return( oids );
+		}
+	}
+	crud_recycle_delete_slots = 0;
+	return( oids );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : crud_recycle_run
+// Description  : The background thread: delete the queue whenever a batch is
+//                waiting, and all of it when told to stop
+//
+// Inputs       : arg - unused
+// Outputs      : NULL
+
+static void *crud_recycle_run( void *arg ) {
+
+	// Local variables
+	CrudOID *oids;
+	uint32_t count;
+
+	pthread_mutex_lock( &crud_recycle_mutex );
+	while ( 1 ) {
+		while ( (crud_recycle_nready < CRUD_RECYCLE_DELETE_BATCH) && !crud_recycle_stopping ) {
+			pthread_cond_wait( &crud_recycle_queued, &crud_recycle_mutex );
+		}
+		if ( crud_recycle_nready == 0 ) {
+			break; // stopping, and nothing left
+		}
+
+		// Take the ready part of the queue and delete it without the lock
+		oids = crud_recycle_take( &count );
+		pthread_mutex_unlock( &crud_recycle_mutex );
+		crud_recycle_delete( oids, count );
+		free( oids );
+		pthread_mutex_lock( &crud_recycle_mutex );
+	}
+	pthread_mutex_unlock( &crud_recycle_mutex );
+	return( NULL );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : crud_recycle_queue
+// Description  : Queue an object to be deleted, recording in the journal
+//                that the pool gave it up; it is deleted once that record
+//                is written (the lock is held)
+//
+// Inputs       : oid - the object
+// Outputs      : none
+
+static void crud_recycle_queue( CrudOID oid ) {
+
+	// Local variables
+	CrudOID *deletes;
+	uint32_t slots;
+
+	if ( crud_recycle_ndeletes == crud_recycle_delete_slots ) {
+		slots = (crud_recycle_delete_slots == 0) ? CRUD_RECYCLE_DELETE_BATCH * 2 : crud_recycle_delete_slots * 2;
+		if ( (deletes = realloc(crud_recycle_deletes, slots * sizeof(CrudOID))) == NULL ) {
+			CRUD_LOG( LOG_ERROR_LEVEL, "CRUD recycle: no memory to queue [OID %u], left in the store", oid );
+			return;
+		}
+		crud_recycle_deletes = deletes;
+		crud_recycle_delete_slots = slots;
+	}
+	crud_recycle_deletes[crud_recycle_ndeletes++] = oid;
+	crud_journal_append( CRUD_JOURNAL_TAKE, &oid, sizeof(CrudOID) );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : crud_recycle_stop
+// Description  : Stop the background thread, once it deleted the queue (or
+//                with the queue thrown away)
+//
+// Inputs       : discard - nonzero to throw the queue away
+// Outputs      : none
+
+static void crud_recycle_stop( int discard ) {
+
+	// Local variables
+	int running;
+
+	pthread_mutex_lock( &crud_recycle_mutex );
+	if ( discard ) {
+		crud_recycle_ndeletes = 0;
+		crud_recycle_nready = 0;
+	}
+	crud_recycle_stopping = 1;
+	running = crud_recycle_running;
+	pthread_cond_signal( &crud_recycle_queued );
+	pthread_mutex_unlock( &crud_recycle_mutex );
+	if ( running ) {
+		pthread_join( crud_recycle_thread, NULL );
+	}
+	pthread_mutex_lock( &crud_recycle_mutex );
+	crud_recycle_running = 0;
+	crud_recycle_stopping = 0;
+	pthread_mutex_unlock( &crud_recycle_mutex );
+}
+
+//
+// Functions
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : crud_recycle_class
+// Description  : Round a length up to its size class: a multiple of
+//                CRUD_RECYCLE_MIN_STEP for small objects, else one of
+//                CRUD_RECYCLE_STEPS sizes per power of two (so the room
+//                wasted is under a step, or a quarter of a larger object),
+//                never past the largest object
+//
+// Inputs       : length - the length
+// Outputs      : the size class
+
+uint32_t crud_recycle_class( uint32_t length ) {
+
+	// Local variables
+	uint32_t step, size;
+
+	if ( length == 0 ) {
+		return( 0 );
+	}
+	step = CRUD_RECYCLE_MIN_STEP;
+	while ( step * CRUD_RECYCLE_STEPS * 2 < length ) {
+		step *= 2;
+	}
+	size = (length + step - 1) / step * step;
+	return( (size > CRUD_MAX_OBJECT_SIZE) ? CRUD_MAX_OBJECT_SIZE : size );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : crud_recycle_create
+// Description  : Make an object holding buf, by updating the most recent
+//                object kept of the size, or creating one if none is (or
+//                the update fails)
+//
+// Inputs       : size - the size of the object
+//                buf - its contents
+// Outputs      : the response, as the one of a create
+
+CrudResponse crud_recycle_create( uint32_t size, void *buf ) {
+
+	// Local variables
+	CrudOID oid = CRUD_NO_OBJECT;
+	CrudResponse response;
+	int i;
+
+	// Take the most recent object of the size (none once the pool is drained)
+	pthread_mutex_lock( &crud_recycle_mutex );
+	crud_recycle_creates++;
+	for ( i=(int)crud_recycle_pooled-1; (i>=0) && (size>0); i-- ) {
+		if ( crud_recycle_pool[i].size == size ) {
+			oid = crud_recycle_pool[i].oid;
+			memmove( &crud_recycle_pool[i], &crud_recycle_pool[i+1], (crud_recycle_pooled - i - 1) * sizeof(CrudRecycleObject) );
+			crud_recycle_pooled--;
+			crud_recycle_pool_bytes -= size;
+			break;
+		}
+	}
+	pthread_mutex_unlock( &crud_recycle_mutex );
+
+	// Rewrite it, or give it up and create one
+	if ( oid != CRUD_NO_OBJECT ) {
+		response = crud_io_request( create_crudrequest(oid, CRUD_UPDATE, size, CRUD_NULL_FLAG), buf );
+		pthread_mutex_lock( &crud_recycle_mutex );
+		if ( !(response & 0x1) ) {
+			crud_recycle_reused++;
+			pthread_mutex_unlock( &crud_recycle_mutex );
+			crud_journal_append( CRUD_JOURNAL_TAKE, &oid, sizeof(CrudOID) );
+			return( create_crudrequest(oid, CRUD_CREATE, size, CRUD_NULL_FLAG) );
+		}
+		CRUD_LOG( LOG_ERROR_LEVEL, "CRUD recycle: failed reusing [OID %u]", oid );
+		crud_recycle_queue( oid );
+		pthread_mutex_unlock( &crud_recycle_mutex );
+	}
+	return( crud_io_request(create_crudrequest(0, CRUD_CREATE, size, CRUD_NULL_FLAG), buf) );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : crud_recycle_free
+// Description  : Give back an object no longer used: the pool keeps it,
+//                giving up its oldest objects to make room, and the objects
+//                it cannot keep are queued to be deleted (right away once
+//                the pool is drained)
+//
+// Inputs       : oid - the object
+//                size - its size (objects of no size are not kept)
+// Outputs      : 0 if successful, -1 if failure
+
+int crud_recycle_free( CrudOID oid, uint32_t size ) {
+
+	pthread_mutex_lock( &crud_recycle_mutex );
+	if ( crud_recycle_closed ) {
+		pthread_mutex_unlock( &crud_recycle_mutex );
+		return( crud_recycle_delete(&oid, 1) );
+	}
+	if ( (size == 0) || (size > CRUD_RECYCLE_POOL_BYTES) ) {
+		crud_recycle_queue( oid );
+		pthread_mutex_unlock( &crud_recycle_mutex );
+		return( 0 );
+	}
+	while ( (crud_recycle_pooled == CRUD_RECYCLE_POOL_OBJECTS) || (crud_recycle_pool_bytes + size > CRUD_RECYCLE_POOL_BYTES) ) {
+		crud_recycle_queue( crud_recycle_pool[0].oid );
+		crud_recycle_pool_bytes -= crud_recycle_pool[0].size;
+		memmove( &crud_recycle_pool[0], &crud_recycle_pool[1], (crud_recycle_pooled - 1) * sizeof(CrudRecycleObject) );
+		crud_recycle_pooled--;
+	}
+	crud_recycle_pool[crud_recycle_pooled].oid = oid;
+	crud_recycle_pool[crud_recycle_pooled].size = size;
+	crud_recycle_pooled++;
+	crud_recycle_pool_bytes += size;
+	pthread_mutex_unlock( &crud_recycle_mutex );
+	return( 0 );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : crud_recycle_kept
+// Description  : List the objects the pool keeps, oldest first (for the
+//                journal to record them again after a checkpoint)
+//
+// Inputs       : objects - set to the list (the caller frees it)
+// Outputs      : the number of objects
+
+uint32_t crud_recycle_kept( CrudRecycleObject **objects ) {
+
+	// Local variables
+	uint32_t count;
+
+	pthread_mutex_lock( &crud_recycle_mutex );
+	count = crud_recycle_pooled;
+	*objects = malloc( (count + 1) * sizeof(CrudRecycleObject) );
+	if ( *objects == NULL ) {
+		CRUD_LOG( LOG_ERROR_LEVEL, "CRUD recycle: no memory to list the pool" );
+		count = 0;
+	} else {
+		memcpy( *objects, crud_recycle_pool, count * sizeof(CrudRecycleObject) );
+	}
+	pthread_mutex_unlock( &crud_recycle_mutex );
+	return( count );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : crud_recycle_commit
+// Description  : The journal wrote the records of the objects queued so far,
+//                let the background thread delete them, waking (or
+//                starting) it once a batch is ready
+//
+// Inputs       : none
+// Outputs      : none
+
+void crud_recycle_commit( void ) {
+
+	pthread_mutex_lock( &crud_recycle_mutex );
+	crud_recycle_nready = crud_recycle_ndeletes;
+	if ( crud_recycle_nready >= CRUD_RECYCLE_DELETE_BATCH ) {
+		if ( !crud_recycle_running ) {
+			if ( pthread_create(&crud_recycle_thread, NULL, crud_recycle_run, NULL) ) {
+				CRUD_LOG( LOG_ERROR_LEVEL, "CRUD recycle: failed starting the delete thread, deleting at the drain" );
+				pthread_mutex_unlock( &crud_recycle_mutex );
+				return;
+			}
+			crud_recycle_running = 1;
+		}
+		pthread_cond_signal( &crud_recycle_queued );
+	}
+	pthread_mutex_unlock( &crud_recycle_mutex );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : crud_recycle_drain
+// Description  : Delete every object kept and queued, waiting for the
+//                background thread to finish, and delete the objects given
+//                back from now on right away (the store is about to close,
+//                the table written next names no object kept)
+//
+// Inputs       : none
+// Outputs      : 0 if successful, -1 if failure
+
+int crud_recycle_drain( void ) {
+
+	// Local variables
+	CrudOID *oids;
+	uint32_t i, count;
+	int ret;
+
+	// The kept objects join the queue, the thread deletes what it can
+	pthread_mutex_lock( &crud_recycle_mutex );
+	for ( i=0; i<crud_recycle_pooled; i++ ) {
+		crud_recycle_queue( crud_recycle_pool[i].oid );
+	}
+	crud_recycle_pooled = 0;
+	crud_recycle_pool_bytes = 0;
+	crud_recycle_nready = crud_recycle_ndeletes;
+	crud_recycle_closed = 1;
+	pthread_mutex_unlock( &crud_recycle_mutex );
+	crud_recycle_stop( 0 );
+
+	// The rest (less than a batch, the thread never started) go here
+	pthread_mutex_lock( &crud_recycle_mutex );
+	oids = crud_recycle_deletes;
+	count = crud_recycle_ndeletes;
+	crud_recycle_deletes = NULL;
+	crud_recycle_ndeletes = 0;
+	crud_recycle_nready = 0;
+	crud_recycle_delete_slots = 0;
+	pthread_mutex_unlock( &crud_recycle_mutex );
+	ret = crud_recycle_delete( oids, count );
+	free( oids );
+	if ( crud_recycle_creates + crud_recycle_deleted > 0 ) {
+		CRUD_LOG( LOG_INFO_LEVEL, "CRUD recycle: %lu of %lu objects made by reuse, %lu deleted in %lu batches.",
+				crud_recycle_reused, crud_recycle_creates, crud_recycle_deleted, crud_recycle_batches );
+	}
+	return( ret );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : crud_recycle_reset
+// Description  : Forget the objects kept and queued without deleting them
+//                (the store was formatted, or is mounted again and the
+//                journal names the objects kept), and start counting again
+//
+// Inputs       : none
+// Outputs      : none
+
+void crud_recycle_reset( void ) {
+	crud_recycle_stop( 1 );
+	pthread_mutex_lock( &crud_recycle_mutex );
+	crud_recycle_creates = 0;
+	crud_recycle_reused = 0;
+	crud_recycle_deleted = 0;
+	crud_recycle_batches = 0;
+	free( crud_recycle_deletes );
+	crud_recycle_deletes = NULL;
+	crud_recycle_ndeletes = 0;
+	crud_recycle_nready = 0;
+	crud_recycle_delete_slots = 0;
+	crud_recycle_pooled = 0;
+	crud_recycle_pool_bytes = 0;
+	crud_recycle_closed = 0;
+	pthread_mutex_unlock( &crud_recycle_mutex );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : crudRecycleUnitTest
+// Description  : Perform a test of the recycling pool: the size classes, an
+//                object given back is made again by an update, the objects
+//                past the pool are deleted in batches, files growing in
+//                turn reuse each other's objects, and the pool survives a
+//                crash
+//
+// Inputs       : none
+// Outputs      : 0 if successful, -1 if failure
+
+int crudRecycleUnitTest( void ) {
+
+	// Local variables
+	char data[CRUD_RECYCLE_UNIT_TEST_SIZE], got[CRUD_RECYCLE_UNIT_TEST_SIZE], name[CRUD_MAX_PATH_LENGTH];
+	CrudOID oids[CRUD_RECYCLE_POOL_OBJECTS+CRUD_RECYCLE_UNIT_TEST_EXTRA], oid;
+	uint64_t reused, deleted, batches;
+	uint32_t i, length, size, classes, kept;
+	CrudResponse response;
+	int16_t fh[2];
+	char *buf;
+	int f, g;
+
+	// Every length fits its class, wasting under a step or a quarter of it
+	for ( length=1; length<=CRUD_MAX_OBJECT_SIZE; length+=(length<4096) ? 1 : 997 ) {
+		size = crud_recycle_class( length );
+		if ( (size < length) || (size > CRUD_MAX_OBJECT_SIZE) || ((size - length >= CRUD_RECYCLE_MIN_STEP) && ((size - length) * 4 > size)) ||
+				(crud_recycle_class(size) != size) ) {
+			CRUD_LOG( LOG_ERROR_LEVEL, "CRUD_RECYCLE_UNIT_TEST : class of %u is %u.", length, size );
+			return( -1 );
+		}
+	}
+	if ( (crud_recycle_class(0) != 0) || (crud_recycle_class(1) != CRUD_RECYCLE_MIN_STEP) || (crud_recycle_class(1000) != 1024) ) {
+		CRUD_LOG( LOG_ERROR_LEVEL, "CRUD_RECYCLE_UNIT_TEST : wrong size classes." );
+		return( -1 );
+	}
+
+	// An object given back is the next one of its size, rewritten
+	if ( crud_format() || crud_mount() ) {
+		CRUD_LOG( LOG_ERROR_LEVEL, "CRUD_RECYCLE_UNIT_TEST : Failure on format or mount." );
+		return( -1 );
+	}
+	memset( data, 'a', CRUD_RECYCLE_UNIT_TEST_SIZE );
+	response = crud_recycle_create( CRUD_RECYCLE_UNIT_TEST_SIZE, data );
+	oid = (CrudOID)(response >> 32);
+	reused = crud_recycle_reused;
+	memset( data, 'b', CRUD_RECYCLE_UNIT_TEST_SIZE );
+	if ( (response & 0x1) || crud_recycle_free(oid, CRUD_RECYCLE_UNIT_TEST_SIZE) ||
+			((CrudOID)((response = crud_recycle_create(CRUD_RECYCLE_UNIT_TEST_SIZE, data)) >> 32) != oid) || (response & 0x1) ||
+			(crud_recycle_reused != reused + 1) ||
+			(crud_io_request(create_crudrequest(oid, CRUD_READ, CRUD_RECYCLE_UNIT_TEST_SIZE, CRUD_NULL_FLAG), got) & 0x1) ||
+			memcmp(got, data, CRUD_RECYCLE_UNIT_TEST_SIZE) ) {
+		CRUD_LOG( LOG_ERROR_LEVEL, "CRUD_RECYCLE_UNIT_TEST : object [OID %u] not reused.", oid );
+		return( -1 );
+	}
+
+	// More objects than the pool keeps: the oldest are deleted in batches,
+	// the rest when the pool is drained
+	deleted = crud_recycle_deleted;
+	batches = crud_recycle_batches;
+	oids[0] = oid;
+	for ( i=1; i<CRUD_RECYCLE_POOL_OBJECTS+CRUD_RECYCLE_UNIT_TEST_EXTRA; i++ ) {
+		response = crud_recycle_create( CRUD_RECYCLE_UNIT_TEST_SIZE, data );
+		oids[i] = (CrudOID)(response >> 32);
+		if ( response & 0x1 ) {
+			CRUD_LOG( LOG_ERROR_LEVEL, "CRUD_RECYCLE_UNIT_TEST : create failed." );
+			return( -1 );
+		}
+	}
+	for ( i=0; i<CRUD_RECYCLE_POOL_OBJECTS+CRUD_RECYCLE_UNIT_TEST_EXTRA; i++ ) {
+		crud_recycle_free( oids[i], CRUD_RECYCLE_UNIT_TEST_SIZE );
+	}
+	if ( (crud_recycle_pooled != CRUD_RECYCLE_POOL_OBJECTS) || crud_recycle_drain() || (crud_recycle_pooled != 0) ||
+			(crud_recycle_deleted != deleted + CRUD_RECYCLE_POOL_OBJECTS + CRUD_RECYCLE_UNIT_TEST_EXTRA) ||
+			(crud_recycle_batches == batches) ) {
+		CRUD_LOG( LOG_ERROR_LEVEL, "CRUD_RECYCLE_UNIT_TEST : pool kept %u, deleted %lu.", crud_recycle_pooled, crud_recycle_deleted - deleted );
+		return( -1 );
+	}
+
+	// A drained pool deletes what it is given, until the next mount
+	response = crud_recycle_create( CRUD_RECYCLE_UNIT_TEST_SIZE, data );
+	oid = (CrudOID)(response >> 32);
+	deleted = crud_recycle_deleted;
+	if ( (response & 0x1) || crud_recycle_free(oid, CRUD_RECYCLE_UNIT_TEST_SIZE) || (crud_recycle_pooled != 0) ||
+			(crud_recycle_deleted != deleted + 1) || crud_unmount() || crud_mount() ) {
+		CRUD_LOG( LOG_ERROR_LEVEL, "CRUD_RECYCLE_UNIT_TEST : drained pool kept [OID %u].", oid );
+		return( -1 );
+	}
+
+	// Two files growing the same way, one after the other: the second takes
+	// every object the first gave up (each size class but the last)
+	reused = crud_recycle_reused;
+	buf = malloc( CRUD_RECYCLE_UNIT_TEST_GROWTH * CRUD_RECYCLE_UNIT_TEST_STEP );
+	for ( i=0; i<CRUD_RECYCLE_UNIT_TEST_GROWTH*CRUD_RECYCLE_UNIT_TEST_STEP; i++ ) {
+		buf[i] = (char)(i * 7 + i / 251);
+	}
+	for ( f=0; f<2; f++ ) {
+		snprintf( name, CRUD_MAX_PATH_LENGTH, "recycle.%d", f );
+		fh[f] = crud_open( name );
+	}
+	for ( i=0, classes=0, size=0; i<CRUD_RECYCLE_UNIT_TEST_GROWTH*2; i++ ) {
+		f = i / CRUD_RECYCLE_UNIT_TEST_GROWTH;
+		g = i % CRUD_RECYCLE_UNIT_TEST_GROWTH;
+		if ( (f == 0) && (crud_recycle_class((g+1)*CRUD_RECYCLE_UNIT_TEST_STEP) != size) ) {
+			size = crud_recycle_class( (g+1)*CRUD_RECYCLE_UNIT_TEST_STEP );
+			classes++;
+		}
+		if ( (fh[f] == -1) || (crud_write(fh[f], &buf[g*CRUD_RECYCLE_UNIT_TEST_STEP], CRUD_RECYCLE_UNIT_TEST_STEP) != CRUD_RECYCLE_UNIT_TEST_STEP) ||
+				crud_flush(fh[f]) || crud_table_commit(1) ) {
+			CRUD_LOG( LOG_ERROR_LEVEL, "CRUD_RECYCLE_UNIT_TEST : growth %d of file %d failed.", g, f );
+			free( buf );
+			return( -1 );
+		}
+	}
+	for ( f=0; f<2; f++ ) {
+		for ( i=0; i<CRUD_RECYCLE_UNIT_TEST_GROWTH; i++ ) {
+			if ( (crud_read_at(fh[f], got, CRUD_RECYCLE_UNIT_TEST_STEP, i*CRUD_RECYCLE_UNIT_TEST_STEP) != CRUD_RECYCLE_UNIT_TEST_STEP) ||
+					memcmp(got, &buf[i*CRUD_RECYCLE_UNIT_TEST_STEP], CRUD_RECYCLE_UNIT_TEST_STEP) ) {
+				CRUD_LOG( LOG_ERROR_LEVEL, "CRUD_RECYCLE_UNIT_TEST : file %d read back wrong at %u.", f, i*CRUD_RECYCLE_UNIT_TEST_STEP );
+				free( buf );
+				return( -1 );
+			}
+		}
+		crud_close( fh[f] );
+	}
+	free( buf );
+	if ( crud_recycle_reused != reused + classes - 1 ) {
+		CRUD_LOG( LOG_ERROR_LEVEL, "CRUD_RECYCLE_UNIT_TEST : %lu objects reused, not %u.", crud_recycle_reused - reused, classes - 1 );
+		return( -1 );
+	}
+
+	// A crash keeps the pool, the journal names the objects it kept
+	kept = crud_recycle_pooled;
+	if ( (kept == 0) || crud_table_commit(1) || crud_table_mount() || (crud_recycle_pooled != kept) ) {
+		CRUD_LOG( LOG_ERROR_LEVEL, "CRUD_RECYCLE_UNIT_TEST : %u of %u objects kept after a crash.", crud_recycle_pooled, kept );
+		return( -1 );
+	}
+
+	// Unmount (draining the pool), return successfully
+	if ( crud_unmount() ) {
+		CRUD_LOG( LOG_ERROR_LEVEL, "CRUD_RECYCLE_UNIT_TEST : Failure on unmount operation." );
+		return( -1 );
+	}
+	CRUD_LOG( LOG_INFO_LEVEL, "CRUD recycle unit tests completed successfully." );
+	return( 0 );
+}
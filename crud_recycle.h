@@ -0,0 +1,69 @@
+#ifndef CRUD_RECYCLE_INCLUDED
+#define CRUD_RECYCLE_INCLUDED
+
+////////////////////////////////////////////////////////////////////////////////
+//
+//  File           : crud_recycle.h
+//  Description    : This is the interface for the object recycling pool of
+//                   the CRUD file system.  Objects a file no longer uses are
+//                   kept by size instead of deleted, and a new object of the
+//                   same size is made by updating one of them; the objects
+//                   the pool cannot keep are deleted in batches by a
+//                   background thread.  The journal names the objects
+//                   kept, so a mount finds them again.
+//
+//  Last Modified  : Sun Oct 18 22:36:41 EDT 2026
+//
+
+// Includes
+#include <stdint.h>
+
+// Project Includes
+#include <crud_driver.h>
+
+// Defines
+#define CRUD_RECYCLE_MIN_STEP 64              // size classes of small objects are this far apart
+#define CRUD_RECYCLE_STEPS 4                  // size classes between two powers of two
+#define CRUD_RECYCLE_POOL_OBJECTS 128         // objects the pool keeps
+#define CRUD_RECYCLE_POOL_BYTES (8*1024*1024) // bytes of objects the pool keeps
+#define CRUD_RECYCLE_DELETE_BATCH 32          // deletes the background thread sends at once
+
+// Type definitions
+
+// This is an object no longer used (and its size)
+typedef struct {
+	CrudOID   oid;
+	uint32_t  size;
+} CrudRecycleObject;
+
+//
+// Recycling interface
+
+uint32_t crud_recycle_class( uint32_t length );
+	// Round a length up to its size class (the size an object grown to it gets)
+
+CrudResponse crud_recycle_create( uint32_t size, void *buf );
+	// Make an object holding buf: a kept object of the size updated, or a new one
+
+int crud_recycle_free( CrudOID oid, uint32_t size );
+	// Give back an object no longer used (kept, or deleted in the background)
+
+uint32_t crud_recycle_kept( CrudRecycleObject **objects );
+	// List the objects kept, oldest first (the caller frees the list)
+
+void crud_recycle_commit( void );
+	// The journal wrote the records of the objects queued, let them be deleted
+
+int crud_recycle_drain( void );
+	// Delete every object kept or waiting to be deleted, and any given back later (before the store closes)
+
+void crud_recycle_reset( void );
+	// Forget the objects kept and not yet deleted (the store was formatted or lost)
+
+//
+// Unit testing for the module
+
+int crudRecycleUnitTest( void );
+	// Perform a test of the object recycling pool
+
+#endif
@@ -0,0 +1,134 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+//  File          : crud_server.c
+//  Description   : This is the main program of the CRUD server, which mounts
+//                  the volume and serves it to the processes linked with
+//                  libcrudclient.a until it is interrupted, then unmounts.
+//
+//  Last Modified : Sun Oct 18 19:12:08 EDT 2026
+//
+
+// Include Files
+#include <stdio.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <signal.h>
+#include <pthread.h>
+
+// Project Includes
+#include <crud_file_io.h>
+#include <crud_service.h>
+#include <crud_log.h>
+
+// Defines
+#define CRUD_SERVER_ARGUMENTS "hvfs:l:b:d:"
+#define USAGE \
+	"USAGE: crud_server [-h] [-v] [-f] [-s <socket>] [-l <logfile>] [-b <backend>] [-d <model>]\n" \
+	"\n" \
+	"where:\n" \
+	"    -h - help mode (display this message)\n" \
+	"    -v - verbose output\n" \
+	"    -f - format the volume before serving it\n" \
+	"    -s - listen on <socket> (default " CRUD_SERVICE_SOCKET ")\n" \
+	"    -l - write log messages to the filename <logfile>\n" \
+	"    -b - store objects in <backend>: crud (default), memory[:<image>], file[:<dir>],\n" \
+	"         stripe:[map=<file>+][unit=<bytes>+][copies=<n>+]<backend>+<backend>...\n" \
+	"    -d - model the device (see crud_sim -h)\n" \
+	"\n" \
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : main
+// Description  : The main function for the CRUD server
+//
+// Inputs       : argc - the number of command line parameters
+//                argv - the parameters
+// Outputs      : 0 if successful, -1 if failure
+
+int main( int argc, char *argv[] ) {
+
+	// Local variables
+	int ch, verbose = 0, format = 0, log_initialized = 0, sig;
+	char *path = NULL, *backend = NULL, *model = NULL;
+	CrudBackend *be;
+	sigset_t signals;
+
+	// Process the command line parameters
+	while ((ch = getopt(argc, argv, CRUD_SERVER_ARGUMENTS)) != -1) {
+
+		switch (ch) {
+		case 'h': // Help, print usage
+			fprintf( stderr, USAGE );
+			return( -1 );
+
+		case 'v': // Verbose Flag
+			verbose = 1;
+			break;
+
+		case 'f': // Format the volume first
+			format = 1;
+			break;
+
+		case 's': // Set the socket
+			path = optarg;
+			break;
+
+		case 'l': // Set the log filename
+			initializeLogWithFilename( optarg );
+			log_initialized = 1;
+			break;
+
+		case 'b': // Select the storage backend
+			backend = optarg;
+			break;
+
+		case 'd': // Model the device latency and failures
+			model = optarg;
+			break;
+
+		default:  // Default (unknown)
+			fprintf( stderr, "Unknown command line option (%c), aborting.\n", ch );
+			return( -1 );
+		}
+	}
+
+	// Setup the log as needed
+	if ( ! log_initialized ) {
+		initializeLogWithFilehandle( CMPSC311_LOG_STDERR );
+	}
+	if ( verbose ) {
+		enableLogLevels( LOG_INFO_LEVEL );
+	}
+
+	// Setup the storage backend, wrapped in the device model if asked
+	if ( (backend != NULL) || (model != NULL) ) {
+		be = crud_backend_create( (backend != NULL) ? backend : CRUD_DEFAULT_BACKEND );
+		if ( model != NULL ) {
+			be = crud_latency_backend_wrap( be, model );
+		}
+		if ( crud_set_backend(be) ) {
+			fprintf( stderr, "Bad storage backend or device model, aborting.\n" );
+			return( -1 );
+		}
+	}
+
+	// The signals that stop the server are waited for, not handled
+	sigemptyset( &signals );
+	sigaddset( &signals, SIGINT );
+	sigaddset( &signals, SIGTERM );
+	pthread_sigmask( SIG_BLOCK, &signals, NULL );
+
+	// Mount and serve until told to stop
+	if ( (format && crud_format()) || crud_mount() || crud_service_start(path) ) {
+		CRUD_LOG( LOG_ERROR_LEVEL, "CRUD server failed to start.\n\n" );
+		return( -1 );
+	}
+	sigwait( &signals, &sig );
+	CRUD_LOG( LOG_INFO_LEVEL, "CRUD server stopping on signal %d.", sig );
+	crud_service_stop();
+	if ( crud_unmount() ) {
+		CRUD_LOG( LOG_ERROR_LEVEL, "CRUD server failed to unmount.\n\n" );
+		return( -1 );
+	}
+	return( 0 );
+}
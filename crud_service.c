@@ -0,0 +1,841 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+//  File           : crud_service.c
+//  Description    : This is the implementation of the CRUD service.  A
+//                   thread accepts the clients and each client gets a thread
+//                   of its own, which makes the driver calls of its requests
+//                   (the driver serializes them).  The bytes are read and
+//                   written straight in the data window the client shares,
+//                   so nothing is copied on the server side.
+//
+//                   The driver has one handle per open file, so the server
+//                   counts the clients holding each one and only closes it
+//                   with the last of them.  Every client handle keeps its
+//                   own position, the driver handle is only read and written
+//                   at an offset.
+//
+//  Last Modified  : Sun Oct 18 19:12:08 EDT 2026
+//
+
+// Includes
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <time.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+
+// Project Includes
+#include <crud_service.h>
+#include <crud_client.h>
+#include <crud_file_io.h>
+#include <crud_log.h>
+
+// Defines
+#define CRUD_SERVICE_BACKLOG 64
+#define CRUD_SERVICE_UNIT_TEST_SOCKET "crud_service_utest.sock"
+#define CRUD_SERVICE_UNIT_TEST_CLIENTS 4
+#define CRUD_SERVICE_UNIT_TEST_SIZE (CRUD_SERVICE_WINDOW*2+12345) // bytes of each client file (more than a window)
+#define CRUD_SERVICE_UNIT_TEST_SLICE 4096                          // bytes of the shared file of each client
+
+// Type definitions
+
+// This is a file handle of a client
+typedef struct {
+	int16_t   fd;         // The driver handle (-1 if the slot is free)
+	uint32_t  position;   // The position of the client in the file
+} CrudServiceHandle;
+
+// This is a connected client
+typedef struct CrudServiceSession {
+	int                        sock;     // The connection
+	char                      *window;   // The data window (mapped)
+	CrudServiceHandle         *handles;  // The file handles of the client
+	int32_t                    slots;    // The slots of handles
+	CrudDirectory            **dirs;     // The open directories of the client
+	int32_t                    dir_slots;// The slots of dirs
+	struct CrudServiceSession *next;     // The next connected client
+} CrudServiceSession;
+
+// This is a page of LIST being filled
+typedef struct {
+	CrudFileAllocationType *out;     // Where the entries go (the window)
+	uint32_t                skip;    // Entries to pass over first
+	uint32_t                room;    // Entries that fit
+	uint32_t                seen;    // Entries called on so far
+} CrudServicePage;
+
+//
+// Global data
+
+static int crud_service_listener = -1;           // The listening socket (-1 if not serving)
+static char crud_service_path[sizeof(((struct sockaddr_un *)0)->sun_path)]; // Where it listens
+static pthread_t crud_service_acceptor;          // The thread accepting the clients
+static CrudServiceSession *crud_service_sessions;// The connected clients
+static uint32_t *crud_service_refs;              // Clients holding each driver handle
+static int32_t crud_service_ref_slots;           // The slots of crud_service_refs
+static uint32_t crud_service_open;               // Driver handles held by clients
+static pthread_mutex_t crud_service_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t crud_service_gone = PTHREAD_COND_INITIALIZER; // signalled as clients go
+
+//
+// Functional prototypes
+
+static void *crud_service_accept( void *arg );
+static void *crud_service_client( void *arg );
+static int crud_service_io( int sock, void *buf, size_t len, int sending );
+static int64_t crud_service_do( CrudServiceSession *session, CrudServiceRequest *request );
+static int32_t crud_service_handle( CrudServiceSession *session, int16_t fd );
+static CrudServiceHandle *crud_service_get( CrudServiceSession *session, int32_t handle );
+static int16_t crud_service_release( CrudServiceSession *session, int32_t handle );
+static int16_t crud_service_unref( int16_t fd );
+static void crud_service_page( const CrudFileAllocationType *entry, void *arg );
+static void crud_service_end( CrudServiceSession *session );
+
+//
+// Functions
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : crud_service_start
+// Description  : Start serving the mounted volume
+//
+// Inputs       : path - the socket to listen on (NULL for the default)
+// Outputs      : 0 if successful, -1 if failure
+
+int crud_service_start( const char *path ) {
+
+	// Local variables
+	struct sockaddr_un addr;
+
+	// Only one service at a time, on a path that fits
+	if ( path == NULL ) {
+		path = CRUD_SERVICE_SOCKET;
+	}
+	if ( (crud_service_listener != -1) || (strlen(path) >= sizeof(addr.sun_path)) ) {
+		CRUD_LOG( LOG_ERROR_LEVEL, "Cannot serve on [%s].", path );
+		return( -1 );
+	}
+
+	// Listen (a socket left by a server that died is replaced)
+	memset( &addr, 0x0, sizeof(addr) );
+	addr.sun_family = AF_UNIX;
+	strcpy( addr.sun_path, path );
+	unlink( path );
+	if ( ((crud_service_listener = socket(AF_UNIX, SOCK_STREAM, 0)) == -1) ||
+			bind(crud_service_listener, (struct sockaddr *)&addr, sizeof(addr)) ||
+			listen(crud_service_listener, CRUD_SERVICE_BACKLOG) ) {
+		CRUD_LOG( LOG_ERROR_LEVEL, "Failure listening on [%s], error: %s.", path, strerror(errno) );
+		if ( crud_service_listener != -1 ) {
+			close( crud_service_listener );
+			crud_service_listener = -1;
+		}
+		return( -1 );
+	}
+	strcpy( crud_service_path, path );
+
+	// Accept the clients on a thread of their own
+	if ( pthread_create(&crud_service_acceptor, NULL, crud_service_accept, NULL) ) {
+		close( crud_service_listener );
+		crud_service_listener = -1;
+		unlink( path );
+		return( -1 );
+	}
+	CRUD_LOG( LOG_INFO_LEVEL, "CRUD service listening on [%s].", path );
+	return( 0 );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : crud_service_stop
+// Description  : Stop serving, disconnecting the clients (their files are
+//                closed as they go)
+//
+// Inputs       : none
+// Outputs      : 0 if successful, -1 if failure
+
+int crud_service_stop( void ) {
+
+	// Local variables
+	CrudServiceSession *session;
+
+	if ( crud_service_listener == -1 ) {
+		return( -1 );
+	}
+
+	// Stop accepting (this wakes the acceptor)
+	shutdown( crud_service_listener, SHUT_RDWR );
+	pthread_join( crud_service_acceptor, NULL );
+	close( crud_service_listener );
+	crud_service_listener = -1;
+	unlink( crud_service_path );
+
+	// Hang up on the clients and wait for their threads to clean up
+	pthread_mutex_lock( &crud_service_mutex );
+	for ( session=crud_service_sessions; session!=NULL; session=session->next ) {
+		shutdown( session->sock, SHUT_RDWR );
+	}
+	while ( crud_service_sessions != NULL ) {
+		pthread_cond_wait( &crud_service_gone, &crud_service_mutex );
+	}
+	free( crud_service_refs );
+	crud_service_refs = NULL;
+	crud_service_ref_slots = 0;
+	pthread_mutex_unlock( &crud_service_mutex );
+	CRUD_LOG( LOG_INFO_LEVEL, "CRUD service stopped." );
+	return( 0 );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : crud_service_accept
+// Description  : Accept clients until the service stops, greeting each with
+//                its data window and starting its thread
+//
+// Inputs       : arg - unused
+// Outputs      : NULL
+
+static void *crud_service_accept( void *arg ) {
+
+	// Local variables
+	char control[CMSG_SPACE(sizeof(int))];
+	CrudServiceSession *session;
+	CrudServiceHello hello = { CRUD_SERVICE_MAGIC, CRUD_SERVICE_WINDOW };
+	struct msghdr msg;
+	struct cmsghdr *cmsg;
+	struct iovec iov;
+	pthread_t thread;
+	int sock, mem;
+
+	while ( (sock = accept(crud_service_listener, NULL, NULL)) != -1 ) {
+
+		// Make the window, mapped here and passed to the client
+		if ( (session = calloc(1, sizeof(CrudServiceSession))) == NULL ) {
+			CRUD_LOG( LOG_ERROR_LEVEL, "Failure allocating a client session." );
+			close( sock );
+			continue;
+		}
+		session->sock = sock;
+		mem = memfd_create( "crud_window", MFD_CLOEXEC );
+		if ( (mem == -1) || ftruncate(mem, CRUD_SERVICE_WINDOW) ||
+				((session->window = mmap(NULL, CRUD_SERVICE_WINDOW, PROT_READ|PROT_WRITE, MAP_SHARED, mem, 0)) == MAP_FAILED) ) {
+			CRUD_LOG( LOG_ERROR_LEVEL, "Failure making a client window, error: %s.", strerror(errno) );
+			if ( mem != -1 ) {
+				close( mem );
+			}
+			close( sock );
+			free( session );
+			continue;
+		}
+		memset( &msg, 0x0, sizeof(msg) );
+		memset( control, 0x0, sizeof(control) );
+		iov.iov_base = &hello;
+		iov.iov_len = sizeof(hello);
+		msg.msg_iov = &iov;
+		msg.msg_iovlen = 1;
+		msg.msg_control = control;
+		msg.msg_controllen = sizeof(control);
+		cmsg = CMSG_FIRSTHDR( &msg );
+		cmsg->cmsg_level = SOL_SOCKET;
+		cmsg->cmsg_type = SCM_RIGHTS;
+		cmsg->cmsg_len = CMSG_LEN( sizeof(int) );
+		memcpy( CMSG_DATA(cmsg), &mem, sizeof(int) );
+		if ( sendmsg(sock, &msg, MSG_NOSIGNAL) != sizeof(hello) ) {
+			CRUD_LOG( LOG_ERROR_LEVEL, "Failure greeting a client, error: %s.", strerror(errno) );
+			munmap( session->window, CRUD_SERVICE_WINDOW );
+			close( mem );
+			close( sock );
+			free( session );
+			continue;
+		}
+		close( mem );
+
+		// Serve the client on its own thread
+		pthread_mutex_lock( &crud_service_mutex );
+		session->next = crud_service_sessions;
+		crud_service_sessions = session;
+		pthread_mutex_unlock( &crud_service_mutex );
+		if ( pthread_create(&thread, NULL, crud_service_client, session) ) {
+			crud_service_end( session );
+		} else {
+			pthread_detach( thread );
+		}
+	}
+	return( NULL );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : crud_service_client
+// Description  : Serve the requests of a client until it hangs up
+//
+// Inputs       : arg - the session of the client
+// Outputs      : NULL
+
+static void *crud_service_client( void *arg ) {
+
+	// Local variables
+	CrudServiceSession *session = arg;
+	CrudServiceRequest request;
+	CrudServiceReply reply;
+
+	while ( crud_service_io(session->sock, &request, sizeof(request), 0) == 0 ) {
+		request.path[CRUD_MAX_PATH_LENGTH-1] = 0x0;
+		request.path2[CRUD_MAX_PATH_LENGTH-1] = 0x0;
+		reply.result = crud_service_do( session, &request );
+		if ( crud_service_io(session->sock, &reply, sizeof(reply), 1) ) {
+			break;
+		}
+	}
+	crud_service_end( session );
+	return( NULL );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : crud_service_io
+// Description  : Send or receive a whole message
+//
+// Inputs       : sock - the connection
+//                buf - the message
+//                len - the bytes of the message
+//                sending - nonzero to send, zero to receive
+// Outputs      : 0 if successful, -1 if failure (or hung up)
+
+static int crud_service_io( int sock, void *buf, size_t len, int sending ) {
+
+	// Local variables
+	size_t done = 0;
+	ssize_t n;
+
+	while ( done < len ) {
+		n = sending ? send( sock, (char *)buf + done, len - done, MSG_NOSIGNAL ) :
+				recv( sock, (char *)buf + done, len - done, 0 );
+		if ( (n == -1) && (errno == EINTR) ) {
+			continue;
+		}
+		if ( n <= 0 ) {
+			return( -1 );
+		}
+		done += n;
+	}
+	return( 0 );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : crud_service_do
+// Description  : Make the driver call of a request
+//
+// Inputs       : session - the client
+//                request - the request
+// Outputs      : the result of the call (-1 if failure)
+
+static int64_t crud_service_do( CrudServiceSession *session, CrudServiceRequest *request ) {
+
+	// Local variables
+	CrudServiceHandle *handle = NULL;
+	CrudDirectoryEntry *entry;
+	CrudServicePage page;
+	CrudDirectory *dir, **dirs;
+	uint32_t *refs;
+	int32_t result, i, slots;
+	int16_t fd;
+
+	// The file requests need a handle of the client, and the bytes must fit the window
+	if ( (request->op >= CRUD_SERVICE_CLOSE) && (request->op <= CRUD_SERVICE_RESERVE) &&
+			((handle = crud_service_get(session, request->handle)) == NULL) ) {
+		return( -1 );
+	}
+	if ( (request->op >= CRUD_SERVICE_READ) && (request->op <= CRUD_SERVICE_WRITE_AT) &&
+			((request->count < 0) || (request->count > CRUD_SERVICE_WINDOW)) ) {
+		return( -1 );
+	}
+
+	switch ( request->op ) {
+	case CRUD_SERVICE_OPEN:
+		// Open, counting the clients on the driver handle (under the lock,
+		// so the last close cannot get between the open and the count)
+		pthread_mutex_lock( &crud_service_mutex );
+		fd = (request->count == -1) ? crud_open( request->path ) : crud_open_durable( request->path, request->count );
+		if ( (fd != -1) && (fd >= crud_service_ref_slots) ) {
+			// No client holds a handle this high, the driver one is closed on failure
+			slots = (fd + 1) * 2;
+			if ( (refs = realloc(crud_service_refs, sizeof(uint32_t) * slots)) == NULL ) {
+				CRUD_LOG( LOG_ERROR_LEVEL, "Failure allocating the handle counts." );
+				crud_close( fd );
+				fd = -1;
+			} else {
+				memset( &refs[crud_service_ref_slots], 0x0, sizeof(uint32_t) * (slots - crud_service_ref_slots) );
+				crud_service_refs = refs;
+				crud_service_ref_slots = slots;
+			}
+		}
+		if ( fd != -1 ) {
+			crud_service_refs[fd]++;
+			crud_service_open++;
+		}
+		pthread_mutex_unlock( &crud_service_mutex );
+		if ( fd == -1 ) {
+			return( -1 );
+		}
+
+		// The count is given back if the client gets no handle
+		if ( (i = crud_service_handle(session, fd)) == -1 ) {
+			crud_service_unref( fd );
+		}
+		return( i );
+
+	case CRUD_SERVICE_CLOSE:
+		return( crud_service_release(session, request->handle) );
+
+	case CRUD_SERVICE_READ:
+		result = crud_read_at( handle->fd, session->window, request->count, handle->position );
+		if ( result > 0 ) {
+			handle->position += result;
+		}
+		return( result );
+
+	case CRUD_SERVICE_WRITE:
+		result = crud_write_at( handle->fd, session->window, request->count, handle->position );
+		if ( result > 0 ) {
+			handle->position += result;
+		}
+		return( result );
+
+	case CRUD_SERVICE_READ_AT:
+		return( crud_read_at(handle->fd, session->window, request->count, request->offset) );
+
+	case CRUD_SERVICE_WRITE_AT:
+		return( crud_write_at(handle->fd, session->window, request->count, request->offset) );
+
+	case CRUD_SERVICE_SEEK:
+		if ( request->offset > CRUD_MAX_FILE_SIZE ) {
+			return( -1 );
+		}
+		handle->position = request->offset;
+		return( 0 );
+
+	case CRUD_SERVICE_FLUSH:
+		return( crud_flush(handle->fd) );
+
+	case CRUD_SERVICE_FSYNC:
+		return( crud_fsync(handle->fd) );
+
+	case CRUD_SERVICE_TRUNCATE:
+		if ( crud_truncate(handle->fd, request->offset) ) {
+			return( -1 );
+		}
+		if ( handle->position > request->offset ) {
+			handle->position = request->offset;
+		}
+		return( 0 );
+
+	case CRUD_SERVICE_RESERVE:
+		return( crud_reserve(handle->fd, request->offset) );
+
+	case CRUD_SERVICE_MKDIR:
+		return( crud_mkdir(request->path) );
+
+	case CRUD_SERVICE_OPENDIR:
+		if ( (dir = crud_opendir(request->path)) == NULL ) {
+			return( -1 );
+		}
+		for ( i=0; (i<session->dir_slots) && (session->dirs[i]!=NULL); i++ );
+		if ( i == session->dir_slots ) {
+			slots = (session->dir_slots == 0) ? 8 : session->dir_slots * 2;
+			if ( (dirs = realloc(session->dirs, sizeof(CrudDirectory *) * slots)) == NULL ) {
+				CRUD_LOG( LOG_ERROR_LEVEL, "Failure allocating the directories of a client." );
+				crud_closedir( dir );
+				return( -1 );
+			}
+			memset( &dirs[i], 0x0, sizeof(CrudDirectory *) * (slots - i) );
+			session->dirs = dirs;
+			session->dir_slots = slots;
+		}
+		session->dirs[i] = dir;
+		return( i );
+
+	case CRUD_SERVICE_READDIR:
+	case CRUD_SERVICE_CLOSEDIR:
+		if ( (request->handle < 0) || (request->handle >= session->dir_slots) || (session->dirs[request->handle] == NULL) ) {
+			return( -1 );
+		}
+		if ( request->op == CRUD_SERVICE_CLOSEDIR ) {
+			dir = session->dirs[request->handle];
+			session->dirs[request->handle] = NULL;
+			return( crud_closedir(dir) );
+		}
+		if ( (entry = crud_readdir(session->dirs[request->handle])) == NULL ) {
+			return( 0 );
+		}
+		memcpy( session->window, entry, sizeof(CrudDirectoryEntry) );
+		return( 1 );
+
+	case CRUD_SERVICE_LIST:
+		// The entries past offset that fit go in the window, the result
+		// is how many there are (the client asks again for the rest)
+		page.out = (CrudFileAllocationType *)session->window;
+		page.skip = request->offset;
+		page.room = CRUD_SERVICE_WINDOW / sizeof(CrudFileAllocationType);
+		page.seen = 0;
+		if ( crud_list(request->path, crud_service_page, &page) == -1 ) {
+			return( -1 );
+		}
+		return( (page.seen > page.skip) ? page.seen - page.skip : 0 );
+
+	case CRUD_SERVICE_CLONE:
+		return( crud_clone(request->path, request->path2) );
+
+	case CRUD_SERVICE_SNAPSHOT:
+		return( crud_snapshot(request->path) );
+
+	case CRUD_SERVICE_FORMAT:
+		// Formatting under the files of the clients would lose them
+		pthread_mutex_lock( &crud_service_mutex );
+		result = ( (crud_service_open == 0) && !crud_format() && !crud_mount() ) ? 0 : -1;
+		pthread_mutex_unlock( &crud_service_mutex );
+		return( result );
+
+	case CRUD_SERVICE_SYNC:
+		return( crud_io_sync() );
+
+	default:
+		CRUD_LOG( LOG_ERROR_LEVEL, "Unknown CRUD service request %u.", request->op );
+		return( -1 );
+	}
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : crud_service_handle
+// Description  : Give a client a handle of a driver handle
+//
+// Inputs       : session - the client
+//                fd - the driver handle
+// Outputs      : the handle of the client
+
+static int32_t crud_service_handle( CrudServiceSession *session, int16_t fd ) {
+
+	// Local variables
+	CrudServiceHandle *handles;
+	int32_t i, slots;
+
+	for ( i=0; (i<session->slots) && (session->handles[i].fd!=-1); i++ );
+	if ( i == session->slots ) {
+		slots = (session->slots == 0) ? 16 : session->slots * 2;
+		if ( (handles = realloc(session->handles, sizeof(CrudServiceHandle) * slots)) == NULL ) {
+			CRUD_LOG( LOG_ERROR_LEVEL, "Failure allocating the handles of a client." );
+			return( -1 );
+		}
+		memset( &handles[i], 0xff, sizeof(CrudServiceHandle) * (slots - i) );
+		session->handles = handles;
+		session->slots = slots;
+	}
+	session->handles[i].fd = fd;
+	session->handles[i].position = 0;
+	return( i );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : crud_service_get
+// Description  : Find an open handle of a client
+//
+// Inputs       : session - the client
+//                handle - the handle of the client
+// Outputs      : the handle or NULL if it is not open
+
+static CrudServiceHandle *crud_service_get( CrudServiceSession *session, int32_t handle ) {
+	if ( (handle < 0) || (handle >= session->slots) || (session->handles[handle].fd == -1) ) {
+		return( NULL );
+	}
+	return( &session->handles[handle] );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : crud_service_release
+// Description  : Close a handle of a client, closing the driver handle when
+//                no other client holds it
+//
+// Inputs       : session - the client
+//                handle - the handle of the client
+// Outputs      : 0 if successful, -1 if failure
+
+static int16_t crud_service_release( CrudServiceSession *session, int32_t handle ) {
+
+	// Local variables
+	int16_t fd = session->handles[handle].fd;
+
+	session->handles[handle].fd = -1;
+	return( crud_service_unref(fd) );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : crud_service_unref
+// Description  : Drop the count of a client on a driver handle, closing it
+//                when no other client holds it
+//
+// Inputs       : fd - the driver handle
+// Outputs      : 0 if successful, -1 if failure
+
+static int16_t crud_service_unref( int16_t fd ) {
+
+	// Local variables
+	int16_t ret = 0;
+
+	pthread_mutex_lock( &crud_service_mutex );
+	crud_service_open--;
+	if ( --crud_service_refs[fd] == 0 ) {
+		ret = crud_close( fd );
+	}
+	pthread_mutex_unlock( &crud_service_mutex );
+	return( ret );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : crud_service_page
+// Description  : Put a listed entry in the page if it is past the skipped
+//                ones and fits (crud_list function)
+//
+// Inputs       : entry - the entry listed
+//                arg - the page
+// Outputs      : none
+
+static void crud_service_page( const CrudFileAllocationType *entry, void *arg ) {
+
+	// Local variables
+	CrudServicePage *page = arg;
+
+	if ( (page->seen >= page->skip) && (page->seen - page->skip < page->room) ) {
+		memcpy( &page->out[page->seen - page->skip], entry, sizeof(CrudFileAllocationType) );
+	}
+	page->seen++;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : crud_service_end
+// Description  : Clean up after a client that hung up, closing what it left
+//                open
+//
+// Inputs       : session - the client
+// Outputs      : none
+
+static void crud_service_end( CrudServiceSession *session ) {
+
+	// Local variables
+	CrudServiceSession **link;
+	int32_t i;
+
+	for ( i=0; i<session->slots; i++ ) {
+		if ( session->handles[i].fd != -1 ) {
+			crud_service_release( session, i );
+		}
+	}
+	for ( i=0; i<session->dir_slots; i++ ) {
+		if ( session->dirs[i] != NULL ) {
+			crud_closedir( session->dirs[i] );
+		}
+	}
+	close( session->sock );
+	munmap( session->window, CRUD_SERVICE_WINDOW );
+
+	// Leave the list of clients, telling a stop waiting on it
+	pthread_mutex_lock( &crud_service_mutex );
+	for ( link=&crud_service_sessions; *link!=session; link=&(*link)->next );
+	*link = session->next;
+	pthread_cond_broadcast( &crud_service_gone );
+	pthread_mutex_unlock( &crud_service_mutex );
+	free( session->handles );
+	free( session->dirs );
+	free( session );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : crud_service_utest_count
+// Description  : Count a listed entry (crud_client_list function)
+//
+// Inputs       : entry - the entry listed
+//                arg - the count
+// Outputs      : none
+
+static void crud_service_utest_count( const CrudFileAllocationType *entry, void *arg ) {
+	(*(int *)arg)++;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : crud_service_utest_client
+// Description  : The work of a client process of the unit test: write a file
+//                larger than the window and read it back, and write a slice
+//                of the file every client shares
+//
+// Inputs       : id - the number of the client
+// Outputs      : 0 if successful, -1 if failure
+
+static int crud_service_utest_client( int id ) {
+
+	// Local variables
+	char name[CRUD_MAX_PATH_LENGTH], *data, *got;
+	int16_t fh, shared;
+	int i, ret = 0;
+
+	data = malloc( CRUD_SERVICE_UNIT_TEST_SIZE );
+	got = malloc( CRUD_SERVICE_UNIT_TEST_SIZE );
+	for ( i=0; i<CRUD_SERVICE_UNIT_TEST_SIZE; i++ ) {
+		data[i] = (char)(i * (id + 3) + i / 509);
+	}
+	snprintf( name, sizeof(name), "clients/%d", id );
+	if ( crud_client_connect(CRUD_SERVICE_UNIT_TEST_SOCKET) ||
+			((fh = crud_client_open(name, -1)) == -1) || ((shared = crud_client_open("clients/shared", -1)) == -1) ||
+			(crud_client_write(fh, data, CRUD_SERVICE_UNIT_TEST_SIZE) != CRUD_SERVICE_UNIT_TEST_SIZE) ||
+			crud_client_seek(fh, 0) || (crud_client_read(fh, got, CRUD_SERVICE_UNIT_TEST_SIZE) != CRUD_SERVICE_UNIT_TEST_SIZE) ||
+			memcmp(got, data, CRUD_SERVICE_UNIT_TEST_SIZE) ||
+			(crud_client_write_at(shared, data, CRUD_SERVICE_UNIT_TEST_SLICE, id * CRUD_SERVICE_UNIT_TEST_SLICE) != CRUD_SERVICE_UNIT_TEST_SLICE) ||
+			crud_client_close(shared) ) {
+		ret = -1;
+	}
+
+	// Leave the file open, the server closes it when the client goes
+	crud_client_disconnect();
+	free( data );
+	free( got );
+	return( ret );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : crudServiceUnitTest
+// Description  : Serve a volume to client processes, then check what they
+//                wrote through a client of this process (and the driver)
+//
+// Inputs       : none
+// Outputs      : 0 if successful, -1 if failure
+
+int crudServiceUnitTest( void ) {
+
+	// Local variables
+	char name[CRUD_MAX_PATH_LENGTH], *data, *got;
+	CrudClientDirectory *dir;
+	CrudDirectoryEntry *entry;
+	pid_t pids[CRUD_SERVICE_UNIT_TEST_CLIENTS];
+	struct timespec deadline;
+	uint32_t held;
+	int i, j, status, listed = 0, entries = 0, left, ret = 0;
+	int16_t fh, fh2;
+
+	if ( crud_format() || crud_mount() || (crud_mkdir("clients") == -1) ||
+			crud_service_start(CRUD_SERVICE_UNIT_TEST_SOCKET) ) {
+		CRUD_LOG( LOG_ERROR_LEVEL, "CRUD service unit test: failure starting the service." );
+		return( -1 );
+	}
+
+	// Run the clients at the same time, each in a process of its own
+	for ( i=0; i<CRUD_SERVICE_UNIT_TEST_CLIENTS; i++ ) {
+		if ( (pids[i] = fork()) == 0 ) {
+			_exit( crud_service_utest_client(i) ? 1 : 0 );
+		}
+	}
+	for ( i=0; i<CRUD_SERVICE_UNIT_TEST_CLIENTS; i++ ) {
+		if ( (pids[i] == -1) || (waitpid(pids[i], &status, 0) != pids[i]) || !WIFEXITED(status) || WEXITSTATUS(status) ) {
+			CRUD_LOG( LOG_ERROR_LEVEL, "CRUD service unit test: client %d failed.", i );
+			ret = -1;
+		}
+	}
+
+	// The clients are gone, so are their files (waiting on their threads
+	// to leave, a second at most)
+	clock_gettime( CLOCK_REALTIME, &deadline );
+	deadline.tv_sec++;
+	pthread_mutex_lock( &crud_service_mutex );
+	while ( (crud_service_sessions != NULL) &&
+			(pthread_cond_timedwait(&crud_service_gone, &crud_service_mutex, &deadline) != ETIMEDOUT) );
+	left = ( (crud_service_sessions != NULL) || (crud_service_open != 0) );
+	held = crud_service_open;
+	pthread_mutex_unlock( &crud_service_mutex );
+	if ( (ret == 0) && left ) {
+		CRUD_LOG( LOG_ERROR_LEVEL, "CRUD service unit test: %u files left open by the clients.", held );
+		ret = -1;
+	}
+
+	// Every client file reads back, and the shared file has a slice of each
+	data = malloc( CRUD_SERVICE_UNIT_TEST_SIZE );
+	got = malloc( CRUD_SERVICE_UNIT_TEST_SIZE );
+	if ( crud_client_connect(CRUD_SERVICE_UNIT_TEST_SOCKET) ) {
+		ret = -1;
+	}
+	for ( i=0; (ret==0) && (i<CRUD_SERVICE_UNIT_TEST_CLIENTS); i++ ) {
+		for ( j=0; j<CRUD_SERVICE_UNIT_TEST_SIZE; j++ ) {
+			data[j] = (char)(j * (i + 3) + j / 509);
+		}
+		snprintf( name, sizeof(name), "clients/%d", i );
+		if ( ((fh = crud_client_open(name, -1)) == -1) || ((fh2 = crud_client_open("clients/shared", -1)) == -1) ||
+				(crud_client_read(fh, got, CRUD_SERVICE_UNIT_TEST_SIZE) != CRUD_SERVICE_UNIT_TEST_SIZE) ||
+				memcmp(got, data, CRUD_SERVICE_UNIT_TEST_SIZE) ||
+				(crud_client_read_at(fh2, got, CRUD_SERVICE_UNIT_TEST_SLICE, i * CRUD_SERVICE_UNIT_TEST_SLICE) != CRUD_SERVICE_UNIT_TEST_SLICE) ||
+				memcmp(got, data, CRUD_SERVICE_UNIT_TEST_SLICE) || crud_client_close(fh) || crud_client_close(fh2) ) {
+			CRUD_LOG( LOG_ERROR_LEVEL, "CRUD service unit test: file of client %d is wrong.", i );
+			ret = -1;
+		}
+	}
+
+	// Two handles of a file keep their own positions, and one closing
+	// leaves the other open
+	if ( (ret == 0) && (((fh = crud_client_open("clients/0", -1)) == -1) || ((fh2 = crud_client_open("clients/0", -1)) == -1) ||
+			crud_client_seek(fh, 100) || (crud_client_read(fh, got, 10) != 10) ||
+			(crud_client_read(fh2, got + 10, 10) != 10) || crud_client_close(fh) ||
+			(crud_client_read(fh2, got + 20, 10) != 10) || crud_client_close(fh2)) ) {
+		CRUD_LOG( LOG_ERROR_LEVEL, "CRUD service unit test: shared handles failed." );
+		ret = -1;
+	}
+	for ( j=0; (ret==0) && (j<30); j++ ) {
+		i = (j < 10) ? 100 + j : j - 10;
+		if ( got[j] != (char)(i * 3 + i / 509) ) {
+			CRUD_LOG( LOG_ERROR_LEVEL, "CRUD service unit test: shared handles read at the wrong position." );
+			ret = -1;
+		}
+	}
+
+	// The directories and lists go through the server too (the list has
+	// the directory, its files and the shared one)
+	if ( (ret == 0) && (((dir = crud_client_opendir("clients")) == NULL) ||
+			((j = crud_client_list("clients/", crud_service_utest_count, &listed)) == -1)) ) {
+		CRUD_LOG( LOG_ERROR_LEVEL, "CRUD service unit test: opendir or list failed." );
+		ret = -1;
+	}
+	while ( (ret == 0) && ((entry = crud_client_readdir(dir)) != NULL) ) {
+		entries++;
+	}
+	if ( (ret == 0) && (crud_client_closedir(dir) || (entries != CRUD_SERVICE_UNIT_TEST_CLIENTS+1) ||
+			(listed != CRUD_SERVICE_UNIT_TEST_CLIENTS+2) || (j != listed)) ) {
+		CRUD_LOG( LOG_ERROR_LEVEL, "CRUD service unit test: %d entries read, %d listed.", entries, listed );
+		ret = -1;
+	}
+
+	// A format is refused under an open file
+	if ( (ret == 0) && (((fh = crud_client_open("clients/0", -1)) == -1) || (crud_client_format() != -1) || crud_client_close(fh)) ) {
+		CRUD_LOG( LOG_ERROR_LEVEL, "CRUD service unit test: format under an open file." );
+		ret = -1;
+	}
+
+	// Clean up
+	crud_client_disconnect();
+	crud_service_stop();
+	free( data );
+	free( got );
+	if ( ret == 0 ) {
+		CRUD_LOG( LOG_INFO_LEVEL, "CRUD service unit tests completed successfully." );
+	}
+	return( ret );
+}
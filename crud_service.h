@@ -0,0 +1,92 @@
+#ifndef CRUD_SERVICE_INCLUDED
+#define CRUD_SERVICE_INCLUDED
+
+////////////////////////////////////////////////////////////////////////////////
+//
+//  File           : crud_service.h
+//  Description    : This is the interface of the CRUD service, which lets
+//                   many processes share one mounted volume (and its cache).
+//                   The server owns the volume; each client connects over a
+//                   Unix socket and is given a shared memory data window.
+//                   Requests and replies are fixed size messages on the
+//                   socket, the bytes read and written go through the window.
+//
+//  Last Modified  : Sun Oct 18 19:12:08 EDT 2026
+//
+
+// Includes
+#include <stdint.h>
+
+// Project Includes
+#include <crud_file_table.h>
+
+// Defines
+#define CRUD_SERVICE_SOCKET "/tmp/crud_server.sock" // where the server listens by default
+#define CRUD_SERVICE_ENV "CRUD_SERVER"              // environment variable naming another socket
+#define CRUD_SERVICE_WINDOW (1024*1024)             // bytes of the data window of a client
+#define CRUD_SERVICE_MAGIC 0x43525344               // "CRSD", the greeting of the server
+
+// Type definitions
+
+// These are the requests of a client (the file ones name a handle of the client)
+typedef enum {
+	CRUD_SERVICE_OPEN     = 0,  // path, count is the durability (-1 to leave it)
+	CRUD_SERVICE_CLOSE    = 1,
+	CRUD_SERVICE_READ     = 2,  // count bytes at the position into the window
+	CRUD_SERVICE_WRITE    = 3,  // count bytes at the position from the window
+	CRUD_SERVICE_READ_AT  = 4,  // count bytes at offset into the window
+	CRUD_SERVICE_WRITE_AT = 5,  // count bytes at offset from the window
+	CRUD_SERVICE_SEEK     = 6,  // offset
+	CRUD_SERVICE_FLUSH    = 7,
+	CRUD_SERVICE_FSYNC    = 8,
+	CRUD_SERVICE_TRUNCATE = 9,  // offset is the length
+	CRUD_SERVICE_RESERVE  = 10, // offset is the length
+	CRUD_SERVICE_MKDIR    = 11, // path
+	CRUD_SERVICE_OPENDIR  = 12, // path
+	CRUD_SERVICE_READDIR  = 13, // the entry goes into the window
+	CRUD_SERVICE_CLOSEDIR = 14,
+	CRUD_SERVICE_LIST     = 15, // path is the prefix, the entries from offset go into the window
+	CRUD_SERVICE_CLONE    = 16, // path to path2
+	CRUD_SERVICE_SNAPSHOT = 17, // path is the name
+	CRUD_SERVICE_FORMAT   = 18, // format and mount the volume (no handle may be open)
+	CRUD_SERVICE_SYNC     = 19,
+	CRUD_SERVICE_REQUESTS = 20,
+} CrudServiceOperation;
+
+// This is a request of a client
+typedef struct {
+	uint32_t  op;                          // CrudServiceOperation
+	int32_t   handle;                      // The file or directory handle of the client
+	int32_t   count;                       // The bytes to read or write (at most the window)
+	uint32_t  offset;                      // The offset, position or length
+	char      path[CRUD_MAX_PATH_LENGTH];  // The path of the request
+	char      path2[CRUD_MAX_PATH_LENGTH]; // The second path (clone)
+} CrudServiceRequest;
+
+// This is the reply to a request
+typedef struct {
+	int64_t   result;   // What the driver call returned (a client handle for the opens)
+} CrudServiceReply;
+
+// This is the greeting of the server, sent with the window (SCM_RIGHTS)
+typedef struct {
+	uint32_t  magic;    // CRUD_SERVICE_MAGIC
+	uint32_t  window;   // The bytes of the window
+} CrudServiceHello;
+
+//
+// Service interface
+
+int crud_service_start( const char *path );
+	// Start serving the mounted volume on the socket at path (NULL for the default)
+
+int crud_service_stop( void );
+	// Stop serving, disconnecting the clients and closing their files
+
+//
+// Unit testing for the module
+
+int crudServiceUnitTest( void );
+	// Perform a test of the service (with client processes)
+
+#endif
@@ -17,26 +17,47 @@
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <fcntl.h>
+#include <time.h>
 
 // Project Includes
 #include <crud_driver.h>
 #include <crud_file_io.h>
-#include <cmpsc311_log.h>
+#include <crud_arena.h>
+#include <crud_journal.h>
+#include <crud_recycle.h>
+#include <crud_heatmap.h>
+#include <crud_workload.h>
+#include <crud_trace.h>
+#include <crud_service.h>
+#include <crud_log.h>
 #include <cmpsc311_util.h>
 #include <cmpsc311_hashtable.h>
 
 // Defines
 #define CRUD_SIM_MAX_OPEN_FILES 128
-#define CRUD_ARGUMENTS "hvul:x:"
+#define CRUD_ARGUMENTS "hvaul:x:b:d:w:S:t:"
 #define USAGE \
-	"USAGE: crud [-h] [-v] [-l <logfile>] [-c <sz>] [-x <file>] <workload-file>\n" \
+	"USAGE: crud [-h] [-v] [-a] [-l <logfile>] [-c <sz>] [-x <file>] [-w <file>] [-b <backend>] [-d <model>] [-S <settings>] [-t <trace>] <workload-file>\n" \
 	"\n" \
 	"where:\n" \
 	"    -h - help mode (display this message)\n" \
 	"    -u - run the unit tests instead of the simulator\n" \
 	"    -v - verbose output\n" \
+	"    -a - format and write log messages on a background thread\n" \
 	"    -l - write log messages to the filename <logfile>\n" \
 	"    -x - extract a file <file> from the crud filesystem\n" \
+	"    -w - compile the workload into <file> instead of running it (a\n" \
+	"         compiled workload is replayed like a text one, only faster)\n" \
+	"    -b - store objects in <backend>: crud (default), memory[:<image>], file[:<dir>],\n" \
+	"         stripe:[map=<file>+][unit=<bytes>+][copies=<n>+]<backend>+<backend>...\n" \
+	"    -d - model the device: comma separated lat=<us>, read=<us> (and the\n" \
+	"         other request types), bw=<MB/s>, jitter=<us>, fail=<prob>,\n" \
+	"         seed=<n>, virtual\n" \
+	"    -S - run the stress benchmark instead of a workload: comma separated\n" \
+	"         files=<n>, threads=<n>, iterations=<n>, write=<max>, read=<max>,\n" \
+	"         size=<max>, verify=<n>, seed=<n> (\"\" for the unit test defaults)\n" \
+	"    -t - write a Chrome trace (JSON) of the driver calls and object store\n" \
+	"         requests to <trace>\n" \
 	"\n" \
 	"    <workload-file> - file contain the workload to simulate\n" \
 	"\n" \
@@ -55,7 +76,11 @@ int verbose;
 // Functional Prototypes
 
 int simulate_CRUD( char *wload );
+int simulate_compiled( char *wload );
+int simulate_command( int cmd, char *fname, int16_t fh, int32_t len, int32_t off, char *data );
+void log_replay_rate( uint64_t commands, const struct timespec *start );
 int extract_file_from_crud(char *ex_file);
+void log_listed_entry( const CrudFileAllocationType *entry, void *arg );
 
 //
 // Functions
@@ -71,9 +96,11 @@ int extract_file_from_crud(char *ex_file);
 
 int main( int argc, char *argv[] ) {
 	// Local variables
-	int ch, verbose = 0, unit_tests = 0, log_initialized = 0, extract_file = 0;
+	int ch, verbose = 0, unit_tests = 0, log_initialized = 0, extract_file = 0, async_log = 0;
 	uint32_t cache_size = 1024; // Defaults to 1024 cache lines
-	char *ex_file = NULL;
+	char *ex_file = NULL, *backend = NULL, *model = NULL, *compiled = NULL, *stress = NULL, *trace = NULL;
+	CrudStressParams params;
+	CrudBackend *be;
 
 	// Process the command line parameters
 	while ((ch = getopt(argc, argv, CRUD_ARGUMENTS)) != -1) {
@@ -87,6 +114,10 @@ int main( int argc, char *argv[] ) {
 			verbose = 1;
 			break;
 
+		case 'a': // Asynchronous logging flag
+			async_log = 1;
+			break;
+
 		case 'u': // Unit Tests Flag
 			unit_tests = 1;
 			break;
@@ -101,9 +132,29 @@ int main( int argc, char *argv[] ) {
 			extract_file = 1;
 			break;
 
+		case 'w': // Compile the workload
+			compiled = optarg;
+			break;
+
+		case 'b': // Select the storage backend
+			backend = optarg;
+			break;
+
+		case 'd': // Model the device latency and failures
+			model = optarg;
+			break;
+
+		case 'S': // Run the stress benchmark
+			stress = optarg;
+			break;
+
+		case 't': // Trace the driver
+			trace = optarg;
+			break;
+
 		case 'c': // Set cache line size
 			if ( sscanf( optarg, "%u", &cache_size ) != 1 ) {
-			    logMessage( LOG_ERROR_LEVEL, "Bad  cache size [%s]", argv[optind] );
+			    CRUD_LOG( LOG_ERROR_LEVEL, "Bad  cache size [%s]", argv[optind] );
 			}
 			break;
 
@@ -121,24 +172,56 @@ int main( int argc, char *argv[] ) {
 		enableLogLevels( LOG_INFO_LEVEL );
 	}
 
+	// Setup the storage backend, wrapped in the device model if asked
+	if ( (backend != NULL) || (model != NULL) ) {
+		be = crud_backend_create( (backend != NULL) ? backend : CRUD_DEFAULT_BACKEND );
+		if ( model != NULL ) {
+			be = crud_latency_backend_wrap( be, model );
+		}
+		if ( crud_set_backend(be) ) {
+			fprintf( stderr, "Bad storage backend or device model, aborting.\n" );
+			return( -1 );
+		}
+	}
+	if ( async_log ) {
+		crud_log_async_start( 0 );
+	}
+	if ( (trace != NULL) && crud_trace_start(trace) ) {
+		return( -1 );
+	}
+
 	// If we are running the unit tests, do that
 	if ( unit_tests ) {
 
 		// Enable verbose, run the tests and check the results
 		enableLogLevels( LOG_INFO_LEVEL );
-		if ( hashTableUnitTest() || crud_unit_test() || crudIOUnitTest() ) {
-			logMessage( LOG_ERROR_LEVEL, "CRUD unit tests failed.\n\n" );
+		if ( hashTableUnitTest() || crudLogUnitTest() || crud_unit_test() || crudArenaUnitTest() || crudTableUnitTest() ||
+				crudIOUnitTest() || crudDirectoryUnitTest() || crudSparseUnitTest() || crudCloneUnitTest() || crudJournalUnitTest() || crudRecycleUnitTest() || crudHeatmapUnitTest() ||
+				crudDurabilityUnitTest() || crudCoalesceUnitTest() || crudServiceUnitTest() || crudStripeUnitTest() || crudWorkloadUnitTest() || crudTraceUnitTest() ) {
+			CRUD_LOG( LOG_ERROR_LEVEL, "CRUD unit tests failed.\n\n" );
 		} else {
-			logMessage( LOG_INFO_LEVEL, "CRUD unit tests completed successfully.\n\n" );
+			CRUD_LOG( LOG_INFO_LEVEL, "CRUD unit tests completed successfully.\n\n" );
+		}
+
+	} else if ( stress != NULL ) {
+
+		// Running the stress benchmark
+		if ( crud_stress_params((*stress != 0x0) ? stress : NULL, &params) == 0 ) {
+			params.report = 1;
+			if ( crud_stress(&params) == 0 ) {
+				CRUD_LOG( LOG_INFO_LEVEL, "CRUD stress benchmark completed successfully.\n\n" );
+			} else {
+				CRUD_LOG( LOG_ERROR_LEVEL, "CRUD stress benchmark failed.\n\n" );
+			}
 		}
 
 	} else if (extract_file) {
 
 		// Extracting a file from the crud file systems
 		if (extract_file_from_crud(ex_file) == 0) {
-			logMessage(LOG_INFO_LEVEL, "File [%s] extracted from crud successfully.\n\n", ex_file);
+			CRUD_LOG(LOG_INFO_LEVEL, "File [%s] extracted from crud successfully.\n\n", ex_file);
 		} else {
-			logMessage(LOG_ERROR_LEVEL, "File [%s] extraction failed, aborting.\n\n");
+			CRUD_LOG(LOG_ERROR_LEVEL, "File [%s] extraction failed, aborting.\n\n", ex_file);
 		}
 
 	} else {
@@ -152,15 +235,27 @@ int main( int argc, char *argv[] ) {
 
 		}
 
-		// Run the simulation
-		if ( simulate_CRUD(argv[optind]) == 0 ) {
-			logMessage( LOG_INFO_LEVEL, "CRUD simulation completed successfully.\n\n" );
+		// Compile the workload, or run the simulation
+		if ( compiled != NULL ) {
+			if ( crud_workload_compile(argv[optind], compiled) == 0 ) {
+				CRUD_LOG( LOG_INFO_LEVEL, "CRUD workload [%s] compiled into [%s].\n\n", argv[optind], compiled );
+			} else {
+				CRUD_LOG( LOG_ERROR_LEVEL, "CRUD workload [%s] failed to compile.\n\n", argv[optind] );
+			}
+		} else if ( simulate_CRUD(argv[optind]) == 0 ) {
+			CRUD_LOG( LOG_INFO_LEVEL, "CRUD simulation completed successfully.\n\n" );
 		} else {
-			logMessage( LOG_INFO_LEVEL, "CRUD simulation failed.\n\n" );
+			CRUD_LOG( LOG_INFO_LEVEL, "CRUD simulation failed.\n\n" );
 		}
 	}
 
-	// Return successfully
+	// Finish the trace, write out any queued log messages, return successfully
+	if ( trace != NULL ) {
+		crud_trace_stop();
+	}
+	if ( async_log ) {
+		crud_log_async_stop();
+	}
 	return( 0 );
 }
 
@@ -168,7 +263,7 @@ int main( int argc, char *argv[] ) {
 //
 // Function     : simulate_CRUD
 // Description  : The main control loop for the processing of the CRUD
-//                simulation.
+//                simulation (compiled workloads are replayed directly).
 //
 // Inputs       : wload - the name of the workload file
 // Outputs      : 0 if successful test, -1 if failure
@@ -176,11 +271,18 @@ int main( int argc, char *argv[] ) {
 int simulate_CRUD( char *wload ) {
 
 	// Local variables
-	char line[1024], fname[128], command[128], text[1025], *sep, *rbuf;
+	char line[1024], fname[128], command[128], text[1025], *sep;
 	FILE *fhandle = NULL;
-	int32_t err=0, len, off, fields, linecount;
+	int32_t len, off, fields, linecount;
 	CrudSimulationTable ftable[CRUD_SIM_MAX_OPEN_FILES];
-	int idx, i;
+	struct timespec start;
+	int16_t fh;
+	int idx, i, cmd;
+
+	// A compiled workload needs no parsing
+	if ( crud_workload_is_compiled(wload) ) {
+		return( simulate_compiled(wload) );
+	}
 
 	// Setup the file table
 	memset(ftable, 0x0, sizeof(CrudSimulationTable)*CRUD_SIM_MAX_OPEN_FILES);
@@ -188,10 +290,11 @@ int simulate_CRUD( char *wload ) {
 	// Open the workload file
 	linecount = 0;
 	if ( (fhandle=fopen(wload, "r")) == NULL ) {
-		logMessage( LOG_ERROR_LEVEL, "Failure opening the workload file [%s], error: %s.\n",
+		CRUD_LOG( LOG_ERROR_LEVEL, "Failure opening the workload file [%s], error: %s.\n",
 			wload, strerror(errno) );
 		return( -1 );
 	}
+	clock_gettime(CLOCK_MONOTONIC, &start);
 
 	// While file not done
 	while (!feof(fhandle)) {
@@ -204,45 +307,23 @@ int simulate_CRUD( char *wload ) {
 			fields = sscanf(line, "%s %s %d %d", fname, command, &len, &off);
 			sep = strchr(line, ':');
 			if ( (fields != 4) || (sep == NULL) ) {
-				logMessage( LOG_ERROR_LEVEL, "CRUD un-parsable workload string, aborting [%s], line %d",
+				CRUD_LOG( LOG_ERROR_LEVEL, "CRUD un-parsable workload string, aborting [%s], line %d",
 						line, linecount );
 				fclose( fhandle );
 				return( -1 );
 			}
 
 			// Just log the contents
-			logMessage(LOG_INFO_LEVEL, "File [%s], command [%s], len=%d, offset=%d",
+			CRUD_LOG(LOG_INFO_LEVEL, "File [%s], command [%s], len=%d, offset=%d",
 					fname, command, len, off);
 
-			// Now process the commands
-			if (strncmp(command, "FORMAT", 6) == 0) {
-
-				// Log the command executed
-				logMessage(LOG_INFO_LEVEL, "CRUD_SIM : Formatting CRUD filesystem");
-
-				// Now perform the format
-				if (crud_format() != len) {
-					// Failed, error out
-					logMessage(LOG_ERROR_LEVEL, "Formatting failed, aborting simulation.");
-					return(-1);
-				}
-
-			} else if (strncmp(command, "MOUNT", 5) == 0) {
+			// Bomb out if we don't understand the command
+			cmd = crud_workload_command(command);
+			CMPSC_ASSERT1(cmd != -1, "CRUD_SIM : Failed, unknown command [%s]", command);
+			fh = -1;
+			idx = -1;
 
-				// Log the command executed
-				logMessage(LOG_INFO_LEVEL, "CRUD_SIM : Mounting CRUD filesystem");
-
-				// Now perform the filesystem mount
-				if (crud_mount() != len) {
-					// Failed, error out
-					logMessage(LOG_ERROR_LEVEL, "Mount failed, aborting simulation.");
-					return(-1);
-				}
-
-			} else if (strncmp(command, "UNMOUNT", 5) == 0) {
-
-				// Log the command executed
-				logMessage(LOG_INFO_LEVEL, "CRUD_SIM : Un-mounting CRUD filesystem");
+			if (cmd == CRUD_WORKLOAD_UNMOUNT) {
 
 				// Finished, close all of the files
 				for (idx=0; idx<CRUD_SIM_MAX_OPEN_FILES; idx++) {
@@ -250,10 +331,11 @@ int simulate_CRUD( char *wload ) {
 					// If file in use, close if
 					if (ftable[idx].filename != NULL) {
 						// Log the file close
-						logMessage(LOG_INFO_LEVEL, "CRUD_SIM : Closing file [%s]", ftable[idx].filename);
+						CRUD_LOG(LOG_INFO_LEVEL, "CRUD_SIM : Closing file [%s]", ftable[idx].filename);
 						if (crud_close(ftable[idx].fhandle) == -1) {
 							// Failed, error out
-							logMessage(LOG_ERROR_LEVEL, "Close file [%s] failed, aborting simulation.", ftable[idx].filename);
+							CRUD_LOG(LOG_ERROR_LEVEL, "Close file [%s] failed, aborting simulation.", ftable[idx].filename);
+							fclose( fhandle );
 							return(-1);
 						}
 						free(ftable[idx].filename);
@@ -262,21 +344,9 @@ int simulate_CRUD( char *wload ) {
 
 				}
 
-				// Now perform the filesystem unmount
-				if (crud_unmount() != len) {
-					// Failed, error out
-					logMessage(LOG_ERROR_LEVEL, "Mount failed, aborting simulation.");
-					return(-1);
-				}
-
-
-			} else {
-
-				//
-				// File operations
+			} else if (CRUD_WORKLOAD_FILE_COMMAND(cmd)) {
 
 				// Now walk the the table looking for the file
-				idx = -1;
 				i = 0;
 				while ( (i < CRUD_SIM_MAX_OPEN_FILES) && (idx == -1) ) {
 					if ( (ftable[i].filename != NULL) && (strcmp(ftable[i].filename,fname) == 0) ) {
@@ -289,7 +359,7 @@ int simulate_CRUD( char *wload ) {
 				if (idx == -1) {
 
 					// Log message, find unused index and save filename for later use
-					logMessage(LOG_INFO_LEVEL, "CRUD_SIM : Opening file [%s]", fname);
+					CRUD_LOG(LOG_INFO_LEVEL, "CRUD_SIM : Opening file [%s]", fname);
 					idx = 0;
 					while ((ftable[idx].filename != NULL) && (idx < CRUD_SIM_MAX_OPEN_FILES)) {
 						idx++;
@@ -301,26 +371,16 @@ int simulate_CRUD( char *wload ) {
 					ftable[idx].fhandle = crud_open(ftable[idx].filename);
 					if (ftable[idx].fhandle == -1) {
 						// Failed, error out
-						logMessage(LOG_ERROR_LEVEL, "Open of new file [%s] failed, aborting simulation.", fname);
+						CRUD_LOG(LOG_ERROR_LEVEL, "Open of new file [%s] failed, aborting simulation.", fname);
+						fclose( fhandle );
 						return(-1);
 					}
 
 				}
+				fh = ftable[idx].fhandle;
 
-				// Now execute the specific command
-				if (strncmp(command, "WRITEAT", 7) == 0) {
-
-					// Log the command executed
-					logMessage(LOG_INFO_LEVEL, "CRUD_SIM : Writing %d bytes at position %d from file [%s]", len, off, fname);
-
-					// First perform the seek
-					if (crud_seek(ftable[idx].fhandle, off)) {
-						// Failed, error out
-						logMessage(LOG_ERROR_LEVEL, "Seek/WriteAt file [%s] to position %d failed, aborting simulation.", fname, off);
-						return(-1);
-					}
-
-					// Now see if we need more data to fill, terminate the lines
+				// Now see if we need more data to fill, terminate the lines
+				if ((cmd == CRUD_WORKLOAD_WRITE) || (cmd == CRUD_WORKLOAD_WRITEAT)) {
 					CMPSC_ASSERT1(len<1024, "Simulated workload command text too large [%d]", len);
 					CMPSC_ASSERT2((strlen(sep+1)>=len), "Workload str [%d<%d]", strlen(sep+1), len);
 					strncpy(text, sep+1, len);
@@ -330,84 +390,361 @@ int simulate_CRUD( char *wload ) {
 							text[i] = '\n';
 						}
 					}
+				}
+			}
 
-					// Now perform the write
-					if (crud_write(ftable[idx].fhandle, text, len) != len) {
-						// Failed, error out
-						logMessage(LOG_ERROR_LEVEL, "WriteAt of file [%s], length %d failed, aborting simulation.", fname, len);
-						return(-1);
-					}
+			// Now execute the command, a closed file frees its slot
+			if (simulate_command(cmd, fname, fh, len, off, text)) {
+				fclose( fhandle );
+				return(-1);
+			}
+			if (cmd == CRUD_WORKLOAD_CLOSE) {
+				free(ftable[idx].filename);
+				ftable[idx].filename = NULL;
+			}
+		}
+	}
 
-				} else if (strncmp(command, "WRITE", 5) == 0) {
+	// Close the workload file, successfully
+	fclose( fhandle );
+	log_replay_rate(linecount, &start);
+	return( 0 );
+}
 
-					// Now see if we need more data to fill, terminate the lines
-					CMPSC_ASSERT1(len<1024, "Simulated workload command text too large [%d]", len);
-					CMPSC_ASSERT2((strlen(sep+1)>=len), "Workload str [%d<%d]", strlen(sep+1), len);
-					strncpy(text, sep+1, len);
-					text[len] = 0x0;
-					for (i=0; i<strlen(text); i++) {
-						if (text[i] == '*') {
-							text[i] = '\n';
-						}
-					}
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : simulate_compiled
+// Description  : Replay a compiled workload, straight from its mapping (the
+//                records were checked when it was mapped, and the handles
+//                are found by file id)
+//
+// Inputs       : wload - the name of the compiled workload
+// Outputs      : 0 if successful test, -1 if failure
 
-					// Log the command executed
-					logMessage(LOG_INFO_LEVEL, "CRUD_SIM : Writing %d bytes to file [%s]", len, fname);
+int simulate_compiled( char *wload ) {
 
-					// Now perform the write
-					if (crud_write(ftable[idx].fhandle, text, len) != len) {
-						// Failed, error out
-						logMessage(LOG_ERROR_LEVEL, "Write of file [%s], length %d failed, aborting simulation.", fname, len);
-						return(-1);
-					}
+	// Local variables
+	const CrudWorkloadRecord *rec;
+	CrudWorkload workload;
+	struct timespec start;
+	int16_t *handles;
+	uint64_t i;
+	uint32_t f;
+	char *fname;
+
+	// Map the workload, no file is open yet
+	if (crud_workload_map(wload, &workload)) {
+		return(-1);
+	}
+	handles = malloc(((workload.header->files > 0) ? workload.header->files : 1) * sizeof(int16_t));
+	for (f=0; f<workload.header->files; f++) {
+		handles[f] = -1;
+	}
+	clock_gettime(CLOCK_MONOTONIC, &start);
 
-				} else if (strncmp(command, "SEEK", 4) == 0) {
+	// Replay each record
+	for (i=0; i<workload.header->records; i++) {
+		rec = &workload.records[i];
+		fname = (char *)workload.names[rec->file];
 
-					// Log the command executed
-					logMessage(LOG_INFO_LEVEL, "CRUD_SIM : Seeking to position %d in file [%s]", off, fname);
+		if (rec->command == CRUD_WORKLOAD_UNMOUNT) {
 
-					// Now perform the seek
-					if (crud_seek(ftable[idx].fhandle, off) != len) {
-						// Failed, error out
-						logMessage(LOG_ERROR_LEVEL, "Seek in file [%s] to position %d failed, aborting simulation.", fname, off);
-						return(-1);
-					}
+			// Finished, close all of the files
+			for (f=0; f<workload.header->files; f++) {
+				if ((handles[f] != -1) && (crud_close(handles[f]) == -1)) {
+					CRUD_LOG(LOG_ERROR_LEVEL, "Close file [%s] failed, aborting simulation.", workload.names[f]);
+					break;
+				}
+				handles[f] = -1;
+			}
+			if (f < workload.header->files) {
+				break;
+			}
 
-				} else if (strncmp(command, "READ", 4) == 0) {
+		} else if (CRUD_WORKLOAD_FILE_COMMAND(rec->command) && (handles[rec->file] == -1)) {
 
-					// Log the command executed
-					logMessage(LOG_INFO_LEVEL, "CRUD_SIM : Reading %d bytes from file [%s]", len, fname);
+			// The first command on a file opens it
+			CRUD_LOG(LOG_INFO_LEVEL, "CRUD_SIM : Opening file [%s]", fname);
+			if ((handles[rec->file] = crud_open(fname)) == -1) {
+				CRUD_LOG(LOG_ERROR_LEVEL, "Open of new file [%s] failed, aborting simulation.", fname);
+				break;
+			}
+		}
 
-					// Now perform the read
-					rbuf = malloc(len);
-					if (crud_read(ftable[idx].fhandle, rbuf, len) != len) {
-						// Failed, error out
-						logMessage(LOG_ERROR_LEVEL, "Read file [%s] of length %d failed, aborting simulation.", fname, off);
-						return(-1);
-					}
-					free(rbuf);
-					rbuf = NULL;
+		// Now execute the command
+		if (simulate_command(rec->command, fname, handles[rec->file], rec->length, rec->offset,
+				(char *)&workload.payloads[rec->payload])) {
+			break;
+		}
+		if (rec->command == CRUD_WORKLOAD_CLOSE) {
+			handles[rec->file] = -1;
+		}
+	}
 
-				} else {
+	// Release the workload, failed if a record stopped the replay
+	if (i == workload.header->records) {
+		log_replay_rate(i, &start);
+	}
+	free(handles);
+	f = (i == workload.header->records);
+	crud_workload_unmap(&workload);
+	return(f ? 0 : -1);
+}
 
-					// Bomb out, don't understand the command
-					CMPSC_ASSERT1(0, "CRUD_SIM : Failed, unknown command [%s]", command);
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : simulate_command
+// Description  : Execute one workload command (a file command on its open
+//                handle)
+//
+// Inputs       : cmd - the command
+//                fname - the file (or directory, or snapshot) named
+//                fh - the handle of the file (file commands only)
+//                len - the length field
+//                off - the offset field
+//                data - the data of a write (len bytes)
+// Outputs      : 0 if successful, -1 if failure
 
-				}
-			}
+int simulate_command( int cmd, char *fname, int16_t fh, int32_t len, int32_t off, char *data ) {
 
-			// Check for the virtual level failing
-			if ( err ) {
-				logMessage( LOG_ERROR_LEVEL, "CRUS system failed, aborting [%d]", err );
-				fclose( fhandle );
-				return( -1 );
-			}
+	// Local variables
+	char *rbuf;
+
+	switch (cmd) {
+	case CRUD_WORKLOAD_FORMAT:
+
+		// Log the command executed
+		CRUD_LOG(LOG_INFO_LEVEL, "CRUD_SIM : Formatting CRUD filesystem");
+
+		// Now perform the format
+		if (crud_format() != len) {
+			// Failed, error out
+			CRUD_LOG(LOG_ERROR_LEVEL, "Formatting failed, aborting simulation.");
+			return(-1);
+		}
+		break;
+
+	case CRUD_WORKLOAD_MOUNT:
+
+		// Log the command executed
+		CRUD_LOG(LOG_INFO_LEVEL, "CRUD_SIM : Mounting CRUD filesystem");
+
+		// Now perform the filesystem mount
+		if (crud_mount() != len) {
+			// Failed, error out
+			CRUD_LOG(LOG_ERROR_LEVEL, "Mount failed, aborting simulation.");
+			return(-1);
+		}
+		break;
+
+	case CRUD_WORKLOAD_UNMOUNT:
+
+		// Log the command executed (the caller closed the files)
+		CRUD_LOG(LOG_INFO_LEVEL, "CRUD_SIM : Un-mounting CRUD filesystem");
+
+		// Now perform the filesystem unmount
+		if (crud_unmount() != len) {
+			// Failed, error out
+			CRUD_LOG(LOG_ERROR_LEVEL, "Mount failed, aborting simulation.");
+			return(-1);
+		}
+		break;
+
+	case CRUD_WORKLOAD_MKDIR:
+
+		// Log the command executed
+		CRUD_LOG(LOG_INFO_LEVEL, "CRUD_SIM : Making directory [%s]", fname);
+
+		// Now make the directory
+		if (crud_mkdir(fname) != len) {
+			// Failed, error out
+			CRUD_LOG(LOG_ERROR_LEVEL, "Mkdir of [%s] failed, aborting simulation.", fname);
+			return(-1);
+		}
+		break;
+
+	case CRUD_WORKLOAD_LIST:
+
+		// Log the command executed ("/" lists everything)
+		CRUD_LOG(LOG_INFO_LEVEL, "CRUD_SIM : Listing files starting with [%s]", fname);
+
+		// Now list the files, the length is the expected count
+		if (crud_list((strcmp(fname, "/") == 0) ? "" : fname, log_listed_entry, NULL) != len) {
+			// Failed, error out
+			CRUD_LOG(LOG_ERROR_LEVEL, "Listing of [%s] did not find %d files, aborting simulation.", fname, len);
+			return(-1);
+		}
+		break;
+
+	case CRUD_WORKLOAD_SNAPSHOT:
+
+		// Log the command executed
+		CRUD_LOG(LOG_INFO_LEVEL, "CRUD_SIM : Taking snapshot [%s]", fname);
+
+		// Now freeze every file under the snapshot name
+		if (crud_snapshot(fname) != len) {
+			// Failed, error out
+			CRUD_LOG(LOG_ERROR_LEVEL, "Snapshot [%s] failed, aborting simulation.", fname);
+			return(-1);
+		}
+		break;
+
+	case CRUD_WORKLOAD_WRITEAT:
+
+		// Log the command executed
+		CRUD_LOG(LOG_INFO_LEVEL, "CRUD_SIM : Writing %d bytes at position %d from file [%s]", len, off, fname);
+
+		// First perform the seek
+		if (crud_seek(fh, off)) {
+			// Failed, error out
+			CRUD_LOG(LOG_ERROR_LEVEL, "Seek/WriteAt file [%s] to position %d failed, aborting simulation.", fname, off);
+			return(-1);
+		}
+
+		// Now perform the write
+		if (crud_write(fh, data, len) != len) {
+			// Failed, error out
+			CRUD_LOG(LOG_ERROR_LEVEL, "WriteAt of file [%s], length %d failed, aborting simulation.", fname, len);
+			return(-1);
 		}
+		break;
+
+	case CRUD_WORKLOAD_WRITE:
+
+		// Log the command executed
+		CRUD_LOG(LOG_INFO_LEVEL, "CRUD_SIM : Writing %d bytes to file [%s]", len, fname);
+
+		// Now perform the write
+		if (crud_write(fh, data, len) != len) {
+			// Failed, error out
+			CRUD_LOG(LOG_ERROR_LEVEL, "Write of file [%s], length %d failed, aborting simulation.", fname, len);
+			return(-1);
+		}
+		break;
+
+	case CRUD_WORKLOAD_SEEK:
+
+		// Log the command executed
+		CRUD_LOG(LOG_INFO_LEVEL, "CRUD_SIM : Seeking to position %d in file [%s]", off, fname);
+
+		// Now perform the seek
+		if (crud_seek(fh, off) != len) {
+			// Failed, error out
+			CRUD_LOG(LOG_ERROR_LEVEL, "Seek in file [%s] to position %d failed, aborting simulation.", fname, off);
+			return(-1);
+		}
+		break;
+
+	case CRUD_WORKLOAD_READ:
+
+		// Log the command executed
+		CRUD_LOG(LOG_INFO_LEVEL, "CRUD_SIM : Reading %d bytes from file [%s]", len, fname);
+
+		// Now perform the read
+		rbuf = crud_arena_alloc(len);
+		if (crud_read(fh, rbuf, len) != len) {
+			// Failed, error out
+			CRUD_LOG(LOG_ERROR_LEVEL, "Read file [%s] of length %d failed, aborting simulation.", fname, off);
+			return(-1);
+		}
+		crud_arena_free(rbuf);
+		rbuf = NULL;
+		break;
+
+	case CRUD_WORKLOAD_TRUNCATE:
+
+		// Log the command executed
+		CRUD_LOG(LOG_INFO_LEVEL, "CRUD_SIM : Truncating file [%s] to %d bytes", fname, len);
+
+		// Now perform the truncate
+		if (crud_truncate(fh, len) != 0) {
+			// Failed, error out
+			CRUD_LOG(LOG_ERROR_LEVEL, "Truncate of file [%s] to %d bytes failed, aborting simulation.", fname, len);
+			return(-1);
+		}
+		break;
+
+	case CRUD_WORKLOAD_RESERVE:
+
+		// Log the command executed
+		CRUD_LOG(LOG_INFO_LEVEL, "CRUD_SIM : Reserving %d bytes for file [%s]", len, fname);
+
+		// Now perform the reserve
+		if (crud_reserve(fh, len) != 0) {
+			// Failed, error out
+			CRUD_LOG(LOG_ERROR_LEVEL, "Reserve of %d bytes for file [%s] failed, aborting simulation.", len, fname);
+			return(-1);
+		}
+		break;
+
+	case CRUD_WORKLOAD_CLOSE:
+
+		// Log the command executed
+		CRUD_LOG(LOG_INFO_LEVEL, "CRUD_SIM : Closing file [%s]", fname);
+
+		// Now perform the close, the caller forgets the handle
+		if (crud_close(fh) != 0) {
+			// Failed, error out
+			CRUD_LOG(LOG_ERROR_LEVEL, "Close of file [%s] failed, aborting simulation.", fname);
+			return(-1);
+		}
+		break;
+
+	case CRUD_WORKLOAD_FSYNC:
+
+		// Log the command executed
+		CRUD_LOG(LOG_INFO_LEVEL, "CRUD_SIM : Syncing file [%s]", fname);
+
+		// Now perform the sync
+		if (crud_fsync(fh) != 0) {
+			// Failed, error out
+			CRUD_LOG(LOG_ERROR_LEVEL, "Sync of file [%s] failed, aborting simulation.", fname);
+			return(-1);
+		}
+		break;
+
+	default:
+
+		// Bomb out, don't understand the command
+		CMPSC_ASSERT1(0, "CRUD_SIM : Failed, unknown command [%d]", cmd);
 	}
+	return(0);
+}
 
-	// Close the workload file, successfully
-	fclose( fhandle );
-	return( 0 );
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : log_replay_rate
+// Description  : Report how long a workload took to replay
+//
+// Inputs       : commands - the number of commands replayed
+//                start - when the replay started
+// Outputs      : none
+
+void log_replay_rate( uint64_t commands, const struct timespec *start ) {
+
+	// Local variables
+	struct timespec end;
+	double secs;
+
+	// Take the elapsed time, then log the rate
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	secs = (end.tv_sec - start->tv_sec) + (end.tv_nsec - start->tv_nsec) / 1e9;
+	CRUD_LOG(LOG_OUTPUT_LEVEL, "CRUD_SIM : replayed %lu commands in %.3f seconds (%.0f commands/sec)",
+			(unsigned long)commands, secs, (secs > 0.0) ? commands / secs : 0.0);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : log_listed_entry
+// Description  : Log an entry found by the LIST command
+//
+// Inputs       : entry - the entry
+//                arg - unused
+// Outputs      : none
+
+void log_listed_entry( const CrudFileAllocationType *entry, void *arg ) {
+	CRUD_LOG(LOG_INFO_LEVEL, "CRUD_SIM : %s %s (%u bytes)",
+			(entry->flags & CRUD_FILE_DIRECTORY) ? "dir " : "file", entry->filename, entry->length);
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -426,12 +763,10 @@ int extract_file_from_crud(char *ex_file) {
 	char buf[CRUD_MAX_OBJECT_SIZE];
     int fhandle, flags;
     mode_t mode;
-	// Open the file, read from it, close it
-	if ( (crud_mount()) || ((fd = crud_open(ex_file)) == -1) ||
-		 ((len = crud_read(fd, buf, CRUD_MAX_OBJECT_SIZE)) == -1) ||
-		 (crud_close(fd) == -1)	) {
+	// Open the file (files larger than the buffer are read in pieces)
+	if ( (crud_mount()) || ((fd = crud_open(ex_file)) == -1) ) {
 		// Error out
-		logMessage(LOG_INFO_LEVEL, "CRUD : extraction failed on crud interface [%s].", ex_file);
+		CRUD_LOG(LOG_INFO_LEVEL, "CRUD : extraction failed on crud interface [%s].", ex_file);
 		return(-1);
 	}
 
@@ -444,9 +779,22 @@ int extract_file_from_crud(char *ex_file) {
         return( -1 );
     }
 
-    // Now write the read bytes to the file, then close
-    if (write(fhandle, buf, len) != len) {
-        fprintf( stderr, "CRUD: extraction write() failed, error=%s\n", strerror(errno) );
+    // Now write the read bytes to the file until the end, then close
+    do {
+        if ( (len = crud_read(fd, buf, CRUD_MAX_OBJECT_SIZE)) == -1 ) {
+            CRUD_LOG(LOG_INFO_LEVEL, "CRUD : extraction failed on crud interface [%s].", ex_file);
+            close( fhandle );
+            return( -1 );
+        }
+        if (write(fhandle, buf, len) != len) {
+            fprintf( stderr, "CRUD: extraction write() failed, error=%s\n", strerror(errno) );
+            close( fhandle );
+            return( -1 );
+        }
+    } while ( len == CRUD_MAX_OBJECT_SIZE );
+    if ( crud_close(fd) == -1 ) {
+        CRUD_LOG(LOG_INFO_LEVEL, "CRUD : extraction failed on crud interface [%s].", ex_file);
+        close( fhandle );
         return( -1 );
     }
     close( fhandle );
@@ -0,0 +1,299 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+//  File           : crud_trace.c
+//  Description    : This is the implementation of the CRUD driver tracing.
+//                   Events are formatted straight into one buffer (under a
+//                   lock, the driver is serialized anyway) and written out
+//                   when it fills, so a traced call costs two clock reads
+//                   and two short formats.  The spans of a thread nest in
+//                   the order they were opened, as the trace format wants.
+//
+//  Last Modified  : Sun Oct 18 18:02:44 EDT 2026
+//
+
+// Includes
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include <time.h>
+#include <unistd.h>
+
+// Project Includes
+#include <crud_trace.h>
+#include <crud_file_io.h>
+#include <crud_log.h>
+
+// Defines
+#define CRUD_TRACE_UNIT_TEST_FILE "crud_trace_utest.json"
+
+//
+// Global data
+
+volatile int crud_trace_enabled = 0;              // Flag indicating a trace is being written
+static FILE *crud_trace_file = NULL;              // The trace
+static char crud_trace_buffer[CRUD_TRACE_BUFFER_SIZE]; // The events not yet written
+static size_t crud_trace_used;                    // Bytes of the buffer used
+static uint64_t crud_trace_events;                // Events in the trace
+static struct timespec crud_trace_epoch;          // When the trace started
+static pthread_mutex_t crud_trace_mutex = PTHREAD_MUTEX_INITIALIZER;
+static atomic_uint crud_trace_threads;            // Threads that have traced (their ids)
+static __thread uint32_t crud_trace_tid;          // The id of this thread in the trace (0 if none yet)
+
+//
+// Functions
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : crud_trace_now
+// Description  : Get the time since the trace started
+//
+// Inputs       : none
+// Outputs      : the time in microseconds
+
+static double crud_trace_now( void ) {
+
+	// Local variables
+	struct timespec now;
+
+	clock_gettime( CLOCK_MONOTONIC, &now );
+	return( (now.tv_sec - crud_trace_epoch.tv_sec) * 1000000.0 + (now.tv_nsec - crud_trace_epoch.tv_nsec) / 1000.0 );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : crud_trace_room
+// Description  : Make room in the buffer for an event and start it (with the
+//                separator from the event before).  Called with the lock.
+//
+// Inputs       : none
+// Outputs      : where the event goes
+
+static char *crud_trace_room( void ) {
+	if ( crud_trace_used + CRUD_TRACE_MAX_EVENT > CRUD_TRACE_BUFFER_SIZE ) {
+		fwrite( crud_trace_buffer, 1, crud_trace_used, crud_trace_file );
+		crud_trace_used = 0;
+	}
+	if ( crud_trace_events++ > 0 ) {
+		crud_trace_buffer[crud_trace_used++] = ',';
+		crud_trace_buffer[crud_trace_used++] = '\n';
+	}
+	return( &crud_trace_buffer[crud_trace_used] );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : crud_trace_thread
+// Description  : Get the id of the calling thread, naming it in the trace the
+//                first time.  Called with the lock.
+//
+// Inputs       : none
+// Outputs      : the id
+
+static uint32_t crud_trace_thread( void ) {
+
+	// Local variables
+	int n;
+
+	if ( crud_trace_tid == 0 ) {
+		crud_trace_tid = atomic_fetch_add( &crud_trace_threads, 1 ) + 1;
+		n = snprintf( crud_trace_room(), CRUD_TRACE_MAX_EVENT,
+				"{\"ph\":\"M\",\"name\":\"thread_name\",\"pid\":%d,\"tid\":%u,\"args\":{\"name\":\"thread %u\"}}",
+				getpid(), crud_trace_tid, crud_trace_tid );
+		crud_trace_used += n;
+	}
+	return( crud_trace_tid );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : crud_trace_start
+// Description  : Start writing a trace
+//
+// Inputs       : path - the file to write the trace to
+// Outputs      : 0 if successful, -1 if failure
+
+int crud_trace_start( const char *path ) {
+
+	// Only one trace at a time
+	pthread_mutex_lock( &crud_trace_mutex );
+	if ( crud_trace_file != NULL ) {
+		pthread_mutex_unlock( &crud_trace_mutex );
+		CRUD_LOG( LOG_ERROR_LEVEL, "CRUD trace: a trace is already being written" );
+		return( -1 );
+	}
+	if ( (crud_trace_file = fopen(path, "w")) == NULL ) {
+		pthread_mutex_unlock( &crud_trace_mutex );
+		CRUD_LOG( LOG_ERROR_LEVEL, "CRUD trace: unable to create [%s]", path );
+		return( -1 );
+	}
+
+	// Start the event array, with the process named
+	fputs( "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n", crud_trace_file );
+	clock_gettime( CLOCK_MONOTONIC, &crud_trace_epoch );
+	crud_trace_used = 0;
+	crud_trace_events = 0;
+	crud_trace_used += snprintf( crud_trace_room(), CRUD_TRACE_MAX_EVENT,
+			"{\"ph\":\"M\",\"name\":\"process_name\",\"pid\":%d,\"args\":{\"name\":\"crud\"}}", getpid() );
+	crud_trace_enabled = 1;
+	pthread_mutex_unlock( &crud_trace_mutex );
+	CRUD_LOG( LOG_INFO_LEVEL, "CRUD trace: writing [%s]", path );
+	return( 0 );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : crud_trace_stop
+// Description  : Write out the buffered events, finish and close the trace
+//
+// Inputs       : none
+// Outputs      : 0 if successful, -1 if failure
+
+int crud_trace_stop( void ) {
+
+	// Local variables
+	uint64_t events;
+	int ret;
+
+	pthread_mutex_lock( &crud_trace_mutex );
+	if ( crud_trace_file == NULL ) {
+		pthread_mutex_unlock( &crud_trace_mutex );
+		return( -1 );
+	}
+	crud_trace_enabled = 0;
+	fwrite( crud_trace_buffer, 1, crud_trace_used, crud_trace_file );
+	fputs( "\n]}\n", crud_trace_file );
+	ret = (fclose( crud_trace_file ) == 0) ? 0 : -1;
+	crud_trace_file = NULL;
+	events = crud_trace_events;
+	pthread_mutex_unlock( &crud_trace_mutex );
+	CRUD_LOG( LOG_INFO_LEVEL, "CRUD trace: %lu events written", events );
+	return( ret );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : crud_trace_begin
+// Description  : Open a span on the calling thread
+//
+// Inputs       : cat - the category of the span
+//                name - the name of the span
+//                args - printf format of the JSON arguments object (or NULL)
+//                ... - the values of the arguments
+// Outputs      : none
+
+void crud_trace_begin( const char *cat, const char *name, const char *args, ... ) {
+
+	// Local variables
+	va_list ap;
+	double ts = crud_trace_now();
+	uint32_t tid;
+	char *event;
+	int n;
+
+	pthread_mutex_lock( &crud_trace_mutex );
+	if ( crud_trace_file != NULL ) {
+		tid = crud_trace_thread();
+		event = crud_trace_room();
+		n = snprintf( event, CRUD_TRACE_MAX_EVENT, "{\"ph\":\"B\",\"cat\":\"%s\",\"name\":\"%s\",\"ts\":%.3f,\"pid\":%d,\"tid\":%u",
+				cat, name, ts, getpid(), tid );
+		if ( args != NULL ) {
+			n += snprintf( &event[n], CRUD_TRACE_MAX_EVENT - n, ",\"args\":" );
+			va_start( ap, args );
+			n += vsnprintf( &event[n], CRUD_TRACE_MAX_EVENT - n, args, ap );
+			va_end( ap );
+		}
+		if ( n > CRUD_TRACE_MAX_EVENT - 2 ) {
+			n = CRUD_TRACE_MAX_EVENT - 2; // only when an argument is far too long
+		}
+		event[n++] = '}';
+		crud_trace_used += n;
+	}
+	pthread_mutex_unlock( &crud_trace_mutex );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : crud_trace_end
+// Description  : Close the innermost span of the calling thread
+//
+// Inputs       : none
+// Outputs      : none
+
+void crud_trace_end( void ) {
+
+	// Local variables
+	double ts = crud_trace_now();
+	uint32_t tid;
+
+	pthread_mutex_lock( &crud_trace_mutex );
+	if ( crud_trace_file != NULL ) {
+		tid = crud_trace_thread();
+		crud_trace_used += snprintf( crud_trace_room(), CRUD_TRACE_MAX_EVENT,
+				"{\"ph\":\"E\",\"ts\":%.3f,\"pid\":%d,\"tid\":%u}", ts, getpid(), tid );
+	}
+	pthread_mutex_unlock( &crud_trace_mutex );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : crudTraceUnitTest
+// Description  : Trace a few driver calls, then check the trace is complete:
+//                the spans balance, and the calls and their requests are in
+//                it
+//
+// Inputs       : none
+// Outputs      : 0 if successful or -1 if failure
+
+int crudTraceUnitTest( void ) {
+
+	// Local variables
+	char data[4096], line[CRUD_TRACE_MAX_EVENT + 16];
+	int depth = 0, deepest = 0, writes = 0, creates = 0, ret = 0;
+	int16_t fh;
+	FILE *trace;
+
+	// Trace a short session
+	memset( data, 'T', sizeof(data) );
+	if ( crud_trace_start(CRUD_TRACE_UNIT_TEST_FILE) ) {
+		return( -1 );
+	}
+	if ( crud_format() || crud_mount() || ((fh = crud_open("trace.dat")) == -1) ||
+			(crud_write(fh, data, sizeof(data)) != sizeof(data)) || crud_seek(fh, 0) ||
+			(crud_read(fh, data, sizeof(data)) != sizeof(data)) || crud_close(fh) || crud_unmount() ) {
+		CRUD_LOG( LOG_ERROR_LEVEL, "CRUD trace unit test: traced calls failed" );
+		ret = -1;
+	}
+	if ( crud_trace_stop() || (ret != 0) ) {
+		return( -1 );
+	}
+
+	// Read it back, one event per line
+	if ( (trace = fopen(CRUD_TRACE_UNIT_TEST_FILE, "r")) == NULL ) {
+		return( -1 );
+	}
+	while ( (ret == 0) && (fgets(line, sizeof(line), trace) != NULL) ) {
+		if ( strstr(line, "\"ph\":\"B\"") != NULL ) {
+			if ( ++depth > deepest ) {
+				deepest = depth;
+			}
+			writes += (strstr(line, "\"name\":\"crud_write\"") != NULL);
+			creates += (strstr(line, "\"name\":\"CRUD_CREATE\"") != NULL);
+		} else if ( (strstr(line, "\"ph\":\"E\"") != NULL) && (--depth < 0) ) {
+			ret = -1;
+		}
+	}
+	fclose( trace );
+	unlink( CRUD_TRACE_UNIT_TEST_FILE );
+	if ( (ret != 0) || (depth != 0) || (deepest < 2) || (writes != 1) || (creates == 0) ) {
+		CRUD_LOG( LOG_ERROR_LEVEL, "CRUD trace unit test: bad trace (depth %d, deepest %d, %d writes, %d creates)",
+				depth, deepest, writes, creates );
+		return( -1 );
+	}
+
+	// Return successfully
+	CRUD_LOG( LOG_INFO_LEVEL, "CRUD trace unit tests completed successfully." );
+	return( 0 );
+}
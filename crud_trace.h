@@ -0,0 +1,56 @@
+#ifndef CRUD_TRACE_INCLUDED
+#define CRUD_TRACE_INCLUDED
+
+////////////////////////////////////////////////////////////////////////////////
+//
+//  File           : crud_trace.h
+//  Description    : This is the interface for tracing the CRUD driver.  When
+//                   a trace is started, every interface call and every
+//                   request it sends to the object store is written as a
+//                   begin/end span to a Chrome trace (JSON) file, which
+//                   chrome://tracing or Perfetto can load.
+//
+//  Last Modified  : Sun Oct 18 18:02:44 EDT 2026
+//
+
+// Includes
+#include <stdint.h>
+
+// Defines
+#define CRUD_TRACE_BUFFER_SIZE (256*1024) // bytes of events held before a write
+#define CRUD_TRACE_MAX_EVENT 512          // longest event (with its arguments)
+
+// Open a span if tracing (the arguments are only formatted then)
+#define CRUD_TRACE_BEGIN(cat, name, ...) \
+	do { if ( crud_trace_enabled ) crud_trace_begin( (cat), (name), __VA_ARGS__ ); } while (0)
+
+// Close the innermost span of the thread if tracing
+#define CRUD_TRACE_END() \
+	do { if ( crud_trace_enabled ) crud_trace_end(); } while (0)
+
+// Flag indicating a trace is being written (use the macros)
+extern volatile int crud_trace_enabled;
+
+//
+// Tracing interface
+
+int crud_trace_start( const char *path );
+	// Start writing a trace to the file at path
+
+int crud_trace_stop( void );
+	// Write out the buffered events, finish and close the trace
+
+void crud_trace_begin( const char *cat, const char *name, const char *args, ... )
+		__attribute__((format(printf, 3, 4)));
+	// Open a span (args is a printf format of the JSON arguments, or NULL)
+
+void crud_trace_end( void );
+	// Close the innermost span of the thread
+
+//
+// Unit testing for the module
+
+int crudTraceUnitTest( void );
+	// Perform a test of the tracing
+
+#endif
@@ -0,0 +1,603 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+//  File          : crud_wlgen.c
+//  Description   : This is the synthetic workload generator for the CRUD
+//                  simulator.  It writes a workload in the crud_sim format
+//                  over any number of files: the file sizes and the files
+//                  each operation picks follow a uniform or a Zipf
+//                  distribution, operations are a read/write/seek mix at
+//                  sequential or random offsets, and the workload runs
+//                  until a total volume has been written.  It models the
+//                  files as it goes, so it can write the image each file
+//                  must have at the end for verification (crud_sim -x).
+//                  The workload is text, or compiled for fast replay.
+//
+//  Last Modified : Sun Oct 18 17:30:12 EDT 2026
+//
+
+// Include Files
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <math.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+
+// Project Includes
+#include <crud_workload.h>
+#include <crud_log.h>
+
+// Defines
+#define CRUD_WLGEN_ARGUMENTS "hs:f:b:S:w:d:a:m:r:c:p:o:i:B"
+#define CRUD_WLGEN_MAX_WRITE 960      // largest payload that fits a crud_sim line
+#define CRUD_WLGEN_MAX_COMPILED_WRITE 65536 // largest payload of a compiled workload
+#define CRUD_WLGEN_MAX_OPEN 128       // crud_sim keeps at most this many files open
+#define CRUD_WLGEN_SIZE_RANKS 4096    // ranks of the Zipf distribution of file sizes
+#define CRUD_WLGEN_MAX_SIZE (1024*1024*1024) // largest file (CRUD_MAX_FILE_SIZE)
+#define USAGE \
+	"USAGE: crud_wlgen [-h] [-s <seed>] [-f <files>] [-b <bytes>] [-S <bytes>] [-w <bytes>]\n" \
+	"                  [-d <dist>] [-a <dist>] [-m <r,w,s>] [-r <pct>] [-c <files>]\n" \
+	"                  [-p <prefix>] [-o <workload-file>] [-i <image-dir>] [-B]\n" \
+	"\n" \
+	"where:\n" \
+	"    -h - help mode (display this message)\n" \
+	"    -s - seed of the generator (default 1)\n" \
+	"    -f - number of files (default 16)\n" \
+	"    -b - total bytes to write, K/M/G suffixes allowed (default 1M)\n" \
+	"    -S - largest file size (default 64K)\n" \
+	"    -w - largest write or read (default 512, at most 960, or 64K compiled)\n" \
+	"    -d - distribution of the file sizes: uniform (default) or zipf[:<s>]\n" \
+	"    -a - distribution of the files used: uniform (default) or zipf[:<s>]\n" \
+	"    -m - percentages of reads, writes and seeks (default 20,70,10)\n" \
+	"    -r - percentage of operations at random offsets, the others are\n" \
+	"         sequential (default 0)\n" \
+	"    -c - files kept open at once, older ones are closed (default 64)\n" \
+	"    -p - prefix of the file names (default wl)\n" \
+	"    -o - write the workload to <workload-file> (default standard output)\n" \
+	"    -i - write the expected final image of each file into <image-dir>\n" \
+	"    -B - write a compiled (binary) workload, -o is then required\n" \
+	"\n"
+
+// Type definitions
+
+// This is a distribution to draw from (uniform, or Zipf with exponent s)
+typedef struct {
+	int       zipf;   // Nonzero for Zipf
+	double    s;      // The Zipf exponent
+	double   *cdf;    // The cumulative probability of each rank (Zipf only)
+	uint32_t  ranks;  // The number of ranks
+} CrudWlgenDist;
+
+// This is the model of a file of the workload
+typedef struct {
+	char      name[64];  // The file name
+	uint8_t  *image;     // The contents (target bytes)
+	uint32_t  target;    // The size the file grows up to
+	uint32_t  length;    // The length of the file
+	uint32_t  position;  // The position of the simulator's handle
+	uint32_t  cursor;    // The offset of the next sequential write
+	uint64_t  used;      // The operation that used the file last (0: not open)
+	int       created;   // Nonzero once the simulator opened the file
+} CrudWlgenFile;
+
+//
+// Global Data
+
+static uint64_t crud_wlgen_state = 1;     // The state of the generator
+static FILE *crud_wlgen_out;              // The workload being written (text)
+static CrudWorkloadWriter crud_wlgen_writer; // The workload being written (compiled)
+static int crud_wlgen_compiled = 0;       // Nonzero to write a compiled workload
+static int crud_wlgen_failed = 0;         // Nonzero once writing the workload failed
+static CrudWlgenFile *crud_wlgen_files;   // The files
+static uint32_t crud_wlgen_nfiles = 16;   // The number of files
+static uint32_t crud_wlgen_open = 0;      // The number of files open
+static uint32_t crud_wlgen_max_open = 64; // The most files open at once
+
+//
+// Functional Prototypes
+
+static uint64_t crud_wlgen_random( void );
+static int crud_wlgen_size( const char *arg, uint64_t *size );
+static int crud_wlgen_dist( const char *arg, CrudWlgenDist *dist, uint32_t ranks );
+static uint32_t crud_wlgen_draw( const CrudWlgenDist *dist );
+static void crud_wlgen_emit( CrudWorkloadCommand command, const char *name, uint32_t len, uint32_t off,
+		const char *data );
+static void crud_wlgen_use( CrudWlgenFile *file, uint64_t op );
+static int crud_wlgen_images( const char *dir );
+
+//
+// Functions
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : main
+// Description  : The main function for the workload generator
+//
+// Inputs       : argc - the number of command line parameters
+//                argv - the parameters
+// Outputs      : 0 if successful, -1 if failure
+
+int main( int argc, char *argv[] ) {
+
+	// Local variables
+	int ch, random_pct = 0, mix[3] = { 20, 70, 10 }, total, pick;
+	uint64_t volume = 1024*1024, max_size = 64*1024, max_write = 512, seed = 1;
+	uint64_t op, written = 0, read = 0, counts[3] = { 0, 0, 0 };
+	char *prefix = "wl", *output = NULL, *images = NULL, *payload;
+	CrudWlgenDist sizes = { 0 }, access = { 0 };
+	CrudWlgenFile *file;
+	uint32_t i, len, off;
+
+	// Process the command line parameters
+	while ( (ch = getopt(argc, argv, CRUD_WLGEN_ARGUMENTS)) != -1 ) {
+
+		switch ( ch ) {
+		case 'h': // Help, print usage
+			fprintf( stderr, USAGE );
+			return( -1 );
+
+		case 's': // Seed of the generator
+			seed = strtoull( optarg, NULL, 10 );
+			break;
+
+		case 'f': // Number of files
+			crud_wlgen_nfiles = strtoul( optarg, NULL, 10 );
+			break;
+
+		case 'b': // Total volume written
+			if ( crud_wlgen_size(optarg, &volume) ) {
+				fprintf( stderr, "Bad volume [%s], aborting.\n", optarg );
+				return( -1 );
+			}
+			break;
+
+		case 'S': // Largest file
+			if ( crud_wlgen_size(optarg, &max_size) || (max_size == 0) || (max_size > CRUD_WLGEN_MAX_SIZE) ) {
+				fprintf( stderr, "Bad file size [%s], aborting.\n", optarg );
+				return( -1 );
+			}
+			break;
+
+		case 'w': // Largest write or read
+			if ( crud_wlgen_size(optarg, &max_write) || (max_write == 0) || (max_write > CRUD_WLGEN_MAX_COMPILED_WRITE) ) {
+				fprintf( stderr, "Bad write size [%s], aborting.\n", optarg );
+				return( -1 );
+			}
+			break;
+
+		case 'd': // Distribution of file sizes
+			if ( crud_wlgen_dist(optarg, &sizes, 0) ) {
+				fprintf( stderr, "Bad size distribution [%s], aborting.\n", optarg );
+				return( -1 );
+			}
+			break;
+
+		case 'a': // Distribution of the files used
+			if ( crud_wlgen_dist(optarg, &access, 0) ) {
+				fprintf( stderr, "Bad access distribution [%s], aborting.\n", optarg );
+				return( -1 );
+			}
+			break;
+
+		case 'm': // Mix of reads, writes and seeks
+			if ( (sscanf(optarg, "%d,%d,%d", &mix[0], &mix[1], &mix[2]) != 3) ||
+					(mix[0] < 0) || (mix[1] <= 0) || (mix[2] < 0) ) {
+				fprintf( stderr, "Bad operation mix [%s], aborting.\n", optarg );
+				return( -1 );
+			}
+			break;
+
+		case 'r': // Random offsets
+			random_pct = atoi( optarg );
+			break;
+
+		case 'c': // Files open at once
+			crud_wlgen_max_open = strtoul( optarg, NULL, 10 );
+			if ( (crud_wlgen_max_open == 0) || (crud_wlgen_max_open > CRUD_WLGEN_MAX_OPEN) ) {
+				fprintf( stderr, "Bad open file count [%s], aborting.\n", optarg );
+				return( -1 );
+			}
+			break;
+
+		case 'p': // Prefix of the file names
+			prefix = optarg;
+			break;
+
+		case 'o': // The workload file
+			output = optarg;
+			break;
+
+		case 'i': // The directory of expected images
+			images = optarg;
+			break;
+
+		case 'B': // Compiled workload
+			crud_wlgen_compiled = 1;
+			break;
+
+		default:  // Default (unknown)
+			fprintf( stderr, "Unknown command line option (%c), aborting.\n", ch );
+			return( -1 );
+		}
+	}
+	if ( (crud_wlgen_nfiles == 0) || (strlen(prefix) > 32) ) {
+		fprintf( stderr, "Bad file count or prefix, aborting.\n" );
+		return( -1 );
+	}
+	if ( (! crud_wlgen_compiled) && (max_write > CRUD_WLGEN_MAX_WRITE) ) {
+		fprintf( stderr, "Writes of a text workload are at most %d bytes, aborting.\n", CRUD_WLGEN_MAX_WRITE );
+		return( -1 );
+	}
+	if ( crud_wlgen_compiled && (output == NULL) ) {
+		fprintf( stderr, "A compiled workload needs an output file (-o), aborting.\n" );
+		return( -1 );
+	}
+	initializeLogWithFilehandle( CMPSC311_LOG_STDERR );
+
+	// Set up the distributions and the files (each grows up to its target)
+	crud_wlgen_state = seed * 0x9e3779b97f4a7c15ULL + 1;
+	if ( crud_wlgen_dist(NULL, &sizes, (max_size < CRUD_WLGEN_SIZE_RANKS) ? max_size : CRUD_WLGEN_SIZE_RANKS) ||
+			crud_wlgen_dist(NULL, &access, crud_wlgen_nfiles) ||
+			((crud_wlgen_files = calloc(crud_wlgen_nfiles, sizeof(CrudWlgenFile))) == NULL) ) {
+		fprintf( stderr, "Out of memory, aborting.\n" );
+		return( -1 );
+	}
+	for ( i=0; i<crud_wlgen_nfiles; i++ ) {
+		file = &crud_wlgen_files[i];
+		snprintf( file->name, sizeof(file->name), "%s%05u.dat", prefix, i );
+		if ( sizes.zipf ) {
+			file->target = max_size / crud_wlgen_draw( &sizes );
+		} else {
+			file->target = 1 + crud_wlgen_random() % max_size;
+		}
+		if ( (images != NULL) && ((file->image = calloc(1, file->target)) == NULL) ) {
+			fprintf( stderr, "Out of memory for the file images, aborting.\n" );
+			return( -1 );
+		}
+	}
+
+	// Open the workload, it starts with a new file system
+	payload = malloc( max_write + 1 );
+	if ( crud_wlgen_compiled ) {
+		if ( crud_workload_create(&crud_wlgen_writer, output) ) {
+			return( -1 );
+		}
+	} else if ( output == NULL ) {
+		crud_wlgen_out = stdout;
+	} else if ( (crud_wlgen_out = fopen(output, "w")) == NULL ) {
+		fprintf( stderr, "Failure opening the workload file [%s], error: %s.\n", output, strerror(errno) );
+		return( -1 );
+	}
+	crud_wlgen_emit( CRUD_WORKLOAD_FORMAT, "x", 0, 0, NULL );
+	crud_wlgen_emit( CRUD_WORKLOAD_MOUNT, "x", 0, 0, NULL );
+
+	// Generate operations until the volume is written
+	total = mix[0] + mix[1] + mix[2];
+	for ( op=1; written<volume; op++ ) {
+
+		// Pick the file, then the operation (reads of an empty file write)
+		file = &crud_wlgen_files[crud_wlgen_draw(&access) - 1];
+		crud_wlgen_use( file, op );
+		pick = crud_wlgen_random() % total;
+		pick = (pick < mix[0]) ? 0 : (pick < mix[0] + mix[1]) ? 1 : 2;
+		if ( (pick != 1) && (file->length == 0) ) {
+			pick = 1;
+		}
+		len = 1 + crud_wlgen_random() % max_write;
+		counts[pick]++;
+
+		switch ( pick ) {
+		case 0: // Read, from a random offset or where the last one ended
+			if ( (int)(crud_wlgen_random() % 100) < random_pct ) {
+				off = crud_wlgen_random() % file->length;
+				crud_wlgen_emit( CRUD_WORKLOAD_SEEK, file->name, 0, off, NULL );
+				file->position = off;
+			} else if ( file->position >= file->length ) {
+				crud_wlgen_emit( CRUD_WORKLOAD_SEEK, file->name, 0, 0, NULL );
+				file->position = 0;
+			}
+			if ( len > file->length - file->position ) {
+				len = file->length - file->position;
+			}
+			crud_wlgen_emit( CRUD_WORKLOAD_READ, file->name, len, 0, NULL );
+			file->position += len;
+			read += len;
+			break;
+
+		case 1: // Write, at a random offset or where the last sequential one
+			// ended (appending until the target, then wrapping around)
+			if ( (int)(crud_wlgen_random() % 100) < random_pct ) {
+				off = crud_wlgen_random() % (((file->length < file->target) ? file->length : file->target - 1) + 1);
+				if ( len > file->target - off ) {
+					len = file->target - off;
+				}
+			} else {
+				off = (file->cursor < file->target) ? file->cursor : 0;
+				if ( len > file->target - off ) {
+					len = file->target - off;
+				}
+				file->cursor = off + len;
+			}
+			memset( payload, "abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789"[crud_wlgen_random() % 62], len );
+			payload[len] = 0x0;
+			if ( off != file->position ) {
+				crud_wlgen_emit( CRUD_WORKLOAD_WRITEAT, file->name, len, off, payload );
+			} else {
+				crud_wlgen_emit( CRUD_WORKLOAD_WRITE, file->name, len, 0, payload );
+			}
+			if ( file->image != NULL ) {
+				memcpy( &file->image[off], payload, len );
+			}
+			file->position = off + len;
+			if ( file->position > file->length ) {
+				file->length = file->position;
+			}
+			written += len;
+			break;
+
+		default: // Seek, anywhere up to the end
+			off = crud_wlgen_random() % (file->length + 1);
+			crud_wlgen_emit( CRUD_WORKLOAD_SEEK, file->name, 0, off, NULL );
+			file->position = off;
+			break;
+		}
+	}
+
+	// Unmount, then write the expected images
+	crud_wlgen_emit( CRUD_WORKLOAD_UNMOUNT, "x", 0, 0, NULL );
+	if ( crud_wlgen_compiled ) {
+		crud_wlgen_failed |= crud_workload_finish( &crud_wlgen_writer );
+	} else if ( (crud_wlgen_out != stdout) && fclose(crud_wlgen_out) ) {
+		crud_wlgen_failed = 1;
+	}
+	if ( crud_wlgen_failed ) {
+		fprintf( stderr, "Failure writing the workload file [%s], error: %s.\n", output, strerror(errno) );
+		return( -1 );
+	}
+	if ( (images != NULL) && crud_wlgen_images(images) ) {
+		return( -1 );
+	}
+	fprintf( stderr, "crud_wlgen: %lu operations (%lu reads, %lu writes, %lu seeks) on %u files, "
+			"%lu bytes written, %lu bytes read.\n", (unsigned long)(op - 1), (unsigned long)counts[0],
+			(unsigned long)counts[1], (unsigned long)counts[2], crud_wlgen_nfiles,
+			(unsigned long)written, (unsigned long)read );
+	return( 0 );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : crud_wlgen_random
+// Description  : Draw the next number of the generator (xorshift64*), so a
+//                seed gives the same workload everywhere
+//
+// Inputs       : none
+// Outputs      : the number
+
+static uint64_t crud_wlgen_random( void ) {
+	crud_wlgen_state ^= crud_wlgen_state >> 12;
+	crud_wlgen_state ^= crud_wlgen_state << 25;
+	crud_wlgen_state ^= crud_wlgen_state >> 27;
+	return( crud_wlgen_state * 0x2545f4914f6cdd1dULL );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : crud_wlgen_size
+// Description  : Parse a byte count with an optional K, M or G suffix
+//
+// Inputs       : arg - the argument
+//                size - the count (returned)
+// Outputs      : 0 if successful, -1 if failure
+
+static int crud_wlgen_size( const char *arg, uint64_t *size ) {
+
+	// Local variables
+	char *end;
+
+	// Reading the number, then scaling it by the suffix
+	*size = strtoull( arg, &end, 10 );
+	if ( end == arg ) {
+		return( -1 );
+	}
+	switch ( *end ) {
+	case 'G': case 'g':
+		*size *= 1024;
+		// Fall through
+	case 'M': case 'm':
+		*size *= 1024;
+		// Fall through
+	case 'K': case 'k':
+		*size *= 1024;
+		end++;
+		break;
+	}
+	return( (*end == 0x0) ? 0 : -1 );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : crud_wlgen_dist
+// Description  : Parse a distribution ("uniform" or "zipf[:<s>]"), or (with
+//                no argument) set it up over a number of ranks
+//
+// Inputs       : arg - the argument (NULL to set up)
+//                dist - the distribution
+//                ranks - the number of ranks (set up only)
+// Outputs      : 0 if successful, -1 if failure
+
+static int crud_wlgen_dist( const char *arg, CrudWlgenDist *dist, uint32_t ranks ) {
+
+	// Local variables
+	double sum = 0.0;
+	uint32_t i;
+
+	// Parsing the argument, Zipf has an exponent of 1 unless one is given
+	if ( arg != NULL ) {
+		if ( strcmp(arg, "uniform") == 0 ) {
+			dist->zipf = 0;
+		} else if ( strncmp(arg, "zipf", 4) == 0 ) {
+			dist->zipf = 1;
+			dist->s = 1.0;
+			if ( (arg[4] == ':') && ((sscanf(&arg[5], "%lf", &dist->s) != 1) || (dist->s <= 0.0)) ) {
+				return( -1 );
+			} else if ( (arg[4] != ':') && (arg[4] != 0x0) ) {
+				return( -1 );
+			}
+		} else {
+			return( -1 );
+		}
+		return( 0 );
+	}
+
+	// Setting up the cumulative probabilities of the ranks
+	dist->ranks = ranks;
+	if ( dist->zipf ) {
+		if ( (dist->cdf = malloc(ranks * sizeof(double))) == NULL ) {
+			return( -1 );
+		}
+		for ( i=0; i<ranks; i++ ) {
+			sum += 1.0 / pow( (double)(i + 1), dist->s );
+			dist->cdf[i] = sum;
+		}
+		for ( i=0; i<ranks; i++ ) {
+			dist->cdf[i] /= sum;
+		}
+	}
+	return( 0 );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : crud_wlgen_draw
+// Description  : Draw a rank from a distribution
+//
+// Inputs       : dist - the distribution
+// Outputs      : the rank (1 to the number of ranks)
+
+static uint32_t crud_wlgen_draw( const CrudWlgenDist *dist ) {
+
+	// Local variables
+	double u;
+	uint32_t lo, hi, mid;
+
+	// Uniform ranks are direct, Zipf ones search the cumulative probabilities
+	if ( ! dist->zipf ) {
+		return( 1 + crud_wlgen_random() % dist->ranks );
+	}
+	u = (double)(crud_wlgen_random() >> 11) / (double)(1ULL << 53);
+	lo = 0;
+	hi = dist->ranks - 1;
+	while ( lo < hi ) {
+		mid = (lo + hi) / 2;
+		if ( dist->cdf[mid] <= u ) {
+			lo = mid + 1;
+		} else {
+			hi = mid;
+		}
+	}
+	return( lo + 1 );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : crud_wlgen_emit
+// Description  : Add a command to the workload, as a line or a record
+//
+// Inputs       : command - the command
+//                name - the file name
+//                len - the length field
+//                off - the offset field
+//                data - the data of a write (len bytes, terminated)
+// Outputs      : none
+
+static void crud_wlgen_emit( CrudWorkloadCommand command, const char *name, uint32_t len, uint32_t off,
+		const char *data ) {
+
+	// Local variables
+	static const char *texts[CRUD_WORKLOAD_COMMANDS] = { "FORMAT", "MOUNT", "UNMOUNT", "MKDIR", "LIST",
+			"SNAPSHOT", "WRITEAT", "WRITE", "SEEK", "READ", "TRUNCATE", "RESERVE", "CLOSE", "FSYNC" };
+
+	// Writing the record, or the line
+	if ( crud_wlgen_compiled ) {
+		if ( crud_workload_add(&crud_wlgen_writer, command, name, len, off, data) ) {
+			crud_wlgen_failed = 1;
+		}
+	} else {
+		fprintf( crud_wlgen_out, "%s %s %u %u :%s\n", name, texts[command], len, off, (data != NULL) ? data : "" );
+	}
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : crud_wlgen_use
+// Description  : Note that an operation uses a file.  The simulator opens a
+//                file on its first use (at position 0), so when too many are
+//                open the one used longest ago is closed first.
+//
+// Inputs       : file - the file
+//                op - the operation
+// Outputs      : none
+
+static void crud_wlgen_use( CrudWlgenFile *file, uint64_t op ) {
+
+	// Local variables
+	CrudWlgenFile *oldest = NULL;
+	uint32_t i;
+
+	// Opening the file, closing the least recently used one if it must
+	if ( file->used == 0 ) {
+		if ( crud_wlgen_open == crud_wlgen_max_open ) {
+			for ( i=0; i<crud_wlgen_nfiles; i++ ) {
+				if ( (crud_wlgen_files[i].used != 0) && ((oldest == NULL) || (crud_wlgen_files[i].used < oldest->used)) ) {
+					oldest = &crud_wlgen_files[i];
+				}
+			}
+			crud_wlgen_emit( CRUD_WORKLOAD_CLOSE, oldest->name, 0, 0, NULL );
+			oldest->used = 0;
+			crud_wlgen_open--;
+		}
+		file->position = 0;
+		file->created = 1;
+		crud_wlgen_open++;
+	}
+	file->used = op;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : crud_wlgen_images
+// Description  : Write the expected image of every file the workload
+//                created into a directory (made if needed)
+//
+// Inputs       : dir - the directory
+// Outputs      : 0 if successful, -1 if failure
+
+static int crud_wlgen_images( const char *dir ) {
+
+	// Local variables
+	char path[512];
+	FILE *fh;
+	uint32_t i;
+
+	// Creating the directory, then a file per image
+	if ( (mkdir(dir, 0755) == -1) && (errno != EEXIST) ) {
+		fprintf( stderr, "Failure creating the image directory [%s], error: %s.\n", dir, strerror(errno) );
+		return( -1 );
+	}
+	for ( i=0; i<crud_wlgen_nfiles; i++ ) {
+		if ( ! crud_wlgen_files[i].created ) {
+			continue;
+		}
+		snprintf( path, sizeof(path), "%s/%s", dir, crud_wlgen_files[i].name );
+		if ( ((fh = fopen(path, "w")) == NULL) ||
+				(fwrite(crud_wlgen_files[i].image, 1, crud_wlgen_files[i].length, fh) != crud_wlgen_files[i].length) ||
+				fclose(fh) ) {
+			fprintf( stderr, "Failure writing the image [%s], error: %s.\n", path, strerror(errno) );
+			return( -1 );
+		}
+	}
+	return( 0 );
+}
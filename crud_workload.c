@@ -0,0 +1,629 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+//  File           : crud_workload.c
+//  Description    : This is the implementation of compiled CRUD workloads.
+//                   The compiler parses a text workload once, giving every
+//                   file name an id (through a small open addressing table)
+//                   and appending fixed size records, with the data of the
+//                   writes in a separate blob.  Mapping a compiled workload
+//                   checks every record once, so replay trusts them.
+//
+//  Last Modified  : Sun Oct 18 17:40:26 EDT 2026
+//
+
+// Includes
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+// Project Includes
+#include <crud_workload.h>
+#include <crud_log.h>
+
+// Defines
+#define CRUD_WORKLOAD_HASH_SLOTS 1024   // first size of the name table
+#define CRUD_WORKLOAD_COPY_SIZE 65536   // bytes copied at a time from the payload file
+#define CRUD_WORKLOAD_UNIT_TEST_FILES 3000
+#define CRUD_WORKLOAD_UNIT_TEST_TEXT "crud_workload_utest.txt"
+#define CRUD_WORKLOAD_UNIT_TEST_BINARY "crud_workload_utest.bin"
+
+// Type definitions
+
+// This is a text workload command: its name and the letters that must
+// match (the simulator always matched on a prefix)
+typedef struct {
+	const char          *name;
+	uint8_t              match;
+	CrudWorkloadCommand  command;
+} CrudWorkloadName;
+
+//
+// Global data
+
+// The commands, WRITEAT before the WRITE it starts with
+static const CrudWorkloadName crud_workload_names[] = {
+	{ "FORMAT",   6, CRUD_WORKLOAD_FORMAT },
+	{ "MOUNT",    5, CRUD_WORKLOAD_MOUNT },
+	{ "UNMOUNT",  5, CRUD_WORKLOAD_UNMOUNT },
+	{ "MKDIR",    5, CRUD_WORKLOAD_MKDIR },
+	{ "LIST",     4, CRUD_WORKLOAD_LIST },
+	{ "SNAPSHOT", 8, CRUD_WORKLOAD_SNAPSHOT },
+	{ "WRITEAT",  7, CRUD_WORKLOAD_WRITEAT },
+	{ "WRITE",    5, CRUD_WORKLOAD_WRITE },
+	{ "SEEK",     4, CRUD_WORKLOAD_SEEK },
+	{ "READ",     4, CRUD_WORKLOAD_READ },
+	{ "TRUNCATE", 8, CRUD_WORKLOAD_TRUNCATE },
+	{ "RESERVE",  7, CRUD_WORKLOAD_RESERVE },
+	{ "CLOSE",    5, CRUD_WORKLOAD_CLOSE },
+	{ "FSYNC",    5, CRUD_WORKLOAD_FSYNC },
+};
+
+//
+// Functional Prototypes
+
+static uint32_t crud_workload_hash( const char *name );
+static int crud_workload_file( CrudWorkloadWriter *writer, const char *name, uint32_t *file );
+static void crud_workload_release( CrudWorkloadWriter *writer );
+
+//
+// Functions
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : crud_workload_command
+// Description  : Get the command named by a text workload command
+//
+// Inputs       : command - the command text
+// Outputs      : the command, -1 if unknown
+
+int crud_workload_command( const char *command ) {
+
+	// Local variables
+	int i;
+
+	// Matching the prefix of each command in turn
+	for ( i=0; i<sizeof(crud_workload_names)/sizeof(CrudWorkloadName); i++ ) {
+		if ( strncmp(command, crud_workload_names[i].name, crud_workload_names[i].match) == 0 ) {
+			return( crud_workload_names[i].command );
+		}
+	}
+	return( -1 );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : crud_workload_create
+// Description  : Start writing a compiled workload (the header is written
+//                last, when the sizes are known)
+//
+// Inputs       : writer - the writer
+//                path - the compiled workload
+// Outputs      : 0 if successful, -1 if failure
+
+int crud_workload_create( CrudWorkloadWriter *writer, const char *path ) {
+
+	// Local variables
+	CrudWorkloadHeader header;
+
+	// Opening the workload with room for the header, and the payload file
+	memset( writer, 0x0, sizeof(CrudWorkloadWriter) );
+	memset( &header, 0x0, sizeof(header) );
+	if ( (writer->out = fopen(path, "w")) == NULL ) {
+		CRUD_LOG( LOG_ERROR_LEVEL, "CRUD workload: failed to create [%s], %s", path, strerror(errno) );
+		return( -1 );
+	}
+	if ( (fwrite(&header, sizeof(header), 1, writer->out) != 1) || ((writer->blob = tmpfile()) == NULL) ) {
+		CRUD_LOG( LOG_ERROR_LEVEL, "CRUD workload: failed to start [%s], %s", path, strerror(errno) );
+		crud_workload_release( writer );
+		return( -1 );
+	}
+	writer->hash_slots = CRUD_WORKLOAD_HASH_SLOTS;
+	writer->hash = calloc( writer->hash_slots, sizeof(uint32_t) );
+	return( 0 );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : crud_workload_add
+// Description  : Add a command to a compiled workload
+//
+// Inputs       : writer - the writer
+//                command - the command
+//                name - the file name
+//                length - the length field
+//                offset - the offset field
+//                data - the data of a write (length bytes)
+// Outputs      : 0 if successful, -1 if failure
+
+int crud_workload_add( CrudWorkloadWriter *writer, CrudWorkloadCommand command, const char *name,
+		int32_t length, int32_t offset, const char *data ) {
+
+	// Local variables
+	CrudWorkloadRecord record;
+
+	// Filling in the record, the data of a write goes in the blob
+	memset( &record, 0x0, sizeof(record) );
+	if ( crud_workload_file(writer, name, &record.file) ) {
+		return( -1 );
+	}
+	record.command = command;
+	record.length = length;
+	record.offset = offset;
+	if ( (command == CRUD_WORKLOAD_WRITE) || (command == CRUD_WORKLOAD_WRITEAT) ) {
+		if ( (length < 0) || (fwrite(data, 1, length, writer->blob) != length) ) {
+			CRUD_LOG( LOG_ERROR_LEVEL, "CRUD workload: failed to add a write of %d bytes", length );
+			return( -1 );
+		}
+		record.payload = writer->bytes;
+		writer->bytes += length;
+	}
+	if ( fwrite(&record, sizeof(record), 1, writer->out) != 1 ) {
+		CRUD_LOG( LOG_ERROR_LEVEL, "CRUD workload: failed to write a record, %s", strerror(errno) );
+		return( -1 );
+	}
+	writer->records++;
+	return( 0 );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : crud_workload_finish
+// Description  : Copy the payloads after the records, then write the names
+//                and the header, and close the workload
+//
+// Inputs       : writer - the writer
+// Outputs      : 0 if successful, -1 if failure
+
+int crud_workload_finish( CrudWorkloadWriter *writer ) {
+
+	// Local variables
+	CrudWorkloadHeader header;
+	char *buf = malloc( CRUD_WORKLOAD_COPY_SIZE );
+	size_t got;
+	int ret = 0;
+
+	// The payloads follow the records, and the names the payloads
+	memset( &header, 0x0, sizeof(header) );
+	memcpy( header.magic, CRUD_WORKLOAD_MAGIC, sizeof(header.magic) );
+	header.version = CRUD_WORKLOAD_VERSION;
+	header.files = writer->files;
+	header.records = writer->records;
+	header.payloads = sizeof(CrudWorkloadHeader) + writer->records * sizeof(CrudWorkloadRecord);
+	header.names = header.payloads + writer->bytes;
+	header.size = header.names + writer->name_bytes;
+	rewind( writer->blob );
+	while ( (got = fread(buf, 1, CRUD_WORKLOAD_COPY_SIZE, writer->blob)) > 0 ) {
+		if ( fwrite(buf, 1, got, writer->out) != got ) {
+			ret = -1;
+		}
+	}
+	if ( ferror(writer->blob) || (fwrite(writer->names, 1, writer->name_bytes, writer->out) != writer->name_bytes) ||
+			fseek(writer->out, 0, SEEK_SET) || (fwrite(&header, sizeof(header), 1, writer->out) != 1) ) {
+		ret = -1;
+	}
+	if ( fclose(writer->out) ) {
+		ret = -1;
+	}
+	writer->out = NULL;
+	if ( ret ) {
+		CRUD_LOG( LOG_ERROR_LEVEL, "CRUD workload: failed to finish the workload, %s", strerror(errno) );
+	}
+	free( buf );
+	crud_workload_release( writer );
+	return( ret );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : crud_workload_compile
+// Description  : Compile a text workload, parsed as the simulator parses it
+//                (the data of a write is the text after the colon, with
+//                '*' for a newline)
+//
+// Inputs       : text - the text workload
+//                path - the compiled workload
+// Outputs      : 0 if successful, -1 if failure
+
+int crud_workload_compile( const char *text, const char *path ) {
+
+	// Local variables
+	char *line = NULL, *sep, *data = NULL, fname[CRUD_WORKLOAD_MAX_NAME], command[CRUD_WORKLOAD_MAX_NAME];
+	size_t slots = 0;
+	int32_t len, off, data_slots = 0, i;
+	int fields, cmd, linecount = 0, ret = 0;
+	CrudWorkloadWriter writer;
+	FILE *fhandle;
+
+	// Open the text workload and the compiled one
+	if ( (fhandle = fopen(text, "r")) == NULL ) {
+		CRUD_LOG( LOG_ERROR_LEVEL, "CRUD workload: failed to open [%s], %s", text, strerror(errno) );
+		return( -1 );
+	}
+	if ( crud_workload_create(&writer, path) ) {
+		fclose( fhandle );
+		return( -1 );
+	}
+
+	// Each line is a command
+	while ( (ret == 0) && (getline(&line, &slots, fhandle) != -1) ) {
+		linecount++;
+		fields = sscanf( line, "%127s %127s %d %d", fname, command, &len, &off );
+		sep = strchr( line, ':' );
+		if ( (fields != 4) || (sep == NULL) || ((cmd = crud_workload_command(command)) == -1) ) {
+			CRUD_LOG( LOG_ERROR_LEVEL, "CRUD workload: un-parsable command in [%s], line %d", text, linecount );
+			ret = -1;
+			break;
+		}
+
+		// Copying the data of a write
+		if ( (cmd == CRUD_WORKLOAD_WRITE) || (cmd == CRUD_WORKLOAD_WRITEAT) ) {
+			if ( (len < 0) || (strlen(sep+1) < len) ) {
+				CRUD_LOG( LOG_ERROR_LEVEL, "CRUD workload: write is longer than its data in [%s], line %d", text, linecount );
+				ret = -1;
+				break;
+			}
+			if ( len > data_slots ) {
+				data_slots = len;
+				data = realloc( data, data_slots );
+			}
+			for ( i=0; i<len; i++ ) {
+				data[i] = (sep[i+1] == '*') ? '\n' : sep[i+1];
+			}
+		}
+		ret = crud_workload_add( &writer, cmd, fname, len, off, data );
+	}
+
+	// Clean up, finishing the workload even on failure to close it
+	free( line );
+	free( data );
+	fclose( fhandle );
+	if ( crud_workload_finish(&writer) || ret ) {
+		unlink( path );
+		return( -1 );
+	}
+	return( 0 );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : crud_workload_is_compiled
+// Description  : Check if a file starts with the magic of a compiled workload
+//
+// Inputs       : path - the file
+// Outputs      : 1 if it is a compiled workload, 0 otherwise
+
+int crud_workload_is_compiled( const char *path ) {
+
+	// Local variables
+	char magic[sizeof(CRUD_WORKLOAD_MAGIC)];
+	int fh, compiled;
+
+	// Reading the magic
+	if ( (fh = open(path, O_RDONLY)) == -1 ) {
+		return( 0 );
+	}
+	compiled = (read(fh, magic, sizeof(magic)-1) == sizeof(magic)-1) &&
+			(memcmp(magic, CRUD_WORKLOAD_MAGIC, sizeof(magic)-1) == 0);
+	close( fh );
+	return( compiled );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : crud_workload_map
+// Description  : Map a compiled workload and check it: the sections fit the
+//                file, every name is terminated and every record names a
+//                file, a command and (for writes) data that exist
+//
+// Inputs       : path - the compiled workload
+//                workload - the workload (returned)
+// Outputs      : 0 if successful, -1 if failure
+
+int crud_workload_map( const char *path, CrudWorkload *workload ) {
+
+	// Local variables
+	const CrudWorkloadHeader *header;
+	const CrudWorkloadRecord *record;
+	const char *name, *end;
+	struct stat st;
+	uint64_t i;
+	void *map;
+	int fh;
+
+	// Mapping the whole file, it is read front to back
+	memset( workload, 0x0, sizeof(CrudWorkload) );
+	if ( (fh = open(path, O_RDONLY)) == -1 ) {
+		CRUD_LOG( LOG_ERROR_LEVEL, "CRUD workload: failed to open [%s], %s", path, strerror(errno) );
+		return( -1 );
+	}
+	if ( fstat(fh, &st) || (st.st_size < sizeof(CrudWorkloadHeader)) ||
+			((map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fh, 0)) == MAP_FAILED) ) {
+		CRUD_LOG( LOG_ERROR_LEVEL, "CRUD workload: failed to map [%s]", path );
+		close( fh );
+		return( -1 );
+	}
+	close( fh );
+	madvise( map, st.st_size, MADV_SEQUENTIAL );
+	header = map;
+	workload->header = header;
+
+	// Checking the header fits the file
+	if ( (memcmp(header->magic, CRUD_WORKLOAD_MAGIC, sizeof(header->magic)) != 0) ||
+			(header->version != CRUD_WORKLOAD_VERSION) || (header->size != st.st_size) ||
+			(header->records > (header->size - sizeof(CrudWorkloadHeader)) / sizeof(CrudWorkloadRecord)) ||
+			(header->payloads != sizeof(CrudWorkloadHeader) + header->records * sizeof(CrudWorkloadRecord)) ||
+			(header->names < header->payloads) || (header->names > header->size) ) {
+		CRUD_LOG( LOG_ERROR_LEVEL, "CRUD workload: [%s] is not a valid compiled workload", path );
+		crud_workload_unmap( workload );
+		return( -1 );
+	}
+	workload->records = (const CrudWorkloadRecord *)&header[1];
+	workload->payloads = (const char *)map + header->payloads;
+
+	// Finding the names
+	workload->names = malloc( ((header->files > 0) ? header->files : 1) * sizeof(char *) );
+	name = (const char *)map + header->names;
+	end = (const char *)map + header->size;
+	for ( i=0; i<header->files; i++ ) {
+		workload->names[i] = name;
+		if ( (name == end) || ((name = memchr(name, 0x0, end - name)) == NULL) ) {
+			CRUD_LOG( LOG_ERROR_LEVEL, "CRUD workload: [%s] has a bad name table", path );
+			crud_workload_unmap( workload );
+			return( -1 );
+		}
+		name++;
+	}
+
+	// Checking the records
+	for ( i=0; i<header->records; i++ ) {
+		record = &workload->records[i];
+		if ( (record->file >= header->files) || (record->command >= CRUD_WORKLOAD_COMMANDS) ||
+				(((record->command == CRUD_WORKLOAD_WRITE) || (record->command == CRUD_WORKLOAD_WRITEAT)) &&
+				((record->length < 0) || (record->payload + record->length > header->names - header->payloads))) ) {
+			CRUD_LOG( LOG_ERROR_LEVEL, "CRUD workload: [%s] has a bad record (%lu)", path, (unsigned long)i );
+			crud_workload_unmap( workload );
+			return( -1 );
+		}
+	}
+	return( 0 );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : crud_workload_unmap
+// Description  : Unmap a compiled workload
+//
+// Inputs       : workload - the workload
+// Outputs      : none
+
+void crud_workload_unmap( CrudWorkload *workload ) {
+	if ( workload->header != NULL ) {
+		munmap( (void *)workload->header, workload->header->size );
+	}
+	free( workload->names );
+	memset( workload, 0x0, sizeof(CrudWorkload) );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : crud_workload_hash
+// Description  : Hash a file name (FNV-1a)
+//
+// Inputs       : name - the name
+// Outputs      : the hash
+
+static uint32_t crud_workload_hash( const char *name ) {
+
+	// Local variables
+	uint32_t hash = 2166136261U;
+
+	// Folding in each byte
+	while ( *name ) {
+		hash = (hash ^ (uint8_t)*name++) * 16777619U;
+	}
+	return( hash );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : crud_workload_file
+// Description  : Get the id of a file name, giving it the next one if it is
+//                new (the table doubles when half full)
+//
+// Inputs       : writer - the writer
+//                name - the name
+//                file - the id (returned)
+// Outputs      : 0 if successful, -1 if failure
+
+static int crud_workload_file( CrudWorkloadWriter *writer, const char *name, uint32_t *file ) {
+
+	// Local variables
+	uint32_t slot, *hash, i;
+	size_t len = strlen( name ) + 1;
+
+	// Looking the name up
+	slot = crud_workload_hash( name ) & (writer->hash_slots - 1);
+	while ( writer->hash[slot] != 0 ) {
+		if ( strcmp(&writer->names[writer->offsets[writer->hash[slot]-1]], name) == 0 ) {
+			*file = writer->hash[slot] - 1;
+			return( 0 );
+		}
+		slot = (slot + 1) & (writer->hash_slots - 1);
+	}
+
+	// Adding the name
+	if ( len > CRUD_WORKLOAD_MAX_NAME ) {
+		CRUD_LOG( LOG_ERROR_LEVEL, "CRUD workload: file name too long [%s]", name );
+		return( -1 );
+	}
+	if ( writer->name_bytes + len > writer->name_slots ) {
+		writer->name_slots = (writer->name_slots == 0) ? 4096 : writer->name_slots * 2;
+		writer->names = realloc( writer->names, writer->name_slots );
+	}
+	if ( (writer->files & 1023) == 0 ) {
+		writer->offsets = realloc( writer->offsets, (writer->files + 1024) * sizeof(uint64_t) );
+	}
+	memcpy( &writer->names[writer->name_bytes], name, len );
+	writer->offsets[writer->files] = writer->name_bytes;
+	writer->name_bytes += len;
+	writer->hash[slot] = writer->files + 1;
+	*file = writer->files++;
+
+	// Rehashing into a table twice the size when half full
+	if ( writer->files * 2 >= writer->hash_slots ) {
+		hash = calloc( writer->hash_slots * 2, sizeof(uint32_t) );
+		for ( i=0; i<writer->files; i++ ) {
+			slot = crud_workload_hash( &writer->names[writer->offsets[i]] ) & (writer->hash_slots * 2 - 1);
+			while ( hash[slot] != 0 ) {
+				slot = (slot + 1) & (writer->hash_slots * 2 - 1);
+			}
+			hash[slot] = i + 1;
+		}
+		free( writer->hash );
+		writer->hash = hash;
+		writer->hash_slots *= 2;
+	}
+	return( 0 );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : crud_workload_release
+// Description  : Release what a writer holds
+//
+// Inputs       : writer - the writer
+// Outputs      : none
+
+static void crud_workload_release( CrudWorkloadWriter *writer ) {
+	if ( writer->out != NULL ) {
+		fclose( writer->out );
+	}
+	if ( writer->blob != NULL ) {
+		fclose( writer->blob );
+	}
+	free( writer->names );
+	free( writer->offsets );
+	free( writer->hash );
+	memset( writer, 0x0, sizeof(CrudWorkloadWriter) );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : crudWorkloadUnitTest
+// Description  : Perform a test of the compiled workloads: a text workload
+//                compiles to the records it says, many files get their own
+//                ids, and broken workloads are refused
+//
+// Inputs       : None
+// Outputs      : 0 if successful or -1 if failure
+
+int crudWorkloadUnitTest( void ) {
+
+	// Local variables
+	CrudWorkloadWriter writer;
+	CrudWorkload workload;
+	const CrudWorkloadRecord *rec;
+	char name[32], data[64];
+	FILE *fh;
+	int i;
+
+	// Compile a small text workload and check what it became
+	if ( (fh = fopen(CRUD_WORKLOAD_UNIT_TEST_TEXT, "w")) == NULL ) {
+		CRUD_LOG( LOG_ERROR_LEVEL, "CRUD_WORKLOAD_UNIT_TEST : cannot write the text workload." );
+		return( -1 );
+	}
+	fprintf( fh, "x FORMAT 0 0:\nx MOUNT 0 0:\na.txt WRITE 5 0 :ab*cd\nb.txt WRITEAT 3 7 :xyz\n"
+			"a.txt SEEK 0 2 :\na.txt READ 3 0 :\nx UNMOUNT 0 0:\n" );
+	fclose( fh );
+	if ( crud_workload_compile(CRUD_WORKLOAD_UNIT_TEST_TEXT, CRUD_WORKLOAD_UNIT_TEST_BINARY) ||
+			(! crud_workload_is_compiled(CRUD_WORKLOAD_UNIT_TEST_BINARY)) ||
+			crud_workload_is_compiled(CRUD_WORKLOAD_UNIT_TEST_TEXT) ||
+			crud_workload_map(CRUD_WORKLOAD_UNIT_TEST_BINARY, &workload) ) {
+		CRUD_LOG( LOG_ERROR_LEVEL, "CRUD_WORKLOAD_UNIT_TEST : compiling the text workload failed." );
+		return( -1 );
+	}
+	rec = workload.records;
+	if ( (workload.header->records != 7) || (workload.header->files != 3) ||
+			(rec[0].command != CRUD_WORKLOAD_FORMAT) || (rec[6].command != CRUD_WORKLOAD_UNMOUNT) ||
+			(rec[2].command != CRUD_WORKLOAD_WRITE) || (rec[2].length != 5) ||
+			memcmp(&workload.payloads[rec[2].payload], "ab\ncd", 5) ||
+			(rec[3].command != CRUD_WORKLOAD_WRITEAT) || (rec[3].offset != 7) ||
+			memcmp(&workload.payloads[rec[3].payload], "xyz", 3) ||
+			(rec[4].command != CRUD_WORKLOAD_SEEK) || (rec[4].offset != 2) || (rec[5].length != 3) ||
+			(rec[2].file != rec[5].file) || strcmp(workload.names[rec[3].file], "b.txt") ) {
+		CRUD_LOG( LOG_ERROR_LEVEL, "CRUD_WORKLOAD_UNIT_TEST : the compiled workload is wrong." );
+		return( -1 );
+	}
+	crud_workload_unmap( &workload );
+
+	// Many files through the writer, each name keeps its id
+	if ( crud_workload_create(&writer, CRUD_WORKLOAD_UNIT_TEST_BINARY) ) {
+		return( -1 );
+	}
+	for ( i=0; i<CRUD_WORKLOAD_UNIT_TEST_FILES*2; i++ ) {
+		snprintf( name, sizeof(name), "dir/file%05d", (i * 7) % CRUD_WORKLOAD_UNIT_TEST_FILES );
+		memset( data, 'a' + i % 26, sizeof(data) );
+		if ( crud_workload_add(&writer, CRUD_WORKLOAD_WRITE, name, i % sizeof(data), 0, data) ) {
+			return( -1 );
+		}
+	}
+	if ( crud_workload_finish(&writer) || crud_workload_map(CRUD_WORKLOAD_UNIT_TEST_BINARY, &workload) ||
+			(workload.header->files != CRUD_WORKLOAD_UNIT_TEST_FILES) ) {
+		CRUD_LOG( LOG_ERROR_LEVEL, "CRUD_WORKLOAD_UNIT_TEST : writing many files failed." );
+		return( -1 );
+	}
+	for ( i=0; i<CRUD_WORKLOAD_UNIT_TEST_FILES*2; i++ ) {
+		rec = &workload.records[i];
+		snprintf( name, sizeof(name), "dir/file%05d", (i * 7) % CRUD_WORKLOAD_UNIT_TEST_FILES );
+		if ( strcmp(workload.names[rec->file], name) || (rec->length != i % sizeof(data)) ||
+				((rec->length > 0) && ((workload.payloads[rec->payload] != 'a' + i % 26) ||
+				(workload.payloads[rec->payload + rec->length - 1] != 'a' + i % 26))) ) {
+			CRUD_LOG( LOG_ERROR_LEVEL, "CRUD_WORKLOAD_UNIT_TEST : record %d of many files is wrong.", i );
+			return( -1 );
+		}
+	}
+	crud_workload_unmap( &workload );
+
+	// Unknown commands, short writes and a cut off workload are refused
+	if ( (fh = fopen(CRUD_WORKLOAD_UNIT_TEST_TEXT, "w")) == NULL ) {
+		return( -1 );
+	}
+	fprintf( fh, "x FORMAT 0 0:\na.txt SCRIBBLE 5 0 :abcde\n" );
+	fclose( fh );
+	if ( crud_workload_compile(CRUD_WORKLOAD_UNIT_TEST_TEXT, CRUD_WORKLOAD_UNIT_TEST_BINARY) == 0 ) {
+		CRUD_LOG( LOG_ERROR_LEVEL, "CRUD_WORKLOAD_UNIT_TEST : an unknown command compiled." );
+		return( -1 );
+	}
+	if ( (fh = fopen(CRUD_WORKLOAD_UNIT_TEST_TEXT, "w")) == NULL ) {
+		return( -1 );
+	}
+	fprintf( fh, "a.txt WRITE 9 0 :abc\n" );
+	fclose( fh );
+	if ( crud_workload_compile(CRUD_WORKLOAD_UNIT_TEST_TEXT, CRUD_WORKLOAD_UNIT_TEST_BINARY) == 0 ) {
+		CRUD_LOG( LOG_ERROR_LEVEL, "CRUD_WORKLOAD_UNIT_TEST : a write longer than its data compiled." );
+		return( -1 );
+	}
+	if ( (fh = fopen(CRUD_WORKLOAD_UNIT_TEST_TEXT, "w")) == NULL ) {
+		return( -1 );
+	}
+	fprintf( fh, "a.txt WRITE 3 0 :abc\n" );
+	fclose( fh );
+	if ( crud_workload_compile(CRUD_WORKLOAD_UNIT_TEST_TEXT, CRUD_WORKLOAD_UNIT_TEST_BINARY) ||
+			truncate(CRUD_WORKLOAD_UNIT_TEST_BINARY, sizeof(CrudWorkloadHeader) + sizeof(CrudWorkloadRecord) / 2) ||
+			(crud_workload_map(CRUD_WORKLOAD_UNIT_TEST_BINARY, &workload) == 0) ) {
+		CRUD_LOG( LOG_ERROR_LEVEL, "CRUD_WORKLOAD_UNIT_TEST : a cut off workload was mapped." );
+		return( -1 );
+	}
+	unlink( CRUD_WORKLOAD_UNIT_TEST_TEXT );
+	unlink( CRUD_WORKLOAD_UNIT_TEST_BINARY );
+
+	// Log, return successfully
+	CRUD_LOG( LOG_INFO_LEVEL, "CRUD workload unit tests completed successfully." );
+	return( 0 );
+}
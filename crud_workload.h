@@ -0,0 +1,129 @@
+#ifndef CRUD_WORKLOAD_INCLUDED
+#define CRUD_WORKLOAD_INCLUDED
+
+////////////////////////////////////////////////////////////////////////////////
+//
+//  File           : crud_workload.h
+//  Description    : This is the interface for compiled CRUD workloads.  A
+//                   text workload (crud_sim format) is compiled once into a
+//                   binary file: a header, fixed size records (file id,
+//                   command, length, offset and payload offset), the
+//                   payloads in one contiguous blob, and the file names.
+//                   The simulator maps the file and replays the records
+//                   without parsing anything.
+//
+//  Last Modified  : Sun Oct 18 17:40:26 EDT 2026
+//
+
+// Includes
+#include <stdio.h>
+#include <stdint.h>
+
+// Defines
+#define CRUD_WORKLOAD_MAGIC "CRUDWLB1"
+#define CRUD_WORKLOAD_VERSION 1
+#define CRUD_WORKLOAD_MAX_NAME 128     // bytes of a file name (with the terminator)
+
+// Type definitions
+
+// These are the workload commands (file commands open the file first)
+typedef enum {
+	CRUD_WORKLOAD_FORMAT   = 0,
+	CRUD_WORKLOAD_MOUNT    = 1,
+	CRUD_WORKLOAD_UNMOUNT  = 2,
+	CRUD_WORKLOAD_MKDIR    = 3,
+	CRUD_WORKLOAD_LIST     = 4,
+	CRUD_WORKLOAD_SNAPSHOT = 5,
+	CRUD_WORKLOAD_WRITEAT  = 6,  // the first file command
+	CRUD_WORKLOAD_WRITE    = 7,
+	CRUD_WORKLOAD_SEEK     = 8,
+	CRUD_WORKLOAD_READ     = 9,
+	CRUD_WORKLOAD_TRUNCATE = 10,
+	CRUD_WORKLOAD_RESERVE  = 11,
+	CRUD_WORKLOAD_CLOSE    = 12,
+	CRUD_WORKLOAD_FSYNC    = 13,
+	CRUD_WORKLOAD_COMMANDS = 14,
+} CrudWorkloadCommand;
+
+#define CRUD_WORKLOAD_FILE_COMMAND(c) ((c) >= CRUD_WORKLOAD_WRITEAT)
+
+// This is the header at the start of a compiled workload
+typedef struct {
+	char      magic[8];   // CRUD_WORKLOAD_MAGIC
+	uint32_t  version;    // CRUD_WORKLOAD_VERSION
+	uint32_t  files;      // The number of file names
+	uint64_t  records;    // The number of records
+	uint64_t  payloads;   // The offset of the payload blob (the records start after the header)
+	uint64_t  names;      // The offset of the names (each with its terminator, in file id order)
+	uint64_t  size;       // The size of the compiled workload
+} CrudWorkloadHeader;
+
+// This is a command of a compiled workload
+typedef struct {
+	uint32_t  file;       // The file id (the index of its name)
+	uint8_t   command;    // CrudWorkloadCommand
+	uint8_t   reserved[3];
+	int32_t   length;     // The length field of the command
+	int32_t   offset;     // The offset field of the command
+	uint64_t  payload;    // The offset of the data written in the payload blob
+} CrudWorkloadRecord;
+
+// This is a compiled workload mapped for replay
+typedef struct {
+	const CrudWorkloadHeader *header;   // The mapped file
+	const CrudWorkloadRecord *records;  // The records
+	const char               *payloads; // The payload blob
+	const char              **names;    // The name of each file id
+} CrudWorkload;
+
+// This is a compiled workload being written: the records are written as
+// they are added, the payloads go to a temporary file until the end
+typedef struct {
+	FILE      *out;       // The compiled workload
+	FILE      *blob;      // The payloads so far
+	uint64_t   records;   // The number of records written
+	uint64_t   bytes;     // The bytes of payload written
+	char      *names;     // The file names (each with its terminator)
+	uint64_t   name_bytes;// The bytes of names used
+	uint64_t   name_slots;// The bytes of names allocated
+	uint64_t  *offsets;   // The offset of each name (by file id)
+	uint32_t   files;     // The number of file ids
+	uint32_t  *hash;      // Open addressing table of file id + 1 by name
+	uint32_t   hash_slots;// The slots of the table (a power of two)
+} CrudWorkloadWriter;
+
+//
+// Workload interface
+
+int crud_workload_command( const char *command );
+	// Get the command named by a text workload command (-1 if unknown)
+
+int crud_workload_create( CrudWorkloadWriter *writer, const char *path );
+	// Start writing a compiled workload
+
+int crud_workload_add( CrudWorkloadWriter *writer, CrudWorkloadCommand command, const char *name,
+		int32_t length, int32_t offset, const char *data );
+	// Add a command (data holds length bytes for the write commands)
+
+int crud_workload_finish( CrudWorkloadWriter *writer );
+	// Write the payloads and names, then the header, and close the workload
+
+int crud_workload_compile( const char *text, const char *path );
+	// Compile a text workload
+
+int crud_workload_is_compiled( const char *path );
+	// Check if a file is a compiled workload (1), or not (0)
+
+int crud_workload_map( const char *path, CrudWorkload *workload );
+	// Map a compiled workload for replay
+
+void crud_workload_unmap( CrudWorkload *workload );
+	// Unmap a compiled workload
+
+//
+// Unit testing for the module
+
+int crudWorkloadUnitTest( void );
+	// Perform a test of the compiled workloads
+
+#endif